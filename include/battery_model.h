@@ -26,6 +26,7 @@
 #define BATTERY_MODEL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -36,16 +37,6 @@ extern "C" {
  */
 #define BATTERY_NAME_MAX_LENGTH 32
 
-/**
- * @brief Battery information sources. Currently used for smoothing the battery runtime.
- */
-typedef enum {
-   SOURCE_INA238,
-   SOURCE_DALYBMS,
-   SOURCE_UNIFIED,
-   SOURCE_MAX
-} battery_source_t;
-
 /**
  * @brief Battery chemistry types
  */
@@ -72,6 +63,7 @@ typedef struct {
    int cells_parallel;                 /**< Number of cells in parallel (default 1) */
    battery_chemistry_t chemistry;      /**< Battery chemistry type */
    char name[BATTERY_NAME_MAX_LENGTH]; /**< Battery type name */
+   float resistance_ohm;               /**< Estimated pack resistance, 0 if unknown */
 } battery_config_t;
 
 /**
@@ -87,15 +79,141 @@ typedef struct {
    bool valid;               /**< Whether the battery state is valid */
 } battery_state_t;
 
+/* Dense lookup tables. The discharge curve is sampled every 1 mV of cell
+ * voltage, its inverse every 0.1 % SOC and the capacity derating every
+ * 0.5 °C, so each query is one clamped index instead of a curve scan. */
+#define BATTERY_LUT_MAX_CELL_MV 1536  /* Widest cell voltage span, in 1 mV entries */
+#define BATTERY_LUT_SOC_STEPS 1000    /* Inverse table resolution (0.1 % SOC) */
+#define BATTERY_LUT_TEMP_MIN_C (-30)  /* Derating table range; clamped outside */
+#define BATTERY_LUT_TEMP_MAX_C 25
+#define BATTERY_LUT_TEMP_STEPS ((BATTERY_LUT_TEMP_MAX_C - BATTERY_LUT_TEMP_MIN_C) * 2 + 1)
+#define BATTERY_LUT_SOC_ONE 65535     /* Fixed-point 100 % SOC */
+#define BATTERY_LUT_FACTOR_ONE 32768  /* Fixed-point capacity factor 1.0 */
+
 /**
- * @brief Apply adaptive smoothing to battery runtime calculation
+ * @brief Precomputed SOC and derating tables for one chemistry and pack
+ */
+typedef struct {
+   battery_chemistry_t chemistry;                /**< Chemistry the tables were built for */
+   int cells_series;                             /**< Cells in series of the pack */
+   float cells_inv;                              /**< 1 / cells_series */
+   int cell_mv_min;                              /**< Cell voltage of soc_q[0] in mV */
+   int cell_mv_span;                             /**< Index of the last soc_q entry */
+   uint16_t soc_q[BATTERY_LUT_MAX_CELL_MV];      /**< SOC per 1 mV (BATTERY_LUT_SOC_ONE = 100 %) */
+   uint16_t cell_mv[BATTERY_LUT_SOC_STEPS + 1];  /**< Cell voltage in mV per 0.1 % SOC */
+   uint16_t temp_q[BATTERY_LUT_TEMP_STEPS];      /**< Capacity factor per 0.5 °C */
+   bool valid;                                   /**< Tables are built */
+} battery_lut_t;
+
+/* SOC estimator defaults, per cell. The discharge curves are measured under
+ * a typical load, so the ohmic term only has to cover the deviation from it. */
+#define BATTERY_EKF_R0_CELL 0.010f       /* Ohmic resistance (Ohm) */
+#define BATTERY_EKF_R1_CELL 0.010f       /* Polarization resistance (Ohm) */
+#define BATTERY_EKF_TAU_S 60.0f          /* Polarization time constant R1*C1 (s) */
+#define BATTERY_EKF_Q_SOC 1e-8f          /* SOC process noise (1/s) */
+#define BATTERY_EKF_Q_RC 1e-6f           /* Polarization process noise (V^2/s, per cell) */
+#define BATTERY_EKF_R_CELL_V 0.020f      /* Voltage measurement/model error (V, per cell) */
+#define BATTERY_EKF_MAX_DT_S 60.0f       /* Longer gaps are integrated as this */
+
+/**
+ * @brief Extended Kalman filter SOC estimator
  *
- * @param raw_time_min Raw calculated time in minutes
- * @param current_a Current in amps (used to detect significant changes)
- * @param source_id Identifier for the data source (to track separate states)
- * @return float Smoothed time in minutes
+ * 1-RC equivalent circuit of the whole pack: state is SOC and the voltage
+ * across the RC pair; the input is current (positive = discharge) and the
+ * measurement is terminal voltage. Coulomb counting drives the prediction,
+ * the voltage correction is weighted by the slope of the discharge curve,
+ * so on flat parts of a curve (LiFePO4) the estimate follows the current.
  */
-float smooth_battery_runtime(float raw_time_min, float current_a, battery_source_t source_id);
+typedef struct {
+   float soc;                 /**< State of charge (0-1) */
+   float v_rc;                /**< Voltage across the RC pair (V) */
+   float p[2][2];             /**< State covariance */
+   float r0;                  /**< Pack ohmic resistance (Ohm) */
+   float r1;                  /**< Pack polarization resistance (Ohm) */
+   float tau_s;               /**< RC time constant (s) */
+   float q_soc;               /**< SOC process noise (1/s) */
+   float q_rc;                /**< Polarization process noise (V^2/s) */
+   float r_v;                 /**< Voltage measurement variance (V^2) */
+   float capacity_as;         /**< Usable capacity (A*s) */
+   int cells_series;          /**< Cells in series */
+   const battery_lut_t *lut;  /**< Discharge curve tables (OCV and its inverse) */
+   bool initialized;          /**< First measurement seen */
+} battery_ekf_t;
+
+/* Internal resistance estimation. Load steps between consecutive samples
+ * give dV = -R * dI; R is fitted by recursive least squares with forgetting,
+ * so it follows ageing and temperature. The first well-established estimate
+ * becomes the baseline that the state-of-health ratio is measured against. */
+#define BATTERY_RINT_MIN_STEP_A 0.5f     /* Smallest current step used (A) */
+#define BATTERY_RINT_MAX_DT_S 10.0f      /* Samples further apart are not a step */
+#define BATTERY_RINT_MAX_OHM 5.0f        /* Implausible step ratios are ignored */
+#define BATTERY_RINT_LAMBDA 0.98f        /* RLS forgetting factor per step */
+#define BATTERY_RINT_P0 1000.0f          /* Initial RLS covariance (Ohm^2 A^2) */
+#define BATTERY_RINT_MIN_STEPS 5         /* Steps before the estimate is used */
+#define BATTERY_RINT_BASELINE_STEPS 50   /* Steps before the baseline is taken */
+#define BATTERY_CURVE_REF_C_RATE 0.2f    /* Load the discharge curves were taken at */
+#define BATTERY_RINT_INA238_PATH "/var/lib/oasis-stat/resistance-ina238"
+
+/**
+ * @brief Online internal resistance estimator for one voltage/current pair
+ *
+ * Zero-initialized state is valid. Resistance includes whatever fast
+ * polarization settles within one sample interval.
+ */
+typedef struct {
+   float r_ohm;        /**< Resistance estimate (Ohm) */
+   float p;            /**< RLS covariance */
+   float baseline_ohm; /**< SoH reference resistance, 0 until known */
+   float last_v;       /**< Previous voltage sample (V) */
+   float last_i;       /**< Previous current sample (A, positive = discharge) */
+   bool primed;        /**< A previous sample exists */
+   int steps;          /**< Load steps folded in */
+} battery_rint_t;
+
+/* Runtime prediction. The discharge current is forecast with Holt's linear
+ * smoothing (level and damped trend, gains scaled by the sample interval). Per-minute
+ * average loads go into a decaying histogram with BATTERY_RUNTIME_BINS_PER_OCTAVE
+ * log-spaced bins from BATTERY_RUNTIME_IDLE_A up; the mean loads of the bins
+ * holding its 10th/90th percentiles bound the forecast. Capacity is derated for temperature and Peukert's law. */
+#define BATTERY_RUNTIME_LEVEL_TAU_S 120.0f   /* Holt level time constant */
+#define BATTERY_RUNTIME_TREND_TAU_S 3600.0f  /* Holt trend time constant */
+#define BATTERY_RUNTIME_TREND_DAMP_H 0.5f    /* Trend and level fade to the mean over this */
+#define BATTERY_RUNTIME_BUCKET_S 60.0f       /* Load is histogrammed per this interval */
+#define BATTERY_RUNTIME_HIST_TAU_S 21600.0f  /* Load history memory (6 h) */
+#define BATTERY_RUNTIME_BINS 32              /* Bin 0 is idle; the top bin is ~130 A */
+#define BATTERY_RUNTIME_BINS_PER_OCTAVE 3
+#define BATTERY_RUNTIME_IDLE_A 0.1f          /* Lower loads count as idle */
+#define BATTERY_RUNTIME_PEUKERT_H 20.0f      /* Discharge time capacity is rated at */
+#define BATTERY_RUNTIME_MAX_MIN 9999.0f      /* Reported when idle or charging */
+
+/**
+ * @brief Load history and forecast state for one pack
+ *
+ * Zero-initialized state is valid; keep one instance per pack.
+ */
+typedef struct {
+   float level_a;                         /**< Holt level: smoothed discharge current (A) */
+   float trend_a_per_h;                   /**< Holt trend (A/h) */
+   float hist[BATTERY_RUNTIME_BINS];      /**< Decayed time spent at each load (buckets) */
+   float hist_load[BATTERY_RUNTIME_BINS]; /**< Decayed sum of bucket loads per bin (A) */
+   float hist_total;                      /**< Sum of hist */
+   float bucket_as;                       /**< Charge drawn in the open bucket (A*s) */
+   float bucket_s;                        /**< Seconds in the open bucket */
+   int samples;                           /**< Samples folded in */
+} battery_runtime_t;
+
+/**
+ * @brief Time-to-empty forecast
+ *
+ * p10 is the pessimistic bound (90 % chance to last at least that long, from
+ * the heavy end of the load history), p90 the optimistic one.
+ */
+typedef struct {
+   float p10_min; /**< Pessimistic time to empty (minutes) */
+   float p50_min; /**< Median time to empty (minutes) */
+   float p90_min; /**< Optimistic time to empty (minutes) */
+   float load_a;  /**< Forecast average discharge current (A) */
+} battery_runtime_forecast_t;
 
 /**
  * @brief Initialize battery configuration with default values
@@ -117,6 +235,218 @@ int init_battery_config(battery_config_t *config);
  */
 float battery_calculate_percentage(float voltage, const battery_config_t *battery);
 
+/**
+ * @brief Build the lookup tables for a battery configuration
+ *
+ * @param lut Table set to fill
+ * @param battery Battery configuration (chemistry and cells in series)
+ * @return int 0 on success, -1 if the configuration has no per-cell curve
+ */
+int battery_lut_build(battery_lut_t *lut, const battery_config_t *battery);
+
+/**
+ * @brief Build the default tables used by battery_calculate_percentage()
+ *
+ * Call once at startup for the configured battery. Configurations that do
+ * not match the tables keep using the curve interpolation.
+ *
+ * @param battery Configured battery
+ * @return int 0 on success, -1 if the configuration has no per-cell curve
+ */
+int battery_model_init_lut(const battery_config_t *battery);
+
+/**
+ * @brief Get the default tables
+ *
+ * @return const battery_lut_t* Tables built by battery_model_init_lut(), or NULL
+ */
+const battery_lut_t *battery_model_lut(void);
+
+/**
+ * @brief SOC for one cell voltage
+ *
+ * @param lut Built tables
+ * @param cell_voltage Cell voltage in Volts
+ * @return float Percentage (0-100%)
+ */
+float battery_lut_cell_percent(const battery_lut_t *lut, float cell_voltage);
+
+/**
+ * @brief Cell voltage at a given SOC (inverse of battery_lut_cell_percent())
+ *
+ * @param lut Built tables
+ * @param percent State of charge (0-100%)
+ * @return float Cell voltage in Volts
+ */
+float battery_lut_cell_voltage(const battery_lut_t *lut, float percent);
+
+/**
+ * @brief Capacity derating factor at a temperature
+ *
+ * @param lut Built tables
+ * @param temp_c Battery temperature in °C
+ * @return float Factor (0-1) relative to 25 °C
+ */
+float battery_lut_temp_factor(const battery_lut_t *lut, float temp_c);
+
+/**
+ * @brief SOC for many cells at once
+ *
+ * @param lut Built tables
+ * @param cell_mv Cell voltages in mV
+ * @param percent Output percentages (0-100%), n entries
+ * @param n Number of cells
+ */
+void battery_lut_cells_percent(const battery_lut_t *lut, const int *cell_mv, float *percent, int n);
+
+/**
+ * @brief SOC for many pack voltage samples at once
+ *
+ * @param lut Built tables
+ * @param pack_voltage Pack voltages in Volts
+ * @param percent Output percentages (0-100%), n entries
+ * @param n Number of samples
+ */
+void battery_lut_pack_percent(const battery_lut_t *lut,
+                              const float *pack_voltage,
+                              float *percent,
+                              int n);
+
+/**
+ * @brief Set up an SOC estimator for a pack
+ *
+ * The state is seeded from the voltage of the first update.
+ *
+ * @param ekf Estimator to initialize
+ * @param battery Battery configuration (capacity, cells in series/parallel)
+ * @param lut Tables built for the same battery; must outlive the estimator
+ * @return int 0 on success, -1 if the battery has no capacity or tables
+ */
+int battery_ekf_init(battery_ekf_t *ekf, const battery_config_t *battery, const battery_lut_t *lut);
+
+/**
+ * @brief Fold one voltage/current sample into the estimate
+ *
+ * Constant time, no allocation.
+ *
+ * @param ekf Initialized estimator
+ * @param voltage Pack terminal voltage in Volts
+ * @param current_a Pack current in Amps (positive = discharge)
+ * @param dt_s Seconds since the previous sample
+ */
+void battery_ekf_update(battery_ekf_t *ekf, float voltage, float current_a, float dt_s);
+
+/**
+ * @brief Estimated state of charge
+ *
+ * @param ekf Estimator
+ * @return float Percentage (0-100%)
+ */
+float battery_ekf_soc_percent(const battery_ekf_t *ekf);
+
+/**
+ * @brief One standard deviation of the SOC estimate
+ *
+ * @param ekf Estimator
+ * @return float Uncertainty in percentage points
+ */
+float battery_ekf_sigma_percent(const battery_ekf_t *ekf);
+
+/**
+ * @brief Feed one voltage/current sample to a resistance estimator
+ *
+ * Constant time; only samples that form a load step update the estimate.
+ *
+ * @param est Estimator state
+ * @param voltage Voltage in Volts (pack or cell)
+ * @param current_a Current in Amps (positive = discharge)
+ * @param dt_s Seconds since the previous sample
+ * @return bool true if the sample completed a step that was used
+ */
+bool battery_rint_update(battery_rint_t *est, float voltage, float current_a, float dt_s);
+
+/**
+ * @brief Whether the estimate has seen enough steps to be used
+ *
+ * @param est Estimator state
+ * @return bool true once BATTERY_RINT_MIN_STEPS steps were used
+ */
+bool battery_rint_valid(const battery_rint_t *est);
+
+/**
+ * @brief Resistance relative to the baseline (state-of-health indicator)
+ *
+ * @param est Estimator state
+ * @return float Ratio (1.0 = as new), 0 if no baseline or estimate yet
+ */
+float battery_rint_ratio(const battery_rint_t *est);
+
+/**
+ * @brief Load resistance baselines saved by battery_rint_save_baselines()
+ *
+ * @param path Baseline file
+ * @param ests Estimators, indexed as when saved
+ * @param n Number of estimators
+ * @return int Number of baselines loaded, -1 if the file cannot be read
+ */
+int battery_rint_load_baselines(const char *path, battery_rint_t *ests, int n);
+
+/**
+ * @brief Save the known resistance baselines
+ *
+ * The file is replaced atomically (temporary file + rename).
+ *
+ * @param path Baseline file
+ * @param ests Estimators
+ * @param n Number of estimators
+ * @return int 0 on success or when no baseline is known, -1 on error
+ */
+int battery_rint_save_baselines(const char *path, const battery_rint_t *ests, int n);
+
+/**
+ * @brief Fold one current sample into a runtime predictor
+ *
+ * Constant time, no allocation. Charging counts as no load.
+ *
+ * @param rt Predictor state
+ * @param current_a Pack current in Amps (positive = discharge)
+ * @param dt_s Seconds since the previous sample, negative if there was none
+ */
+void battery_runtime_update(battery_runtime_t *rt, float current_a, float dt_s);
+
+/**
+ * @brief Forecast time to empty
+ *
+ * @param rt Predictor state
+ * @param battery Battery configuration (chemistry and rated capacity), or NULL
+ *                to skip Peukert and temperature derating
+ * @param remaining_mah Remaining capacity at 25 °C and rated load
+ * @param temp_c Battery temperature, or below -100 if unknown
+ * @param out Forecast, each time capped at BATTERY_RUNTIME_MAX_MIN
+ * @return int 0 on success, -1 if no sample has been seen
+ */
+int battery_runtime_predict(const battery_runtime_t *rt,
+                            const battery_config_t *battery,
+                            float remaining_mah,
+                            float temp_c,
+                            battery_runtime_forecast_t *out);
+
+/**
+ * @brief Battery percentage with the load effect on voltage removed
+ *
+ * The terminal voltage is moved to the load the discharge curves were
+ * taken at (BATTERY_CURVE_REF_C_RATE) using battery->resistance_ohm, then
+ * looked up as usual. Without a resistance the reading is used as it is.
+ *
+ * @param voltage Pack terminal voltage
+ * @param current_a Pack current in Amps (positive = discharge)
+ * @param battery Battery configuration, with the resistance estimated for it
+ * @return float Percentage remaining (0-100%)
+ */
+float battery_calculate_percentage_loaded(float voltage,
+                                          float current_a,
+                                          const battery_config_t *battery);
+
 /**
  * @brief Estimate remaining battery time
  *
@@ -42,12 +42,51 @@ extern "C" {
 
 #define DALY_DEFAULT_BAUD 9600
 #define DALY_DEFAULT_TIMEOUT_MS 500
+
+/* RS-485 multi-drop. Each BMS on a shared segment has a board number; requests
+ * go to DALY_HOST_ADDR + (board - 1) and replies come from the board number,
+ * so board 1 is the plain single-BMS exchange. */
+#define DALY_BUS_MAX_ADDR 16         /* Highest board number probed by a bus scan */
+#define DALY_BUS_TURNAROUND_MS 5     /* Idle line time before addressing another board */
+#define DALY_BUS_SCAN_TIMEOUT_MS 150 /* Reply window per board during a scan */
+#define DALY_POLL_MAX_FRAMES 16      /* Multi-frame replies (0x95/0x96) kept per poll */
+
+/* Reply timeouts adapt to the measured round trip of each command: smoothed
+ * RTT plus four mean deviations, between DALY_RTT_FLOOR_MS and the device's
+ * configured timeout. A failed request is retried on its own. Every attempt
+ * that fails doubles the command's timeout until a first attempt succeeds
+ * again (RFC 6298 backoff), so a unit that slowed down is never locked out. */
+#define DALY_RTT_ALPHA 0.125f   /* Smoothed RTT gain */
+#define DALY_RTT_BETA 0.25f     /* RTT deviation gain */
+#define DALY_RTT_FLOOR_MS 40    /* Shortest timeout (9600 baud frame in and out ~27 ms) */
+#define DALY_REQUEST_RETRIES 1  /* Extra attempts for a failed request */
+#define DALY_LINK_CMDS 10       /* RTT slots: 0x90..0x98, then all other reads */
+#define DALY_LINK_OTHER (DALY_LINK_CMDS - 1)
+#define DALY_RTT_BUCKETS 8      /* Round-trip histogram: < 10, 20, 40 ... 640 ms, then longer */
+#define DALY_RTT_BUCKET0_MS 10
+
+/* Fields refreshed by a poll (daly_data_t.fields), one per read command */
+#define DALY_FIELD_PACK (1u << 0)     /* 0x90 voltage, current, SOC */
+#define DALY_FIELD_EXTREMES (1u << 1) /* 0x91 cell voltage extremes */
+#define DALY_FIELD_TEMPS (1u << 2)    /* 0x92 temperature extremes */
+#define DALY_FIELD_MOS (1u << 3)      /* 0x93 MOS state, cycles, remaining capacity */
+#define DALY_FIELD_STATUS (1u << 4)   /* 0x94 cell and sensor counts */
+#define DALY_FIELD_CELLS (1u << 5)    /* 0x95 cell voltages */
+#define DALY_FIELD_SENSORS (1u << 6)  /* 0x96 temperature sensors */
+#define DALY_FIELD_BALANCE (1u << 7)  /* 0x97 balancing */
+#define DALY_FIELD_FAULTS (1u << 8)   /* 0x98 fault flags */
+#define DALY_FIELD_ALL 0x1FFu
+
+/* Auto-detection: last good port/baud cache, and the udev tag that marks
+ * extra candidate ports (e.g. TAG+="oasis-daly" in a udev rule) */
+#define DALY_DETECT_CACHE_PATH "/var/lib/oasis-stat/daly-port"
+#define DALY_UDEV_TAG "oasis-daly"
 #define DALY_CURRENT_DEADBAND 0.15 /* Amps, to avoid mode flicker around zero */
 
 /* Maximum supported configuration */
 #define DALY_MAX_CELLS 32
 #define DALY_MAX_TEMPS 8
-#define DALY_MAX_FAULTS 32
+#define DALY_FAULT_CODES 64 /* 8 data bytes x 8 bits of command 0x98 */
 
 /* Command Codes */
 #define DALY_CMD_PACK_INFO 0x90      /* Basic pack info: voltage, current, SOC */
@@ -136,6 +175,20 @@ typedef struct {
    int dio_bits;         /**< Digital I/O bits */
 } daly_status_t;
 
+/**
+ * @brief Active fault flags; fault code N is bit N (byte N / 8, bit N % 8 of 0x98)
+ */
+typedef uint64_t daly_fault_bits_t;
+
+/**
+ * @brief Fault severity
+ */
+typedef enum {
+   DALY_FAULT_INFO = 0, /**< Informational or reserved */
+   DALY_FAULT_WARNING,  /**< Level 1 alarm or recoverable error */
+   DALY_FAULT_CRITICAL  /**< Level 2 alarm or hardware failure */
+} daly_fault_severity_t;
+
 /**
  * @brief Complete BMS data
  */
@@ -147,25 +200,77 @@ typedef struct {
    daly_status_t status;             /**< Status information */
    int cell_mv[DALY_MAX_CELLS];      /**< Individual cell voltages in mV */
    bool balance[DALY_MAX_CELLS];     /**< Cell balancing status */
-   char faults[DALY_MAX_FAULTS][64]; /**< Active fault descriptions */
+   daly_fault_bits_t faults;         /**< Active fault flags */
+   daly_fault_bits_t faults_raised;  /**< Flags that appeared in the latest poll */
+   daly_fault_bits_t faults_cleared; /**< Flags that went away in the latest poll */
    int fault_count;                  /**< Number of active faults */
+   unsigned fields;                  /**< DALY_FIELD_* refreshed by the latest poll; the
+                                          others hold values from earlier polls */
    time_t last_ok;                   /**< Timestamp of last successful update */
    char last_err[128];               /**< Last error message */
    bool valid;                       /**< Data validity flag */
 } daly_data_t;
 
+/**
+ * @brief Progress of a poll made one request at a time (see daly_bms_poll_step)
+ */
+typedef struct {
+   int step;                                /**< Next request of the poll sequence */
+   int attempts;                            /**< Requests made for a multi-frame reply */
+   int frame_count;                         /**< Frames kept for a multi-frame reply */
+   uint8_t frames[DALY_POLL_MAX_FRAMES][8]; /**< Their payloads */
+} daly_poll_state_t;
+
+/**
+ * @brief Quality statistics of one serial link
+ *
+ * Counted since the pack was first opened; reconnects keep them.
+ */
+typedef struct {
+   float srtt_ms[DALY_LINK_CMDS];   /**< Smoothed round trip per command, 0 until measured */
+   float rttvar_ms[DALY_LINK_CMDS]; /**< Its mean deviation */
+   uint8_t backoff[DALY_LINK_CMDS]; /**< Timeout doublings since the last first-attempt reply */
+   uint32_t rtt_hist[DALY_LINK_CMDS][DALY_RTT_BUCKETS]; /**< Measured round trips */
+   uint64_t bytes_read;      /**< Bytes received while waiting for replies */
+   uint32_t requests;        /**< Requests sent, retries included */
+   uint32_t retries;         /**< Requests repeated after a failure */
+   uint32_t timeouts;        /**< Requests that got no reply frame in time */
+   uint32_t resyncs;         /**< Runs of bytes skipped to find the next frame start */
+   uint32_t checksum_errors; /**< Frames with a bad checksum */
+   uint32_t mismatches;      /**< Intact frames from another board or for another command */
+} daly_link_t;
+
 /**
  * @brief Daly BMS device information
  */
 typedef struct {
-   int fd;           /**< Serial port file descriptor */
-   char port[64];    /**< Serial port path */
-   int baud;         /**< Baud rate */
-   int timeout_ms;   /**< Communication timeout in milliseconds */
-   bool initialized; /**< Initialization status */
-   daly_data_t data; /**< Most recent BMS data */
+   int fd;                 /**< Serial port file descriptor */
+   char port[64];          /**< Serial port path */
+   int baud;               /**< Baud rate */
+   int timeout_ms;         /**< Communication timeout in milliseconds */
+   uint8_t addr;           /**< Board number on an RS-485 segment (DALY_BMS_ADDR if alone) */
+   bool shared;            /**< Port opened by another device on the segment */
+   bool initialized;       /**< Initialization status */
+   daly_poll_state_t poll; /**< Poll in progress */
+   daly_link_t link;       /**< Link quality and round-trip statistics */
+   daly_data_t data;       /**< Most recent BMS data */
 } daly_device_t;
 
+/**
+ * @brief Frame-level taps used to record and replay BMS traffic
+ *
+ * on_frame is called after every request with the complete response frame
+ * (DALY_FRAME_LEN bytes), or NULL if the exchange failed. When fetch_frame is
+ * set it replaces the serial transaction: it fills a DALY_FRAME_LEN-byte frame
+ * and returns 0, or returns -1 to reproduce a failed exchange. Fetched frames
+ * are validated exactly like frames read from the port.
+ */
+typedef struct {
+   void (*on_frame)(void *ctx, const daly_device_t *dev, uint8_t cmd, const uint8_t *frame);
+   int (*fetch_frame)(void *ctx, const daly_device_t *dev, uint8_t cmd, uint8_t *frame);
+   void *ctx; /**< Passed back to both callbacks */
+} daly_frame_hooks_t;
+
 /**
  * @brief Capacity information
  */
@@ -174,46 +279,84 @@ typedef struct {
    int nominal_cell_mv;    /**< Nominal cell voltage in mV */
 } daly_capacity_t;
 
-/**
- * @brief Cell health information
- */
-typedef struct {
-   int status;      /**< Cell health status (NORMAL, WARNING, CRITICAL) */
-   float voltage;   /**< Cell voltage in Volts */
-   int cell_index;  /**< Cell index (1-based) */
-   bool balancing;  /**< Whether the cell is balancing */
-   char reason[64]; /**< Reason for WARNING/CRITICAL status */
-} daly_cell_health_t;
+/* Rolling cell statistics. Each cell's deviation from the pack mean is
+ * smoothed with an EWMA and its trend fitted by exponentially weighted least
+ * squares, so a cell that is slowly pulling away from the rest of the pack is
+ * reported as drifting before it reaches the warning threshold. */
+#define DALY_HEALTH_EWMA_TAU_S 600.0            /* EWMA time constant (10 min) */
+#define DALY_HEALTH_DRIFT_TAU_S (24.0 * 3600.0) /* Trend fit memory (1 day) */
+#define DALY_HEALTH_DRIFT_MIN_SPAN_S (6 * 3600) /* History needed before trusting a trend */
+#define DALY_HEALTH_DRIFT_HORIZON_H 72.0        /* Look-ahead for the drift warning */
+
+/* Saved pack and per-cell resistance baselines (daly_pack_health_t.rint) */
+#define DALY_RINT_PATH "/var/lib/oasis-stat/resistance-daly"
 
 /**
- * @brief Enhanced battery health status
+ * @brief Pack and per-cell health
+ *
+ * Fixed size, struct-of-arrays layout indexed by cell (0-based). The caller
+ * owns one instance per pack and passes it to every daly_bms_analyze_health()
+ * call; the rolling statistics live here, so it must not be cleared between
+ * polls. Zero-initialize it (or call daly_bms_reset_health()) once.
  */
 typedef struct {
-   int overall_status;        /**< Overall health status (NORMAL, WARNING, CRITICAL) */
-   float vmax;                /**< Maximum cell voltage */
-   float vmin;                /**< Minimum cell voltage */
-   float vdelta;              /**< Voltage delta between max and min */
-   float vavg;                /**< Average cell voltage */
-   daly_cell_health_t *cells; /**< Array of cell health information */
-   int cell_count;            /**< Number of cells */
-   int problem_cell_count;    /**< Number of problem cells */
-   char status_reason[128];   /**< Reason for overall status */
+   /* Pack summary, recomputed on every analysis */
+   int overall_status;       /**< Overall health status (NORMAL, WARNING, CRITICAL) */
+   float vmax;               /**< Maximum cell voltage */
+   float vmin;               /**< Minimum cell voltage */
+   float vdelta;             /**< Voltage delta between max and min */
+   float vavg;               /**< Average cell voltage */
+   int cell_count;           /**< Number of cells */
+   int problem_cell_count;   /**< Number of cells in WARNING or CRITICAL */
+   int drifting_cell_count;  /**< Number of NORMAL cells trending toward WARNING */
+   char status_reason[128];  /**< Reason for overall status */
+   uint32_t changed;         /**< Bit i set if cell i's status or reason changed last analysis */
+
+   /* Per-cell results */
+   float voltage[DALY_MAX_CELLS];      /**< Cell voltage in Volts */
+   float deviation_mv[DALY_MAX_CELLS]; /**< Signed deviation from the pack mean in mV */
+   uint8_t status[DALY_MAX_CELLS];     /**< Cell health status (NORMAL, WARNING, CRITICAL) */
+   uint8_t cause[DALY_MAX_CELLS];      /**< Internal: reason code behind status */
+   bool balancing[DALY_MAX_CELLS];     /**< Whether the cell is balancing */
+   bool drifting[DALY_MAX_CELLS];      /**< NORMAL cell projected to reach WARNING */
+   char reason[DALY_MAX_CELLS][64];    /**< Formatted when the cell's status changes */
+
+   /* Rolling statistics, carried across analyses */
+   float ewma_mv[DALY_MAX_CELLS];          /**< EWMA of the deviation in mV */
+   float ewvar_mv2[DALY_MAX_CELLS];        /**< EW variance of the deviation in mV^2 */
+   float drift_mv_per_day[DALY_MAX_CELLS]; /**< Fitted deviation trend in mV/day */
+   double fit_sy[DALY_MAX_CELLS];          /**< Trend fit: weighted sum of deviations */
+   double fit_sty[DALY_MAX_CELLS];         /**< Trend fit: weighted sum of age x deviation */
+   double fit_sw;                          /**< Trend fit: sum of weights */
+   double fit_st;                          /**< Trend fit: weighted sum of sample ages */
+   double fit_stt;                         /**< Trend fit: weighted sum of squared ages */
+   battery_rint_t rint[DALY_MAX_CELLS + 1]; /**< Resistance: [0] pack, [1 + i] cell i */
+   battery_runtime_t runtime;              /**< Pack load history and runtime forecast */
+   time_t first_sample;                    /**< Time of the first sample in the statistics */
+   time_t last_sample;                     /**< Time of the latest cell sample */
+   time_t last_pack_sample;                /**< Time of the latest pack sample, 0 before any */
+   int samples;                            /**< Cell samples folded into the statistics */
 } daly_pack_health_t;
 
 /**
  * @brief Fault severity categories
  */
 typedef struct {
-   int critical_count;                            /**< Number of critical faults */
-   int warning_count;                             /**< Number of warning faults */
-   int info_count;                                /**< Number of informational faults */
-   char critical_faults[DALY_MAX_FAULTS / 2][64]; /**< Critical fault descriptions */
-   char warning_faults[DALY_MAX_FAULTS / 2][64];  /**< Warning fault descriptions */
-   char info_faults[DALY_MAX_FAULTS / 2][64];     /**< Informational fault descriptions */
+   int critical_count;         /**< Number of critical faults */
+   int warning_count;          /**< Number of warning faults */
+   int info_count;             /**< Number of informational faults */
+   daly_fault_bits_t critical; /**< Critical fault flags */
+   daly_fault_bits_t warning;  /**< Warning fault flags */
+   daly_fault_bits_t info;     /**< Informational fault flags */
 } daly_fault_summary_t;
 
 /**
- * @brief Auto-detect Daly BMS on common serial ports
+ * @brief Auto-detect Daly BMS on the available serial ports
+ *
+ * The port/baud from the detect cache is tried first. Otherwise every
+ * /dev/serial/by-id link, every port udev tagged DALY_UDEV_TAG and the common
+ * fixed ports (ttyTHS1/0, ttyS0, ttyUSB0, ttyACM0) are probed concurrently,
+ * one baud rate at a time, and the first to answer wins and is cached.
  *
  * @param detected_port Buffer to store detected port path (must be at least 64 bytes)
  * @param detected_baud Pointer to store detected baud rate
@@ -221,6 +364,13 @@ typedef struct {
  */
 bool daly_bms_auto_detect(char *detected_port, int *detected_baud);
 
+/**
+ * @brief Set the file daly_bms_auto_detect() caches its result in
+ *
+ * @param path Cache file path (default DALY_DETECT_CACHE_PATH), or NULL/"" to disable
+ */
+void daly_bms_set_detect_cache(const char *path);
+
 /**
  * @brief Initialize the Daly BMS device
  *
@@ -232,6 +382,51 @@ bool daly_bms_auto_detect(char *detected_port, int *detected_baud);
  */
 int daly_bms_init(daly_device_t *dev, const char *port, int baud, int timeout_ms);
 
+/**
+ * @brief Initialize a device that has no serial port behind it
+ *
+ * Used with a fetch_frame hook (see daly_bms_set_frame_hooks) to run the poll,
+ * parse and health pipeline against recorded frames.
+ *
+ * @param dev Pointer to device structure
+ * @param label Name stored in dev->port for display/logging
+ * @param timeout_ms Communication timeout in milliseconds (unused by hooks)
+ * @return int 0 on success, negative on error
+ */
+int daly_bms_init_offline(daly_device_t *dev, const char *label, int timeout_ms);
+
+/**
+ * @brief Initialize a device for another BMS on an already open RS-485 segment
+ *
+ * The device shares the port of bus; closing it leaves the port open.
+ *
+ * @param dev Pointer to device structure
+ * @param bus Initialized device that opened the segment
+ * @param addr Board number of the BMS (1..DALY_BUS_MAX_ADDR)
+ * @return int 0 on success, negative on error
+ */
+int daly_bms_attach(daly_device_t *dev, const daly_device_t *bus, uint8_t addr);
+
+/**
+ * @brief Find the BMS units answering on an RS-485 segment
+ *
+ * Sends a pack info request to every board number from 1 to DALY_BUS_MAX_ADDR
+ * with a short reply window.
+ *
+ * @param dev Initialized device on the segment (its address is restored)
+ * @param found Board numbers that answered, in increasing order
+ * @param max_found Capacity of found
+ * @return int Number of boards found, negative on error
+ */
+int daly_bms_scan_bus(daly_device_t *dev, uint8_t *found, int max_found);
+
+/**
+ * @brief Install frame record/replay hooks for all devices
+ *
+ * @param hooks Hooks to copy, or NULL to clear them
+ */
+void daly_bms_set_frame_hooks(const daly_frame_hooks_t *hooks);
+
 /**
  * @brief Close the Daly BMS device
  *
@@ -242,11 +437,46 @@ void daly_bms_close(daly_device_t *dev);
 /**
  * @brief Poll all data from the Daly BMS
  *
+ * A poll succeeds when the pack info (0x90) is read; every other command
+ * that fails after its retry leaves its field stale, see data.fields.
+ *
  * @param dev Pointer to device structure
  * @return int 0 on success, negative on error
  */
 int daly_bms_poll(daly_device_t *dev);
 
+/**
+ * @brief Start a poll that is advanced one request at a time
+ *
+ * @param dev Pointer to device structure
+ * @return int 0 on success, negative on error
+ */
+int daly_bms_poll_begin(daly_device_t *dev);
+
+/**
+ * @brief Make the next request of a poll started with daly_bms_poll_begin()
+ *
+ * @param dev Pointer to device structure
+ * @return int 1 if more requests remain, 0 once the poll completed and the
+ *         data is valid, negative if it failed
+ */
+int daly_bms_poll_step(daly_device_t *dev);
+
+/**
+ * @brief Poll several BMS units sharing one RS-485 segment
+ *
+ * Each unit's requests run back to back, with turnaround_ms of idle line
+ * only when the next unit is addressed. A unit that fails a required request
+ * ends its poll there and the next unit follows.
+ *
+ * @param devs Devices on the segment
+ * @param count Number of devices
+ * @param turnaround_ms Idle time before addressing another board
+ * @param results Per device: 0 if its poll completed, negative if it failed
+ * @return int Number of devices polled successfully
+ */
+int daly_bms_poll_bus(daly_device_t **devs, int count, int turnaround_ms, int *results);
+
 /**
  * @brief Read rated capacity from the Daly BMS
  *
@@ -259,19 +489,23 @@ int daly_bms_read_capacity(daly_device_t *dev, daly_capacity_t *capacity);
 /**
  * @brief Write rated capacity to the Daly BMS
  *
+ * The write is sent once and confirmed by reading the capacity back.
+ *
  * @param dev Pointer to device structure
  * @param capacity_mah Rated capacity in mAh
  * @param nominal_cell_mv Nominal cell voltage in mV
- * @return int 0 on success, negative on error
+ * @return int 0 if the BMS reads back the written values, negative otherwise
  */
 int daly_bms_write_capacity(daly_device_t *dev, int capacity_mah, int nominal_cell_mv);
 
 /**
  * @brief Write SOC to the Daly BMS
  *
+ * The write is sent once and confirmed by the SOC in a fresh 0x90 reply.
+ *
  * @param dev Pointer to device structure
  * @param soc_percent SOC percentage (0-100)
- * @return int 0 on success, negative on error
+ * @return int 0 if the BMS reports the written SOC, negative otherwise
  */
 int daly_bms_write_soc(daly_device_t *dev, float soc_percent);
 
@@ -313,11 +547,42 @@ bool daly_bms_infer_load(float current_a, bool dsg_mos, float threshold);
  */
 void daly_bms_print_data(const daly_device_t *dev);
 
+/**
+ * @brief Command whose round trips a link statistics slot holds
+ *
+ * @param slot Slot, 0 to DALY_LINK_CMDS - 1
+ * @return int Command, or -1 for DALY_LINK_OTHER (any other read)
+ */
+int daly_bms_link_cmd(int slot);
+
+/**
+ * @brief Current reply timeout for a link statistics slot
+ *
+ * The RTT estimate, doubled for each pending backoff step, within
+ * DALY_RTT_FLOOR_MS and the configured timeout.
+ *
+ * @param dev Pointer to device structure
+ * @param slot Slot, 0 to DALY_LINK_CMDS - 1
+ * @return int Timeout in milliseconds
+ */
+int daly_bms_link_timeout(const daly_device_t *dev, int slot);
+
+/**
+ * @brief Print serial link quality statistics in human-readable format
+ *
+ * @param dev Pointer to device structure
+ */
+void daly_bms_print_link(const daly_device_t *dev);
+
 /**
  * @brief Analyze cell health status
  *
+ * Does not allocate. Cell reasons are only formatted when a cell changes
+ * status; a change in cell count resets the rolling statistics. Pack and
+ * cell resistance estimates are updated from the load steps between polls.
+ *
  * @param dev Pointer to device structure
- * @param health Pointer to health structure to fill
+ * @param health Health state of this pack, updated in place
  * @param warning_threshold_mv Threshold for WARNING status in mV
  * @param critical_threshold_mv Threshold for CRITICAL status in mV
  * @return int Overall health status
@@ -328,21 +593,59 @@ int daly_bms_analyze_health(daly_device_t *dev,
                             int critical_threshold_mv);
 
 /**
- * @brief Free resources allocated for pack health
+ * @brief Forget all health results and rolling statistics
  *
  * @param health Pointer to pack health structure
  */
-void daly_bms_free_health(daly_pack_health_t *health);
+void daly_bms_reset_health(daly_pack_health_t *health);
 
 /**
  * @brief Categorize BMS faults by severity
  *
+ * Pure bit operations on the active fault flags; no strings are built.
+ *
  * @param dev Pointer to device structure
  * @param summary Pointer to fault summary structure to fill
  * @return int 0 on success, negative on error
  */
 int daly_bms_categorize_faults(const daly_device_t *dev, daly_fault_summary_t *summary);
 
+/**
+ * @brief Get the description of a fault code
+ *
+ * @param code Fault code (0 to DALY_FAULT_CODES - 1)
+ * @return const char* Static description, "Unknown" if out of range
+ */
+const char *daly_fault_description(int code);
+
+/**
+ * @brief Get the severity of a fault code
+ *
+ * @param code Fault code (0 to DALY_FAULT_CODES - 1)
+ * @return daly_fault_severity_t Severity, DALY_FAULT_INFO if out of range
+ */
+daly_fault_severity_t daly_fault_severity(int code);
+
+/**
+ * @brief Get the fault codes of one severity as a bit mask
+ *
+ * Built from the fault table, so it always agrees with daly_fault_severity().
+ *
+ * @param severity Severity to select
+ * @return daly_fault_bits_t Bit n set when code n has that severity
+ */
+daly_fault_bits_t daly_fault_mask(daly_fault_severity_t severity);
+
+/**
+ * @brief Remove the lowest fault code from a set of flags
+ *
+ * Iterate with: while ((code = daly_fault_next(&bits)) >= 0) { ... }
+ *
+ * @param bits Fault flags; the returned code is cleared
+ * @return int Lowest fault code that was set, -1 if none remain
+ */
+int daly_fault_next(daly_fault_bits_t *bits);
+
 /**
  * @brief Get string representation of health status
  *
@@ -360,6 +663,15 @@ const char *daly_bms_health_string(int status);
  */
 float daly_bms_estimate_runtime(const daly_device_t *dev, const battery_config_t *batt_config);
 
+/**
+ * @brief Remaining pack capacity: the BMS counter, else its SOC of the rated capacity
+ *
+ * @param data Pack data
+ * @param batt_config Battery configuration for the rated capacity, or NULL
+ * @return float Remaining capacity in mAh, 0 if unknown
+ */
+float daly_bms_remaining_mah(const daly_data_t *data, const battery_config_t *batt_config);
+
 /**
  * @brief Check if cell balancing is active
  *
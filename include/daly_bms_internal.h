@@ -23,6 +23,7 @@
 #ifndef DALY_BMS_INTERNAL_H
 #define DALY_BMS_INTERNAL_H
 
+#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -34,13 +35,30 @@ extern "C" {
 
 uint8_t daly_checksum(const uint8_t *data, size_t len);
 uint16_t daly_get_u16be(const uint8_t *data, int offset);
+int daly_validate_frame(const uint8_t *frame,
+                        uint8_t expected_addr,
+                        uint8_t expected_cmd,
+                        uint8_t *data);
 
 void daly_parse_0x90(const uint8_t *data, daly_pack_summary_t *pack);
 void daly_parse_0x91(const uint8_t *data, daly_extremes_t *extremes);
 void daly_parse_0x92(const uint8_t *data, daly_temps_t *temps);
 void daly_parse_0x93(const uint8_t *data, daly_mos_caps_t *mos);
 void daly_parse_0x97(const uint8_t *data, int cell_count, bool *balance);
-void daly_parse_0x98(const uint8_t *data, char faults[][64], int *fault_count);
+void daly_parse_0x98(const uint8_t *data, daly_fault_bits_t *faults, int *fault_count);
+
+/** Per-port state while probing candidates concurrently */
+typedef struct {
+   char path[64];               /**< Name to open and report (by-id link if it fits) */
+   char resolved[PATH_MAX];     /**< Canonical device node, for de-duplication */
+   int fd;                      /**< Open descriptor during a round, else -1 */
+   uint8_t buf[DALY_FRAME_LEN]; /**< Partial response frame */
+   size_t have;                 /**< Bytes collected in buf */
+} daly_probe_t;
+
+bool daly_probe_feed(daly_probe_t *probe, const uint8_t *bytes, size_t len);
+bool daly_read_detect_cache(char *port, size_t port_len, int *baud);
+void daly_write_detect_cache(const char *port, int baud);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,219 @@
+/**
+ * @file daly_packs.h
+ * @brief Several Daly BMS packs polled in parallel, and their combined view
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * A pack has its own UART, or shares an RS-485 segment with other packs and
+ * is told apart by its board number. Each UART gets a worker thread, so a poll
+ * cycle takes as long as the slowest line rather than the sum of all of them;
+ * the packs on one segment are polled one after the other.
+ * Ports that are missing or stop answering are reopened periodically, which
+ * lets packs be swapped while running.
+ */
+
+#ifndef DALY_PACKS_H
+#define DALY_PACKS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "daly_bms.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DALY_MAX_PACKS 8
+#define DALY_PACK_REOPEN_S 10     /* Retry a missing pack this often */
+#define DALY_PACK_MAX_FAILURES 5  /* Consecutive failed polls before a pack is reopened */
+
+struct daly_pack_group;
+
+/**
+ * @brief One pack: its BMS, health state and poll result
+ */
+typedef struct {
+   daly_device_t dev;              /**< BMS on this pack's UART */
+   daly_pack_health_t health;      /**< Rolling health statistics */
+   daly_fault_summary_t faults;    /**< Faults by severity from the latest poll */
+   char port[64];                  /**< Serial port */
+   int baud;                       /**< Baud rate */
+   uint8_t addr;                   /**< Board number on the port's RS-485 segment */
+   int bus;                        /**< Index of the pack that opens the port (itself if first) */
+   int poll_result;                /**< daly_bms_poll() result of the latest cycle */
+   int failures;                   /**< Consecutive cycles nobody on the port answered */
+   bool health_valid;              /**< health/faults hold an analysis */
+   time_t last_open;               /**< Last open attempt */
+   struct daly_pack_group *group;  /**< Owning group (for the worker) */
+} daly_pack_t;
+
+/**
+ * @brief All configured packs and their poll workers
+ *
+ * Zero-initialize, add packs with daly_packs_add(), then daly_packs_open()
+ * and daly_packs_start().
+ */
+typedef struct daly_pack_group {
+   daly_pack_t packs[DALY_MAX_PACKS]; /**< Packs, in configuration order */
+   int count;                         /**< Packs configured */
+   int timeout_ms;                    /**< BMS response timeout */
+   bool reopen;                       /**< Reopen missing packs (off for replay) */
+
+   /* Workers, one per port, used when there is more than one port */
+   pthread_t threads[DALY_MAX_PACKS];
+   pthread_mutex_t lock;
+   pthread_cond_t start_cond;         /**< A new cycle was requested */
+   pthread_cond_t done_cond;          /**< A worker finished its poll */
+   unsigned cycle;                    /**< Poll cycle counter */
+   int pending;                       /**< Workers still polling this cycle */
+   int workers;                       /**< Worker threads running */
+   bool stop;                         /**< Workers should exit */
+} daly_pack_group_t;
+
+/**
+ * @brief Combined view of all packs (packs in parallel)
+ */
+typedef struct {
+   int pack_count;       /**< Packs configured */
+   int valid_count;      /**< Packs whose latest poll succeeded; only these are combined */
+   float voltage_v;      /**< Mean pack voltage */
+   float current_a;      /**< Total current (positive = charging, as reported by Daly) */
+   float power_w;        /**< Total power */
+   float remaining_mah;  /**< Total remaining capacity */
+   float capacity_mah;   /**< Total full capacity, from remaining capacity and SOC */
+   float soc_pct;        /**< SOC weighted by pack capacity */
+   float tmax_c;         /**< Highest temperature */
+   float tmin_c;         /**< Lowest temperature */
+   int weakest_pack;     /**< Pack holding the lowest cell, -1 if none */
+   int weakest_cell;     /**< Lowest cell within that pack (0-based) */
+   float weakest_cell_v; /**< Its voltage */
+   int overall_status;   /**< Worst health status (DALY_HEALTH_*) */
+   int fault_count;      /**< Active faults across packs */
+   time_t last_ok;       /**< Time of the newest pack sample */
+} daly_packs_summary_t;
+
+/**
+ * @brief Parse a "PORT[:BAUD][@BOARD]" pack specification
+ *
+ * @param spec Specification, e.g. "/dev/ttyUSB1:9600@2"
+ * @param port Buffer for the port
+ * @param port_size Size of the buffer
+ * @param baud Baud rate; left unchanged if the spec has none
+ * @param addr Board number; left unchanged if the spec has none (may be NULL
+ *             if no board number is accepted)
+ * @return int 0 on success, -1 if the spec is malformed
+ */
+int daly_packs_parse_spec(const char *spec,
+                          char *port,
+                          size_t port_size,
+                          int *baud,
+                          uint8_t *addr);
+
+/**
+ * @brief Add a pack to the group
+ *
+ * Packs on the same port share it as an RS-485 segment.
+ *
+ * @param group Pack group
+ * @param port Serial port
+ * @param baud Baud rate
+ * @param addr Board number on the segment (DALY_BMS_ADDR for a BMS alone on its port)
+ * @return int Index of the pack, -1 if the group is full or the port already
+ *         has a pack with this board number
+ */
+int daly_packs_add(daly_pack_group_t *group, const char *port, int baud, uint8_t addr);
+
+/**
+ * @brief Add a pack for every BMS answering on an RS-485 segment
+ *
+ * @param group Pack group
+ * @param port Serial port of the segment
+ * @param baud Baud rate
+ * @return int Number of packs added, -1 if the port cannot be opened
+ */
+int daly_packs_scan(daly_pack_group_t *group, const char *port, int baud);
+
+/**
+ * @brief Open every pack's serial port
+ *
+ * @param group Pack group
+ * @param timeout_ms BMS response timeout
+ * @return int Number of packs whose port is open
+ */
+int daly_packs_open(daly_pack_group_t *group, int timeout_ms);
+
+/**
+ * @brief Start the poll workers (only when there is more than one port)
+ *
+ * @param group Opened pack group
+ * @return int 0 on success, -1 if a worker could not be started (packs are
+ *         then polled one after another)
+ */
+int daly_packs_start(daly_pack_group_t *group);
+
+/**
+ * @brief Poll every pack, in parallel when workers are running
+ *
+ * Returns once all packs have answered or timed out; each pack's
+ * poll_result is set. Missing packs are reopened when due.
+ *
+ * @param group Pack group
+ * @return int Number of packs polled successfully
+ */
+int daly_packs_poll(daly_pack_group_t *group);
+
+/**
+ * @brief Stop the workers and close every pack
+ *
+ * @param group Pack group
+ */
+void daly_packs_close(daly_pack_group_t *group);
+
+/**
+ * @brief Combine the latest data of all packs
+ *
+ * Packs whose latest poll failed are left out, so a pack that stopped
+ * answering does not hold the combined SOC and capacity at its last reading.
+ *
+ * @param group Pack group
+ * @param summary Output
+ */
+void daly_packs_summarize(const daly_pack_group_t *group, daly_packs_summary_t *summary);
+
+/**
+ * @brief Resistance baseline file of a pack
+ *
+ * Pack 0 keeps DALY_RINT_PATH so single-pack setups keep their baselines.
+ *
+ * @param index Pack index
+ * @param path Buffer for the path
+ * @param size Size of the buffer
+ */
+void daly_packs_rint_path(int index, char *path, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DALY_PACKS_H */
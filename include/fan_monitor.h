@@ -32,10 +32,23 @@ extern "C" {
 /**
  * @brief Initialize the fan monitoring subsystem
  *
+ * Uses the fan files recorded in the sysfs discovery cache when they are
+ * still readable, and searches sysfs otherwise.
+ *
  * @return int 0 on success, negative on error
  */
 int fan_monitor_init(void);
 
+/**
+ * @brief Resolve the fan files again, ignoring the discovery cache
+ *
+ * Called after a hwmon device was added, removed or renumbered. The getters
+ * below never search sysfs themselves.
+ *
+ * @return int 0 if a fan is available, negative if none was found
+ */
+int fan_monitor_rescan(void);
+
 /**
  * @brief Sets the maximum expected RPM value for the fan
  *
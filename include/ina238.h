@@ -82,6 +82,19 @@ typedef struct {
    bool valid;         ///< Data validity flag
 } ina238_measurements_t;
 
+/**
+ * @brief Raw INA238 register snapshot (as read over I2C, before scaling)
+ *
+ * A register that failed to read is stored as 0, which matches the 0.0 the
+ * scaled readers return on error.
+ */
+typedef struct {
+   uint16_t vbus;     ///< VBUS register
+   uint16_t current;  ///< CURRENT register
+   uint32_t power;    ///< POWER register (24-bit)
+   uint16_t dietemp;  ///< DIETEMP register
+} ina238_raw_t;
+
 /* Function Prototypes */
 
 /**
@@ -100,6 +113,20 @@ int ina238_init(ina238_device_t *dev,
                 float r_shunt,
                 float max_current);
 
+/**
+ * @brief Compute scaling parameters without touching the bus
+ *
+ * Fills in the LSBs, ADC range and shunt calibration exactly as ina238_init()
+ * does, but leaves the device unopened (fd = -1). Used to convert recorded
+ * register values during replay.
+ *
+ * @param dev Pointer to device structure
+ * @param i2c_addr I2C address of the device
+ * @param r_shunt Shunt resistor value in Ohms
+ * @param max_current Maximum current in Amps
+ */
+void ina238_init_params(ina238_device_t *dev, uint8_t i2c_addr, float r_shunt, float max_current);
+
 /**
  * @brief Close the INA238 device
  *
@@ -116,6 +143,27 @@ void ina238_close(ina238_device_t *dev);
  */
 int ina238_read_measurements(ina238_device_t *dev, ina238_measurements_t *measurements);
 
+/**
+ * @brief Read the raw measurement registers from INA238
+ *
+ * @param dev Pointer to device structure
+ * @param raw Pointer to raw register snapshot to fill
+ * @return int 0 on success, negative on error
+ */
+int ina238_read_raw(ina238_device_t *dev, ina238_raw_t *raw);
+
+/**
+ * @brief Convert a raw register snapshot into scaled measurements
+ *
+ * @param dev Pointer to device structure (only the scaling parameters are used)
+ * @param raw Raw register snapshot
+ * @param measurements Pointer to measurements structure to fill
+ * @return int 0 if the measurements are valid, negative otherwise
+ */
+int ina238_convert_raw(const ina238_device_t *dev,
+                       const ina238_raw_t *raw,
+                       ina238_measurements_t *measurements);
+
 /**
  * @brief Read bus voltage from INA238
  *
@@ -55,6 +55,8 @@ typedef struct {
    float power;                        ///< Power in Watts (calculated)
    char label[INA3221_LABEL_MAX_LEN];  ///< Channel label/name
    float shunt_resistor;               ///< Shunt resistor value in Ohms
+   int raw_voltage_mv;                 ///< in<N>_input as read from sysfs
+   int raw_current_ma;                 ///< curr<N>_input as read from sysfs
    bool enabled;                       ///< Channel enabled status
    bool valid;                         ///< Data validity flag
 } ina3221_channel_t;
@@ -115,6 +117,18 @@ int ina3221_read_measurements(ina3221_device_t *dev, ina3221_measurements_t *mea
  */
 int ina3221_read_channel(ina3221_device_t *dev, int channel, ina3221_channel_t *channel_data);
 
+/**
+ * @brief Fill a channel's measurements from raw sysfs values
+ *
+ * Shared by the live sysfs reader and the replay path so both produce
+ * identical scaled values.
+ *
+ * @param channel_data Channel data structure to update
+ * @param voltage_mv Bus voltage in millivolts (in<N>_input)
+ * @param current_ma Current in milliamps (curr<N>_input)
+ */
+void ina3221_apply_raw(ina3221_channel_t *channel_data, int voltage_mv, int current_ma);
+
 /**
  * @brief Get the number of active/enabled channels
  *
@@ -133,6 +147,10 @@ void ina3221_print_status(const ina3221_device_t *dev);
 /**
  * @brief Auto-detect INA3221 device in sysfs
  *
+ * The hwmon directory from the sysfs discovery cache is used when its name
+ * still reads "ina3221"; otherwise the driver directory is searched and the
+ * result cached.
+ *
  * @param sysfs_path Buffer to store the detected path
  * @param path_size Size of the buffer
  * @return int 0 on success, negative if not found
@@ -29,14 +29,44 @@
 
 #include "battery_model.h"
 #include "daly_bms.h"
+#include "daly_packs.h"
 #include "ina238.h"
 #include "ina3221.h"
+#include "stat_window.h"
 
 /* MQTT Configuration */
 #define MQTT_DEFAULT_HOST "localhost"
 #define MQTT_DEFAULT_PORT 1883
 #define MQTT_DEFAULT_TOPIC "stat/telemetry"
 #define MQTT_STATUS_TOPIC "stat/status"
+#define MQTT_DEFAULT_EXPIRY_S 60             /* v5 telemetry message expiry */
+#define MQTT_MAX_INFLIGHT 20                 /* QoS 1 messages awaiting acknowledgement */
+#define MQTT_PRIORITY_MAX_INFLIGHT 10        /* The same for the priority client */
+#define MQTT_PRIORITY_QUEUE_LIMIT 32         /* Alerts are dropped beyond this queue depth */
+#define MQTT_KEEPALIVE_S 60                  /* Bulk telemetry client */
+#define MQTT_PRIORITY_KEEPALIVE_S 10         /* Alert and status client */
+#define MQTT_ALERT_SUBTOPIC "alert"          /* Alerts go to <topic>/alert */
+
+/* Publish queue depth at which each degradation level starts; it ends below half of that */
+#define MQTT_QUEUE_NO_DETAIL 20
+#define MQTT_QUEUE_THROTTLED 50
+#define MQTT_QUEUE_ESSENTIAL 100
+#define MQTT_QUEUE_LIMIT 200    /* Only battery status and alarms are queued beyond this */
+#define MQTT_QUEUE_RESERVE 20   /* Headroom above the limit for them; nothing goes beyond */
+#define MQTT_THROTTLE_UPDATES 5 /* Routine messages go out every Nth update when throttled */
+
+/**
+ * @brief How much telemetry is held back while the publish queue is backed up
+ *
+ * Unified battery status and alarms (a status other than NORMAL, or critical
+ * faults) are published at every level.
+ */
+typedef enum {
+   MQTT_DEGRADE_NONE,      /**< Everything is published */
+   MQTT_DEGRADE_NO_DETAIL, /**< Per-cell, per-sensor and serial link detail left out */
+   MQTT_DEGRADE_THROTTLED, /**< As above, routine messages every MQTT_THROTTLE_UPDATES */
+   MQTT_DEGRADE_ESSENTIAL  /**< Only battery status and alarms */
+} mqtt_degrade_t;
 
 /**
  * @brief MQTT security configuration (optional auth + TLS)
@@ -51,6 +81,10 @@ typedef struct {
 /**
  * @brief Initialize MQTT connection
  *
+ * Returns without waiting for the broker: the connection is completed (and
+ * retried) by the background network thread, which publishes the online
+ * status each time it connects.
+ *
  * @param host MQTT broker hostname or IP
  * @param port MQTT broker port
  * @param topic MQTT topic for publishing
@@ -60,7 +94,7 @@ typedef struct {
 int mqtt_init(const char *host, int port, const char *topic, const mqtt_security_t *security);
 
 /**
- * @brief Publish online status message after MQTT connect
+ * @brief Publish online status message (called automatically on connect)
  * @return int 0 on success, negative on error
  */
 int mqtt_publish_status_online(void);
@@ -77,28 +111,45 @@ int mqtt_publish_status_offline(void);
  * @param measurements INA238 measurements
  * @param battery_percentage Calculated battery percentage
  * @param battery Battery configuration for time estimation
+ * @param soc_ekf SOC estimator fed with the same samples, or NULL
+ * @param rint Pack resistance estimator fed with the same samples, or NULL
+ * @param runtime Runtime predictor fed with the same samples, or NULL
+ * @param window Samples since the previous battery message, or NULL
  * @return int 0 on success, negative on error
  */
 int mqtt_publish_battery_data(const ina238_measurements_t *measurements,
                               float battery_percentage,
-                              const battery_config_t *battery);
+                              const battery_config_t *battery,
+                              const battery_ekf_t *soc_ekf,
+                              const battery_rint_t *rint,
+                              const battery_runtime_t *runtime,
+                              const stat_battery_window_t *window);
 
 /**
  * @brief Publish INA3221 multi-channel power data to MQTT
  *
  * @param measurements INA3221 measurements from all channels
+ * @param windows Samples since the previous message, one per entry of
+ *        measurements->channels, or NULL
  * @return int 0 on success, negative on error
  */
-int mqtt_publish_ina3221_data(const ina3221_measurements_t *measurements);
+int mqtt_publish_ina3221_data(const ina3221_measurements_t *measurements,
+                              const stat_battery_window_t *windows);
 
 /**
  * @brief Publish Daly BMS data to MQTT
  *
  * @param daly_dev Pointer to Daly BMS device
  * @param battery Battery configuration for time estimation
+ * @param runtime Runtime predictor of this pack, or NULL
+ * @param pack Pack index with several packs (published to <topic>/pack/<n>, n = pack + 1),
+ *             -1 for a single pack
  * @return int 0 on success, negative on error
  */
-int mqtt_publish_daly_bms_data(const daly_device_t *daly_dev, const battery_config_t *battery);
+int mqtt_publish_daly_bms_data(const daly_device_t *daly_dev,
+                               const battery_config_t *battery,
+                               const battery_runtime_t *runtime,
+                               int pack);
 
 /**
  * @brief Publish enhanced Daly BMS health data to MQTT
@@ -106,11 +157,21 @@ int mqtt_publish_daly_bms_data(const daly_device_t *daly_dev, const battery_conf
  * @param daly_dev Pointer to Daly BMS device
  * @param health Pointer to pack health structure
  * @param fault_summary Pointer to fault summary structure
+ * @param pack Pack index with several packs, -1 for a single pack
  * @return int 0 on success, negative on error
  */
 int mqtt_publish_daly_health_data(const daly_device_t *daly_dev,
                                   const daly_pack_health_t *health,
-                                  const daly_fault_summary_t *fault_summary);
+                                  const daly_fault_summary_t *fault_summary,
+                                  int pack);
+
+/**
+ * @brief Publish the combined view of several Daly BMS packs
+ *
+ * @param summary Combined pack data
+ * @return int 0 on success, negative on error
+ */
+int mqtt_publish_daly_packs_data(const daly_packs_summary_t *summary);
 
 /**
  * @brief Publish unified battery data combining multiple sources
@@ -118,12 +179,19 @@ int mqtt_publish_daly_health_data(const daly_device_t *daly_dev,
  * @param ina238_measurements INA238 measurements (can be NULL)
  * @param daly_dev Daly BMS device (can be NULL)
  * @param battery_config Battery configuration
+ * @param max_current Current limit for the status check (0 to skip)
+ * @param runtime Runtime predictor of the source in use (Daly BMS when its
+ *                data is valid, otherwise INA238), or NULL
+ * @param packs Combined view when several packs are configured, or NULL;
+ *              its SOC and capacity replace those of daly_dev
  * @return int 0 on success, negative on error
  */
 int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurements,
                                  const daly_device_t *daly_dev,
                                  const battery_config_t *battery_config,
-                                 float max_current);
+                                 float max_current,
+                                 const battery_runtime_t *runtime,
+                                 const daly_packs_summary_t *packs);
 
 /**
  * @brief Publish System monitoring data to MQTT
@@ -145,6 +213,85 @@ int mqtt_publish_system_monitoring_data(float cpu_usage, float memory_usage, flo
  */
 int mqtt_publish_fan_data(int rpm, int load_percent, int pwm);
 
+/**
+ * @brief Publish with MQTT v5 instead of v3.1.1 (call before mqtt_init())
+ *
+ * Every message then carries a content type and a "type" user property.
+ * Telemetry also gets a topic alias, when the broker allows enough of them,
+ * and a message expiry interval so that messages queued for an offline
+ * subscriber are dropped rather than delivered late.
+ *
+ * @param enable true for MQTT v5
+ * @param expiry_s Telemetry message expiry in seconds, 0 for none
+ */
+void mqtt_set_protocol_v5(bool enable, unsigned int expiry_s);
+
+/**
+ * @brief Publish one message per tick instead of one per section
+ *
+ * In bundle mode the mqtt_publish_*() data calls add their message to the
+ * tick's bundle, and mqtt_publish_bundle() sends them together under one
+ * envelope and timestamp.
+ *
+ * @param enable true for bundle mode
+ */
+void mqtt_set_bundle(bool enable);
+
+/**
+ * @brief Send alerts and status over a connection of their own
+ *
+ * With priority mode, mqtt_init() opens a second client for the status
+ * messages (and the Last Will) and for alerts, published at QoS 1 on
+ * <topic>/alert. An alert goes out once per source (the battery, or one
+ * pack) when its alarm (a CRITICAL status, or critical faults) is raised,
+ * escalated or cleared: a copy of that update's most severe message, without
+ * its per-cell arrays. Bulk telemetry keeps the first client, so an alert
+ * never queues behind a large message on the same socket. Call before
+ * mqtt_init().
+ *
+ * @param enable true for a separate priority client
+ */
+void mqtt_set_priority(bool enable);
+
+/**
+ * @brief Send this tick's alerts and bundle, and start the next one
+ *
+ * Call once per iteration, after the mqtt_publish_*() calls, in every mode.
+ *
+ * @return int 0 on success or when there is nothing to send, negative on error
+ */
+int mqtt_publish_bundle(void);
+
+/**
+ * @brief Start a main-loop update: pick the degradation level for its messages
+ *
+ * Call once per iteration before the mqtt_publish_*() calls, so that all
+ * messages of an update are treated alike.
+ */
+void mqtt_begin_update(void);
+
+/**
+ * @brief Messages handed to the MQTT client and not yet sent (QoS 0) or
+ *        acknowledged (QoS 1)
+ *
+ * @return int Queue depth
+ */
+int mqtt_queue_depth(void);
+
+/**
+ * @brief Current degradation level
+ *
+ * @return mqtt_degrade_t Level chosen by the last mqtt_begin_update()
+ */
+mqtt_degrade_t mqtt_degrade_level(void);
+
+/**
+ * @brief Telemetry messages (or bundle sections) not published because of backpressure
+ *
+ * @return unsigned long Count since start
+ */
+unsigned long mqtt_dropped_messages(void);
+
 /**
  * @brief Clean up MQTT resources
  */
@@ -27,7 +27,9 @@
 
 #include "battery_model.h"
 #include "daly_bms.h"
+#include "daly_packs.h"
 #include "ina238.h"
+#include "mqtt_publisher.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,11 +45,36 @@ extern "C" {
  * @param battery_percentage SOC percentage (0-100).
  * @param battery Optional battery configuration; if NULL, battery-detail fields
  *                (chemistry, capacity, time remaining) are omitted.
+ * @param soc_ekf Optional SOC estimator; adds soc_estimate/soc_uncertainty once seeded.
+ * @param rint Optional resistance estimator; adds resistance fields once valid.
+ * @param runtime Optional runtime predictor; adds p10/p90 time remaining and
+ *                takes the median from it instead of the instantaneous load.
+ * @param window Optional samples since the previous message; adds a "window"
+ *               object with their statistics, charge and energy.
  * @return struct json_object* Newly allocated JSON object, or NULL on error.
  */
 struct json_object *build_battery_json(const ina238_measurements_t *measurements,
                                        float battery_percentage,
-                                       const battery_config_t *battery);
+                                       const battery_config_t *battery,
+                                       const battery_ekf_t *soc_ekf,
+                                       const battery_rint_t *rint,
+                                       const battery_runtime_t *runtime,
+                                       const stat_battery_window_t *window);
+
+/**
+ * @brief Build the JSON payload for an INA3221 telemetry message.
+ *
+ * Pure constructor — no broker interaction. Caller owns the returned object
+ * and must call json_object_put() when done.
+ *
+ * @param measurements INA3221 measurements (must be valid).
+ * @param windows Optional samples since the previous message, one per entry of
+ *                measurements->channels; adds a "window" object to each
+ *                channel that has samples.
+ * @return struct json_object* Newly allocated JSON object, or NULL on error.
+ */
+struct json_object *build_ina3221_json(const ina3221_measurements_t *measurements,
+                                       const stat_battery_window_t *windows);
 
 /**
  * @brief Build the JSON payload for a Daly BMS telemetry message.
@@ -57,10 +84,215 @@ struct json_object *build_battery_json(const ina238_measurements_t *measurements
  *
  * @param daly_dev Daly BMS device with valid data populated.
  * @param battery Optional battery configuration for runtime estimation.
+ * @param runtime Optional runtime predictor for this pack.
  * @return struct json_object* Newly allocated JSON object, or NULL on error.
  */
 struct json_object *build_daly_bms_json(const daly_device_t *daly_dev,
-                                        const battery_config_t *battery);
+                                        const battery_config_t *battery,
+                                        const battery_runtime_t *runtime);
+
+/**
+ * @brief Build the serial link quality object of the Daly BMS health message.
+ *
+ * Pure constructor — no broker interaction. Caller owns the returned object
+ * and must call json_object_put() when done.
+ *
+ * @param daly_dev Daly BMS device.
+ * @return struct json_object* Newly allocated JSON object, or NULL on error.
+ */
+struct json_object *build_daly_link_json(const daly_device_t *daly_dev);
+
+/**
+ * @brief Build the JSON payload for the combined view of several packs.
+ *
+ * Pure constructor — no broker interaction. Caller owns the returned object
+ * and must call json_object_put() when done.
+ *
+ * @param summary Combined pack data.
+ * @return struct json_object* Newly allocated JSON object, or NULL on error.
+ */
+struct json_object *build_daly_packs_json(const daly_packs_summary_t *summary);
+
+/**
+ * @brief Start an empty bundle message: the telemetry envelope with type
+ *        "Bundle" and an empty "sections" array.
+ *
+ * Caller owns the returned object and must call json_object_put() when done.
+ *
+ * @return struct json_object* Newly allocated JSON object, or NULL on error.
+ */
+struct json_object *mqtt_bundle_new(void);
+
+/**
+ * @brief Add a telemetry message to a bundle as one of its sections.
+ *
+ * Removes the envelope fields (device, msg_type, timestamp) from the message,
+ * which keeps its type and data, and appends a new reference to it.
+ *
+ * @param bundle Bundle from mqtt_bundle_new().
+ * @param message Message from one of the build functions.
+ * @return int 0 on success, -1 on error.
+ */
+int mqtt_bundle_add(struct json_object *bundle, struct json_object *message);
+
+/* Telemetry topics that can have an alias: the main topic and one per pack */
+#define MQTT_TOPIC_ALIASES (DALY_MAX_PACKS + 1)
+
+/**
+ * @brief Topic alias for an MQTT v5 telemetry publish.
+ *
+ * Aliases are numbered from 1 in the order topics are first seen. A topic
+ * is sent along with its alias the first time on each connection, so the
+ * broker learns the mapping; after that only the alias is sent.
+ *
+ * @param topic Topic to publish to.
+ * @param generation Current connection, changed on every connect.
+ * @param alias_max Topic Alias Maximum announced by the broker.
+ * @param send_topic Output: whether the topic must be sent as well.
+ * @return int Alias, or 0 to publish without one.
+ */
+int mqtt_topic_alias(const char *topic, unsigned int generation, unsigned int alias_max,
+                     bool *send_topic);
+
+/**
+ * @brief Send the topic with an alias again next time, after a failed publish.
+ *
+ * @param alias Alias from mqtt_topic_alias().
+ */
+void mqtt_topic_alias_forget(int alias);
+
+/**
+ * @brief Clear the topic alias table.
+ *
+ * Called by mqtt_init() before the bulk client starts. Reconnects keep the
+ * table; the connection generation makes each alias be set up again.
+ */
+void mqtt_topic_alias_reset(void);
+
+/**
+ * @brief Degradation level for a publish queue depth, with hysteresis.
+ *
+ * A level starts when the depth reaches its MQTT_QUEUE_* threshold and ends
+ * when the depth falls below half of it.
+ *
+ * @param level Current level.
+ * @param depth Publish queue depth.
+ * @return mqtt_degrade_t New level.
+ */
+mqtt_degrade_t mqtt_degrade_next(mqtt_degrade_t level, int depth);
+
+/**
+ * @brief Whether a telemetry message is published at every degradation level.
+ *
+ * True for the unified battery status and for alarms.
+ *
+ * @param message Telemetry message.
+ * @return bool true if essential.
+ */
+bool mqtt_message_essential(struct json_object *message);
+
+/**
+ * @brief Whether a telemetry message reports an alarm.
+ *
+ * True for a battery_status other than NORMAL, or critical faults.
+ *
+ * @param message Telemetry message.
+ * @return bool true for an alarm.
+ */
+bool mqtt_message_alarm(struct json_object *message);
+
+/**
+ * @brief Alarm level of a telemetry message.
+ *
+ * The number of critical conditions it reports: its critical fault count,
+ * or 1 for a CRITICAL battery_status without one. WARNING is not an alarm.
+ *
+ * @param message Telemetry message.
+ * @return int Alarm level, 0 without an alarm.
+ */
+int mqtt_message_alarm_level(struct json_object *message);
+
+/* Alert sources: the main topic, then one per pack */
+#define MQTT_ALERT_SOURCES (DALY_MAX_PACKS + 1)
+
+/**
+ * @brief How a source's alarm changed over an update.
+ */
+typedef enum {
+   MQTT_ALERT_NONE,     /**< No change worth an alert */
+   MQTT_ALERT_RAISE,    /**< An alarm started */
+   MQTT_ALERT_ESCALATE, /**< More critical conditions than last reported */
+   MQTT_ALERT_CLEAR     /**< The alarm ended */
+} mqtt_alert_event_t;
+
+/**
+ * @brief Alarm state of one alert source.
+ */
+typedef struct {
+   int reported; /**< Level as of the last settled update, 0 when clear */
+   int seen;     /**< Highest level among this update's messages, -1 for none */
+} mqtt_alert_source_t;
+
+/**
+ * @brief Close an update for one source and report how its alarm changed.
+ *
+ * All message types from a source (unified, Daly, health, packs) fold into
+ * one level per update, so each change gives a single alert. A source that
+ * published nothing keeps its state; a milder alarm is taken silently.
+ *
+ * @param source Source state; seen is reset for the next update.
+ * @return mqtt_alert_event_t The change.
+ */
+mqtt_alert_event_t mqtt_alert_settle(mqtt_alert_source_t *source);
+
+/**
+ * @brief Copy of an alarm message for the alert topic.
+ *
+ * The copy keeps the envelope and leaves out the per-cell, per-sensor and
+ * serial link arrays, so its size does not grow with the pack.
+ *
+ * @param message Telemetry message.
+ * @return struct json_object* New object (caller must put), or NULL on error.
+ */
+struct json_object *mqtt_alert_json(struct json_object *message);
+
+/**
+ * @brief Apply a degradation level to a message about to be published.
+ *
+ * Removes the detail arrays at MQTT_DEGRADE_NO_DETAIL and above. A bundle
+ * loses the sections the level holds back; another message is held back
+ * as a whole.
+ *
+ * @param message Message or bundle, modified in place.
+ * @param level Degradation level.
+ * @param update Update counter, for throttling.
+ * @param dropped Incremented for each message or section held back.
+ * @return bool true if anything is left to publish.
+ */
+bool mqtt_degrade_message(struct json_object *message,
+                          mqtt_degrade_t level,
+                          unsigned long update,
+                          unsigned long *dropped);
+
+/**
+ * @brief Apply the degradation level and the queue limit to a message about to be queued.
+ *
+ * From MQTT_QUEUE_LIMIT on the message is degraded as at MQTT_DEGRADE_ESSENTIAL,
+ * so battery status and alarms still go out into the MQTT_QUEUE_RESERVE
+ * messages of headroom above the limit. Beyond that nothing is queued.
+ *
+ * @param message Message or bundle, modified in place.
+ * @param level Current degradation level.
+ * @param depth Publish queue depth.
+ * @param update Update counter, for throttling.
+ * @param dropped Incremented for each message or section held back.
+ * @return bool true if the message is to be queued.
+ */
+bool mqtt_queue_admit(struct json_object *message,
+                      mqtt_degrade_t level,
+                      int depth,
+                      unsigned long update,
+                      unsigned long *dropped);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,94 @@
+/**
+ * @file sample_rate.h
+ * @brief Adaptive main-loop sampling interval
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * With --adaptive the main loop no longer sleeps a fixed --interval. Each
+ * iteration feeds the battery current, the charge state and whether an alarm
+ * is raised; the next interval drops to the fast rate at once when the
+ * current moves (exponentially weighted standard deviation or rate of
+ * change over a threshold) or an alarm is raised, and backs off by doubling
+ * after SAMPLE_RATE_CALM_SAMPLES quiet samples. It backs off to --interval
+ * while charging or discharging and to the idle interval when idle.
+ */
+
+#ifndef SAMPLE_RATE_H
+#define SAMPLE_RATE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLE_RATE_DEFAULT_FAST_MS 200  /* Interval during load transients and alarms */
+#define SAMPLE_RATE_DEFAULT_IDLE_MS 5000 /* Interval when idle and stable */
+#define SAMPLE_RATE_ALPHA 0.2f           /* Weight of a new sample in the mean and variance */
+#define SAMPLE_RATE_EVENT_STDDEV_A 0.5f  /* Current standard deviation that is an event (A) */
+#define SAMPLE_RATE_EVENT_SLEW_A_S 2.0f  /* Current rate of change that is an event (A/s) */
+#define SAMPLE_RATE_CALM_SAMPLES 5       /* Quiet samples before the interval doubles */
+
+/**
+ * @brief Adaptive sampling state
+ *
+ * Initialize with sample_rate_init().
+ */
+typedef struct {
+   int fast_ms;     /**< Interval during events */
+   int steady_ms;   /**< Longest interval while charging or discharging */
+   int idle_ms;     /**< Longest interval when idle */
+   int interval_ms; /**< Interval chosen by the last update */
+   float mean_a;    /**< Weighted mean of the current (A) */
+   float var_a2;    /**< Weighted variance of the current (A^2) */
+   float last_a;    /**< Previous current sample (A) */
+   bool primed;     /**< A previous sample exists */
+   int calm;        /**< Quiet samples since the interval last changed */
+} sample_rate_t;
+
+/**
+ * @brief Start at the steady interval
+ *
+ * @param sr State to initialize
+ * @param fast_ms Interval during events
+ * @param steady_ms Longest interval while charging or discharging
+ * @param idle_ms Longest interval when idle
+ */
+void sample_rate_init(sample_rate_t *sr, int fast_ms, int steady_ms, int idle_ms);
+
+/**
+ * @brief Fold in one iteration's readings and pick the next interval
+ *
+ * The rate of change is taken over the previous interval, which is the time
+ * the main loop slept since the last sample.
+ *
+ * @param sr Adaptive sampling state
+ * @param current_a Battery current (A, either sign convention)
+ * @param state DALY_STATE_CHARGE, DALY_STATE_DISCHARGE or DALY_STATE_IDLE
+ * @param alarm true while an alarm is raised
+ * @return int Next sleep interval (ms)
+ */
+int sample_rate_update(sample_rate_t *sr, float current_a, int state, bool alarm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SAMPLE_RATE_H */
@@ -0,0 +1,96 @@
+/**
+ * @file stat_events.h
+ * @brief Server-Sent Events stream of the telemetry messages
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * With --events, GET /events streams the JSON telemetry messages (the same
+ * payloads published to MQTT) as text/event-stream, broker or not. The main
+ * loop collects one iteration's messages into a batch and hands the batch to
+ * the server thread, which serves every client from an epoll loop.
+ *
+ * Each client gets batches into a ring of its own, one per interval it asked
+ * for (GET /events?hz=N, capped at STAT_EVENTS_MAX_HZ), on a fixed schedule.
+ * Batches that fall between a client's deliveries are merged into the next
+ * one, keeping the latest message of each type (and pack), so a slow client
+ * sees every kind of message at its own rate. A client whose ring cannot take
+ * the next batch is disconnected, so the slowest reader costs at most its
+ * ring and never holds back the others or the main loop; EventSource clients
+ * reconnect by themselves.
+ */
+
+#ifndef STAT_EVENTS_H
+#define STAT_EVENTS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STAT_EVENTS_DEFAULT_PORT 9465
+#define STAT_EVENTS_MAX_CLIENTS 16
+#define STAT_EVENTS_MAX_HZ 20                /* Highest batch rate a client can ask for */
+#define STAT_EVENTS_BATCH_SIZE (32 * 1024)   /* One iteration's messages */
+#define STAT_EVENTS_CLIENT_RING (128 * 1024) /* Pending output per client */
+#define STAT_EVENTS_KEEPALIVE_MS 15000       /* Comment line sent to idle clients */
+#define STAT_EVENTS_REQUEST_TIMEOUT_MS 5000  /* Time allowed for the request headers */
+#define STAT_EVENTS_RETRY_MS 2000            /* Reconnect delay suggested to clients */
+
+/**
+ * @brief Start the HTTP listener
+ *
+ * @param addr IPv4 address to bind
+ * @param port TCP port, 0 for any free port
+ * @return int 0 on success, -1 on error
+ */
+int stat_events_start(const char *addr, int port);
+
+/**
+ * @brief Whether the stream is being served
+ *
+ * @return bool true between stat_events_start() and stat_events_stop()
+ */
+bool stat_events_active(void);
+
+/**
+ * @brief Add a JSON message to this iteration's batch (main loop only)
+ *
+ * @param json Single-line JSON text
+ * @param len Its length
+ */
+void stat_events_push(const char *json, size_t len);
+
+/**
+ * @brief Hand this iteration's batch to the server and start a new one
+ */
+void stat_events_commit(void);
+
+/**
+ * @brief Stop the listener and disconnect the clients
+ */
+void stat_events_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STAT_EVENTS_H */
@@ -0,0 +1,57 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s).
+ *
+ * Event stream internal helpers exposed for unit testing. Not part of the
+ * public API — only stat_events.c and test files should include this header.
+ */
+
+#ifndef STAT_EVENTS_INTERNAL_H
+#define STAT_EVENTS_INTERNAL_H
+
+#include "stat_events.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Port the listener is bound to (useful after starting on port 0).
+ *
+ * @return int Port, or -1 when not listening.
+ */
+int stat_events_bound_port(void);
+
+/**
+ * @brief Clients disconnected because their ring was full, since the start.
+ *
+ * @return unsigned long Count.
+ */
+unsigned long stat_events_dropped_clients(void);
+
+/**
+ * @brief Clients currently streaming.
+ *
+ * @return int Count.
+ */
+int stat_events_streaming_clients(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STAT_EVENTS_INTERNAL_H */
@@ -0,0 +1,105 @@
+/**
+ * @file stat_log.h
+ * @brief Asynchronous, rate-limited front end for the shared OASIS logger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * logging.c is shared verbatim with the other OASIS daemons, so STAT's
+ * asynchronous writer lives here instead. STAT sources include this header
+ * in place of logging.h; it redirects OLOG_INFO/WARNING/ERROR through
+ * stat_log_message(). Until stat_log_start_async() is called every message
+ * goes straight to log_message() as before.
+ *
+ * Once started, callers only format into a lock-free ring and return; a
+ * writer thread hands each line to log_message(). Identical messages (same
+ * level, format and arguments) are limited to a burst per window and the
+ * excess is reported as one "Suppressed N times" line. SLOG_EVENT_* lines
+ * (state transitions, one-shot reports) are never rate limited.
+ */
+
+#ifndef STAT_LOG_H
+#define STAT_LOG_H
+
+#include <stdbool.h>
+
+#include "logging.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Log one message, through the writer thread when it is running
+ *
+ * @param level Severity
+ * @param file  Source filename (usually __FILE__)
+ * @param line  Source line number (usually __LINE__)
+ * @param limit Apply the repeat limit (false for events that must all appear)
+ * @param fmt   printf-style format string (must be a literal)
+ */
+void stat_log_message(log_level_t level,
+                      const char *file,
+                      int line,
+                      bool limit,
+                      const char *fmt,
+                      ...);
+
+/**
+ * @brief Start the writer thread. Call after init_logging() or init_syslog().
+ *
+ * If the ring is full a message is dropped and counted instead of blocking
+ * the caller.
+ *
+ * @return 0 on success, -1 if the thread could not be started (logging
+ *         stays synchronous)
+ */
+int stat_log_start_async(void);
+
+/**
+ * @brief Drain the ring, emit pending summaries and stop the writer thread
+ *
+ * Call before close_logging() or init_logging(). Also registered with
+ * atexit() by stat_log_start_async(), so early exits keep their messages.
+ */
+void stat_log_stop_async(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef OLOG_INFO
+#undef OLOG_WARNING
+#undef OLOG_ERROR
+#define OLOG_INFO(fmt, ...) \
+   stat_log_message(LOGLEVEL_INFO, __FILE__, __LINE__, true, fmt, ##__VA_ARGS__)
+#define OLOG_WARNING(fmt, ...) \
+   stat_log_message(LOGLEVEL_WARNING, __FILE__, __LINE__, true, fmt, ##__VA_ARGS__)
+#define OLOG_ERROR(fmt, ...) \
+   stat_log_message(LOGLEVEL_ERROR, __FILE__, __LINE__, true, fmt, ##__VA_ARGS__)
+
+/* Never rate limited: fault raise/clear, startup reports */
+#define SLOG_EVENT_INFO(fmt, ...) \
+   stat_log_message(LOGLEVEL_INFO, __FILE__, __LINE__, false, fmt, ##__VA_ARGS__)
+#define SLOG_EVENT_WARNING(fmt, ...) \
+   stat_log_message(LOGLEVEL_WARNING, __FILE__, __LINE__, false, fmt, ##__VA_ARGS__)
+#define SLOG_EVENT_ERROR(fmt, ...) \
+   stat_log_message(LOGLEVEL_ERROR, __FILE__, __LINE__, false, fmt, ##__VA_ARGS__)
+
+#endif /* STAT_LOG_H */
@@ -0,0 +1,124 @@
+/**
+ * @file stat_metrics.h
+ * @brief OpenMetrics (Prometheus) exporter
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * With --metrics, a small HTTP listener serves GET /metrics in the OpenMetrics
+ * text format: the latest telemetry snapshot plus histograms of how long each
+ * stage of the main loop takes. Scrapes are answered on a thread of their
+ * own; the main loop only stores the snapshot and bumps the histograms, and
+ * never waits for a scraper.
+ */
+
+#ifndef STAT_METRICS_H
+#define STAT_METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stat_shm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STAT_METRICS_DEFAULT_PORT 9464
+#define STAT_METRICS_BUFFER_SIZE (32 * 1024) /* Rendered exposition */
+#define STAT_METRICS_IO_TIMEOUT_S 2          /* Per scrape connection */
+
+/**
+ * @brief Main-loop stages with a latency histogram
+ */
+typedef enum {
+   STAT_STAGE_INA238,  /**< INA238 read, battery model and publish */
+   STAT_STAGE_INA3221, /**< INA3221 read and publish */
+   STAT_STAGE_BMS,     /**< Daly poll, health analysis and publish (polls only) */
+   STAT_STAGE_UNIFIED, /**< Unified battery message */
+   STAT_STAGE_HOST,    /**< CPU, memory, temperature and fan sampling and publish, bundle send */
+   STAT_STAGE_LOCAL,   /**< Shared memory, socket, exporter and event stream hand-off */
+   STAT_STAGE_TICK,    /**< Whole iteration, without the interval sleep */
+   STAT_STAGE_COUNT
+} stat_stage_t;
+
+/**
+ * @brief Parse a "[ADDR:]PORT" listen address
+ *
+ * @param spec Specification; NULL or "" for all addresses on the default port
+ * @param default_port Port used when spec has none
+ * @param addr Output IPv4 address, "0.0.0.0" when omitted
+ * @param addr_size Size of addr
+ * @param port Output port
+ * @return int 0 on success, -1 if spec is malformed
+ */
+int stat_metrics_parse_listen(const char *spec, int default_port, char *addr, size_t addr_size,
+                              int *port);
+
+/**
+ * @brief Start the HTTP listener
+ *
+ * @param addr IPv4 address to bind
+ * @param port TCP port, 0 for any free port
+ * @return int 0 on success, -1 on error
+ */
+int stat_metrics_start(const char *addr, int port);
+
+/**
+ * @brief Store the snapshot later scrapes report
+ *
+ * @param snapshot Snapshot to copy
+ */
+void stat_metrics_publish(const stat_shm_snapshot_t *snapshot);
+
+/**
+ * @brief Store the MQTT publish queue state later scrapes report
+ *
+ * @param queue_depth Messages not yet sent or acknowledged
+ * @param degrade_level Backpressure degradation level (mqtt_degrade_t)
+ * @param dropped Telemetry messages held back so far
+ */
+void stat_metrics_publish_mqtt(int queue_depth, int degrade_level, unsigned long dropped);
+
+/**
+ * @brief Monotonic time for stage timing
+ *
+ * @return uint64_t Microseconds
+ */
+uint64_t stat_metrics_now_us(void);
+
+/**
+ * @brief Record the duration of a stage that began at start_us
+ *
+ * @param stage Stage
+ * @param start_us stat_metrics_now_us() when the stage began
+ * @return uint64_t The current time, to start the next stage from
+ */
+uint64_t stat_metrics_stage_done(stat_stage_t stage, uint64_t start_us);
+
+/**
+ * @brief Stop the listener
+ */
+void stat_metrics_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STAT_METRICS_H */
@@ -0,0 +1,67 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s).
+ *
+ * OpenMetrics exporter internal helpers exposed for unit testing. Not part of
+ * the public API — only stat_metrics.c and test files should include this header.
+ */
+
+#ifndef STAT_METRICS_INTERNAL_H
+#define STAT_METRICS_INTERNAL_H
+
+#include <stddef.h>
+
+#include "stat_metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Render the exposition from the latest snapshot and the histograms.
+ *
+ * @param buf Output buffer.
+ * @param size Size of buf.
+ * @return size_t Length written, or 0 if it did not fit.
+ */
+size_t stat_metrics_render(char *buf, size_t size);
+
+/**
+ * @brief Record one stage duration.
+ *
+ * @param stage Stage.
+ * @param duration_us Duration in microseconds.
+ */
+void stat_metrics_observe(stat_stage_t stage, uint64_t duration_us);
+
+/**
+ * @brief Forget the snapshot and clear the histograms.
+ */
+void stat_metrics_reset(void);
+
+/**
+ * @brief Port the listener is bound to (useful after starting on port 0).
+ *
+ * @return int Port, or -1 when not listening.
+ */
+int stat_metrics_bound_port(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STAT_METRICS_INTERNAL_H */
@@ -0,0 +1,206 @@
+/**
+ * @file stat_shm.h
+ * @brief Shared-memory telemetry snapshot for local consumers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * With --shm, oasis-stat keeps the latest telemetry in a POSIX shared-memory
+ * object (default /oasis-stat, i.e. /dev/shm/oasis-stat) so that programs on
+ * the same machine can read it without MQTT, the broker or JSON. This header
+ * is self-contained: consumers build it with stat_shm_reader.c (or link the
+ * stat_shm library) and need nothing else from STAT.
+ *
+ * The segment is a fixed header followed by one snapshot, guarded by a
+ * sequence lock: the writer makes the sequence odd, copies the snapshot in
+ * and makes it even again; a reader copies the snapshot out and keeps it
+ * only if the sequence was even and unchanged across the copy. Readers never
+ * block the writer and a read costs one copy of the snapshot.
+ *
+ * Layout rules: fields are fixed-width and naturally aligned. New fields are
+ * only ever appended to the snapshot (readers check snapshot_size); any other
+ * change bumps STAT_SHM_VERSION.
+ */
+
+#ifndef STAT_SHM_H
+#define STAT_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STAT_SHM_DEFAULT_NAME "/oasis-stat"
+#define STAT_SHM_MAGIC 0x54415453u /* "STAT" in memory on little-endian hosts */
+#define STAT_SHM_VERSION 1
+#define STAT_SHM_READ_ATTEMPTS 1000 /* Reads tried before giving up on a busy writer */
+
+#define STAT_SHM_MAX_CELLS 32
+#define STAT_SHM_MAX_RAILS 4
+#define STAT_SHM_LABEL_LEN 32
+
+/* Sections of the snapshot holding current data (stat_shm_snapshot_t.valid) */
+#define STAT_SHM_BATTERY (1u << 0)
+#define STAT_SHM_CELLS (1u << 1)
+#define STAT_SHM_RAILS (1u << 2)
+#define STAT_SHM_CPU (1u << 3)
+#define STAT_SHM_MEMORY (1u << 4)
+#define STAT_SHM_THERMAL (1u << 5)
+#define STAT_SHM_FAN (1u << 6)
+
+/* Charging state (stat_shm_snapshot_t.charging_state) */
+#define STAT_SHM_DISCHARGING 0
+#define STAT_SHM_IDLE 1
+#define STAT_SHM_CHARGING 2
+
+/* battery_temp_c when no sensor reports the pack temperature */
+#define STAT_SHM_TEMP_UNKNOWN -273.0f
+
+/**
+ * @brief One power rail (an INA3221 channel)
+ */
+typedef struct {
+   char label[STAT_SHM_LABEL_LEN]; /**< Channel label, NUL-terminated */
+   float voltage_v;                /**< Bus voltage */
+   float current_a;                /**< Current */
+   float power_w;                  /**< Power */
+   uint32_t reserved;
+} stat_shm_rail_t;
+
+/**
+ * @brief Telemetry of one main-loop iteration
+ *
+ * Sections whose STAT_SHM_* bit is clear in valid hold zeros.
+ */
+typedef struct {
+   uint64_t timestamp_ms; /**< Wall clock of the iteration (ms since the epoch) */
+   uint32_t valid;        /**< STAT_SHM_* sections present */
+   uint32_t reserved0;
+
+   /* Battery, as in the unified BatteryStatus message */
+   float battery_voltage_v;  /**< Pack voltage */
+   float battery_current_a;  /**< Pack current, positive when discharging */
+   float battery_power_w;    /**< Power drawn from the pack */
+   float battery_level_pct;  /**< State of charge */
+   float battery_temp_c;     /**< Warmest pack temperature, or STAT_SHM_TEMP_UNKNOWN */
+   float time_remaining_min; /**< Median time to empty, -1 if unknown */
+   uint32_t charging_state;  /**< STAT_SHM_DISCHARGING / _IDLE / _CHARGING */
+   uint16_t critical_faults; /**< Active BMS faults by severity */
+   uint16_t warning_faults;
+
+   /* Cells of the first pack that answered */
+   uint32_t cell_count;                  /**< Cells in cell_mv */
+   uint32_t balancing;                   /**< Bit n set while cell n is balancing */
+   uint16_t cell_mv[STAT_SHM_MAX_CELLS]; /**< Cell voltages (mV) */
+
+   /* Power rails */
+   uint32_t rail_count;
+   uint32_t reserved1;
+   stat_shm_rail_t rails[STAT_SHM_MAX_RAILS];
+
+   /* Host */
+   float cpu_usage_pct;
+   float memory_usage_pct;
+   float system_temp_c; /**< SoC temperature */
+   int32_t fan_rpm;
+   int32_t fan_load_pct;
+   uint32_t reserved2;
+} stat_shm_snapshot_t;
+
+/**
+ * @brief The shared-memory object
+ */
+typedef struct {
+   uint32_t magic;         /**< STAT_SHM_MAGIC once initialized, 0 after the writer closed */
+   uint16_t version;       /**< STAT_SHM_VERSION */
+   uint16_t header_size;   /**< Offset of data */
+   uint32_t snapshot_size; /**< sizeof(stat_shm_snapshot_t) of the writer */
+   uint32_t seq;           /**< Sequence lock; odd while the writer is copying */
+   uint64_t reserved;
+   stat_shm_snapshot_t data;
+} stat_shm_segment_t;
+
+/**
+ * @brief Reader handle
+ */
+typedef struct {
+   const stat_shm_segment_t *seg; /**< Mapped segment, NULL when closed */
+   size_t size;                   /**< Mapped size */
+} stat_shm_reader_t;
+
+/**
+ * @brief Map the segment for reading
+ *
+ * @param reader Handle to fill
+ * @param name Shared-memory object name, NULL for STAT_SHM_DEFAULT_NAME
+ * @return int 0 on success, -1 with errno set (ENOENT: oasis-stat is not
+ *         running with --shm, EPROTO: incompatible layout)
+ */
+int stat_shm_reader_open(stat_shm_reader_t *reader, const char *name);
+
+/**
+ * @brief Copy out a consistent snapshot
+ *
+ * @param reader Open handle
+ * @param snapshot Output
+ * @param generation Optional; set to the number of snapshots published so far,
+ *                   so a caller can tell whether anything changed
+ * @return int 0 on success, -1 with errno set (EAGAIN: the writer stayed busy,
+ *         ENOENT: the writer has exited; reopen later)
+ */
+int stat_shm_read(const stat_shm_reader_t *reader,
+                  stat_shm_snapshot_t *snapshot,
+                  uint32_t *generation);
+
+/**
+ * @brief Unmap the segment
+ *
+ * @param reader Handle
+ */
+void stat_shm_reader_close(stat_shm_reader_t *reader);
+
+/* Writer side, used by oasis-stat */
+
+/**
+ * @brief Create (or replace) the segment
+ *
+ * @param name Shared-memory object name, NULL for STAT_SHM_DEFAULT_NAME
+ * @return int 0 on success, -1 on error
+ */
+int stat_shm_writer_open(const char *name);
+
+/**
+ * @brief Publish a snapshot (no-op unless the segment is open)
+ *
+ * @param snapshot Snapshot to copy in
+ */
+void stat_shm_writer_publish(const stat_shm_snapshot_t *snapshot);
+
+/**
+ * @brief Mark the segment closed for readers and remove it
+ */
+void stat_shm_writer_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STAT_SHM_H */
@@ -0,0 +1,146 @@
+/**
+ * @file stat_socket.h
+ * @brief Local query and streaming socket
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * With --socket, oasis-stat serves its telemetry on an AF_UNIX stream socket,
+ * independent of MQTT. A thread of its own runs the socket from an epoll
+ * loop; the main loop only hands it each iteration's snapshot.
+ *
+ * Framing, in both directions and in the host's byte order (the socket
+ * never leaves the machine):
+ *
+ *   uint32 length   bytes that follow (type + payload)
+ *   uint8  type     STAT_SOCK_*
+ *   payload
+ *
+ * Requests:
+ *   GET_SNAPSHOT  uint32 sections                 latest snapshot
+ *   GET_HISTORY   uint32 sections, uint32 count   up to count recent snapshots,
+ *                                                 oldest first, then HISTORY_END
+ *   SUBSCRIBE     uint32 sections, uint32 min_interval_ms
+ *                                                 a SNAPSHOT frame per iteration,
+ *                                                 at most one per interval
+ *   UNSUBSCRIBE   (none)
+ *
+ * Replies:
+ *   SNAPSHOT      uint64 timestamp_ms, uint32 generation, uint32 sections,
+ *                 then each section present, in STAT_SHM_* bit order, as the
+ *                 bytes of its fields in stat_shm_snapshot_t
+ *   HISTORY_END   uint32 count
+ *   ERROR         uint32 errno value
+ *
+ * sections selects STAT_SHM_* bits, 0 meaning all; a section is only sent
+ * when the iteration had data for it.
+ */
+
+#ifndef STAT_SOCKET_H
+#define STAT_SOCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stat_shm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STAT_SOCKET_DEFAULT_PATH "/run/oasis-stat.sock"
+#define STAT_SOCKET_MAX_CLIENTS 16
+#define STAT_SOCKET_HISTORY 300            /* Snapshots kept for GET_HISTORY */
+#define STAT_SOCKET_TX_BUFFER (128 * 1024) /* Pending output per client */
+#define STAT_SOCKET_MAX_FRAME 64           /* Longest request accepted */
+
+/* Request types */
+#define STAT_SOCK_GET_SNAPSHOT 0x01
+#define STAT_SOCK_GET_HISTORY 0x02
+#define STAT_SOCK_SUBSCRIBE 0x03
+#define STAT_SOCK_UNSUBSCRIBE 0x04
+
+/* Reply types */
+#define STAT_SOCK_SNAPSHOT 0x81
+#define STAT_SOCK_HISTORY_END 0x82
+#define STAT_SOCK_ERROR 0xFF
+
+#define STAT_SOCK_HEADER_LEN 5                         /* length + type */
+#define STAT_SOCK_SNAPSHOT_HEADER_LEN 16               /* timestamp, generation, sections */
+#define STAT_SOCK_SNAPSHOT_MAX                         \
+   (STAT_SOCK_HEADER_LEN + STAT_SOCK_SNAPSHOT_HEADER_LEN + sizeof(stat_shm_snapshot_t))
+
+/**
+ * @brief Start serving on a socket path
+ *
+ * A stale socket file at path is replaced.
+ *
+ * @param path Socket path, NULL for STAT_SOCKET_DEFAULT_PATH
+ * @return int 0 on success, -1 on error
+ */
+int stat_socket_start(const char *path);
+
+/**
+ * @brief Hand the server this iteration's snapshot
+ *
+ * Adds it to the history and wakes the server for the subscribers; never
+ * waits on a client.
+ *
+ * @param snapshot Snapshot to copy
+ */
+void stat_socket_publish(const stat_shm_snapshot_t *snapshot);
+
+/**
+ * @brief Stop the server, disconnect the clients and remove the socket
+ */
+void stat_socket_stop(void);
+
+/**
+ * @brief Encode a SNAPSHOT frame
+ *
+ * @param snapshot Snapshot
+ * @param generation Its generation
+ * @param sections STAT_SHM_* sections wanted, 0 for all
+ * @param frame Output, at least STAT_SOCK_SNAPSHOT_MAX bytes
+ * @return size_t Frame length, including the length field
+ */
+size_t stat_socket_encode_snapshot(const stat_shm_snapshot_t *snapshot,
+                                   uint32_t generation,
+                                   uint32_t sections,
+                                   uint8_t *frame);
+
+/**
+ * @brief Decode the payload of a SNAPSHOT frame
+ *
+ * @param payload Payload (after the type byte)
+ * @param len Payload length
+ * @param snapshot Output; sections not in the frame are zeroed
+ * @param generation Optional output
+ * @return int 0 on success, -1 if the payload is malformed
+ */
+int stat_socket_decode_snapshot(const uint8_t *payload,
+                                size_t len,
+                                stat_shm_snapshot_t *snapshot,
+                                uint32_t *generation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STAT_SOCKET_H */
@@ -0,0 +1,117 @@
+/**
+ * @file stat_window.h
+ * @brief Streaming statistics over the samples between two publishes
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * When the publish interval is longer than the sampling interval, a point
+ * sample per message would hide whatever happened in between. A window folds
+ * in every sample at the sampling rate (Welford mean and variance, extremes,
+ * and the time integral) in constant space, and is read and reset when the
+ * message goes out.
+ */
+
+#ifndef STAT_WINDOW_H
+#define STAT_WINDOW_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Statistics of one metric over a window
+ *
+ * Zero-initialized state (or stat_window_reset()) is an empty window.
+ */
+typedef struct {
+   uint32_t count;    /**< Samples folded in */
+   double mean;       /**< Running mean */
+   double m2;         /**< Sum of squared deviations from the mean (Welford) */
+   float min;         /**< Smallest sample */
+   float max;         /**< Largest sample */
+   double integral;   /**< Sum of sample x interval it stands for (unit x s) */
+   double duration_s; /**< Sum of those intervals (s) */
+} stat_window_t;
+
+/**
+ * @brief Voltage, current and power readings between two messages
+ *
+ * Used for the INA238 battery and for each INA3221 channel.
+ */
+typedef struct {
+   stat_window_t voltage; /**< Bus voltage (V) */
+   stat_window_t current; /**< Current (A, positive = discharge); integral in A*s */
+   stat_window_t power;   /**< Power (W); integral in J */
+} stat_battery_window_t;
+
+/**
+ * @brief Empty a window
+ *
+ * @param w Window
+ */
+void stat_window_reset(stat_window_t *w);
+
+/**
+ * @brief Fold in one sample
+ *
+ * @param w Window
+ * @param value Sample
+ * @param dt_s Time since the previous sample, which this sample stands for
+ *             in the integral; 0 or less adds nothing to it
+ */
+void stat_window_add(stat_window_t *w, float value, float dt_s);
+
+/**
+ * @brief Population standard deviation of the window's samples
+ *
+ * @param w Window
+ * @return float Standard deviation, 0 with fewer than two samples
+ */
+float stat_window_stddev(const stat_window_t *w);
+
+/**
+ * @brief Empty the three battery windows
+ *
+ * @param w Battery window
+ */
+void stat_battery_window_reset(stat_battery_window_t *w);
+
+/**
+ * @brief Fold in one INA238 sample
+ *
+ * @param w Battery window
+ * @param voltage Bus voltage (V)
+ * @param current Current (A)
+ * @param power Power (W)
+ * @param dt_s Time since the previous sample (s)
+ */
+void stat_battery_window_add(stat_battery_window_t *w,
+                             float voltage,
+                             float current,
+                             float power,
+                             float dt_s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STAT_WINDOW_H */
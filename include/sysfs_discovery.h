@@ -0,0 +1,123 @@
+/**
+ * @file sysfs_discovery.h
+ * @brief Cache of resolved sysfs paths and hotplug notification
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * The fan, thermal zone and INA3221 lookups walk several sysfs directories.
+ * Their results are kept in a small "key path" text file so the next start
+ * only has to validate one path per sensor. While running, kernel uevents for
+ * the hwmon and thermal subsystems tell the monitors to resolve their paths
+ * again when a device is added, removed or renumbered.
+ */
+
+#ifndef SYSFS_DISCOVERY_H
+#define SYSFS_DISCOVERY_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYSFS_DISCOVERY_CACHE_PATH "/var/lib/oasis-stat/sysfs-paths"
+
+/* Cache keys */
+#define SYSFS_KEY_FAN_RPM "fan_rpm"
+#define SYSFS_KEY_FAN_PWM "fan_pwm"
+#define SYSFS_KEY_FAN_NAME "fan_hwmon_name" /* hwmon name of the fan_rpm device */
+#define SYSFS_KEY_THERMAL "thermal_temp"
+#define SYSFS_KEY_INA3221 "ina3221_hwmon"
+
+/* Change mask returned by sysfs_discovery_watch_poll() */
+#define SYSFS_CHANGE_HWMON 0x01u
+#define SYSFS_CHANGE_THERMAL 0x02u
+
+/**
+ * @brief Load the discovery cache
+ *
+ * A missing or unreadable file leaves the cache empty. Values are absolute
+ * paths, except for keys ending in "_name", which hold a device name.
+ *
+ * @param path Cache file path (default SYSFS_DISCOVERY_CACHE_PATH), or NULL/"" to disable
+ * @return int Number of entries loaded, negative if the cache is disabled
+ */
+int sysfs_discovery_load(const char *path);
+
+/**
+ * @brief Look up a cached path
+ *
+ * @param key Cache key (one of the SYSFS_KEY_* names)
+ * @param value Buffer filled with the cached path
+ * @param size Size of the buffer
+ * @return int 0 if the key is cached and fits, -1 otherwise
+ */
+int sysfs_discovery_get(const char *key, char *value, size_t size);
+
+/**
+ * @brief Store a resolved path
+ *
+ * @param key Cache key (one of the SYSFS_KEY_* names)
+ * @param value Resolved path, or NULL/"" to drop the entry
+ */
+void sysfs_discovery_set(const char *key, const char *value);
+
+/**
+ * @brief Write the cache back to its file if anything changed
+ *
+ * The file is replaced atomically (temporary file + rename).
+ *
+ * @return int 0 on success or when nothing changed, negative on error
+ */
+int sysfs_discovery_save(void);
+
+/**
+ * @brief Start listening for kernel hwmon/thermal uevents
+ *
+ * @return int 0 on success, negative on error (hotplug is then not followed)
+ */
+int sysfs_discovery_watch_open(void);
+
+/**
+ * @brief Drain pending uevents without blocking
+ *
+ * @return unsigned Mask of SYSFS_CHANGE_* bits for devices added, removed or moved
+ */
+unsigned sysfs_discovery_watch_poll(void);
+
+/**
+ * @brief Classify one uevent message
+ *
+ * @param msg Raw message as received from the kernel (NUL-separated fields)
+ * @param len Message length in bytes
+ * @return unsigned Mask of SYSFS_CHANGE_* bits, 0 if the event is irrelevant
+ */
+unsigned sysfs_discovery_parse_uevent(const char *msg, size_t len);
+
+/**
+ * @brief Stop listening for uevents and forget the cache
+ */
+void sysfs_discovery_cleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSFS_DISCOVERY_H */
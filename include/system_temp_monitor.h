@@ -32,12 +32,22 @@ extern "C" {
 /**
  * @brief Initialize system temperature monitoring
  *
- * Scans thermal zones to find junction temperature sensor (tj-thermal)
+ * Scans thermal zones to find junction temperature sensor (tj-thermal),
+ * unless the zone recorded in the sysfs discovery cache is still suitable.
  *
  * @return int 0 on success, negative on error
  */
 int system_temp_monitor_init(void);
 
+/**
+ * @brief Find the thermal zone again, ignoring the discovery cache
+ *
+ * Called after a thermal zone was added or removed.
+ *
+ * @return int 0 on success, negative if no suitable zone exists
+ */
+int system_temp_monitor_rescan(void);
+
 /**
  * @brief Get system temperature in Celsius
  *
@@ -0,0 +1,218 @@
+/**
+ * @file telemetry_record.h
+ * @brief Record and replay of raw sensor readings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * A recording is a line-oriented text file. Each main-loop iteration starts
+ * with a "T" line and is followed by the raw readings taken during that
+ * iteration (INA238 registers, INA3221 sysfs values, Daly response frames
+ * and proc/sysfs samples). Replaying a file feeds those readings back through
+ * the same conversion, battery-model, health and publish code as live data.
+ */
+
+#ifndef TELEMETRY_RECORD_H
+#define TELEMETRY_RECORD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "daly_bms.h"
+#include "ina238.h"
+#include "ina3221.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMETRY_RECORD_VERSION 1
+
+/* One poll is at most 5 fixed requests + 32 cell + 16 temp attempts + 2 */
+#define TELEMETRY_MAX_DALY_FRAMES 64
+
+/**
+ * @brief Acquisition settings needed to reproduce a recording
+ */
+typedef struct {
+   float r_shunt;       /**< INA238 shunt resistance in Ohms */
+   float max_current;   /**< INA238 maximum current in Amps */
+   uint8_t i2c_addr;    /**< INA238 I2C address */
+   int power_monitor;   /**< Power monitor selection in effect while recording */
+   bool bms_enable;     /**< Whether Daly frames are present */
+   int interval_ms;     /**< Main loop sampling interval */
+   int bms_interval_ms; /**< Daly polling interval */
+} telemetry_record_header_t;
+
+/**
+ * @brief Host metrics sampled once per iteration
+ */
+typedef struct {
+   float cpu_usage;          /**< CPU utilization percent */
+   float memory_usage;       /**< Memory utilization percent */
+   float system_temperature; /**< System temperature in Celsius (-1 if unavailable) */
+   bool fan_available;       /**< Fan readings present */
+   int fan_rpm;              /**< Fan speed in RPM */
+   int fan_load;             /**< Fan load percent */
+   int fan_pwm;              /**< Fan PWM value (0-255) */
+} telemetry_proc_sample_t;
+
+/**
+ * @brief Raw INA3221 channel values (sysfs units)
+ */
+typedef struct {
+   int channel;                       /**< Channel number (1-3) */
+   int voltage_mv;                    /**< in<N>_input */
+   int current_ma;                    /**< curr<N>_input */
+   char label[INA3221_LABEL_MAX_LEN]; /**< Channel label */
+} telemetry_ina3221_raw_t;
+
+/**
+ * @brief One recorded Daly request/response exchange
+ */
+typedef struct {
+   uint8_t cmd;                   /**< Command that was requested */
+   bool ok;                       /**< false if the exchange failed (timeout etc.) */
+   uint8_t frame[DALY_FRAME_LEN]; /**< Complete response frame when ok */
+} telemetry_daly_frame_t;
+
+/**
+ * @brief Everything read during one main-loop iteration
+ */
+typedef struct {
+   uint64_t t_us;  /**< Monotonic time since recording start (microseconds) */
+   int64_t wall_ms; /**< Wall-clock time when recorded (ms since epoch) */
+
+   bool has_ina238;     /**< INA238 registers present */
+   ina238_raw_t ina238; /**< INA238 register snapshot */
+
+   int ina3221_count;                                       /**< INA3221 channels present */
+   telemetry_ina3221_raw_t ina3221[INA3221_MAX_CHANNELS]; /**< INA3221 channel values */
+
+   int daly_count;                                      /**< Daly exchanges present */
+   int daly_next;                                       /**< Replay cursor into daly[] */
+   telemetry_daly_frame_t daly[TELEMETRY_MAX_DALY_FRAMES]; /**< Daly exchanges in order */
+
+   bool has_proc;                /**< Host metrics present */
+   telemetry_proc_sample_t proc; /**< Host metrics */
+} telemetry_tick_t;
+
+/**
+ * @brief Start recording to a file (truncates an existing file)
+ *
+ * @param path Output file path
+ * @param header Acquisition settings written at the top of the file
+ * @return int 0 on success, negative on error
+ */
+int telemetry_record_open(const char *path, const telemetry_record_header_t *header);
+
+/**
+ * @brief Check whether a recording is in progress
+ *
+ * @return bool true if telemetry_record_open() succeeded and is not yet closed
+ */
+bool telemetry_record_active(void);
+
+/**
+ * @brief Mark the start of a main-loop iteration
+ *
+ * The record_* functions below are no-ops when no recording is active.
+ */
+void telemetry_record_tick(void);
+
+/**
+ * @brief Record an INA238 register snapshot
+ *
+ * @param raw Raw registers
+ */
+void telemetry_record_ina238(const ina238_raw_t *raw);
+
+/**
+ * @brief Record the raw sysfs values of all valid INA3221 channels
+ *
+ * @param measurements Measurements as returned by ina3221_read_measurements()
+ */
+void telemetry_record_ina3221(const ina3221_measurements_t *measurements);
+
+/**
+ * @brief Record one Daly exchange (signature matches daly_frame_hooks_t.on_frame)
+ *
+ * @param ctx Unused
+ * @param dev Device the exchange was made with
+ * @param cmd Command that was requested
+ * @param frame Complete response frame, or NULL if the exchange failed
+ */
+void telemetry_record_daly_frame(void *ctx,
+                                 const daly_device_t *dev,
+                                 uint8_t cmd,
+                                 const uint8_t *frame);
+
+/**
+ * @brief Record the host metrics for this iteration
+ *
+ * @param sample Host metrics
+ */
+void telemetry_record_proc(const telemetry_proc_sample_t *sample);
+
+/**
+ * @brief Flush and close the recording
+ */
+void telemetry_record_close(void);
+
+/**
+ * @brief Open a recording for replay and read its header
+ *
+ * @param path Recording file path
+ * @param header Filled with the settings the file was recorded with
+ * @return int 0 on success, negative on error
+ */
+int telemetry_replay_open(const char *path, telemetry_record_header_t *header);
+
+/**
+ * @brief Read the next iteration from the recording
+ *
+ * @param tick Filled with the readings of the next iteration
+ * @return int 1 if a tick was read, 0 at end of file, negative on a malformed file
+ */
+int telemetry_replay_next(telemetry_tick_t *tick);
+
+/**
+ * @brief Serve a recorded Daly exchange (signature matches daly_frame_hooks_t.fetch_frame)
+ *
+ * @param ctx The telemetry_tick_t currently being replayed
+ * @param dev Device the request is made for
+ * @param cmd Command being requested
+ * @param frame Filled with the recorded response frame
+ * @return int 0 if a successful exchange for cmd was recorded next, -1 otherwise
+ */
+int telemetry_replay_fetch_daly_frame(void *ctx,
+                                      const daly_device_t *dev,
+                                      uint8_t cmd,
+                                      uint8_t *frame);
+
+/**
+ * @brief Close the replay file
+ */
+void telemetry_replay_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TELEMETRY_RECORD_H */
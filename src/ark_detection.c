@@ -32,7 +32,7 @@
 #include <string.h>
 
 #include "i2c_utils.h"
-#include "logging.h"
+#include "stat_log.h"
 
 /**
  * @brief Read serial number from ARK Jetson Carrier EEPROM
@@ -24,14 +24,16 @@
 
 #include "battery_model.h"
 
+#include <limits.h>
 #include <math.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
-#include "logging.h"
+#include "stat_log.h"
 
 /* Discharge curve points [soc (0-1), voltage per cell] */
 typedef struct {
@@ -40,7 +42,8 @@ typedef struct {
 } discharge_point_t;
 
 /* Note: all of these folowing tables have been adjusted to multiple sources
- * UNDER LOAD, not open circuit.
+ * UNDER LOAD, not open circuit. battery_calculate_percentage_loaded() moves
+ * a reading to that load (BATTERY_CURVE_REF_C_RATE) before the lookup.
  */
 /* Li-ion discharge curve (typical 18650/21700 cell) */
 static const discharge_point_t liion_discharge_curve[] = {
@@ -93,6 +96,15 @@ static const discharge_point_t lifepo4_discharge_curve[] = {
    { 1.00, 3.38 }  /* 100% - fully charged */
 };
 
+/* Linear fallback for chemistries without a curve (assumes the Li-ion range) */
+static const discharge_point_t linear_discharge_curve[] = {
+   { 0.00, 3.00 },
+   { 1.00, 4.20 }
+};
+
+/* Default tables for the configured battery */
+static battery_lut_t default_lut;
+
 /**
  * @brief Initialize battery configuration with default values
  *
@@ -114,6 +126,7 @@ int init_battery_config(battery_config_t *config) {
    config->cells_series = 0;
    config->cells_parallel = 1;
    config->chemistry = BATT_CHEMISTRY_UNKNOWN;
+   config->resistance_ohm = 0.0f;
 
    // Use strncpy to avoid buffer overflow
    strncpy(config->name, "uninitialized", BATTERY_NAME_MAX_LENGTH - 1);
@@ -176,21 +189,54 @@ static float interp_tbl(const tf_pair_t *tbl, size_t n, float Tc) {
    return 1.0f; /* should never hit */
 }
 
-// temperature derate factor (0 – 1) at 25 °C ref
-static float battery_temp_capacity_factor(const battery_config_t *cfg, float temp_c) {
-   switch (cfg->chemistry) {
-      case BATT_CHEMISTRY_LIION:
-         return interp_tbl(tf_liion, sizeof tf_liion / sizeof tf_liion[0], temp_c);
+/**
+ * @brief Capacity-retention table for a chemistry
+ */
+static const tf_pair_t *chemistry_tf_table(battery_chemistry_t chemistry, size_t *n) {
+   switch (chemistry) {
       case BATT_CHEMISTRY_LIPO:
-         return interp_tbl(tf_lipo, sizeof tf_lipo / sizeof tf_lipo[0], temp_c);
+         *n = sizeof tf_lipo / sizeof tf_lipo[0];
+         return tf_lipo;
       case BATT_CHEMISTRY_LIFEPO4:
-         return interp_tbl(tf_lifepo4, sizeof tf_lifepo4 / sizeof tf_lifepo4[0], temp_c);
+         *n = sizeof tf_lifepo4 / sizeof tf_lifepo4[0];
+         return tf_lifepo4;
       case BATT_CHEMISTRY_NIMH:
-         return interp_tbl(tf_nimh, sizeof tf_nimh / sizeof tf_nimh[0], temp_c);
+         *n = sizeof tf_nimh / sizeof tf_nimh[0];
+         return tf_nimh;
       case BATT_CHEMISTRY_LEAD_ACID:
-         return interp_tbl(tf_lead, sizeof tf_lead / sizeof tf_lead[0], temp_c);
+         *n = sizeof tf_lead / sizeof tf_lead[0];
+         return tf_lead;
+      case BATT_CHEMISTRY_LIION:
       default: /* unknown: fall back to Li-ion table as “least wrong” */
-         return interp_tbl(tf_liion, sizeof tf_liion / sizeof tf_liion[0], temp_c);
+         *n = sizeof tf_liion / sizeof tf_liion[0];
+         return tf_liion;
+   }
+}
+
+// temperature derate factor (0 – 1) at 25 °C ref
+static float battery_temp_capacity_factor(const battery_config_t *cfg, float temp_c) {
+   size_t n;
+   const tf_pair_t *tbl = chemistry_tf_table(cfg->chemistry, &n);
+   return interp_tbl(tbl, n, temp_c);
+}
+
+/**
+ * @brief Discharge curve for a chemistry
+ */
+static const discharge_point_t *chemistry_curve(battery_chemistry_t chemistry, size_t *n) {
+   switch (chemistry) {
+      case BATT_CHEMISTRY_LIION:
+         *n = sizeof(liion_discharge_curve) / sizeof(discharge_point_t);
+         return liion_discharge_curve;
+      case BATT_CHEMISTRY_LIPO:
+         *n = sizeof(lipo_discharge_curve) / sizeof(discharge_point_t);
+         return lipo_discharge_curve;
+      case BATT_CHEMISTRY_LIFEPO4:
+         *n = sizeof(lifepo4_discharge_curve) / sizeof(discharge_point_t);
+         return lifepo4_discharge_curve;
+      default:
+         *n = sizeof(linear_discharge_curve) / sizeof(discharge_point_t);
+         return linear_discharge_curve;
    }
 }
 
@@ -246,68 +292,584 @@ static float interpolate_soc(float cell_voltage,
 }
 
 /**
- * @brief Apply adaptive smoothing to battery runtime calculation
+ * @brief Interpolate cell voltage from discharge curve at a state of charge
+ */
+static float interpolate_voltage(float soc, const discharge_point_t *curve, size_t curve_size) {
+   if (soc <= curve[0].soc) {
+      return curve[0].voltage;
+   }
+
+   for (size_t i = 0; i < curve_size - 1; i++) {
+      if (soc <= curve[i + 1].soc) {
+         float position = (soc - curve[i].soc) / (curve[i + 1].soc - curve[i].soc);
+         return curve[i].voltage + position * (curve[i + 1].voltage - curve[i].voltage);
+      }
+   }
+
+   return curve[curve_size - 1].voltage;
+}
+
+/**
+ * @brief Build the lookup tables for a battery configuration
+ */
+int battery_lut_build(battery_lut_t *lut, const battery_config_t *battery) {
+   if (!lut || !battery || battery->chemistry == BATT_CHEMISTRY_UNKNOWN ||
+       battery->cells_series <= 0) {
+      return -1;
+   }
+
+   size_t n;
+   const discharge_point_t *curve = chemistry_curve(battery->chemistry, &n);
+   int mv_min = (int)lroundf(curve[0].voltage * 1000.0f);
+   int mv_max = (int)lroundf(curve[n - 1].voltage * 1000.0f);
+   if (mv_max - mv_min >= BATTERY_LUT_MAX_CELL_MV) {
+      return -1; /* Curve wider than the table */
+   }
+
+   memset(lut, 0, sizeof(*lut));
+   lut->chemistry = battery->chemistry;
+   lut->cells_series = battery->cells_series;
+   lut->cells_inv = 1.0f / (float)battery->cells_series;
+   lut->cell_mv_min = mv_min;
+   lut->cell_mv_span = mv_max - mv_min;
+
+   for (int i = 0; i <= lut->cell_mv_span; i++) {
+      float soc = interpolate_soc((mv_min + i) / 1000.0f, curve, n);
+      lut->soc_q[i] = (uint16_t)lroundf(soc * BATTERY_LUT_SOC_ONE);
+   }
+
+   for (int i = 0; i <= BATTERY_LUT_SOC_STEPS; i++) {
+      float v = interpolate_voltage((float)i / BATTERY_LUT_SOC_STEPS, curve, n);
+      lut->cell_mv[i] = (uint16_t)lroundf(v * 1000.0f);
+   }
+
+   const tf_pair_t *tbl = chemistry_tf_table(battery->chemistry, &n);
+   for (int i = 0; i < BATTERY_LUT_TEMP_STEPS; i++) {
+      float f = interp_tbl(tbl, n, BATTERY_LUT_TEMP_MIN_C + i * 0.5f);
+      lut->temp_q[i] = (uint16_t)lroundf(f * BATTERY_LUT_FACTOR_ONE);
+   }
+
+   lut->valid = true;
+   return 0;
+}
+
+/**
+ * @brief Build the default tables used by battery_calculate_percentage()
+ */
+int battery_model_init_lut(const battery_config_t *battery) {
+   default_lut.valid = false;
+   return battery_lut_build(&default_lut, battery);
+}
+
+/**
+ * @brief Get the default tables
+ */
+const battery_lut_t *battery_model_lut(void) {
+   return default_lut.valid ? &default_lut : NULL;
+}
+
+/**
+ * @brief Clamp x to [0, hi] (compiles to conditional moves)
+ */
+static inline int lut_clamp(int x, int hi) {
+   x = x < 0 ? 0 : x;
+   return x > hi ? hi : x;
+}
+
+/**
+ * @brief SOC for one cell voltage
  */
-float smooth_battery_runtime(float raw_time_min, float current_a, battery_source_t source_id) {
-   /* State variables for each source (0=INA238, 1=DalyBMS, 2=Unified) */
-   static float smoothed_times[SOURCE_MAX] = { 0 };
-   static float previous_currents[SOURCE_MAX] = { 0 };
-   static time_t last_significant_change[SOURCE_MAX] = { 0 };
-   static bool initialized[SOURCE_MAX] = { false };
+float battery_lut_cell_percent(const battery_lut_t *lut, float cell_voltage) {
+   int i = lut_clamp((int)(cell_voltage * 1000.0f + 0.5f) - lut->cell_mv_min, lut->cell_mv_span);
+   return lut->soc_q[i] * (100.0f / BATTERY_LUT_SOC_ONE);
+}
 
-   /* Ensure valid source_id */
-   if (source_id < 0 || source_id >= SOURCE_MAX) {
-      source_id = 0;
+/**
+ * @brief Cell voltage at a given SOC
+ */
+float battery_lut_cell_voltage(const battery_lut_t *lut, float percent) {
+   int i = lut_clamp((int)(percent * (BATTERY_LUT_SOC_STEPS / 100.0f) + 0.5f),
+                     BATTERY_LUT_SOC_STEPS);
+   return lut->cell_mv[i] * 0.001f;
+}
+
+/**
+ * @brief Capacity derating factor at a temperature
+ */
+float battery_lut_temp_factor(const battery_lut_t *lut, float temp_c) {
+   int i = lut_clamp((int)((temp_c - BATTERY_LUT_TEMP_MIN_C) * 2.0f + 0.5f),
+                     BATTERY_LUT_TEMP_STEPS - 1);
+   return lut->temp_q[i] * (1.0f / BATTERY_LUT_FACTOR_ONE);
+}
+
+/**
+ * @brief SOC for many cells at once
+ */
+void battery_lut_cells_percent(const battery_lut_t *lut, const int *cell_mv, float *percent, int n) {
+   const int mv_min = lut->cell_mv_min;
+   const int span = lut->cell_mv_span;
+   for (int k = 0; k < n; k++) {
+      percent[k] = lut->soc_q[lut_clamp(cell_mv[k] - mv_min, span)] *
+                   (100.0f / BATTERY_LUT_SOC_ONE);
    }
+}
 
-   /* Initialize on first call for this source */
-   if (!initialized[source_id]) {
-      smoothed_times[source_id] = raw_time_min;
-      previous_currents[source_id] = current_a;
-      last_significant_change[source_id] = time(NULL);
-      initialized[source_id] = true;
-      return raw_time_min;
+/**
+ * @brief SOC for many pack voltage samples at once
+ */
+void battery_lut_pack_percent(const battery_lut_t *lut,
+                              const float *pack_voltage,
+                              float *percent,
+                              int n) {
+   const float scale = 1000.0f * lut->cells_inv;
+   const int mv_min = lut->cell_mv_min;
+   const int span = lut->cell_mv_span;
+   for (int k = 0; k < n; k++) {
+      int mv = (int)(pack_voltage[k] * scale + 0.5f);
+      percent[k] = lut->soc_q[lut_clamp(mv - mv_min, span)] * (100.0f / BATTERY_LUT_SOC_ONE);
    }
+}
+
+/**
+ * @brief Cell OCV at a state of charge, and its slope (V per unit SOC)
+ */
+static float lut_cell_ocv(const battery_lut_t *lut, float soc, float *slope) {
+   float x = soc * BATTERY_LUT_SOC_STEPS;
+   x = x < 0.0f ? 0.0f : (x > BATTERY_LUT_SOC_STEPS - 1 ? BATTERY_LUT_SOC_STEPS - 1 : x);
+   int i = (int)x;
+   float f = x - (float)i;
+
+   /* Slope over +-1 % SOC; single 0.1 % steps are only a few mV apart */
+   int lo = lut_clamp(i - 10, BATTERY_LUT_SOC_STEPS);
+   int hi = lut_clamp(i + 11, BATTERY_LUT_SOC_STEPS);
+   *slope = (lut->cell_mv[hi] - lut->cell_mv[lo]) * (float)BATTERY_LUT_SOC_STEPS /
+            (1000.0f * (float)(hi - lo));
+
+   return (lut->cell_mv[i] + f * (lut->cell_mv[i + 1] - lut->cell_mv[i])) * 0.001f;
+}
 
-   /* Base smoothing factor */
-   float alpha_base = 0.1f; /* 10% weight to new reading */
-   float alpha = alpha_base;
+/**
+ * @brief Set up an SOC estimator for a pack
+ */
+int battery_ekf_init(battery_ekf_t *ekf, const battery_config_t *battery, const battery_lut_t *lut) {
+   if (!ekf || !battery || !lut || !lut->valid || battery->capacity_mah <= 0.0f ||
+       battery->cells_series <= 0) {
+      return -1;
+   }
 
-   /* Calculate current change percentage (use fabs to handle negative currents) */
-   float prev_current = previous_currents[source_id];
-   float current_change_percent = 0.0f;
+   float series = (float)battery->cells_series;
+   float parallel = battery->cells_parallel > 0 ? (float)battery->cells_parallel : 1.0f;
+
+   memset(ekf, 0, sizeof(*ekf));
+   ekf->r0 = BATTERY_EKF_R0_CELL * series / parallel;
+   ekf->r1 = BATTERY_EKF_R1_CELL * series / parallel;
+   ekf->tau_s = BATTERY_EKF_TAU_S;
+   ekf->q_soc = BATTERY_EKF_Q_SOC;
+   ekf->q_rc = BATTERY_EKF_Q_RC * series * series;
+   ekf->r_v = BATTERY_EKF_R_CELL_V * BATTERY_EKF_R_CELL_V * series * series;
+   ekf->capacity_as = battery->capacity_mah * 3.6f;
+   ekf->cells_series = battery->cells_series;
+   ekf->lut = lut;
+   return 0;
+}
 
-   /* Avoid division by zero or near-zero */
-   if (fabs(prev_current) > 0.1f) {
-      current_change_percent = fabs(current_a - prev_current) / fabs(prev_current);
+/**
+ * @brief Fold one voltage/current sample into the estimate
+ */
+void battery_ekf_update(battery_ekf_t *ekf, float voltage, float current_a, float dt_s) {
+   if (!ekf || !ekf->lut) {
+      return;
+   }
+
+   float cells = (float)ekf->cells_series;
+
+   /* Seed from the (load-compensated) voltage with a wide prior */
+   if (!ekf->initialized) {
+      float cell_v = (voltage + ekf->r0 * current_a) / cells;
+      ekf->soc = battery_lut_cell_percent(ekf->lut, cell_v) * 0.01f;
+      ekf->v_rc = 0.0f;
+      ekf->p[0][0] = 0.1f * 0.1f;
+      ekf->p[0][1] = ekf->p[1][0] = 0.0f;
+      ekf->p[1][1] = 0.05f * 0.05f * cells * cells;
+      ekf->initialized = true;
+      return;
    }
 
-   /* Get time since last significant change */
-   time_t now = time(NULL);
-   time_t time_since_change = now - last_significant_change[source_id];
+   dt_s = dt_s < 0.0f ? 0.0f : (dt_s > BATTERY_EKF_MAX_DT_S ? BATTERY_EKF_MAX_DT_S : dt_s);
+
+   /* Predict: coulomb counting and RC relaxation. F = [[1, 0], [0, a]] */
+   float a = expf(-dt_s / ekf->tau_s);
+   ekf->soc -= current_a * dt_s / ekf->capacity_as;
+   ekf->v_rc = a * ekf->v_rc + ekf->r1 * (1.0f - a) * current_a;
+
+   float p00 = ekf->p[0][0] + ekf->q_soc * dt_s;
+   float p01 = a * ekf->p[0][1];
+   float p11 = a * a * ekf->p[1][1] + ekf->q_rc * dt_s;
+
+   /* Correct with terminal voltage: v = OCV(soc) - v_rc - r0 * i, H = [dOCV/dsoc, -1] */
+   float slope;
+   float ocv = lut_cell_ocv(ekf->lut, ekf->soc, &slope) * cells;
+   float h0 = slope * cells;
+   float h1 = -1.0f;
+   float innovation = voltage - (ocv - ekf->v_rc - ekf->r0 * current_a);
+
+   float ph0 = p00 * h0 + p01 * h1; /* P H^T */
+   float ph1 = p01 * h0 + p11 * h1;
+   float s_inv = 1.0f / (h0 * ph0 + h1 * ph1 + ekf->r_v);
+   float k0 = ph0 * s_inv;
+   float k1 = ph1 * s_inv;
+
+   ekf->soc += k0 * innovation;
+   ekf->v_rc += k1 * innovation;
+
+   /* P = (I - K H) P, kept symmetric */
+   ekf->p[0][0] = p00 - k0 * ph0;
+   ekf->p[0][1] = ekf->p[1][0] = p01 - k0 * ph1;
+   ekf->p[1][1] = p11 - k1 * ph1;
+
+   ekf->soc = ekf->soc < 0.0f ? 0.0f : (ekf->soc > 1.0f ? 1.0f : ekf->soc);
+}
+
+/**
+ * @brief Estimated state of charge
+ */
+float battery_ekf_soc_percent(const battery_ekf_t *ekf) {
+   return ekf ? ekf->soc * 100.0f : 0.0f;
+}
+
+/**
+ * @brief One standard deviation of the SOC estimate
+ */
+float battery_ekf_sigma_percent(const battery_ekf_t *ekf) {
+   return (ekf && ekf->p[0][0] > 0.0f) ? sqrtf(ekf->p[0][0]) * 100.0f : 0.0f;
+}
 
-   /* Adapt smoothing factor based on change magnitude and time */
-   if (current_change_percent > 0.2f) {
-      /* Fast adaptation for significant changes (>20%) */
-      alpha = 0.5f;
-      last_significant_change[source_id] = now;
-   } else if (current_change_percent > 0.1f) {
-      /* Moderate adaptation for medium changes (>10%) */
-      alpha = 0.3f;
-      last_significant_change[source_id] = now;
-   } else if (time_since_change > 60) {
-      /* Gradual increase in adaptation if stable for over 60 seconds */
-      alpha = 0.2f;
+/**
+ * @brief Feed one voltage/current sample to a resistance estimator
+ */
+bool battery_rint_update(battery_rint_t *est, float voltage, float current_a, float dt_s) {
+   if (!est) {
+      return false;
    }
 
-   /* Apply exponential moving average smoothing */
-   float smoothed_time = (alpha * raw_time_min) + ((1.0f - alpha) * smoothed_times[source_id]);
+   bool used = false;
+   if (est->primed && dt_s >= 0.0f && dt_s <= BATTERY_RINT_MAX_DT_S) {
+      float di = current_a - est->last_i;
+      float dv = voltage - est->last_v;
+
+      /* A real load step moves the voltage against the current */
+      if (fabsf(di) >= BATTERY_RINT_MIN_STEP_A && dv * di < 0.0f &&
+          -dv <= BATTERY_RINT_MAX_OHM * fabsf(di)) {
+         if (est->p <= 0.0f) {
+            est->p = BATTERY_RINT_P0;
+         }
+
+         /* Scalar RLS on dv = x * R with x = -di */
+         float x = -di;
+         float k = est->p * x / (BATTERY_RINT_LAMBDA + x * est->p * x);
+         est->r_ohm += k * (dv - x * est->r_ohm);
+         est->p = (est->p - k * x * est->p) / BATTERY_RINT_LAMBDA;
+         est->steps++;
+
+         if (est->baseline_ohm <= 0.0f && est->steps >= BATTERY_RINT_BASELINE_STEPS) {
+            est->baseline_ohm = est->r_ohm;
+         }
+         used = true;
+      }
+   }
 
-   /* Update state variables */
-   smoothed_times[source_id] = smoothed_time;
-   previous_currents[source_id] = current_a;
+   est->last_v = voltage;
+   est->last_i = current_a;
+   est->primed = true;
+   return used;
+}
 
-   return smoothed_time;
+/**
+ * @brief Whether the estimate has seen enough steps to be used
+ */
+bool battery_rint_valid(const battery_rint_t *est) {
+   return est && est->steps >= BATTERY_RINT_MIN_STEPS && est->r_ohm > 0.0f;
+}
+
+/**
+ * @brief Resistance relative to the baseline
+ */
+float battery_rint_ratio(const battery_rint_t *est) {
+   if (!battery_rint_valid(est) || est->baseline_ohm <= 0.0f) {
+      return 0.0f;
+   }
+   return est->r_ohm / est->baseline_ohm;
+}
+
+/**
+ * @brief Load resistance baselines
+ */
+int battery_rint_load_baselines(const char *path, battery_rint_t *ests, int n) {
+   FILE *fp = path ? fopen(path, "r") : NULL;
+   if (!fp) {
+      return -1;
+   }
+
+   char line[64];
+   int loaded = 0;
+   while (fgets(line, sizeof(line), fp)) {
+      int index;
+      float ohm;
+      if (line[0] == '#' || sscanf(line, "%d %f", &index, &ohm) != 2) {
+         continue;
+      }
+      if (index >= 0 && index < n && ohm > 0.0f && ohm <= BATTERY_RINT_MAX_OHM) {
+         ests[index].baseline_ohm = ohm;
+         loaded++;
+      }
+   }
+   fclose(fp);
+   return loaded;
+}
+
+/**
+ * @brief Save the known resistance baselines
+ */
+int battery_rint_save_baselines(const char *path, const battery_rint_t *ests, int n) {
+   int known = 0;
+   for (int i = 0; i < n; i++) {
+      known += ests[i].baseline_ohm > 0.0f;
+   }
+   if (!path || known == 0) {
+      return 0;
+   }
+
+   char tmp_path[PATH_MAX + 8];
+   snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+   FILE *fp = fopen(tmp_path, "w");
+   if (!fp) {
+      return -1;
+   }
+
+   fprintf(fp, "# oasis-stat internal resistance baselines: <index> <ohm>\n");
+   for (int i = 0; i < n; i++) {
+      if (ests[i].baseline_ohm > 0.0f) {
+         fprintf(fp, "%d %.6f\n", i, ests[i].baseline_ohm);
+      }
+   }
+
+   if (fclose(fp) != 0 || rename(tmp_path, path) != 0) {
+      unlink(tmp_path);
+      return -1;
+   }
+   return 0;
+}
+
+/**
+ * @brief Battery percentage with the load effect on voltage removed
+ */
+float battery_calculate_percentage_loaded(float voltage,
+                                          float current_a,
+                                          const battery_config_t *battery) {
+   if (battery && battery->resistance_ohm > 0.0f) {
+      float ref_a = BATTERY_CURVE_REF_C_RATE * battery->capacity_mah / 1000.0f;
+      voltage += battery->resistance_ohm * (current_a - ref_a);
+   }
+   return battery_calculate_percentage(voltage, battery);
+}
+
+/**
+ * @brief Temperature capacity factor, from the tables when they match
+ */
+static float capacity_temp_factor(const battery_config_t *battery, float temp_c) {
+   return (default_lut.valid && default_lut.chemistry == battery->chemistry)
+              ? battery_lut_temp_factor(&default_lut, temp_c)
+              : battery_temp_capacity_factor(battery, temp_c);
+}
+
+/**
+ * @brief Peukert exponent for a chemistry
+ */
+static float chemistry_peukert(battery_chemistry_t chemistry) {
+   switch (chemistry) {
+      case BATT_CHEMISTRY_LIFEPO4:
+         return 1.03f;
+      case BATT_CHEMISTRY_NIMH:
+         return 1.15f;
+      case BATT_CHEMISTRY_LEAD_ACID:
+         return 1.25f;
+      case BATT_CHEMISTRY_LIION:
+      case BATT_CHEMISTRY_LIPO:
+      default:
+         return 1.05f;
+   }
+}
+
+/**
+ * @brief Histogram bin of a discharge current
+ */
+static int runtime_bin(float current_a) {
+   if (current_a < BATTERY_RUNTIME_IDLE_A) {
+      return 0;
+   }
+   int bin = 1 + (int)(log2f(current_a / BATTERY_RUNTIME_IDLE_A) * BATTERY_RUNTIME_BINS_PER_OCTAVE);
+   return bin < BATTERY_RUNTIME_BINS ? bin : BATTERY_RUNTIME_BINS - 1;
+}
+
+/**
+ * @brief Load at quantile q of the histogram (mean load of the bin it falls in)
+ */
+static float runtime_quantile(const battery_runtime_t *rt, float q) {
+   float target = q * rt->hist_total;
+   float cum = 0.0f;
+   for (int i = 0; i < BATTERY_RUNTIME_BINS; i++) {
+      cum += rt->hist[i];
+      if (rt->hist[i] > 0.0f && cum >= target) {
+         return rt->hist_load[i] / rt->hist[i];
+      }
+   }
+   return rt->level_a;
+}
+
+/**
+ * @brief Mean load of the histogram
+ */
+static float runtime_mean(const battery_runtime_t *rt) {
+   float sum = 0.0f;
+   for (int i = 0; i < BATTERY_RUNTIME_BINS; i++) {
+      sum += rt->hist_load[i];
+   }
+   return sum / rt->hist_total;
+}
+
+/**
+ * @brief Fold one current sample into a runtime predictor
+ */
+void battery_runtime_update(battery_runtime_t *rt, float current_a, float dt_s) {
+   if (!rt) {
+      return;
+   }
+
+   float load_a = current_a > 0.0f ? current_a : 0.0f;
+   if (rt->samples++ == 0) {
+      rt->level_a = load_a;
+      rt->trend_a_per_h = 0.0f;
+      return;
+   }
+   if (dt_s <= 0.0f) {
+      return;
+   }
+   /* A gap stands for at most one bucket of load */
+   if (dt_s > BATTERY_RUNTIME_BUCKET_S) {
+      dt_s = BATTERY_RUNTIME_BUCKET_S;
+   }
+
+   /* Holt's method with a damped trend, for irregular intervals */
+   float dt_h = dt_s / 3600.0f;
+   float prev = rt->level_a;
+   float phi = expf(-dt_h / BATTERY_RUNTIME_TREND_DAMP_H);
+   float predicted = prev + rt->trend_a_per_h * BATTERY_RUNTIME_TREND_DAMP_H * (1.0f - phi);
+   float alpha = 1.0f - expf(-dt_s / BATTERY_RUNTIME_LEVEL_TAU_S);
+   float beta = 1.0f - expf(-dt_s / BATTERY_RUNTIME_TREND_TAU_S);
+   rt->level_a = predicted + alpha * (load_a - predicted);
+   if (rt->level_a < 0.0f) {
+      rt->level_a = 0.0f;
+   }
+   rt->trend_a_per_h = beta * (rt->level_a - prev) / dt_h + (1.0f - beta) * phi * rt->trend_a_per_h;
+
+   /* Close a bucket into the decaying load histogram */
+   rt->bucket_as += load_a * dt_s;
+   rt->bucket_s += dt_s;
+   if (rt->bucket_s >= BATTERY_RUNTIME_BUCKET_S) {
+      float decay = expf(-rt->bucket_s / BATTERY_RUNTIME_HIST_TAU_S);
+      float weight = rt->bucket_s / BATTERY_RUNTIME_BUCKET_S;
+      float avg_a = rt->bucket_as / rt->bucket_s;
+      int bin = runtime_bin(avg_a);
+      rt->hist_total = 0.0f;
+      for (int i = 0; i < BATTERY_RUNTIME_BINS; i++) {
+         rt->hist[i] *= decay;
+         rt->hist_load[i] *= decay;
+         rt->hist_total += rt->hist[i];
+      }
+      rt->hist[bin] += weight;
+      rt->hist_load[bin] += weight * avg_a;
+      rt->hist_total += weight;
+      rt->bucket_as = 0.0f;
+      rt->bucket_s = 0.0f;
+   }
+}
+
+/**
+ * @brief Minutes to draw capacity_mah at load_a, with Peukert derating
+ */
+static float runtime_minutes(float capacity_mah, float load_a, float rated_a, float peukert) {
+   if (load_a < BATTERY_RUNTIME_IDLE_A) {
+      return BATTERY_RUNTIME_MAX_MIN;
+   }
+
+   /* Above the rated load less of the capacity is usable; below it the
+    * remaining capacity is not assumed to grow */
+   float factor = 1.0f;
+   if (rated_a > 0.0f && load_a > rated_a) {
+      factor = powf(rated_a / load_a, peukert - 1.0f);
+   }
+
+   float minutes = capacity_mah * factor / (load_a * 1000.0f) * 60.0f;
+   if (minutes < 0.0f) {
+      return 0.0f;
+   }
+   return minutes < BATTERY_RUNTIME_MAX_MIN ? minutes : BATTERY_RUNTIME_MAX_MIN;
+}
+
+/**
+ * @brief Forecast time to empty
+ */
+int battery_runtime_predict(const battery_runtime_t *rt,
+                            const battery_config_t *battery,
+                            float remaining_mah,
+                            float temp_c,
+                            battery_runtime_forecast_t *out) {
+   if (!rt || !out || rt->samples == 0) {
+      return -1;
+   }
+
+   float capacity_mah = remaining_mah > 0.0f ? remaining_mah : 0.0f;
+   float rated_a = 0.0f;
+   float peukert = 1.0f;
+   if (battery) {
+      if (temp_c > -100.0f) {
+         capacity_mah *= capacity_temp_factor(battery, temp_c);
+      }
+      rated_a = battery->capacity_mah / 1000.0f / BATTERY_RUNTIME_PEUKERT_H;
+      peukert = chemistry_peukert(battery->chemistry);
+   }
+
+   /* Range of loads seen: the 10th-90th percentile of the history, widened
+    * to include the present level */
+   float light_a = rt->level_a;
+   float heavy_a = rt->level_a;
+   float mean_a = rt->level_a;
+   if (rt->hist_total > 0.0f) {
+      light_a = fminf(light_a, runtime_quantile(rt, 0.1f));
+      heavy_a = fmaxf(heavy_a, runtime_quantile(rt, 0.9f));
+      mean_a = runtime_mean(rt);
+   }
+
+   /* Average of the forecast over the horizon it predicts. The damped Holt
+    * trend and the distance of the level from the long-run mean load both
+    * fade over BATTERY_RUNTIME_TREND_DAMP_H, so short horizons follow the
+    * present load and long ones the history. A trend overshooting after a
+    * load step is held within the range of loads seen. */
+   const float damp_h = BATTERY_RUNTIME_TREND_DAMP_H;
+   float load_a = rt->level_a;
+   for (int iter = 0; iter < 2; iter++) {
+      float horizon_h = runtime_minutes(capacity_mah, load_a, rated_a, peukert) / 60.0f;
+      float fade = horizon_h > 0.0f ? damp_h / horizon_h * (1.0f - expf(-horizon_h / damp_h)) : 1.0f;
+      float forecast = mean_a + (rt->level_a - mean_a) * fade +
+                       rt->trend_a_per_h * damp_h * (1.0f - fade);
+      load_a = forecast < light_a ? light_a : forecast > heavy_a ? heavy_a : forecast;
+   }
+
+   out->load_a = load_a;
+   out->p50_min = runtime_minutes(capacity_mah, load_a, rated_a, peukert);
+   out->p10_min = runtime_minutes(capacity_mah, heavy_a, rated_a, peukert);
+   out->p90_min = runtime_minutes(capacity_mah, light_a, rated_a, peukert);
+   return 0;
 }
 
 float battery_calculate_percentage(float voltage, const battery_config_t *battery) {
@@ -331,33 +893,18 @@ float battery_calculate_percentage(float voltage, const battery_config_t *batter
       return percentage;
    }
 
-   /* Get per-cell voltage */
-   float cell_voltage = get_cell_voltage(voltage, battery->cells_series);
-   float soc = 0.0f;
-
-   /* Select appropriate discharge curve based on chemistry */
-   switch (battery->chemistry) {
-      case BATT_CHEMISTRY_LIION:
-         soc = interpolate_soc(cell_voltage, liion_discharge_curve,
-                               sizeof(liion_discharge_curve) / sizeof(discharge_point_t));
-         break;
-
-      case BATT_CHEMISTRY_LIPO:
-         soc = interpolate_soc(cell_voltage, lipo_discharge_curve,
-                               sizeof(lipo_discharge_curve) / sizeof(discharge_point_t));
-         break;
-
-      case BATT_CHEMISTRY_LIFEPO4:
-         soc = interpolate_soc(cell_voltage, lifepo4_discharge_curve,
-                               sizeof(lifepo4_discharge_curve) / sizeof(discharge_point_t));
-         break;
-
-      default:
-         /* Fall back to linear model for other chemistries */
-         soc = (cell_voltage - 3.0f) / (4.2f - 3.0f); /* Assume Li-ion range */
-         break;
+   /* Dense table built at startup for this pack */
+   if (default_lut.valid && default_lut.chemistry == battery->chemistry &&
+       default_lut.cells_series == battery->cells_series) {
+      return battery_lut_cell_percent(&default_lut, voltage * default_lut.cells_inv);
    }
 
+   /* Get per-cell voltage and interpolate the chemistry's discharge curve */
+   float cell_voltage = get_cell_voltage(voltage, battery->cells_series);
+   size_t curve_size;
+   const discharge_point_t *curve = chemistry_curve(battery->chemistry, &curve_size);
+   float soc = interpolate_soc(cell_voltage, curve, curve_size);
+
    /* Convert to percentage and clamp */
    float percentage = soc * 100.0f;
    if (percentage < 0.0f)
@@ -384,8 +931,7 @@ float battery_estimate_time_remaining(const battery_state_t *state,
 
    /* Apply temperature compensation if temperature is available */
    if (state->temperature > -100.0f) { /* Valid temperature reading */
-      float temp_factor = battery_temp_capacity_factor(battery, state->temperature);
-      effective_capacity *= temp_factor;
+      effective_capacity *= capacity_temp_factor(battery, state->temperature);
    }
 
    /* Calculate remaining capacity in mAh */
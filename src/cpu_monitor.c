@@ -28,7 +28,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 
-#include "logging.h"
+#include "stat_log.h"
 
 /* Static variables */
 static float cpu_usage = 0.0f;
@@ -87,12 +87,9 @@ float cpu_monitor_get_usage(void) {
    long double a[6];
    long double total, idle, delta_total, delta_idle;
 
-   /* Check if initialized */
+   /* Initialized once at startup; a failed init is not retried per sample */
    if (!cpu_monitor_initialized) {
-      /* Try to initialize */
-      if (cpu_monitor_init() != 0) {
-         return -1.0f;
-      }
+      return -1.0f;
    }
 
    /* Open /proc/stat to read current CPU values */
@@ -18,8 +18,10 @@
 
 #include "daly_bms.h"
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,20 +33,52 @@
 #include <unistd.h>
 
 #include "daly_bms_internal.h"
-#include "logging.h"
+#include "stat_log.h"
 
 /* Internal function prototypes (not exposed to tests) */
-static int daly_build_request(uint8_t cmd, uint8_t *frame, const uint8_t *payload);
+static int daly_build_request(uint8_t addr, uint8_t cmd, uint8_t *frame, const uint8_t *payload);
 static int daly_read_exact(int fd, uint8_t *buf, size_t len, int timeout_ms);
-static int daly_read_frame(int fd, uint8_t expected_cmd, uint8_t *data, int timeout_ms);
-static int daly_request(int fd,
+static int daly_read_frame(int fd,
+                           daly_link_t *link,
+                           uint8_t expected_addr,
+                           uint8_t expected_cmd,
+                           uint8_t *data,
+                           uint8_t *frame_out,
+                           int timeout_ms);
+static int daly_request(daly_device_t *dev,
                         uint8_t cmd,
                         uint8_t *response,
                         int timeout_ms,
                         const uint8_t *payload);
+static int daly_exchange(daly_device_t *dev,
+                         uint8_t cmd,
+                         uint8_t *response,
+                         const uint8_t *payload);
+static int daly_write(daly_device_t *dev, uint8_t cmd, const uint8_t *payload);
+static void daly_count_rejected(daly_link_t *link, const uint8_t *frame);
+
+/* Record/replay taps (see daly_bms_set_frame_hooks) */
+static daly_frame_hooks_t frame_hooks = { 0 };
+
+/* Auto-detection */
+#define DALY_DETECT_MAX_PORTS 16
+#define DALY_DETECT_TIMEOUT_MS 500
+#define DALY_SERIAL_BY_ID_DIR "/dev/serial/by-id"
+#define DALY_UDEV_TAG_DIR "/run/udev/tags/" DALY_UDEV_TAG
+#define DALY_SOC_READBACK_TOLERANCE_PCT 1.0f
+
+/* Baud rates auto-detection probes, most common first */
+static const int detect_bauds[] = {
+   9600,   /* Most common for Daly */
+   115200, /* Some custom firmware uses this */
+   0       /* End marker */
+};
+
+static char detect_cache_path[PATH_MAX] = DALY_DETECT_CACHE_PATH;
 
-/* Non-static parse helpers declared in daly_bms_internal.h for test access:
- * daly_checksum, daly_get_u16be, daly_parse_0x90/91/92/93/97/98 */
+/* Non-static helpers declared in daly_bms_internal.h for test access:
+ * daly_checksum, daly_get_u16be, daly_validate_frame, daly_parse_0x90/91/92/93/97/98,
+ * daly_probe_feed, daly_read_detect_cache, daly_write_detect_cache */
 
 /* Parse helpers that remain file-local (not yet unit-tested) */
 static void daly_parse_0x94(const uint8_t *data, daly_status_t *status);
@@ -57,79 +91,87 @@ static void daly_parse_0x96_frames(const uint8_t **frames,
                                    int ntc_count,
                                    daly_temps_t *temps);
 
-/* Fault descriptions by byte and bit position */
-static const char *const daly_faults[8][8] = {
+/* Fault code -> description and severity. Code = byte * 8 + bit of the 0x98
+ * data. L2 alarms and hardware failures are critical, L1 alarms and sensor
+ * errors are warnings, everything else is informational. */
+typedef struct {
+   const char *description;
+   daly_fault_severity_t severity;
+} daly_fault_info_t;
+
+static const daly_fault_info_t daly_fault_table[DALY_FAULT_CODES] = {
    /* Byte 0 */
-   {
-       "Cell volt high L1",
-       "Cell volt high L2",
-       "Cell volt low L1",
-       "Cell volt low L2",
-       "Sum volt high L1",
-       "Sum volt high L2",
-       "Sum volt low L1",
-       "Sum volt low L2",
-   },
+   { "Cell volt high L1", DALY_FAULT_WARNING },
+   { "Cell volt high L2", DALY_FAULT_CRITICAL },
+   { "Cell volt low L1", DALY_FAULT_WARNING },
+   { "Cell volt low L2", DALY_FAULT_CRITICAL },
+   { "Sum volt high L1", DALY_FAULT_WARNING },
+   { "Sum volt high L2", DALY_FAULT_CRITICAL },
+   { "Sum volt low L1", DALY_FAULT_WARNING },
+   { "Sum volt low L2", DALY_FAULT_CRITICAL },
    /* Byte 1 */
-   {
-       "Chg temp high L1",
-       "Chg temp high L2",
-       "Chg temp low L1",
-       "Chg temp low L2",
-       "Dischg temp high L1",
-       "Dischg temp high L2",
-       "Dischg temp low L1",
-       "Dischg temp low L2",
-   },
+   { "Chg temp high L1", DALY_FAULT_WARNING },
+   { "Chg temp high L2", DALY_FAULT_CRITICAL },
+   { "Chg temp low L1", DALY_FAULT_WARNING },
+   { "Chg temp low L2", DALY_FAULT_CRITICAL },
+   { "Dischg temp high L1", DALY_FAULT_WARNING },
+   { "Dischg temp high L2", DALY_FAULT_CRITICAL },
+   { "Dischg temp low L1", DALY_FAULT_WARNING },
+   { "Dischg temp low L2", DALY_FAULT_CRITICAL },
    /* Byte 2 */
-   {
-       "Chg OC L1",
-       "Chg OC L2",
-       "Dischg OC L1",
-       "Dischg OC L2",
-       "SOC high L1",
-       "SOC high L2",
-       "SOC low L1",
-       "SOC low L2",
-   },
+   { "Chg OC L1", DALY_FAULT_WARNING },
+   { "Chg OC L2", DALY_FAULT_CRITICAL },
+   { "Dischg OC L1", DALY_FAULT_WARNING },
+   { "Dischg OC L2", DALY_FAULT_CRITICAL },
+   { "SOC high L1", DALY_FAULT_WARNING },
+   { "SOC high L2", DALY_FAULT_CRITICAL },
+   { "SOC low L1", DALY_FAULT_WARNING },
+   { "SOC low L2", DALY_FAULT_CRITICAL },
    /* Byte 3 */
-   { "Diff volt L1", "Diff volt L2", "Diff temp L1", "Diff temp L2", "Reserved", "Reserved",
-     "Reserved", "Reserved" },
+   { "Diff volt L1", DALY_FAULT_WARNING },
+   { "Diff volt L2", DALY_FAULT_CRITICAL },
+   { "Diff temp L1", DALY_FAULT_WARNING },
+   { "Diff temp L2", DALY_FAULT_CRITICAL },
+   { "Reserved", DALY_FAULT_INFO },
+   { "Reserved", DALY_FAULT_INFO },
+   { "Reserved", DALY_FAULT_INFO },
+   { "Reserved", DALY_FAULT_INFO },
    /* Byte 4 */
-   {
-       "Chg MOS temp high",
-       "Dischg MOS temp high",
-       "Chg MOS temp sensor err",
-       "Dischg MOS temp sensor err",
-       "Chg MOS adhesion err",
-       "Dischg MOS adhesion err",
-       "Chg MOS open circuit",
-       "Dischg MOS open circuit",
-   },
+   { "Chg MOS temp high", DALY_FAULT_WARNING },
+   { "Dischg MOS temp high", DALY_FAULT_WARNING },
+   { "Chg MOS temp sensor err", DALY_FAULT_WARNING },
+   { "Dischg MOS temp sensor err", DALY_FAULT_WARNING },
+   { "Chg MOS adhesion err", DALY_FAULT_WARNING },
+   { "Dischg MOS adhesion err", DALY_FAULT_WARNING },
+   { "Chg MOS open circuit", DALY_FAULT_CRITICAL },
+   { "Dischg MOS open circuit", DALY_FAULT_CRITICAL },
    /* Byte 5 */
-   {
-       "AFE collect chip err",
-       "Voltage collect dropped",
-       "Cell temp sensor err",
-       "EEPROM err",
-       "RTC err",
-       "Precharge failure",
-       "Communication failure",
-       "Internal comm failure",
-   },
+   { "AFE collect chip err", DALY_FAULT_WARNING },
+   { "Voltage collect dropped", DALY_FAULT_INFO },
+   { "Cell temp sensor err", DALY_FAULT_WARNING },
+   { "EEPROM err", DALY_FAULT_WARNING },
+   { "RTC err", DALY_FAULT_WARNING },
+   { "Precharge failure", DALY_FAULT_CRITICAL },
+   { "Communication failure", DALY_FAULT_CRITICAL },
+   { "Internal comm failure", DALY_FAULT_CRITICAL },
    /* Byte 6 */
-   {
-       "Current module fault",
-       "Sum voltage detect fault",
-       "Short circuit protect fault",
-       "Low volt forbid charge",
-       "Reserved",
-       "Reserved",
-       "Reserved",
-       "Reserved",
-   },
+   { "Current module fault", DALY_FAULT_INFO },
+   { "Sum voltage detect fault", DALY_FAULT_CRITICAL },
+   { "Short circuit protect fault", DALY_FAULT_CRITICAL },
+   { "Low volt forbid charge", DALY_FAULT_INFO },
+   { "Reserved", DALY_FAULT_INFO },
+   { "Reserved", DALY_FAULT_INFO },
+   { "Reserved", DALY_FAULT_INFO },
+   { "Reserved", DALY_FAULT_INFO },
    /* Byte 7 */
-   { "Fault code bit0", "bit1", "bit2", "bit3", "bit4", "bit5", "bit6", "bit7" }
+   { "Fault code bit0", DALY_FAULT_INFO },
+   { "bit1", DALY_FAULT_INFO },
+   { "bit2", DALY_FAULT_INFO },
+   { "bit3", DALY_FAULT_INFO },
+   { "bit4", DALY_FAULT_INFO },
+   { "bit5", DALY_FAULT_INFO },
+   { "bit6", DALY_FAULT_INFO },
+   { "bit7", DALY_FAULT_INFO },
 };
 
 /**
@@ -148,12 +190,13 @@ uint8_t daly_checksum(const uint8_t *data, size_t len) {
 /**
  * @brief Build a Daly BMS request frame
  *
+ * @param addr Board address of the BMS (DALY_BMS_ADDR for a single BMS)
  * @param cmd Command byte
  * @param frame Output buffer for the complete frame (must be DALY_FRAME_LEN bytes)
  * @param payload Optional 8-byte payload (null for default zeros)
  * @return int Number of bytes in the frame
  */
-static int daly_build_request(uint8_t cmd, uint8_t *frame, const uint8_t *payload) {
+static int daly_build_request(uint8_t addr, uint8_t cmd, uint8_t *frame, const uint8_t *payload) {
    uint8_t default_payload[8] = { 0 };
 
    if (!payload) {
@@ -161,7 +204,7 @@ static int daly_build_request(uint8_t cmd, uint8_t *frame, const uint8_t *payloa
    }
 
    frame[0] = DALY_START_BYTE;
-   frame[1] = DALY_HOST_ADDR;
+   frame[1] = DALY_HOST_ADDR + (addr - DALY_BMS_ADDR);
    frame[2] = cmd;
    frame[3] = DALY_LEN_FIXED;
 
@@ -251,19 +294,86 @@ static int daly_read_exact(int fd, uint8_t *buf, size_t len, int timeout_ms) {
    return total_read;
 }
 
+/**
+ * @brief Count a frame daly_validate_frame() turned down, by cause
+ */
+static void daly_count_rejected(daly_link_t *link, const uint8_t *frame) {
+   if (daly_checksum(frame, DALY_FRAME_LEN - 1) != frame[DALY_FRAME_LEN - 1]) {
+      link->checksum_errors++;
+   } else {
+      link->mismatches++;
+   }
+}
+
+/**
+ * @brief Validate a complete 13-byte response frame
+ */
+int daly_validate_frame(const uint8_t *frame,
+                        uint8_t expected_addr,
+                        uint8_t expected_cmd,
+                        uint8_t *data) {
+   if (frame[0] != DALY_START_BYTE) {
+      return -1;
+   }
+
+   /* Check address, command, and length */
+   uint8_t addr = frame[1];
+   uint8_t cmd = frame[2];
+   uint8_t len = frame[3];
+
+   if (addr < DALY_BMS_ADDR || addr >= DALY_HOST_ADDR || len != DALY_LEN_FIXED) {
+      /* Invalid frame (or a request from another host on the bus) */
+      return -1;
+   }
+
+   if (expected_addr != 0 && addr != expected_addr) {
+      /* Reply from another BMS on the bus */
+      return -1;
+   }
+
+   if (expected_cmd != 0 && cmd != expected_cmd) {
+      /* Unexpected command */
+      return -1;
+   }
+
+   /* Verify checksum */
+   if (daly_checksum(frame, DALY_FRAME_LEN - 1) != frame[DALY_FRAME_LEN - 1]) {
+      /* Bad checksum */
+      return -1;
+   }
+
+   /* Frame is valid, copy data */
+   if (data) {
+      memcpy(data, frame + 4, 8);
+   }
+
+   return cmd;
+}
+
 /**
  * @brief Read a Daly BMS frame
  *
  * @param fd File descriptor
+ * @param expected_addr Board address the reply must come from
  * @param expected_cmd Expected command byte, or 0 to accept any command
  * @param data Buffer to store frame data (8 bytes)
+ * @param frame_out Optional buffer for the complete validated frame (DALY_FRAME_LEN bytes)
  * @param timeout_ms Timeout in milliseconds
- * @return int Command byte on success, -1 on error
+ * @return int Command byte on success, -1 if nothing usable arrived in time,
+ *         -2 if the time ran out after rejecting a frame
  */
-static int daly_read_frame(int fd, uint8_t expected_cmd, uint8_t *data, int timeout_ms) {
+static int daly_read_frame(int fd,
+                           daly_link_t *link,
+                           uint8_t expected_addr,
+                           uint8_t expected_cmd,
+                           uint8_t *data,
+                           uint8_t *frame_out,
+                           int timeout_ms) {
    struct timespec start_time, now;
    clock_gettime(CLOCK_MONOTONIC, &start_time);
    int elapsed_ms;
+   bool hunting = false;
+   bool rejected = false;
 
    while (1) {
       /* Check for timeout */
@@ -272,58 +382,48 @@ static int daly_read_frame(int fd, uint8_t expected_cmd, uint8_t *data, int time
                    (now.tv_nsec - start_time.tv_nsec) / 1000000;
       if (elapsed_ms >= timeout_ms) {
          /* Timeout */
-         return -1;
+         return rejected ? -2 : -1;
       }
 
       /* Try to read start byte */
-      uint8_t byte;
-      int n = daly_read_exact(fd, &byte, 1, timeout_ms - elapsed_ms);
+      uint8_t full_frame[DALY_FRAME_LEN];
+      int n = daly_read_exact(fd, full_frame, 1, timeout_ms - elapsed_ms);
       if (n != 1) {
-         return -1;
+         return rejected ? -2 : -1;
       }
+      link->bytes_read++;
 
-      if (byte != DALY_START_BYTE) {
+      if (full_frame[0] != DALY_START_BYTE) {
          /* Not a start byte, keep hunting */
+         if (!hunting) {
+            link->resyncs++;
+            hunting = true;
+         }
          continue;
       }
+      hunting = false;
 
       /* Read the rest of the frame */
-      uint8_t frame[DALY_FRAME_LEN - 1];
-      n = daly_read_exact(fd, frame, DALY_FRAME_LEN - 1, timeout_ms - elapsed_ms);
+      n = daly_read_exact(fd, full_frame + 1, DALY_FRAME_LEN - 1, timeout_ms - elapsed_ms);
+      if (n > 0) {
+         link->bytes_read += (uint64_t)n;
+      }
       if (n != DALY_FRAME_LEN - 1) {
          /* Incomplete frame */
          continue;
       }
 
-      /* Check address, command, and length */
-      uint8_t addr = frame[0];
-      uint8_t cmd = frame[1];
-      uint8_t len = frame[2];
-
-      if (addr != DALY_BMS_ADDR || len != DALY_LEN_FIXED) {
-         /* Invalid frame */
-         continue;
-      }
-
-      if (expected_cmd != 0 && cmd != expected_cmd) {
-         /* Unexpected command */
+      int cmd = daly_validate_frame(full_frame, expected_addr, expected_cmd, data);
+      if (cmd < 0) {
+         daly_count_rejected(link, full_frame);
+         rejected = true;
          continue;
       }
 
-      /* Verify checksum */
-      uint8_t full_frame[DALY_FRAME_LEN];
-      full_frame[0] = DALY_START_BYTE;
-      memcpy(full_frame + 1, frame, DALY_FRAME_LEN - 1);
-
-      uint8_t calc_checksum = daly_checksum(full_frame, DALY_FRAME_LEN - 1);
-      if (calc_checksum != frame[DALY_FRAME_LEN - 2]) {
-         /* Bad checksum */
-         continue;
+      if (frame_out) {
+         memcpy(frame_out, full_frame, DALY_FRAME_LEN);
       }
 
-      /* Frame is valid, copy data */
-      memcpy(data, frame + 3, 8);
-
       return cmd;
    }
 }
@@ -331,39 +431,206 @@ static int daly_read_frame(int fd, uint8_t expected_cmd, uint8_t *data, int time
 /**
  * @brief Send a request and read response
  *
- * @param fd File descriptor
+ * When a fetch hook is installed the serial port is bypassed and the frame
+ * comes from the hook instead; either way it is validated the same way and
+ * reported to the on_frame hook. Only a request that got no frame at all in
+ * time counts as a timeout; rejected replies have their own counters.
+ *
+ * @param dev Device to talk to
  * @param cmd Command byte
  * @param response Buffer to store response data (8 bytes)
  * @param timeout_ms Timeout in milliseconds
  * @param payload Optional 8-byte payload (null for default zeros)
  * @return int 0 on success, -1 on error
  */
-static int daly_request(int fd,
+static int daly_request(daly_device_t *dev,
                         uint8_t cmd,
                         uint8_t *response,
                         int timeout_ms,
                         const uint8_t *payload) {
    uint8_t frame[DALY_FRAME_LEN];
+   int result;
 
-   /* Build request frame */
-   daly_build_request(cmd, frame, payload);
+   dev->link.requests++;
+   if (frame_hooks.fetch_frame) {
+      result = -1;
+      /* Recordings hold one BMS, whatever its board address was */
+      if (frame_hooks.fetch_frame(frame_hooks.ctx, dev, cmd, frame) != 0) {
+         dev->link.timeouts++;
+      } else if (daly_validate_frame(frame, 0, cmd, response) >= 0) {
+         result = 0;
+      } else {
+         daly_count_rejected(&dev->link, frame);
+      }
+   } else {
+      /* Build request frame */
+      daly_build_request(dev->addr, cmd, frame, payload);
 
-   /* Flush input buffer */
-   tcflush(fd, TCIFLUSH);
+      /* Flush input buffer */
+      tcflush(dev->fd, TCIFLUSH);
 
-   /* Send request */
-   if (write(fd, frame, DALY_FRAME_LEN) != DALY_FRAME_LEN) {
-      OLOG_ERROR("Failed to write request frame: %s", strerror(errno));
-      return -1;
+      /* Send request */
+      if (write(dev->fd, frame, DALY_FRAME_LEN) != DALY_FRAME_LEN) {
+         OLOG_ERROR("Failed to write request frame: %s", strerror(errno));
+         result = -1;
+      } else {
+         /* Read response */
+         result = daly_read_frame(dev->fd, &dev->link, dev->addr, cmd, response, frame,
+                                  timeout_ms);
+         if (result == -1) {
+            dev->link.timeouts++;
+         }
+         result = result < 0 ? -1 : 0;
+      }
    }
 
-   /* Read response */
-   int result = daly_read_frame(fd, cmd, response, timeout_ms);
-   if (result < 0) {
-      return -1;
+   if (frame_hooks.on_frame) {
+      frame_hooks.on_frame(frame_hooks.ctx, dev, cmd, result == 0 ? frame : NULL);
    }
 
-   return 0;
+   return result;
+}
+
+/**
+ * @brief Map a command to its link statistics slot
+ */
+static int daly_cmd_slot(uint8_t cmd) {
+   return cmd >= DALY_CMD_PACK_INFO && cmd <= DALY_CMD_FAULTS ? cmd - DALY_CMD_PACK_INFO
+                                                               : DALY_LINK_OTHER;
+}
+
+/**
+ * @brief Command whose round trips a link statistics slot holds
+ */
+int daly_bms_link_cmd(int slot) {
+   return slot >= 0 && slot < DALY_LINK_OTHER ? DALY_CMD_PACK_INFO + slot : -1;
+}
+
+/**
+ * @brief Reply timeout for a command: smoothed RTT plus four deviations, backed off, clamped
+ *
+ * Until a command has been measured the configured timeout applies.
+ */
+int daly_bms_link_timeout(const daly_device_t *dev, int slot) {
+   const daly_link_t *link = &dev->link;
+   if (link->srtt_ms[slot] <= 0.0f) {
+      return dev->timeout_ms;
+   }
+
+   int timeout_ms = (int)ceilf(link->srtt_ms[slot] + 4.0f * link->rttvar_ms[slot]);
+   if (timeout_ms < DALY_RTT_FLOOR_MS) {
+      timeout_ms = DALY_RTT_FLOOR_MS;
+   }
+   for (int i = 0; i < link->backoff[slot] && timeout_ms < dev->timeout_ms; i++) {
+      timeout_ms *= 2;
+   }
+   return MIN(timeout_ms, dev->timeout_ms);
+}
+
+/**
+ * @brief Double a command's timeout after a failed attempt, until it reaches the configured one
+ */
+static void daly_rtt_backoff(daly_device_t *dev, int slot) {
+   if (daly_bms_link_timeout(dev, slot) < dev->timeout_ms) {
+      dev->link.backoff[slot]++;
+   }
+}
+
+/**
+ * @brief Count a measured round trip in a command's histogram
+ */
+static void daly_rtt_histogram(daly_link_t *link, int slot, float rtt_ms) {
+   int bucket = 0;
+   while (bucket < DALY_RTT_BUCKETS - 1 && rtt_ms >= (float)(DALY_RTT_BUCKET0_MS << bucket)) {
+      bucket++;
+   }
+   link->rtt_hist[slot][bucket]++;
+}
+
+/**
+ * @brief Fold a measured round trip into a command's smoothed RTT (RFC 6298 gains)
+ */
+static void daly_rtt_sample(daly_link_t *link, int slot, float rtt_ms) {
+   if (link->srtt_ms[slot] <= 0.0f) {
+      link->srtt_ms[slot] = rtt_ms;
+      link->rttvar_ms[slot] = rtt_ms / 2.0f;
+      return;
+   }
+
+   link->rttvar_ms[slot] += DALY_RTT_BETA * (fabsf(link->srtt_ms[slot] - rtt_ms) -
+                                             link->rttvar_ms[slot]);
+   link->srtt_ms[slot] += DALY_RTT_ALPHA * (rtt_ms - link->srtt_ms[slot]);
+}
+
+/**
+ * @brief Read with an adaptive timeout, retrying just this command on failure
+ *
+ * Only first attempts feed the estimate (Karn's rule), so a late reply to a
+ * request that was retried cannot skew it; the histogram counts every reply.
+ * Each failed attempt doubles the timeout, up to the configured one, and the
+ * doubling persists across exchanges until a first attempt is answered: a
+ * unit that has become slower than the estimate keeps getting the longer
+ * timeout until it yields a sample. Writes go through daly_write() instead.
+ *
+ * @return int 0 on success, -1 once every attempt failed
+ */
+static int daly_exchange(daly_device_t *dev,
+                         uint8_t cmd,
+                         uint8_t *response,
+                         const uint8_t *payload) {
+   int slot = daly_cmd_slot(cmd);
+
+   for (int attempt = 0; attempt <= DALY_REQUEST_RETRIES; attempt++) {
+      struct timespec start, end;
+      if (attempt > 0) {
+         dev->link.retries++;
+      }
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      if (daly_request(dev, cmd, response, daly_bms_link_timeout(dev, slot), payload) == 0) {
+         clock_gettime(CLOCK_MONOTONIC, &end);
+         if (!frame_hooks.fetch_frame) {
+            float rtt_ms = (float)(end.tv_sec - start.tv_sec) * 1000.0f +
+                           (float)(end.tv_nsec - start.tv_nsec) / 1e6f;
+            daly_rtt_histogram(&dev->link, slot, rtt_ms);
+            if (attempt == 0) {
+               daly_rtt_sample(&dev->link, slot, rtt_ms);
+            }
+         }
+         if (attempt == 0) {
+            dev->link.backoff[slot] = 0;
+         }
+         return 0;
+      }
+      daly_rtt_backoff(dev, slot);
+   }
+
+   return -1;
+}
+
+/**
+ * @brief Send a write command once, with the configured timeout
+ *
+ * A missing acknowledgement does not mean the BMS ignored the write, so it
+ * is never repeated; callers confirm the result with a read-back. Writes are
+ * rare and slow to commit, so they stay out of the RTT estimates.
+ *
+ * @return int 0 if the write was acknowledged, -1 otherwise
+ */
+static int daly_write(daly_device_t *dev, uint8_t cmd, const uint8_t *payload) {
+   uint8_t response[8];
+
+   return daly_request(dev, cmd, response, dev->timeout_ms, payload);
+}
+
+/**
+ * @brief Install (or clear, with NULL) the frame record/replay hooks
+ */
+void daly_bms_set_frame_hooks(const daly_frame_hooks_t *hooks) {
+   if (hooks) {
+      frame_hooks = *hooks;
+   } else {
+      memset(&frame_hooks, 0, sizeof(frame_hooks));
+   }
 }
 
 /**
@@ -523,227 +790,95 @@ void daly_parse_0x97(const uint8_t *data, int cell_count, bool *balance) {
 /**
  * @brief Parse fault flags from 0x98 command response
  */
-void daly_parse_0x98(const uint8_t *data, char faults[][64], int *fault_count) {
-   *fault_count = 0;
+void daly_parse_0x98(const uint8_t *data, daly_fault_bits_t *faults, int *fault_count) {
+   daly_fault_bits_t bits = 0;
 
    for (int byte_idx = 0; byte_idx < 8; byte_idx++) {
-      uint8_t mask = data[byte_idx];
-      if (!mask)
-         continue;
-
-      for (int bit = 0; bit < 8; bit++) {
-         if (mask & (1 << bit)) {
-            if (*fault_count < DALY_MAX_FAULTS) {
-               /* Copy fault description */
-               strncpy(faults[*fault_count], daly_faults[byte_idx][bit], 63);
-               faults[*fault_count][63] = '\0';
-               (*fault_count)++;
-            }
-         }
-      }
+      bits |= (daly_fault_bits_t)data[byte_idx] << (byte_idx * 8);
    }
+
+   *faults = bits;
+   *fault_count = __builtin_popcountll(bits);
 }
 
 /**
- * @brief Auto-detect Daly BMS on common serial ports
+ * @brief Get the description of a fault code
  */
-bool daly_bms_auto_detect(char *detected_port, int *detected_baud) {
-   if (!detected_port || !detected_baud) {
-      return false;
+const char *daly_fault_description(int code) {
+   if (code < 0 || code >= DALY_FAULT_CODES) {
+      return "Unknown";
    }
+   return daly_fault_table[code].description;
+}
 
-   /* List of common serial ports to try */
-   const char *ports[] = { "/dev/ttyTHS1", /* NVIDIA Jetson THS1 */
-                           "/dev/ttyTHS0", /* NVIDIA Jetson THS0 */
-                           "/dev/ttyS0",   /* Standard serial port */
-                           "/dev/ttyUSB0", /* USB-to-Serial adapter */
-                           "/dev/ttyACM0", /* Arduino/USB CDC device */
-                           NULL };
-
-   /* List of common baud rates to try */
-   const int baud_rates[] = {
-      9600,   /* Most common for Daly */
-      115200, /* Some custom firmware uses this */
-      0       /* End marker */
-   };
-
-   OLOG_INFO("Auto-detecting Daly BMS...");
-
-   for (int i = 0; ports[i] != NULL; i++) {
-      /* Check if port exists */
-      if (access(ports[i], F_OK) != 0) {
-         OLOG_INFO("Port %s not found, skipping", ports[i]);
-         continue;
-      }
-
-      for (int j = 0; baud_rates[j] != 0; j++) {
-         OLOG_INFO("Trying %s at %d baud...", ports[i], baud_rates[j]);
-
-         /* Try to open port */
-         int fd = open(ports[i], O_RDWR | O_NOCTTY);
-         if (fd < 0) {
-            OLOG_INFO("Failed to open %s: %s", ports[i], strerror(errno));
-            continue;
-         }
-
-         /* Configure port */
-         struct termios tty;
-         if (tcgetattr(fd, &tty) != 0) {
-            OLOG_INFO("Failed to get port attributes: %s", strerror(errno));
-            close(fd);
-            continue;
-         }
-
-         /* Set up serial port parameters (8N1) */
-         tty.c_cflag &= ~PARENB;
-         tty.c_cflag &= ~CSTOPB;
-         tty.c_cflag &= ~CSIZE;
-         tty.c_cflag |= CS8;
-         tty.c_cflag &= ~CRTSCTS;
-         tty.c_cflag |= CREAD | CLOCAL;
-         tty.c_lflag &= ~ICANON;
-         tty.c_lflag &= ~ECHO;
-         tty.c_lflag &= ~ECHOE;
-         tty.c_lflag &= ~ECHONL;
-         tty.c_lflag &= ~ISIG;
-         tty.c_iflag &= ~(IXON | IXOFF | IXANY);
-         tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL);
-         tty.c_oflag &= ~OPOST;
-         tty.c_oflag &= ~ONLCR;
-         tty.c_cc[VTIME] = 1;
-         tty.c_cc[VMIN] = 0;
-
-         /* Set baud rate */
-         speed_t baud_const;
-         switch (baud_rates[j]) {
-            case 9600:
-               baud_const = B9600;
-               break;
-            case 115200:
-               baud_const = B115200;
-               break;
-            default:
-               baud_const = B9600;
-               break;
-         }
-         cfsetispeed(&tty, baud_const);
-         cfsetospeed(&tty, baud_const);
-
-         if (tcsetattr(fd, TCSANOW, &tty) != 0) {
-            OLOG_INFO("Failed to set port attributes: %s", strerror(errno));
-            close(fd);
-            continue;
-         }
-
-         /* Flush buffers */
-         tcflush(fd, TCIOFLUSH);
-
-         /* Build request frame for basic pack info (0x90) */
-         uint8_t request[DALY_FRAME_LEN];
-         uint8_t payload[8] = { 0 };
-
-         request[0] = DALY_START_BYTE;
-         request[1] = DALY_HOST_ADDR;
-         request[2] = DALY_CMD_PACK_INFO;
-         request[3] = DALY_LEN_FIXED;
-         memcpy(request + 4, payload, 8);
-         request[12] = daly_checksum(request, 12);
-
-         /* Send request */
-         if (write(fd, request, DALY_FRAME_LEN) != DALY_FRAME_LEN) {
-            OLOG_INFO("Failed to write request: %s", strerror(errno));
-            close(fd);
-            continue;
-         }
-
-         /* Read response */
-         uint8_t response[DALY_FRAME_LEN];
-         memset(response, 0, DALY_FRAME_LEN);
-
-         /* Wait for response with timeout */
-         struct timeval timeout;
-         timeout.tv_sec = 0;
-         timeout.tv_usec = 500000; /* 500ms */
-
-         fd_set readfds;
-         FD_ZERO(&readfds);
-         FD_SET(fd, &readfds);
-
-         int select_result = select(fd + 1, &readfds, NULL, NULL, &timeout);
-         if (select_result <= 0) {
-            OLOG_INFO("No response from BMS");
-            close(fd);
-            continue;
-         }
-
-         /* Read first byte - should be start byte */
-         if (read(fd, response, 1) != 1 || response[0] != DALY_START_BYTE) {
-            OLOG_INFO("Invalid response start byte");
-            close(fd);
-            continue;
-         }
-
-         /* Read rest of frame */
-         int bytes_read = read(fd, response + 1, DALY_FRAME_LEN - 1);
-         if (bytes_read != DALY_FRAME_LEN - 1) {
-            OLOG_INFO("Failed to read complete frame");
-            close(fd);
-            continue;
-         }
-
-         /* Verify basic frame structure */
-         if (response[1] != DALY_BMS_ADDR || response[2] != DALY_CMD_PACK_INFO) {
-            OLOG_INFO("Invalid response header");
-            close(fd);
-            continue;
-         }
-
-         /* Success! Daly BMS detected */
-         OLOG_INFO("Daly BMS detected on %s at %d baud!", ports[i], baud_rates[j]);
-         strncpy(detected_port, ports[i], 63);
-         detected_port[63] = '\0';
-         *detected_baud = baud_rates[j];
+/**
+ * @brief Get the severity of a fault code
+ */
+daly_fault_severity_t daly_fault_severity(int code) {
+   if (code < 0 || code >= DALY_FAULT_CODES) {
+      return DALY_FAULT_INFO;
+   }
+   return daly_fault_table[code].severity;
+}
 
-         close(fd);
-         return true;
+/**
+ * @brief Get the fault codes of one severity as a bit mask
+ */
+daly_fault_bits_t daly_fault_mask(daly_fault_severity_t severity) {
+   daly_fault_bits_t mask = 0;
+   for (int code = 0; code < DALY_FAULT_CODES; code++) {
+      if (daly_fault_table[code].severity == severity) {
+         mask |= 1ULL << code;
       }
    }
-
-   OLOG_INFO("No Daly BMS detected on common ports");
-   return false;
+   return mask;
 }
 
 /**
- * @brief Initialize the Daly BMS device
+ * @brief Remove and return the lowest fault code from a set of flags
  */
-int daly_bms_init(daly_device_t *dev, const char *port, int baud, int timeout_ms) {
-   struct termios tty;
-   speed_t baud_const;
-
-   if (!dev || !port) {
+int daly_fault_next(daly_fault_bits_t *bits) {
+   if (!bits || *bits == 0) {
       return -1;
    }
 
-   /* Clear device structure */
-   memset(dev, 0, sizeof(daly_device_t));
+   int code = __builtin_ctzll(*bits);
+   *bits &= *bits - 1;
+   return code;
+}
 
-   /* Store configuration */
-   strncpy(dev->port, port, sizeof(dev->port) - 1);
-   dev->baud = baud;
-   dev->timeout_ms = timeout_ms;
+/**
+ * @brief Apply 8N1 raw mode and the given baud rate to an open serial port
+ */
+static int daly_configure_tty(int fd, int baud) {
+   struct termios tty;
+   speed_t baud_const;
 
-   /* Open serial port */
-   dev->fd = open(port, O_RDWR | O_NOCTTY);
-   if (dev->fd < 0) {
-      OLOG_ERROR("Failed to open serial port %s: %s", port, strerror(errno));
-      return -1;
+   /* Set baud rate */
+   switch (baud) {
+      case 9600:
+         baud_const = B9600;
+         break;
+      case 19200:
+         baud_const = B19200;
+         break;
+      case 38400:
+         baud_const = B38400;
+         break;
+      case 57600:
+         baud_const = B57600;
+         break;
+      case 115200:
+         baud_const = B115200;
+         break;
+      default:
+         OLOG_ERROR("Unsupported baud rate: %d", baud);
+         return -1;
    }
 
    /* Get current port settings */
-   if (tcgetattr(dev->fd, &tty) != 0) {
+   if (tcgetattr(fd, &tty) != 0) {
       OLOG_ERROR("Failed to get port attributes: %s", strerror(errno));
-      close(dev->fd);
-      dev->fd = -1;
       return -1;
    }
 
@@ -784,209 +919,674 @@ int daly_bms_init(daly_device_t *dev, const char *port, int baud, int timeout_ms
    tty.c_cc[VTIME] = 1; /* 100ms timeout (1 decisecond) */
    tty.c_cc[VMIN] = 0;  /* No blocking, return immediately with what is available */
 
-   /* Set baud rate */
-   switch (baud) {
-      case 9600:
-         baud_const = B9600;
-         break;
-      case 19200:
-         baud_const = B19200;
-         break;
-      case 38400:
-         baud_const = B38400;
-         break;
-      case 57600:
-         baud_const = B57600;
-         break;
-      case 115200:
-         baud_const = B115200;
-         break;
-      default:
-         OLOG_ERROR("Unsupported baud rate: %d", baud);
-         close(dev->fd);
-         dev->fd = -1;
-         return -1;
-   }
-
    cfsetispeed(&tty, baud_const);
    cfsetospeed(&tty, baud_const);
 
    /* Apply settings */
-   if (tcsetattr(dev->fd, TCSANOW, &tty) != 0) {
+   if (tcsetattr(fd, TCSANOW, &tty) != 0) {
       OLOG_ERROR("Failed to set port attributes: %s", strerror(errno));
-      close(dev->fd);
-      dev->fd = -1;
       return -1;
    }
 
    /* Flush any existing data */
-   tcflush(dev->fd, TCIOFLUSH);
-
-   dev->initialized = true;
-   OLOG_INFO("Daly BMS initialized on %s at %d baud", port, baud);
+   tcflush(fd, TCIOFLUSH);
 
    return 0;
 }
 
 /**
- * @brief Close the Daly BMS device
+ * @brief Set (or disable, with NULL) the auto-detect cache file
  */
-void daly_bms_close(daly_device_t *dev) {
-   if (dev && dev->fd >= 0) {
-      close(dev->fd);
-      dev->fd = -1;
-      dev->initialized = false;
-      OLOG_INFO("Daly BMS connection closed");
-   }
+void daly_bms_set_detect_cache(const char *path) {
+   snprintf(detect_cache_path, sizeof(detect_cache_path), "%s", path ? path : "");
 }
 
 /**
- * @brief Poll all data from the Daly BMS
+ * @brief Add a candidate port unless it resolves to one already listed
  */
-int daly_bms_poll(daly_device_t *dev) {
-   if (!dev || !dev->initialized) {
+static int daly_add_candidate(daly_probe_t *probes, int count, const char *path) {
+   char resolved[PATH_MAX];
+
+   if (count >= DALY_DETECT_MAX_PORTS || !realpath(path, resolved)) {
+      return count;
+   }
+
+   for (int i = 0; i < count; i++) {
+      if (strcmp(probes[i].resolved, resolved) == 0) {
+         return count;
+      }
+   }
+
+   /* Prefer the stable by-id name when it fits the 64-byte port buffers */
+   const char *name = strlen(path) < sizeof(probes[count].path) ? path : resolved;
+   size_t name_len = strlen(name);
+   if (name_len >= sizeof(probes[count].path)) {
+      return count;
+   }
+
+   daly_probe_t *probe = &probes[count];
+   memset(probe, 0, sizeof(*probe));
+   probe->fd = -1;
+   memcpy(probe->path, name, name_len + 1);
+   memcpy(probe->resolved, resolved, sizeof(probe->resolved));
+
+   return count + 1;
+}
+
+/**
+ * @brief Add every /dev/serial/by-id link, in name order
+ */
+static int daly_add_by_id_candidates(daly_probe_t *probes, int count) {
+   struct dirent **entries = NULL;
+   int n = scandir(DALY_SERIAL_BY_ID_DIR, &entries, NULL, alphasort);
+
+   for (int i = 0; i < n; i++) {
+      if (entries[i]->d_name[0] != '.') {
+         char path[PATH_MAX];
+         snprintf(path, sizeof(path), "%s/%s", DALY_SERIAL_BY_ID_DIR, entries[i]->d_name);
+         count = daly_add_candidate(probes, count, path);
+      }
+      free(entries[i]);
+   }
+   free(entries);
+
+   return count;
+}
+
+/**
+ * @brief Add every character device udev has tagged DALY_UDEV_TAG
+ *
+ * udev lists tagged devices as /run/udev/tags/<tag>/c<major>:<minor>; the
+ * device node name comes from the matching /sys/dev/char uevent.
+ */
+static int daly_add_udev_tagged_candidates(daly_probe_t *probes, int count) {
+   DIR *dir = opendir(DALY_UDEV_TAG_DIR);
+   struct dirent *entry;
+
+   if (!dir) {
+      return count;
+   }
+
+   while ((entry = readdir(dir)) != NULL) {
+      unsigned int major, minor;
+      if (sscanf(entry->d_name, "c%u:%u", &major, &minor) != 2) {
+         continue;
+      }
+
+      char uevent_path[PATH_MAX];
+      snprintf(uevent_path, sizeof(uevent_path), "/sys/dev/char/%u:%u/uevent", major, minor);
+      FILE *fp = fopen(uevent_path, "r");
+      if (!fp) {
+         continue;
+      }
+
+      char line[256];
+      while (fgets(line, sizeof(line), fp)) {
+         if (strncmp(line, "DEVNAME=", 8) == 0) {
+            char path[PATH_MAX];
+            line[strcspn(line, "\n")] = '\0';
+            snprintf(path, sizeof(path), "/dev/%s", line + 8);
+            count = daly_add_candidate(probes, count, path);
+            break;
+         }
+      }
+      fclose(fp);
+   }
+   closedir(dir);
+
+   return count;
+}
+
+/**
+ * @brief Feed received bytes into a probe, resyncing on the start byte
+ *
+ * @return bool true once a valid 0x90 response frame has been assembled
+ */
+bool daly_probe_feed(daly_probe_t *probe, const uint8_t *bytes, size_t len) {
+   for (size_t i = 0; i < len; i++) {
+      if (probe->have == 0 && bytes[i] != DALY_START_BYTE) {
+         continue;
+      }
+      probe->buf[probe->have++] = bytes[i];
+      if (probe->have < DALY_FRAME_LEN) {
+         continue;
+      }
+
+      if (daly_validate_frame(probe->buf, DALY_BMS_ADDR, DALY_CMD_PACK_INFO, NULL) >= 0) {
+         return true;
+      }
+
+      /* Drop the bad start byte and rescan from the next one */
+      size_t next = 1;
+      while (next < DALY_FRAME_LEN && probe->buf[next] != DALY_START_BYTE) {
+         next++;
+      }
+      memmove(probe->buf, probe->buf + next, DALY_FRAME_LEN - next);
+      probe->have = DALY_FRAME_LEN - next;
+   }
+
+   return false;
+}
+
+/**
+ * @brief Probe all candidates concurrently at one baud rate
+ *
+ * Every port gets its 0x90 request up front, then a single select() loop
+ * collects replies until the first valid frame or the shared deadline, so a
+ * round costs one timeout regardless of the number of ports.
+ *
+ * @return int Index of the first port that answered, or -1
+ */
+static int daly_probe_round(daly_probe_t *probes, int count, int baud, int timeout_ms) {
+   uint8_t request[DALY_FRAME_LEN];
+   int open_count = 0;
+   int winner = -1;
+
+   daly_build_request(DALY_BMS_ADDR, DALY_CMD_PACK_INFO, request, NULL);
+
+   for (int i = 0; i < count; i++) {
+      daly_probe_t *probe = &probes[i];
+      probe->have = 0;
+      probe->fd = open(probe->path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+      if (probe->fd < 0) {
+         OLOG_INFO("Failed to open %s: %s", probe->path, strerror(errno));
+         continue;
+      }
+      if (probe->fd >= FD_SETSIZE || daly_configure_tty(probe->fd, baud) != 0 ||
+          write(probe->fd, request, DALY_FRAME_LEN) != DALY_FRAME_LEN) {
+         close(probe->fd);
+         probe->fd = -1;
+         continue;
+      }
+      open_count++;
+   }
+
+   struct timespec start;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   while (open_count > 0 && winner < 0) {
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      long elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 +
+                        (now.tv_nsec - start.tv_nsec) / 1000000;
+      if (elapsed_ms >= timeout_ms) {
+         break;
+      }
+
+      fd_set readfds;
+      int max_fd = -1;
+      FD_ZERO(&readfds);
+      for (int i = 0; i < count; i++) {
+         if (probes[i].fd >= 0) {
+            FD_SET(probes[i].fd, &readfds);
+            if (probes[i].fd > max_fd) {
+               max_fd = probes[i].fd;
+            }
+         }
+      }
+
+      long remaining_ms = timeout_ms - elapsed_ms;
+      struct timeval timeout = { .tv_sec = remaining_ms / 1000,
+                                 .tv_usec = (remaining_ms % 1000) * 1000 };
+      int ready = select(max_fd + 1, &readfds, NULL, NULL, &timeout);
+      if (ready < 0 && errno == EINTR) {
+         continue;
+      }
+      if (ready <= 0) {
+         break;
+      }
+
+      for (int i = 0; i < count && winner < 0; i++) {
+         daly_probe_t *probe = &probes[i];
+         if (probe->fd < 0 || !FD_ISSET(probe->fd, &readfds)) {
+            continue;
+         }
+
+         uint8_t bytes[64];
+         ssize_t n = read(probe->fd, bytes, sizeof(bytes));
+         if (n > 0 && daly_probe_feed(probe, bytes, (size_t)n)) {
+            winner = i;
+         } else if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            close(probe->fd);
+            probe->fd = -1;
+            open_count--;
+         }
+      }
+   }
+
+   for (int i = 0; i < count; i++) {
+      if (probes[i].fd >= 0) {
+         close(probes[i].fd);
+         probes[i].fd = -1;
+      }
+   }
+
+   return winner;
+}
+
+/**
+ * @brief Read the port/baud that answered last time from the cache file
+ *
+ * A line that does not parse, a path too long for port, or a baud rate the
+ * detector does not probe makes the whole cache unusable.
+ */
+bool daly_read_detect_cache(char *port, size_t port_len, int *baud) {
+   if (detect_cache_path[0] == '\0') {
+      return false;
+   }
+
+   FILE *fp = fopen(detect_cache_path, "r");
+   if (!fp) {
+      return false;
+   }
+
+   char line[PATH_MAX + 32];
+   char path[PATH_MAX];
+   int cached_baud;
+   bool ok = fgets(line, sizeof(line), fp) && sscanf(line, "%4095s %d", path, &cached_baud) == 2 &&
+             strlen(path) < port_len;
+   fclose(fp);
+
+   if (ok) {
+      ok = false;
+      for (int i = 0; detect_bauds[i] != 0; i++) {
+         ok = ok || detect_bauds[i] == cached_baud;
+      }
+   }
+   if (ok) {
+      snprintf(port, port_len, "%s", path);
+      *baud = cached_baud;
+   }
+   return ok;
+}
+
+/**
+ * @brief Remember the detected port/baud for the next startup
+ *
+ * Written to a temporary file and renamed, so a crash never leaves half a line.
+ */
+void daly_write_detect_cache(const char *port, int baud) {
+   if (detect_cache_path[0] == '\0') {
+      return;
+   }
+
+   char tmp_path[PATH_MAX + 8];
+   snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", detect_cache_path);
+   FILE *fp = fopen(tmp_path, "w");
+   if (!fp) {
+      OLOG_DEBUG("Cannot write Daly detect cache %s: %s", detect_cache_path, strerror(errno));
+      return;
+   }
+   fprintf(fp, "%s %d\n", port, baud);
+   if (fclose(fp) != 0 || rename(tmp_path, detect_cache_path) != 0) {
+      OLOG_DEBUG("Cannot write Daly detect cache %s: %s", detect_cache_path, strerror(errno));
+      unlink(tmp_path);
+   }
+}
+
+/**
+ * @brief Auto-detect Daly BMS on the available serial ports
+ */
+bool daly_bms_auto_detect(char *detected_port, int *detected_baud) {
+   if (!detected_port || !detected_baud) {
+      return false;
+   }
+
+   /* Fixed ports tried after the enumerated ones */
+   const char *fallback_ports[] = { "/dev/ttyTHS1", /* NVIDIA Jetson THS1 */
+                                    "/dev/ttyTHS0", /* NVIDIA Jetson THS0 */
+                                    "/dev/ttyS0",   /* Standard serial port */
+                                    "/dev/ttyUSB0", /* USB-to-Serial adapter */
+                                    "/dev/ttyACM0", /* Arduino/USB CDC device */
+                                    NULL };
+
+   daly_probe_t probes[DALY_DETECT_MAX_PORTS];
+   int count = 0;
+   int winner;
+
+   OLOG_INFO("Auto-detecting Daly BMS...");
+
+   /* Last known good port first, on its own, at its own baud */
+   char cached_port[64];
+   int cached_baud;
+   if (daly_read_detect_cache(cached_port, sizeof(cached_port), &cached_baud)) {
+      count = daly_add_candidate(probes, 0, cached_port);
+      if (count == 1 && daly_probe_round(probes, 1, cached_baud, DALY_DETECT_TIMEOUT_MS) == 0) {
+         OLOG_INFO("Daly BMS detected on %s at %d baud (cached)", probes[0].path, cached_baud);
+         snprintf(detected_port, 64, "%s", probes[0].path);
+         *detected_baud = cached_baud;
+         return true;
+      }
+      OLOG_INFO("Cached Daly BMS port %s did not answer", cached_port);
+   }
+
+   count = daly_add_by_id_candidates(probes, count);
+   count = daly_add_udev_tagged_candidates(probes, count);
+   for (int i = 0; fallback_ports[i] != NULL; i++) {
+      count = daly_add_candidate(probes, count, fallback_ports[i]);
+   }
+
+   if (count == 0) {
+      OLOG_INFO("No serial ports found for Daly BMS");
+      return false;
+   }
+
+   for (int j = 0; detect_bauds[j] != 0; j++) {
+      OLOG_INFO("Probing %d serial port(s) at %d baud...", count, detect_bauds[j]);
+
+      winner = daly_probe_round(probes, count, detect_bauds[j], DALY_DETECT_TIMEOUT_MS);
+      if (winner >= 0) {
+         OLOG_INFO("Daly BMS detected on %s at %d baud!", probes[winner].path, detect_bauds[j]);
+         snprintf(detected_port, 64, "%s", probes[winner].path);
+         *detected_baud = detect_bauds[j];
+         daly_write_detect_cache(detected_port, *detected_baud);
+         return true;
+      }
+   }
+
+   OLOG_INFO("No Daly BMS detected on %d serial port(s)", count);
+   return false;
+}
+
+/**
+ * @brief Initialize the Daly BMS device
+ */
+int daly_bms_init(daly_device_t *dev, const char *port, int baud, int timeout_ms) {
+   if (!dev || !port) {
       return -1;
    }
 
-   daly_data_t *data = &dev->data;
-   uint8_t response[8];
-   int result;
+   /* Clear device structure */
+   memset(dev, 0, sizeof(daly_device_t));
 
-   /* Clear previous error */
-   data->last_err[0] = '\0';
+   /* Store configuration */
+   strncpy(dev->port, port, sizeof(dev->port) - 1);
+   dev->baud = baud;
+   dev->timeout_ms = timeout_ms;
+   dev->addr = DALY_BMS_ADDR;
 
-   /* Request basic pack info (0x90) */
-   result = daly_request(dev->fd, DALY_CMD_PACK_INFO, response, dev->timeout_ms, NULL);
-   if (result == 0) {
-      daly_parse_0x90(response, &data->pack);
-   } else {
-      snprintf(data->last_err, sizeof(data->last_err), "Failed to read pack info (0x90)");
+   /* Open serial port */
+   dev->fd = open(port, O_RDWR | O_NOCTTY);
+   if (dev->fd < 0) {
+      OLOG_ERROR("Failed to open serial port %s: %s", port, strerror(errno));
       return -1;
    }
 
-   /* Request cell voltage extremes (0x91) */
-   result = daly_request(dev->fd, DALY_CMD_CELL_VOLTAGE, response, dev->timeout_ms, NULL);
-   if (result == 0) {
-      daly_parse_0x91(response, &data->extremes);
-   } else {
-      snprintf(data->last_err, sizeof(data->last_err),
-               "Failed to read cell voltage extremes (0x91)");
+   /* 8N1 raw mode at the requested baud */
+   if (daly_configure_tty(dev->fd, baud) != 0) {
+      close(dev->fd);
+      dev->fd = -1;
       return -1;
    }
 
-   /* Request temperature extremes (0x92) */
-   result = daly_request(dev->fd, DALY_CMD_TEMPERATURE, response, dev->timeout_ms, NULL);
-   if (result == 0) {
-      daly_parse_0x92(response, &data->temps);
-   } else {
-      snprintf(data->last_err, sizeof(data->last_err),
-               "Failed to read temperature extremes (0x92)");
+   dev->initialized = true;
+   OLOG_INFO("Daly BMS initialized on %s at %d baud", port, baud);
+
+   return 0;
+}
+
+/**
+ * @brief Initialize a device that has no serial port behind it
+ */
+int daly_bms_init_offline(daly_device_t *dev, const char *label, int timeout_ms) {
+   if (!dev || !label) {
       return -1;
    }
 
-   /* Request MOS status (0x93) */
-   result = daly_request(dev->fd, DALY_CMD_MOS_STATUS, response, dev->timeout_ms, NULL);
-   if (result == 0) {
-      daly_parse_0x93(response, &data->mos);
-   } else {
-      snprintf(data->last_err, sizeof(data->last_err), "Failed to read MOS status (0x93)");
+   memset(dev, 0, sizeof(daly_device_t));
+   strncpy(dev->port, label, sizeof(dev->port) - 1);
+   dev->fd = -1;
+   dev->timeout_ms = timeout_ms;
+   dev->addr = DALY_BMS_ADDR;
+   dev->initialized = true;
+
+   return 0;
+}
+
+/**
+ * @brief Initialize a device for another BMS on an already open RS-485 segment
+ */
+int daly_bms_attach(daly_device_t *dev, const daly_device_t *bus, uint8_t addr) {
+   if (!dev || !bus || !bus->initialized || addr < DALY_BMS_ADDR || addr > DALY_BUS_MAX_ADDR) {
       return -1;
    }
 
-   /* Request system status (0x94) */
-   result = daly_request(dev->fd, DALY_CMD_STATUS, response, dev->timeout_ms, NULL);
-   if (result == 0) {
-      daly_parse_0x94(response, &data->status);
-      data->temps.ntc_count = data->status.ntc_count;
-   } else {
-      snprintf(data->last_err, sizeof(data->last_err), "Failed to read system status (0x94)");
+   memset(dev, 0, sizeof(daly_device_t));
+   memcpy(dev->port, bus->port, sizeof(dev->port));
+   dev->fd = bus->fd;
+   dev->baud = bus->baud;
+   dev->timeout_ms = bus->timeout_ms;
+   dev->addr = addr;
+   dev->shared = true;
+   dev->initialized = true;
+
+   return 0;
+}
+
+/**
+ * @brief Close the Daly BMS device
+ */
+void daly_bms_close(daly_device_t *dev) {
+   if (dev && dev->shared) {
+      /* The port belongs to the device that opened the segment */
+      dev->fd = -1;
+      dev->initialized = false;
+   } else if (dev && dev->fd >= 0) {
+      close(dev->fd);
+      dev->fd = -1;
+      dev->initialized = false;
+      OLOG_INFO("Daly BMS connection closed");
+   }
+}
+
+/* Poll sequence. Pack info doubles as the liveness check and must succeed;
+ * any other request that fails leaves its field stale (DALY_FIELD_* clear). */
+enum {
+   DALY_STEP_PACK_INFO,
+   DALY_STEP_CELL_VOLTAGE,
+   DALY_STEP_TEMPERATURE,
+   DALY_STEP_MOS_STATUS,
+   DALY_STEP_STATUS,
+   DALY_STEP_CELL_VOLTAGES,
+   DALY_STEP_TEMPERATURES,
+   DALY_STEP_BALANCE,
+   DALY_STEP_FAULTS,
+   DALY_STEP_DONE
+};
+
+/**
+ * @brief Start a poll, to be advanced with daly_bms_poll_step()
+ */
+int daly_bms_poll_begin(daly_device_t *dev) {
+   if (!dev || !dev->initialized) {
       return -1;
    }
 
-   /* Request cell voltages (0x95) - Multiple frames */
-   int cell_count = data->status.cell_count;
-   if (cell_count > 0) {
-      int frames_needed = (cell_count + 2) / 3; /* Ceiling division */
-      const uint8_t *frames[16] = { 0 };
-      int frame_count = 0;
-
-      for (int i = 0; i < 32 && frame_count < frames_needed; i++) {
-         result = daly_request(dev->fd, DALY_CMD_CELL_VOLTAGES, response, dev->timeout_ms, NULL);
-         if (result == 0) {
-            /* Check frame number */
-            uint8_t frame_no = response[0];
-            if (frame_no != 0 && frame_no != 0xFF && frame_no <= frames_needed) {
-               /* Allocate memory for this frame */
-               uint8_t *frame_data = malloc(8);
-               if (frame_data == NULL) {
-                  snprintf(data->last_err, sizeof(data->last_err),
-                           "Memory allocation failed for frame_data");
-                  continue;  // Skip this frame and proceed to the next iteration
-               }
-               memcpy(frame_data, response, 8);
-               frames[frame_count++] = frame_data;
-            }
-         }
-      }
+   memset(&dev->poll, 0, sizeof(dev->poll));
+   dev->data.last_err[0] = '\0';
+   dev->data.fields = 0;
+   return 0;
+}
 
-      /* Parse cell voltages */
-      if (frame_count > 0) {
-         daly_parse_0x95_frames(frames, frame_count, cell_count, data->cell_mv);
-      }
+/**
+ * @brief Collect one frame of a multi-frame reply (0x95/0x96)
+ *
+ * @return bool true once frames_needed frames were kept or max_attempts requests were made
+ */
+static bool daly_poll_collect(daly_device_t *dev,
+                              uint8_t cmd,
+                              int frames_needed,
+                              int max_attempts,
+                              uint8_t skip_frame_no) {
+   daly_poll_state_t *poll = &dev->poll;
+   uint8_t response[8];
+
+   if (poll->frame_count >= frames_needed || poll->attempts >= max_attempts) {
+      return true;
+   }
 
-      /* Free frame data */
-      for (int i = 0; i < frame_count; i++) {
-         free((void *)frames[i]);
+   poll->attempts++;
+   if (daly_exchange(dev, cmd, response, NULL) == 0) {
+      /* Check frame number */
+      uint8_t frame_no = response[0];
+      if (frame_no != 0 && frame_no != skip_frame_no && frame_no <= frames_needed &&
+          poll->frame_count < DALY_POLL_MAX_FRAMES) {
+         memcpy(poll->frames[poll->frame_count++], response, 8);
       }
    }
 
-   /* Request temperature sensors (0x96) - Multiple frames */
-   int ntc_count = data->status.ntc_count;
-   if (ntc_count > 0) {
-      int frames_needed = (ntc_count + 6) / 7; /* Ceiling division */
-      const uint8_t *frames[8] = { 0 };
-      int frame_count = 0;
-
-      for (int i = 0; i < 16 && frame_count < frames_needed; i++) {
-         result = daly_request(dev->fd, DALY_CMD_TEMPERATURES, response, dev->timeout_ms, NULL);
-         if (result == 0) {
-            /* Check frame number */
-            uint8_t frame_no = response[0];
-            if (frame_no != 0 && frame_no <= frames_needed) {
-               /* Allocate memory for this frame */
-               uint8_t *frame_data = malloc(8);
-               if (frame_data == NULL) {
-                  snprintf(data->last_err, sizeof(data->last_err),
-                           "Memory allocation failed for frame_data");
-                  continue;  // Skip this frame and proceed to the next iteration
-               }
-               memcpy(frame_data, response, 8);
-               frames[frame_count++] = frame_data;
+   return poll->frame_count >= frames_needed || poll->attempts >= max_attempts;
+}
+
+/**
+ * @brief Make the next request of a poll started with daly_bms_poll_begin()
+ */
+int daly_bms_poll_step(daly_device_t *dev) {
+   if (!dev || !dev->initialized) {
+      return -1;
+   }
+
+   daly_data_t *data = &dev->data;
+   daly_poll_state_t *poll = &dev->poll;
+   const uint8_t *frames[DALY_POLL_MAX_FRAMES];
+   uint8_t response[8];
+
+   switch (poll->step) {
+      case DALY_STEP_PACK_INFO:
+         /* Request basic pack info (0x90) */
+         if (daly_exchange(dev, DALY_CMD_PACK_INFO, response, NULL) != 0) {
+            snprintf(data->last_err, sizeof(data->last_err), "Failed to read pack info (0x90)");
+            return -1;
+         }
+         daly_parse_0x90(response, &data->pack);
+         data->fields |= DALY_FIELD_PACK;
+         break;
+
+      case DALY_STEP_CELL_VOLTAGE:
+         /* Request cell voltage extremes (0x91) */
+         if (daly_exchange(dev, DALY_CMD_CELL_VOLTAGE, response, NULL) != 0) {
+            snprintf(data->last_err, sizeof(data->last_err),
+                     "Failed to read cell voltage extremes (0x91)");
+            break;
+         }
+         daly_parse_0x91(response, &data->extremes);
+         data->fields |= DALY_FIELD_EXTREMES;
+         break;
+
+      case DALY_STEP_TEMPERATURE:
+         /* Request temperature extremes (0x92) */
+         if (daly_exchange(dev, DALY_CMD_TEMPERATURE, response, NULL) != 0) {
+            snprintf(data->last_err, sizeof(data->last_err),
+                     "Failed to read temperature extremes (0x92)");
+            break;
+         }
+         daly_parse_0x92(response, &data->temps);
+         data->fields |= DALY_FIELD_TEMPS;
+         break;
+
+      case DALY_STEP_MOS_STATUS:
+         /* Request MOS status (0x93) */
+         if (daly_exchange(dev, DALY_CMD_MOS_STATUS, response, NULL) != 0) {
+            snprintf(data->last_err, sizeof(data->last_err), "Failed to read MOS status (0x93)");
+            break;
+         }
+         daly_parse_0x93(response, &data->mos);
+         data->fields |= DALY_FIELD_MOS;
+         break;
+
+      case DALY_STEP_STATUS:
+         /* Request system status (0x94) */
+         if (daly_exchange(dev, DALY_CMD_STATUS, response, NULL) != 0) {
+            /* The cell and sensor counts of the last poll still apply */
+            snprintf(data->last_err, sizeof(data->last_err),
+                     "Failed to read system status (0x94)");
+            break;
+         }
+         daly_parse_0x94(response, &data->status);
+         data->temps.ntc_count = data->status.ntc_count;
+         data->fields |= DALY_FIELD_STATUS;
+         break;
+
+      case DALY_STEP_CELL_VOLTAGES: {
+         /* Request cell voltages (0x95) - three cells per frame, one frame per request */
+         int cell_count = data->status.cell_count;
+         if (cell_count > 0 &&
+             !daly_poll_collect(dev, DALY_CMD_CELL_VOLTAGES, (cell_count + 2) / 3, 32, 0xFF)) {
+            return 1;
+         }
+         if (poll->frame_count > 0) {
+            for (int i = 0; i < poll->frame_count; i++) {
+               frames[i] = poll->frames[i];
             }
+            daly_parse_0x95_frames(frames, poll->frame_count, cell_count, data->cell_mv);
+         }
+         if (cell_count > 0 && poll->frame_count >= (cell_count + 2) / 3) {
+            data->fields |= DALY_FIELD_CELLS;
          }
+         poll->frame_count = 0;
+         poll->attempts = 0;
+         break;
       }
 
-      /* Parse temperature sensors */
-      if (frame_count > 0) {
-         daly_parse_0x96_frames(frames, frame_count, ntc_count, &data->temps);
+      case DALY_STEP_TEMPERATURES: {
+         /* Request temperature sensors (0x96) - seven sensors per frame */
+         int ntc_count = data->status.ntc_count;
+         if (ntc_count > 0 &&
+             !daly_poll_collect(dev, DALY_CMD_TEMPERATURES, (ntc_count + 6) / 7, 16, 0)) {
+            return 1;
+         }
+         if (poll->frame_count > 0) {
+            for (int i = 0; i < poll->frame_count; i++) {
+               frames[i] = poll->frames[i];
+            }
+            daly_parse_0x96_frames(frames, poll->frame_count, ntc_count, &data->temps);
+         }
+         if (ntc_count > 0 && poll->frame_count >= (ntc_count + 6) / 7) {
+            data->fields |= DALY_FIELD_SENSORS;
+         }
+         poll->frame_count = 0;
+         poll->attempts = 0;
+         break;
       }
 
-      /* Free frame data */
-      for (int i = 0; i < frame_count; i++) {
-         free((void *)frames[i]);
-      }
-   }
+      case DALY_STEP_BALANCE:
+         /* Request balance status (0x97) */
+         if (daly_exchange(dev, DALY_CMD_BALANCE_STATUS, response, NULL) == 0) {
+            daly_parse_0x97(response, data->status.cell_count, data->balance);
+            data->fields |= DALY_FIELD_BALANCE;
+         }
+         break;
+
+      case DALY_STEP_FAULTS:
+         /* Request fault flags (0x98) */
+         if (daly_exchange(dev, DALY_CMD_FAULTS, response, NULL) == 0) {
+            daly_fault_bits_t previous = data->faults;
+            daly_parse_0x98(response, &data->faults, &data->fault_count);
+            data->fields |= DALY_FIELD_FAULTS;
+            data->faults_raised = data->faults & ~previous;
+            data->faults_cleared = previous & ~data->faults;
+
+            daly_fault_bits_t changed = data->faults_raised;
+            int code;
+            while ((code = daly_fault_next(&changed)) >= 0) {
+               SLOG_EVENT_WARNING("BMS fault raised: %s", daly_fault_description(code));
+            }
+            changed = data->faults_cleared;
+            while ((code = daly_fault_next(&changed)) >= 0) {
+               SLOG_EVENT_INFO("BMS fault cleared: %s", daly_fault_description(code));
+            }
+         } else {
+            data->faults_raised = 0;
+            data->faults_cleared = 0;
+         }
+         break;
 
-   /* Request balance status (0x97) */
-   result = daly_request(dev->fd, DALY_CMD_BALANCE_STATUS, response, dev->timeout_ms, NULL);
-   if (result == 0) {
-      daly_parse_0x97(response, cell_count, data->balance);
+      default:
+         return 0;
    }
 
-   /* Request fault flags (0x98) */
-   result = daly_request(dev->fd, DALY_CMD_FAULTS, response, dev->timeout_ms, NULL);
-   if (result == 0) {
-      daly_parse_0x98(response, data->faults, &data->fault_count);
+   if (++poll->step < DALY_STEP_DONE) {
+      return 1;
    }
 
    /* Mark data as valid and update timestamp */
@@ -996,6 +1596,87 @@ int daly_bms_poll(daly_device_t *dev) {
    return 0;
 }
 
+/**
+ * @brief Poll all data from the Daly BMS
+ */
+int daly_bms_poll(daly_device_t *dev) {
+   if (daly_bms_poll_begin(dev) != 0) {
+      return -1;
+   }
+
+   int result;
+   while ((result = daly_bms_poll_step(dev)) > 0) {
+   }
+   return result;
+}
+
+/**
+ * @brief Wait for the bus to turn around before addressing another BMS
+ */
+static void daly_bus_turnaround(int turnaround_ms) {
+   if (turnaround_ms > 0) {
+      struct timespec ts = { .tv_sec = turnaround_ms / 1000,
+                             .tv_nsec = (long)(turnaround_ms % 1000) * 1000000L };
+      nanosleep(&ts, NULL);
+   }
+}
+
+/**
+ * @brief Poll several BMS units sharing one RS-485 segment, one unit at a time
+ */
+int daly_bms_poll_bus(daly_device_t **devs, int count, int turnaround_ms, int *results) {
+   int ok = 0;
+   int last = -1;
+
+   /* Interleaving the units would buy nothing on a half-duplex line and cost a
+    * turnaround per exchange; each unit's sequence runs back to back instead.
+    * A unit that stops answering ends its poll at its first failed request. */
+   for (int i = 0; i < count; i++) {
+      if (daly_bms_poll_begin(devs[i]) != 0) {
+         results[i] = -1;
+         continue;
+      }
+      if (last >= 0 && devs[last]->addr != devs[i]->addr) {
+         daly_bus_turnaround(turnaround_ms);
+      }
+      last = i;
+
+      while ((results[i] = daly_bms_poll_step(devs[i])) > 0) {
+      }
+      ok += results[i] == 0;
+   }
+
+   return ok;
+}
+
+/**
+ * @brief Find the BMS units answering on an RS-485 segment
+ */
+int daly_bms_scan_bus(daly_device_t *dev, uint8_t *found, int max_found) {
+   if (!dev || !dev->initialized || !found) {
+      return -1;
+   }
+
+   uint8_t saved_addr = dev->addr;
+   int saved_timeout = dev->timeout_ms;
+   uint8_t response[8];
+   int count = 0;
+
+   dev->timeout_ms = DALY_BUS_SCAN_TIMEOUT_MS;
+   for (int addr = DALY_BMS_ADDR; addr <= DALY_BUS_MAX_ADDR && count < max_found; addr++) {
+      dev->addr = (uint8_t)addr;
+      if (daly_request(dev, DALY_CMD_PACK_INFO, response, dev->timeout_ms, NULL) == 0) {
+         OLOG_INFO("Daly BMS board %d answered on %s", addr, dev->port);
+         found[count++] = (uint8_t)addr;
+      }
+      daly_bus_turnaround(DALY_BUS_TURNAROUND_MS);
+   }
+   dev->addr = saved_addr;
+   dev->timeout_ms = saved_timeout;
+
+   return count;
+}
+
 /**
  * @brief Read rated capacity from the Daly BMS
  */
@@ -1006,7 +1687,7 @@ int daly_bms_read_capacity(daly_device_t *dev, daly_capacity_t *capacity) {
 
    uint8_t response[8];
 
-   int result = daly_request(dev->fd, DALY_CMD_READ_CAPACITY, response, dev->timeout_ms, NULL);
+   int result = daly_exchange(dev, DALY_CMD_READ_CAPACITY, response, NULL);
    if (result != 0) {
       OLOG_ERROR("Failed to read rated capacity");
       return -1;
@@ -1029,7 +1710,6 @@ int daly_bms_write_capacity(daly_device_t *dev, int capacity_mah, int nominal_ce
    }
 
    uint8_t payload[8];
-   uint8_t response[8];
 
    /* Prepare payload */
    payload[0] = (capacity_mah >> 24) & 0xFF;
@@ -1041,8 +1721,13 @@ int daly_bms_write_capacity(daly_device_t *dev, int capacity_mah, int nominal_ce
    payload[6] = (nominal_cell_mv >> 8) & 0xFF;
    payload[7] = nominal_cell_mv & 0xFF;
 
-   int result = daly_request(dev->fd, DALY_CMD_WRITE_CAPACITY, response, dev->timeout_ms, payload);
-   if (result != 0) {
+   if (daly_write(dev, DALY_CMD_WRITE_CAPACITY, payload) != 0) {
+      OLOG_WARNING("Rated capacity write not acknowledged, reading it back");
+   }
+
+   daly_capacity_t check;
+   if (daly_bms_read_capacity(dev, &check) != 0 || check.rated_capacity_mah != capacity_mah ||
+       check.nominal_cell_mv != nominal_cell_mv) {
       OLOG_ERROR("Failed to write rated capacity");
       return -1;
    }
@@ -1060,6 +1745,7 @@ int daly_bms_write_soc(daly_device_t *dev, float soc_percent) {
 
    uint8_t payload[8];
    uint8_t response[8];
+   daly_pack_summary_t check;
    time_t now;
    struct tm *tm_info;
 
@@ -1086,11 +1772,19 @@ int daly_bms_write_soc(daly_device_t *dev, float soc_percent) {
    payload[6] = (soc_tenths >> 8) & 0xFF;
    payload[7] = soc_tenths & 0xFF;
 
-   int result = daly_request(dev->fd, DALY_CMD_WRITE_SOC, response, dev->timeout_ms, payload);
-   if (result != 0) {
+   if (daly_write(dev, DALY_CMD_WRITE_SOC, payload) != 0) {
+      OLOG_WARNING("SOC write not acknowledged, reading it back");
+   }
+
+   if (daly_exchange(dev, DALY_CMD_PACK_INFO, response, NULL) != 0) {
       OLOG_ERROR("Failed to write SOC");
       return -1;
    }
+   daly_parse_0x90(response, &check);
+   if (fabsf(check.soc_pct - soc_tenths / 10.0f) > DALY_SOC_READBACK_TOLERANCE_PCT) {
+      OLOG_ERROR("Failed to write SOC: BMS reports %.1f%%", check.soc_pct);
+      return -1;
+   }
 
    return 0;
 }
@@ -1182,9 +1876,170 @@ void daly_bms_print_data(const daly_device_t *dev) {
    if (data->fault_count == 0) {
       printf("  None\n");
    } else {
-      for (int i = 0; i < data->fault_count; i++) {
-         printf("  %s\n", data->faults[i]);
+      daly_fault_bits_t bits = data->faults;
+      int code;
+      while ((code = daly_fault_next(&bits)) >= 0) {
+         printf("  %s\n", daly_fault_description(code));
+      }
+   }
+}
+
+/**
+ * @brief Print serial link quality statistics in human-readable format
+ */
+void daly_bms_print_link(const daly_device_t *dev) {
+   if (!dev) {
+      return;
+   }
+
+   const daly_link_t *link = &dev->link;
+   double lost_pct = link->requests ? 100.0 * link->timeouts / link->requests : 0.0;
+
+   printf("Daly BMS link %s (board %d, %d baud):\n", dev->port, dev->addr, dev->baud);
+   printf("  Requests: %u  Retries: %u  Timeouts: %u (%.1f%%)\n", link->requests, link->retries,
+          link->timeouts, lost_pct);
+   printf("  Bytes read: %llu  Resyncs: %u  Checksum errors: %u  Mismatched frames: %u\n",
+          (unsigned long long)link->bytes_read, link->resyncs, link->checksum_errors,
+          link->mismatches);
+
+   /* Header: histogram bucket upper bounds */
+   printf("  Cmd    SRTT   Dev   Timeout |");
+   for (int b = 0; b < DALY_RTT_BUCKETS - 1; b++) {
+      printf(" <%-4d", DALY_RTT_BUCKET0_MS << b);
+   }
+   printf(" more\n");
+
+   for (int slot = 0; slot < DALY_LINK_CMDS; slot++) {
+      uint32_t samples = 0;
+      for (int b = 0; b < DALY_RTT_BUCKETS; b++) {
+         samples += link->rtt_hist[slot][b];
+      }
+      if (samples == 0) {
+         continue;
+      }
+
+      int cmd = daly_bms_link_cmd(slot);
+      if (cmd < 0) {
+         printf("  other");
+      } else {
+         printf("  0x%02X ", cmd);
+      }
+      printf(" %5.1f %5.1f %6d ms |", link->srtt_ms[slot], link->rttvar_ms[slot],
+             daly_bms_link_timeout(dev, slot));
+      for (int b = 0; b < DALY_RTT_BUCKETS - 1; b++) {
+         printf(" %-5u", link->rtt_hist[slot][b]);
+      }
+      printf(" %u\n", link->rtt_hist[slot][DALY_RTT_BUCKETS - 1]);
+   }
+}
+
+/* Reason codes behind a cell's status (daly_pack_health_t.cause) */
+enum {
+   CELL_CAUSE_NONE = 0,
+   CELL_CAUSE_DRIFT,
+   CELL_CAUSE_LOW_VOLTAGE,
+   CELL_CAUSE_DEV_WARNING,
+   CELL_CAUSE_DEV_CRITICAL,
+};
+
+static const uint8_t cell_cause_status[] = {
+   [CELL_CAUSE_NONE] = DALY_HEALTH_NORMAL,         [CELL_CAUSE_DRIFT] = DALY_HEALTH_NORMAL,
+   [CELL_CAUSE_LOW_VOLTAGE] = DALY_HEALTH_WARNING, [CELL_CAUSE_DEV_WARNING] = DALY_HEALTH_WARNING,
+   [CELL_CAUSE_DEV_CRITICAL] = DALY_HEALTH_CRITICAL,
+};
+
+_Static_assert(DALY_MAX_CELLS <= 32, "daly_pack_health_t.changed is a 32-bit cell mask");
+
+/* Cells at or below this read as absent/misconfigured rather than weak */
+#define CELL_VALID_MIN_V 2.0f
+
+/**
+ * @brief Fold one set of deviations into the rolling statistics
+ */
+static void health_update_rolling(daly_pack_health_t *health, const uint8_t *cause, time_t now) {
+   int n = health->cell_count;
+   double dt_s = health->samples > 0 ? difftime(now, health->last_sample) : 0.0;
+   if (dt_s < 0.0) {
+      dt_s = 0.0;
+   }
+
+   /* Per-sample smoothing factors for irregular polling */
+   float alpha = health->samples > 0 ? (float)(1.0 - exp(-dt_s / DALY_HEALTH_EWMA_TAU_S)) : 1.0f;
+   double dt_h = dt_s / 3600.0;
+   double decay = exp(-dt_s / DALY_HEALTH_DRIFT_TAU_S);
+
+   /* Trend fit in sample age (hours before now): move the origin to the new
+    * sample, age everything by the decay, then add the new point at age 0. */
+   double sw = health->fit_sw, st = health->fit_st, stt = health->fit_stt;
+   double stt_new = (stt + 2.0 * dt_h * st + dt_h * dt_h * sw) * decay;
+   double st_new = (st + dt_h * sw) * decay;
+   double sw_new = sw * decay + 1.0;
+   double denom = sw_new * stt_new - st_new * st_new;
+   bool fit_ok = health->samples > 0 && denom > 1e-9 &&
+                 difftime(now, health->first_sample) >= DALY_HEALTH_DRIFT_MIN_SPAN_S;
+
+   for (int i = 0; i < n; i++) {
+      /* Cells with an implausible reading are kept out of the statistics */
+      if (cause[i] == CELL_CAUSE_LOW_VOLTAGE) {
+         continue;
       }
+
+      float x = health->deviation_mv[i];
+      float diff = x - health->ewma_mv[i];
+      float incr = alpha * diff;
+      health->ewma_mv[i] += incr;
+      health->ewvar_mv2[i] = (1.0f - alpha) * (health->ewvar_mv2[i] + diff * incr);
+
+      double sy = health->fit_sy[i] * decay + x;
+      double sty = (health->fit_sty[i] + dt_h * health->fit_sy[i]) * decay;
+      health->fit_sy[i] = sy;
+      health->fit_sty[i] = sty;
+
+      /* Slope against age; the trend over time has the opposite sign */
+      health->drift_mv_per_day[i] =
+          fit_ok ? (float)(-24.0 * (sw_new * sty - st_new * sy) / denom) : 0.0f;
+   }
+
+   health->fit_sw = sw_new;
+   health->fit_st = st_new;
+   health->fit_stt = stt_new;
+   if (health->samples == 0) {
+      health->first_sample = now;
+   }
+   health->last_sample = now;
+   health->samples++;
+}
+
+/**
+ * @brief Format the reason for a cell whose status just changed
+ */
+static void health_format_reason(daly_pack_health_t *health,
+                                 int i,
+                                 int warning_threshold_mv,
+                                 int critical_threshold_mv) {
+   char *reason = health->reason[i];
+   size_t size = sizeof(health->reason[i]);
+   float dev = fabsf(health->deviation_mv[i]);
+
+   switch (health->cause[i]) {
+      case CELL_CAUSE_LOW_VOLTAGE:
+         snprintf(reason, size, "Cell reads %.3fV - likely BMS config issue", health->voltage[i]);
+         break;
+      case CELL_CAUSE_DEV_CRITICAL:
+         snprintf(reason, size, "Deviation of %.1f mV exceeds critical threshold (%.0f mV)", dev,
+                  (float)critical_threshold_mv);
+         break;
+      case CELL_CAUSE_DEV_WARNING:
+         snprintf(reason, size, "Deviation of %.1f mV exceeds warning threshold (%.0f mV)", dev,
+                  (float)warning_threshold_mv);
+         break;
+      case CELL_CAUSE_DRIFT:
+         snprintf(reason, size, "Drifting %+.1f mV/day toward warning threshold (%.0f mV)",
+                  health->drift_mv_per_day[i], (float)warning_threshold_mv);
+         break;
+      default:
+         reason[0] = '\0';
+         break;
    }
 }
 
@@ -1200,120 +2055,158 @@ int daly_bms_analyze_health(daly_device_t *dev,
    }
 
    const daly_data_t *data = &dev->data;
-   int cell_count = data->status.cell_count;
-
-   /* Initialize health structure */
-   memset(health, 0, sizeof(daly_pack_health_t));
-   health->cell_count = cell_count;
-
-   /* Allocate memory for cell health information */
-   health->cells = (daly_cell_health_t *)malloc(cell_count * sizeof(daly_cell_health_t));
-   if (!health->cells) {
-      OLOG_ERROR("Failed to allocate memory for cell health");
-      return DALY_HEALTH_NORMAL;
+   int cell_count = MIN(data->status.cell_count, DALY_MAX_CELLS);
+   if (cell_count < 0) {
+      cell_count = 0;
    }
 
-   /* Calculate voltage statistics */
-   health->vmax = data->extremes.vmax_v;
-   health->vmin = data->extremes.vmin_v;
-   health->vdelta = health->vmax - health->vmin;
-
-   /* Calculate average cell voltage - skip cells with extremely low/zero voltage */
-   float sum_volts = 0.0f;
-   int valid_cells = 0;
-   for (int i = 0; i < cell_count; i++) {
-      float cell_volts = data->cell_mv[i] / 1000.0f;
+   /* Only readings refreshed by the latest poll feed the statistics; a
+    * failed 0x95/0x90 read leaves the previous values in data */
+   bool have_cells = data->fields & DALY_FIELD_CELLS;
+   bool have_pack = data->fields & DALY_FIELD_PACK;
 
-      /* Only include cells with reasonable voltage (above 2V) */
-      if (cell_volts > 2.0f) {  // 2V is well below any operational Li-ion cell
-         sum_volts += cell_volts;
-         valid_cells++;
+   /* Different pack layout: earlier statistics no longer apply. The first
+    * analysis keeps any resistance baselines loaded beforehand. */
+   if (cell_count != health->cell_count) {
+      if (health->cell_count != 0) {
+         daly_bms_reset_health(health);
       }
+      health->cell_count = cell_count;
    }
-   health->vavg = (valid_cells > 0) ? (sum_volts / valid_cells) : 0.0f;
 
-   /* Analyze each cell */
-   health->problem_cell_count = 0;
-   for (int i = 0; i < cell_count; i++) {
-      daly_cell_health_t *cell = &health->cells[i];
-
-      cell->cell_index = i + 1;
-      cell->voltage = data->cell_mv[i] / 1000.0f;
-      cell->balancing = (i < cell_count) ? data->balance[i] : false;
-
-      /* Skip health analysis for cells with unreasonable voltage */
-      if (cell->voltage <= 2.0f) {
-         cell->status = DALY_HEALTH_WARNING;  // Mark as warning instead of critical
-         snprintf(cell->reason, sizeof(cell->reason), "Cell reads %.3fV - likely BMS config issue",
-                  cell->voltage);
-         health->problem_cell_count++;
-         continue;
+   /* Pass 1: voltages, min/max and mean over plausible cells */
+   long sum_mv = 0;
+   float vmax = 0.0f;
+   float vmin = 1e9f;
+   int valid_cells = 0;
+   for (int i = 0; have_cells && i < cell_count; i++) {
+      float v = data->cell_mv[i] * 0.001f;
+      bool valid = v > CELL_VALID_MIN_V;
+      health->voltage[i] = v;
+      sum_mv += valid ? data->cell_mv[i] : 0;
+      valid_cells += valid;
+      vmax = (valid && v > vmax) ? v : vmax;
+      vmin = (valid && v < vmin) ? v : vmin;
+   }
+   if (data->fields & DALY_FIELD_BALANCE) {
+      for (int i = 0; i < cell_count; i++) {
+         health->balancing[i] = data->balance[i];
       }
+   }
 
-      /* Calculate deviation explicitly with intermediate value for debugging */
-      float deviation_v = fabsf(cell->voltage - health->vavg);
-      float deviation_mv = deviation_v * 1000.0f;
+   float vavg_mv = valid_cells > 0 ? (float)sum_mv / valid_cells : 0.0f;
+   if (have_cells) {
+      health->vavg = vavg_mv * 0.001f;
+   }
+   if (valid_cells > 0) {
+      health->vmax = vmax;
+      health->vmin = vmin;
+   } else if (data->fields & DALY_FIELD_EXTREMES) {
+      /* No per-cell readings; fall back to the 0x91 extremes */
+      health->vmax = data->extremes.vmax_v;
+      health->vmin = data->extremes.vmin_v;
+   }
+   health->vdelta = health->vmax - health->vmin;
 
-      /* Determine cell status */
-      if (deviation_mv >= critical_threshold_mv) {
-         cell->status = DALY_HEALTH_CRITICAL;
-         snprintf(cell->reason, sizeof(cell->reason),
-                  "Deviation of %.1f mV exceeds critical threshold (%.0f mV)", deviation_mv,
-                  (float)critical_threshold_mv);
-         health->problem_cell_count++;
-      } else if (deviation_mv >= warning_threshold_mv) {
-         cell->status = DALY_HEALTH_WARNING;
-         snprintf(cell->reason, sizeof(cell->reason),
-                  "Deviation of %.1f mV exceeds warning threshold (%.0f mV)", deviation_mv,
-                  (float)warning_threshold_mv);
-         health->problem_cell_count++;
-      } else {
-         cell->status = DALY_HEALTH_NORMAL;
-         cell->reason[0] = '\0';
-      }
+   /* Pass 2: deviation and instantaneous classification */
+   float warn_mv = (float)warning_threshold_mv;
+   float crit_mv = (float)critical_threshold_mv;
+   uint8_t new_cause[DALY_MAX_CELLS];
+   for (int i = 0; !have_cells && i < cell_count; i++) {
+      /* Keep the last classification; drift is re-derived below */
+      new_cause[i] = health->cause[i] == CELL_CAUSE_DRIFT ? CELL_CAUSE_NONE : health->cause[i];
+   }
+   for (int i = 0; have_cells && i < cell_count; i++) {
+      float dev_mv = data->cell_mv[i] - vavg_mv;
+      float abs_mv = fabsf(dev_mv);
+      bool valid = health->voltage[i] > CELL_VALID_MIN_V;
+      health->deviation_mv[i] = valid ? dev_mv : 0.0f;
+      new_cause[i] = !valid               ? CELL_CAUSE_LOW_VOLTAGE
+                     : abs_mv >= crit_mv ? CELL_CAUSE_DEV_CRITICAL
+                     : abs_mv >= warn_mv ? CELL_CAUSE_DEV_WARNING
+                                         : CELL_CAUSE_NONE;
    }
 
-   /* Determine overall status */
-   health->overall_status = DALY_HEALTH_NORMAL;
+   /* Resistance from load steps since the previous poll (Daly current is
+    * positive when charging) */
+   float load_a = -data->pack.current_a;
+   if (have_pack) {
+      float pack_dt_s = health->last_pack_sample
+                            ? (float)difftime(data->last_ok, health->last_pack_sample)
+                            : -1.0f;
+      battery_rint_update(&health->rint[0], data->pack.v_total_v, load_a, pack_dt_s);
+      battery_runtime_update(&health->runtime, load_a, pack_dt_s);
+      health->last_pack_sample = data->last_ok;
+   }
 
-   /* First check if any cells are in critical state */
-   for (int i = 0; i < cell_count; i++) {
-      if (health->cells[i].status == DALY_HEALTH_CRITICAL) {
-         health->overall_status = DALY_HEALTH_CRITICAL;
-         snprintf(health->status_reason, sizeof(health->status_reason),
-                  "Cell %d is in critical state", health->cells[i].cell_index);
-         break;
+   if (have_cells) {
+      float dt_s =
+          health->samples > 0 ? (float)difftime(data->last_ok, health->last_sample) : -1.0f;
+      for (int i = 0; have_pack && i < cell_count; i++) {
+         if (new_cause[i] != CELL_CAUSE_LOW_VOLTAGE) {
+            battery_rint_update(&health->rint[1 + i], health->voltage[i], load_a, dt_s);
+         }
       }
+
+      health_update_rolling(health, new_cause, data->last_ok);
    }
 
-   /* If not critical, check if any cells are in warning state */
-   if (health->overall_status != DALY_HEALTH_CRITICAL) {
-      for (int i = 0; i < cell_count; i++) {
-         if (health->cells[i].status == DALY_HEALTH_WARNING) {
-            health->overall_status = DALY_HEALTH_WARNING;
-            snprintf(health->status_reason, sizeof(health->status_reason),
-                     "Cell %d is in warning state", health->cells[i].cell_index);
-            break;
+   /* Pass 3: drift on otherwise normal cells, then reasons for changed cells */
+   health->changed = 0;
+   health->problem_cell_count = 0;
+   health->drifting_cell_count = 0;
+   int first_critical = -1;
+   int first_warning = -1;
+   for (int i = 0; i < cell_count; i++) {
+      uint8_t cause = new_cause[i];
+      if (cause == CELL_CAUSE_NONE) {
+         float projected = health->ewma_mv[i] + health->drift_mv_per_day[i] *
+                                                   (float)(DALY_HEALTH_DRIFT_HORIZON_H / 24.0);
+         bool growing = health->drift_mv_per_day[i] * health->ewma_mv[i] > 0.0f;
+         if (growing && fabsf(projected) >= warn_mv) {
+            cause = CELL_CAUSE_DRIFT;
          }
       }
-   }
 
-   /* Also check voltage delta as another indicator */
-   if (health->overall_status == DALY_HEALTH_NORMAL) {
-      if (health->vdelta * 1000.0f >= critical_threshold_mv) {
-         health->overall_status = DALY_HEALTH_CRITICAL;
-         snprintf(health->status_reason, sizeof(health->status_reason),
-                  "Cell voltage delta (%.0f mV) exceeds critical threshold",
-                  health->vdelta * 1000.0f);
-      } else if (health->vdelta * 1000.0f >= warning_threshold_mv) {
-         health->overall_status = DALY_HEALTH_WARNING;
-         snprintf(health->status_reason, sizeof(health->status_reason),
-                  "Cell voltage delta (%.0f mV) exceeds warning threshold",
-                  health->vdelta * 1000.0f);
+      uint8_t status = cell_cause_status[cause];
+      if (cause != health->cause[i]) {
+         health->changed |= 1u << i;
+         health->cause[i] = cause;
+         health->status[i] = status;
+         health_format_reason(health, i, warning_threshold_mv, critical_threshold_mv);
+      }
+      health->drifting[i] = cause == CELL_CAUSE_DRIFT;
+
+      health->problem_cell_count += status != DALY_HEALTH_NORMAL;
+      health->drifting_cell_count += health->drifting[i];
+      if (status == DALY_HEALTH_CRITICAL && first_critical < 0) {
+         first_critical = i;
+      } else if (status == DALY_HEALTH_WARNING && first_warning < 0) {
+         first_warning = i;
       }
    }
 
-   /* Check for BMS faults */
+   /* Overall status: worst cell, then voltage spread, then BMS faults */
+   health->overall_status = DALY_HEALTH_NORMAL;
+   health->status_reason[0] = '\0';
+   if (first_critical >= 0) {
+      health->overall_status = DALY_HEALTH_CRITICAL;
+      snprintf(health->status_reason, sizeof(health->status_reason),
+               "Cell %d is in critical state", first_critical + 1);
+   } else if (first_warning >= 0) {
+      health->overall_status = DALY_HEALTH_WARNING;
+      snprintf(health->status_reason, sizeof(health->status_reason),
+               "Cell %d is in warning state", first_warning + 1);
+   } else if (health->vdelta * 1000.0f >= crit_mv) {
+      health->overall_status = DALY_HEALTH_CRITICAL;
+      snprintf(health->status_reason, sizeof(health->status_reason),
+               "Cell voltage delta (%.0f mV) exceeds critical threshold", health->vdelta * 1000.0f);
+   } else if (health->vdelta * 1000.0f >= warn_mv) {
+      health->overall_status = DALY_HEALTH_WARNING;
+      snprintf(health->status_reason, sizeof(health->status_reason),
+               "Cell voltage delta (%.0f mV) exceeds warning threshold", health->vdelta * 1000.0f);
+   }
+
    if (health->overall_status != DALY_HEALTH_CRITICAL && data->fault_count > 0) {
       health->overall_status = DALY_HEALTH_WARNING;
       snprintf(health->status_reason, sizeof(health->status_reason), "%d active BMS faults",
@@ -1324,12 +2217,11 @@ int daly_bms_analyze_health(daly_device_t *dev,
 }
 
 /**
- * @brief Free resources allocated for pack health
+ * @brief Forget all health results and rolling statistics
  */
-void daly_bms_free_health(daly_pack_health_t *health) {
-   if (health && health->cells) {
-      free(health->cells);
-      health->cells = NULL;
+void daly_bms_reset_health(daly_pack_health_t *health) {
+   if (health) {
+      memset(health, 0, sizeof(*health));
    }
 }
 
@@ -1343,58 +2235,12 @@ int daly_bms_categorize_faults(const daly_device_t *dev, daly_fault_summary_t *s
 
    const daly_data_t *data = &dev->data;
 
-   /* Initialize summary structure */
-   memset(summary, 0, sizeof(daly_fault_summary_t));
-
-   /* Go through all faults and categorize them */
-   for (int i = 0; i < data->fault_count; i++) {
-      const char *fault = data->faults[i];
-
-      /* First check for L2 vs L1 since this takes precedence */
-      if (strstr(fault, "L2")) {
-         /* L2 faults are always critical */
-         if (summary->critical_count < DALY_MAX_FAULTS / 2) {
-            strncpy(summary->critical_faults[summary->critical_count], fault,
-                    sizeof(summary->critical_faults[0]) - 1);
-            summary->critical_count++;
-         }
-      } else if (strstr(fault, "L1")) {
-         /* L1 faults are always warnings */
-         if (summary->warning_count < DALY_MAX_FAULTS / 2) {
-            strncpy(summary->warning_faults[summary->warning_count], fault,
-                    sizeof(summary->warning_faults[0]) - 1);
-            summary->warning_count++;
-         }
-      }
-      /* Check for other critical faults (no L1/L2 designation) */
-      else if (strstr(fault, "Short circuit") || strstr(fault, "open circuit") ||
-               strstr(fault, "detect fault") || strstr(fault, "failure")) {
-         /* Critical fault */
-         if (summary->critical_count < DALY_MAX_FAULTS / 2) {
-            strncpy(summary->critical_faults[summary->critical_count], fault,
-                    sizeof(summary->critical_faults[0]) - 1);
-            summary->critical_count++;
-         }
-      }
-      /* Warning-level faults */
-      else if (strstr(fault, "low") || strstr(fault, "high") || strstr(fault, "adhesion") ||
-               strstr(fault, "err")) {
-         /* Warning fault */
-         if (summary->warning_count < DALY_MAX_FAULTS / 2) {
-            strncpy(summary->warning_faults[summary->warning_count], fault,
-                    sizeof(summary->warning_faults[0]) - 1);
-            summary->warning_count++;
-         }
-      }
-      /* All other faults are informational */
-      else {
-         if (summary->info_count < DALY_MAX_FAULTS / 2) {
-            strncpy(summary->info_faults[summary->info_count], fault,
-                    sizeof(summary->info_faults[0]) - 1);
-            summary->info_count++;
-         }
-      }
-   }
+   summary->critical = data->faults & daly_fault_mask(DALY_FAULT_CRITICAL);
+   summary->warning = data->faults & daly_fault_mask(DALY_FAULT_WARNING);
+   summary->info = data->faults & daly_fault_mask(DALY_FAULT_INFO);
+   summary->critical_count = __builtin_popcountll(summary->critical);
+   summary->warning_count = __builtin_popcountll(summary->warning);
+   summary->info_count = __builtin_popcountll(summary->info);
 
    return 0;
 }
@@ -1415,6 +2261,16 @@ const char *daly_bms_health_string(int status) {
    }
 }
 
+/**
+ * @brief Remaining pack capacity: the BMS counter, else its SOC of the rated capacity
+ */
+float daly_bms_remaining_mah(const daly_data_t *data, const battery_config_t *batt_config) {
+   if (data->mos.remain_capacity_mah > 0) {
+      return data->mos.remain_capacity_mah;
+   }
+   return batt_config ? batt_config->capacity_mah * data->pack.soc_pct / 100.0f : 0.0f;
+}
+
 /**
  * @brief Calculate battery runtime based on BMS data
  */
@@ -1434,17 +2290,7 @@ float daly_bms_estimate_runtime(const daly_device_t *dev, const battery_config_t
    /* Use discharge current (positive value) */
    float discharge_current_a = -current_a;
 
-   /* Choose the best capacity source */
-   float capacity_mah;
-
-   /* If BMS reports remaining capacity, use it */
-   if (data->mos.remain_capacity_mah > 0) {
-      capacity_mah = data->mos.remain_capacity_mah;
-   }
-   /* Otherwise use SOC percentage and config capacity */
-   else {
-      capacity_mah = batt_config->capacity_mah * (data->pack.soc_pct / 100.0f);
-   }
+   float capacity_mah = daly_bms_remaining_mah(data, batt_config);
 
    /* Calculate time in hours, then convert to minutes */
    float time_hours = capacity_mah / (discharge_current_a * 1000.0f);
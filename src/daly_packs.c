@@ -0,0 +1,462 @@
+/**
+ * @file daly_packs.c
+ * @brief Several Daly BMS packs polled in parallel, and their combined view
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include "daly_packs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stat_log.h"
+
+/**
+ * @brief Parse a "PORT[:BAUD][@BOARD]" pack specification
+ */
+int daly_packs_parse_spec(const char *spec,
+                          char *port,
+                          size_t port_size,
+                          int *baud,
+                          uint8_t *addr) {
+   if (!spec || spec[0] == '\0' || !port || port_size == 0) {
+      return -1;
+   }
+
+   /* Board number last, then the baud rate */
+   size_t len = strlen(spec);
+   const char *at = strrchr(spec, '@');
+   if (at) {
+      char *end;
+      long value = strtol(at + 1, &end, 10);
+      if (!addr || end == at + 1 || *end != '\0' || value < DALY_BMS_ADDR ||
+          value > DALY_BUS_MAX_ADDR) {
+         return -1;
+      }
+      *addr = (uint8_t)value;
+      len = (size_t)(at - spec);
+   }
+
+   const char *colon = memchr(spec, ':', len);
+   if (colon) {
+      char *end;
+      long value = strtol(colon + 1, &end, 10);
+      if (end == colon + 1 || end != spec + len || value <= 0) {
+         return -1;
+      }
+      *baud = (int)value;
+      len = (size_t)(colon - spec);
+   }
+
+   if (len == 0 || len >= port_size) {
+      return -1;
+   }
+   memcpy(port, spec, len);
+   port[len] = '\0';
+   return 0;
+}
+
+/**
+ * @brief Add a pack to the group
+ */
+int daly_packs_add(daly_pack_group_t *group, const char *port, int baud, uint8_t addr) {
+   if (!group || !port || group->count >= DALY_MAX_PACKS) {
+      return -1;
+   }
+
+   /* The first pack on a port opens it for the others */
+   int bus = group->count;
+   for (int i = 0; i < group->count; i++) {
+      if (strcmp(group->packs[i].port, port) == 0) {
+         if (group->packs[i].addr == addr) {
+            return -1;
+         }
+         if (bus == group->count) {
+            bus = i;
+         }
+      }
+   }
+
+   int index = group->count++;
+   daly_pack_t *pack = &group->packs[index];
+   memset(pack, 0, sizeof(*pack));
+   snprintf(pack->port, sizeof(pack->port), "%s", port);
+   pack->baud = baud;
+   pack->addr = addr;
+   pack->bus = bus;
+   pack->poll_result = -1;
+   pack->dev.fd = -1;
+   pack->group = group;
+   return index;
+}
+
+/**
+ * @brief Add a pack for every BMS answering on an RS-485 segment
+ */
+int daly_packs_scan(daly_pack_group_t *group, const char *port, int baud) {
+   daly_device_t dev;
+   uint8_t found[DALY_MAX_PACKS];
+
+   if (daly_bms_init(&dev, port, baud, DALY_BUS_SCAN_TIMEOUT_MS) < 0) {
+      return -1;
+   }
+   int count = daly_bms_scan_bus(&dev, found, DALY_MAX_PACKS);
+   daly_bms_close(&dev);
+
+   int added = 0;
+   for (int i = 0; i < count; i++) {
+      if (daly_packs_add(group, port, baud, found[i]) >= 0) {
+         added++;
+      }
+   }
+   return added;
+}
+
+/**
+ * @brief Open a port, and attach the other packs on its segment
+ */
+static bool bus_open(daly_pack_group_t *group, int bus) {
+   daly_pack_t *leader = &group->packs[bus];
+
+   for (int i = bus; i < group->count; i++) {
+      daly_pack_t *pack = &group->packs[i];
+      if (pack->bus != bus) {
+         continue;
+      }
+      pack->last_open = time(NULL);
+      pack->failures = 0;
+
+      /* Link statistics span reconnects; a flaky cable is what they are for */
+      daly_link_t link = pack->dev.link;
+      if (i == bus) {
+         if (daly_bms_init(&pack->dev, pack->port, pack->baud, group->timeout_ms) < 0) {
+            pack->dev.link = link;
+            return false;
+         }
+         pack->dev.addr = pack->addr;
+      } else {
+         daly_bms_attach(&pack->dev, &leader->dev, pack->addr);
+      }
+      pack->dev.link = link;
+   }
+   return true;
+}
+
+/**
+ * @brief Close a port and detach the packs on its segment
+ */
+static void bus_close(daly_pack_group_t *group, int bus) {
+   /* Members first: they only borrow the leader's port */
+   for (int i = group->count - 1; i >= bus; i--) {
+      daly_pack_t *pack = &group->packs[i];
+      if (pack->bus == bus && pack->dev.initialized) {
+         daly_bms_close(&pack->dev);
+      }
+   }
+}
+
+/**
+ * @brief Open every pack's serial port
+ */
+int daly_packs_open(daly_pack_group_t *group, int timeout_ms) {
+   int opened = 0;
+
+   group->timeout_ms = timeout_ms;
+   for (int i = 0; i < group->count; i++) {
+      if (group->packs[i].bus == i && bus_open(group, i)) {
+         for (int j = i; j < group->count; j++) {
+            opened += group->packs[j].bus == i;
+         }
+      }
+   }
+   return opened;
+}
+
+/**
+ * @brief Poll the packs on one port, reopening it first if it is missing
+ */
+static void bus_poll(daly_pack_group_t *group, int bus) {
+   daly_pack_t *leader = &group->packs[bus];
+   daly_device_t *devs[DALY_MAX_PACKS];
+   daly_pack_t *members[DALY_MAX_PACKS];
+   int results[DALY_MAX_PACKS];
+   int count = 0;
+
+   for (int i = bus; i < group->count; i++) {
+      if (group->packs[i].bus == bus) {
+         group->packs[i].poll_result = -1;
+         members[count] = &group->packs[i];
+         devs[count++] = &group->packs[i].dev;
+      }
+   }
+
+   if (!leader->dev.initialized) {
+      if (!group->reopen || time(NULL) - leader->last_open < DALY_PACK_REOPEN_S ||
+          !bus_open(group, bus)) {
+         return;
+      }
+      OLOG_INFO("Daly BMS pack %d is back on %s", bus + 1, leader->port);
+   }
+
+   /* A BMS alone on its port is polled straight through */
+   int ok;
+   if (count == 1) {
+      results[0] = daly_bms_poll(&leader->dev);
+      ok = results[0] == 0;
+   } else {
+      ok = daly_bms_poll_bus(devs, count, DALY_BUS_TURNAROUND_MS, results);
+   }
+   for (int i = 0; i < count; i++) {
+      members[i]->poll_result = results[i];
+   }
+   if (ok > 0) {
+      leader->failures = 0;
+      return;
+   }
+
+   /* A port where nobody answers any more may have been unplugged; reopen it later */
+   if (group->reopen && ++leader->failures >= DALY_PACK_MAX_FAILURES) {
+      OLOG_WARNING("Daly BMS on %s stopped answering", leader->port);
+      bus_close(group, bus);
+      for (int i = 0; i < count; i++) {
+         members[i]->dev.data.valid = false;
+         members[i]->health_valid = false;
+      }
+      leader->last_open = time(NULL);
+   }
+}
+
+/**
+ * @brief Worker: poll one port each time a cycle is requested
+ */
+static void *pack_worker(void *arg) {
+   daly_pack_t *pack = (daly_pack_t *)arg;
+   daly_pack_group_t *group = pack->group;
+   unsigned seen = 0;
+
+   pthread_mutex_lock(&group->lock);
+   for (;;) {
+      while (!group->stop && group->cycle == seen) {
+         pthread_cond_wait(&group->start_cond, &group->lock);
+      }
+      if (group->stop) {
+         break;
+      }
+      seen = group->cycle;
+      pthread_mutex_unlock(&group->lock);
+
+      bus_poll(group, (int)(pack - group->packs));
+
+      pthread_mutex_lock(&group->lock);
+      if (--group->pending == 0) {
+         pthread_cond_signal(&group->done_cond);
+      }
+   }
+   pthread_mutex_unlock(&group->lock);
+   return NULL;
+}
+
+/**
+ * @brief Stop and join the poll workers
+ */
+static void stop_workers(daly_pack_group_t *group) {
+   pthread_mutex_lock(&group->lock);
+   group->stop = true;
+   pthread_cond_broadcast(&group->start_cond);
+   pthread_mutex_unlock(&group->lock);
+   for (int i = 0; i < group->workers; i++) {
+      pthread_join(group->threads[i], NULL);
+   }
+   group->workers = 0;
+   pthread_cond_destroy(&group->done_cond);
+   pthread_cond_destroy(&group->start_cond);
+   pthread_mutex_destroy(&group->lock);
+}
+
+/**
+ * @brief Start the poll workers
+ */
+int daly_packs_start(daly_pack_group_t *group) {
+   int buses = 0;
+   for (int i = 0; i < group->count; i++) {
+      buses += group->packs[i].bus == i;
+   }
+   if (buses < 2) {
+      return 0;
+   }
+
+   pthread_mutex_init(&group->lock, NULL);
+   pthread_cond_init(&group->start_cond, NULL);
+   pthread_cond_init(&group->done_cond, NULL);
+   group->cycle = 0;
+   group->stop = false;
+
+   for (int i = 0; i < group->count; i++) {
+      if (group->packs[i].bus != i) {
+         continue;
+      }
+      if (pthread_create(&group->threads[group->workers], NULL, pack_worker,
+                         &group->packs[i]) != 0) {
+         OLOG_WARNING("Failed to start Daly BMS poll workers, polling packs in turn");
+         stop_workers(group);
+         return -1;
+      }
+      group->workers++;
+   }
+   return 0;
+}
+
+/**
+ * @brief Poll every pack
+ */
+int daly_packs_poll(daly_pack_group_t *group) {
+   if (group->workers > 0) {
+      pthread_mutex_lock(&group->lock);
+      group->pending = group->workers;
+      group->cycle++;
+      pthread_cond_broadcast(&group->start_cond);
+      while (group->pending > 0) {
+         pthread_cond_wait(&group->done_cond, &group->lock);
+      }
+      pthread_mutex_unlock(&group->lock);
+   } else {
+      for (int i = 0; i < group->count; i++) {
+         if (group->packs[i].bus == i) {
+            bus_poll(group, i);
+         }
+      }
+   }
+
+   int ok = 0;
+   for (int i = 0; i < group->count; i++) {
+      ok += group->packs[i].poll_result == 0;
+   }
+   return ok;
+}
+
+/**
+ * @brief Stop the workers and close every pack
+ */
+void daly_packs_close(daly_pack_group_t *group) {
+   if (group->workers > 0) {
+      stop_workers(group);
+   }
+
+   for (int i = 0; i < group->count; i++) {
+      if (group->packs[i].bus == i) {
+         bus_close(group, i);
+      }
+   }
+}
+
+/**
+ * @brief Combine the latest data of all packs
+ */
+void daly_packs_summarize(const daly_pack_group_t *group, daly_packs_summary_t *summary) {
+   memset(summary, 0, sizeof(*summary));
+   summary->pack_count = group->count;
+   summary->weakest_pack = -1;
+   summary->overall_status = DALY_HEALTH_NORMAL;
+
+   /* Packs are weighted by their full capacity; if any pack cannot report
+    * one, all count the same */
+   bool capacity_known = true;
+   float soc_sum = 0.0f;
+   float weighted_soc = 0.0f;
+
+   for (int i = 0; i < group->count; i++) {
+      const daly_pack_t *pack = &group->packs[i];
+      const daly_data_t *data = &pack->dev.data;
+
+      /* A pack whose latest poll failed only has the data of an earlier one */
+      if (!pack->dev.initialized || !data->valid || pack->poll_result != 0) {
+         continue;
+      }
+
+      if (summary->valid_count == 0 || data->temps.tmax_c > summary->tmax_c) {
+         summary->tmax_c = data->temps.tmax_c;
+      }
+      if (summary->valid_count == 0 || data->temps.tmin_c < summary->tmin_c) {
+         summary->tmin_c = data->temps.tmin_c;
+      }
+      summary->valid_count++;
+      summary->voltage_v += data->pack.v_total_v;
+      summary->current_a += data->pack.current_a;
+      summary->power_w += data->pack.v_total_v * data->pack.current_a;
+      summary->remaining_mah += data->mos.remain_capacity_mah;
+      summary->fault_count += data->fault_count;
+      if (data->last_ok > summary->last_ok) {
+         summary->last_ok = data->last_ok;
+      }
+
+      soc_sum += data->pack.soc_pct;
+      if (data->mos.remain_capacity_mah > 0 && data->pack.soc_pct >= 1.0f) {
+         float full_mah = data->mos.remain_capacity_mah * 100.0f / data->pack.soc_pct;
+         summary->capacity_mah += full_mah;
+         weighted_soc += data->pack.soc_pct * full_mah;
+      } else {
+         capacity_known = false;
+      }
+
+      /* Lowest cell from this poll's readings; a cell reading 0 was not reported */
+      int cell = -1;
+      float cell_v = 0.0f;
+      int cells = (data->fields & DALY_FIELD_CELLS) ? data->status.cell_count : 0;
+      for (int c = 0; c < cells && c < DALY_MAX_CELLS; c++) {
+         if (data->cell_mv[c] > 0 && (cell < 0 || data->cell_mv[c] / 1000.0f < cell_v)) {
+            cell = c;
+            cell_v = data->cell_mv[c] / 1000.0f;
+         }
+      }
+      if (cell >= 0 && (summary->weakest_pack < 0 || cell_v < summary->weakest_cell_v)) {
+         summary->weakest_pack = i;
+         summary->weakest_cell = cell;
+         summary->weakest_cell_v = cell_v;
+      }
+
+      if (pack->health_valid && pack->health.overall_status > summary->overall_status) {
+         summary->overall_status = pack->health.overall_status;
+      }
+   }
+
+   if (summary->valid_count == 0) {
+      return;
+   }
+   summary->voltage_v /= summary->valid_count;
+   summary->soc_pct = (capacity_known && summary->capacity_mah > 0.0f)
+                          ? weighted_soc / summary->capacity_mah
+                          : soc_sum / summary->valid_count;
+   if (!capacity_known) {
+      summary->capacity_mah = 0.0f;
+   }
+}
+
+/**
+ * @brief Resistance baseline file of a pack
+ */
+void daly_packs_rint_path(int index, char *path, size_t size) {
+   if (index == 0) {
+      snprintf(path, size, "%s", DALY_RINT_PATH);
+   } else {
+      snprintf(path, size, "%s-pack%d", DALY_RINT_PATH, index + 1);
+   }
+}
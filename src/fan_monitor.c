@@ -26,12 +26,14 @@
 
 #include <dirent.h>
 #include <limits.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
-#include "logging.h"
+#include "stat_log.h"
+#include "sysfs_discovery.h"
 
 /* Default max RPM value */
 #define FAN_DEFAULT_MAX_RPM 6000
@@ -281,6 +283,101 @@ static int find_fan_rpm_file(char *rpm_path, size_t path_size) {
    return -1; /* Not found */
 }
 
+/**
+ * @brief Read the name of the hwmon device a fan file belongs to
+ *
+ * hwmon numbers are assigned in probe order, so after a reboot the cached
+ * hwmonN can belong to another driver; its name tells them apart.
+ *
+ * @return int 0 on success, -1 if the path has no hwmonN or it has no name
+ */
+static int fan_hwmon_name(const char *file, char *name, size_t size) {
+   const char *hwmon = NULL;
+   for (const char *p = strstr(file, "/hwmon"); p; p = strstr(p + 1, "/hwmon")) {
+      if (p[6] >= '0' && p[6] <= '9') {
+         hwmon = p + 6;
+      }
+   }
+   if (!hwmon) {
+      return -1;
+   }
+
+   char name_path[64];
+   int digits = (int)strspn(hwmon, "0123456789");
+   snprintf(name_path, sizeof(name_path), "/sys/class/hwmon/hwmon%.*s/name",
+            digits < 10 ? digits : 10, hwmon);
+   FILE *fp = fopen(name_path, "r");
+   if (!fp) {
+      return -1;
+   }
+   bool ok = fgets(name, (int)size, fp) != NULL;
+   fclose(fp);
+   if (!ok) {
+      return -1;
+   }
+   name[strcspn(name, "\n")] = '\0';
+   return name[0] ? 0 : -1;
+}
+
+/**
+ * @brief Use the fan paths from the discovery cache if they still name the same device
+ *
+ * @return int 0 if the cached RPM file is readable and its hwmon name matches, -1 otherwise
+ */
+static int fan_load_cached_paths(void) {
+   char cached_name[64];
+   char name[64];
+
+   if (sysfs_discovery_get(SYSFS_KEY_FAN_RPM, fan_rpm_path, sizeof(fan_rpm_path)) != 0 ||
+       access(fan_rpm_path, R_OK) != 0) {
+      fan_rpm_path[0] = '\0';
+      return -1;
+   }
+   if (sysfs_discovery_get(SYSFS_KEY_FAN_NAME, cached_name, sizeof(cached_name)) != 0 ||
+       fan_hwmon_name(fan_rpm_path, name, sizeof(name)) != 0 || strcmp(name, cached_name) != 0) {
+      OLOG_INFO("Cached fan RPM file %s now belongs to another device", fan_rpm_path);
+      fan_rpm_path[0] = '\0';
+      return -1;
+   }
+
+   if (sysfs_discovery_get(SYSFS_KEY_FAN_PWM, fan_pwm_path, sizeof(fan_pwm_path)) != 0 ||
+       access(fan_pwm_path, R_OK) != 0) {
+      fan_pwm_path[0] = '\0';
+   }
+
+   OLOG_INFO("Using cached fan RPM file: %s", fan_rpm_path);
+   return 0;
+}
+
+/**
+ * @brief Resolve the fan files, from the cache if allowed, and update the cache
+ */
+static int fan_resolve_paths(int use_cache) {
+   fan_monitor_initialized = 0;
+   fan_rpm_path[0] = '\0';
+   fan_pwm_path[0] = '\0';
+
+   if (!use_cache || fan_load_cached_paths() != 0) {
+      char name[64] = "";
+      if (find_fan_rpm_file(fan_rpm_path, sizeof(fan_rpm_path)) != 0) {
+         fan_rpm_path[0] = '\0';
+         fan_pwm_path[0] = '\0';
+      } else if (fan_hwmon_name(fan_rpm_path, name, sizeof(name)) != 0) {
+         name[0] = '\0';
+      }
+      sysfs_discovery_set(SYSFS_KEY_FAN_RPM, fan_rpm_path);
+      sysfs_discovery_set(SYSFS_KEY_FAN_PWM, fan_pwm_path);
+      sysfs_discovery_set(SYSFS_KEY_FAN_NAME, name);
+   }
+
+   if (fan_rpm_path[0] == '\0') {
+      return -1;
+   }
+
+   fan_monitor_initialized = 1;
+   return 0;
+}
+
 /**
  * @brief Initialize the fan monitoring subsystem
  *
@@ -291,16 +388,32 @@ int fan_monitor_init(void) {
       return 0; /* Already initialized with valid file */
    }
 
-   if (find_fan_rpm_file(fan_rpm_path, sizeof(fan_rpm_path)) != 0) {
+   if (fan_resolve_paths(1) != 0) {
       OLOG_WARNING("Failed to find fan RPM file, fan monitoring disabled");
       return -1;
    }
 
    OLOG_INFO("Fan monitoring initialized with RPM file: %s", fan_rpm_path);
-   fan_monitor_initialized = 1;
    return 0;
 }
 
+/**
+ * @brief Resolve the fan files again after a hwmon hotplug event
+ *
+ * @return int 0 if a fan is available, -1 otherwise
+ */
+int fan_monitor_rescan(void) {
+   char old_rpm_path[sizeof(fan_rpm_path)];
+   memcpy(old_rpm_path, fan_rpm_path, sizeof(old_rpm_path));
+
+   int ret = fan_resolve_paths(0);
+   if (strcmp(old_rpm_path, fan_rpm_path) != 0) {
+      OLOG_INFO("Fan RPM file changed: %s -> %s", old_rpm_path[0] ? old_rpm_path : "(none)",
+                fan_rpm_path[0] ? fan_rpm_path : "(none)");
+   }
+   return ret;
+}
+
 /**
  * @brief Sets the maximum expected RPM value for the fan
  *
@@ -322,30 +435,24 @@ int fan_monitor_get_rpm(void) {
    FILE *rpm_file = NULL;
    int rpm = -1;
 
+   /* Paths are resolved by fan_monitor_init()/fan_monitor_rescan(), never here */
    if (!fan_monitor_initialized) {
-      if (fan_monitor_init() != 0) {
-         return -1;
-      }
+      return -1;
    }
 
-   /* Open the file for persistent use */
-   if (fan_pwm_path[0] != '\0') {
-      rpm_file = fopen(fan_rpm_path, "r");
-      if (rpm_file == NULL) {
-         OLOG_ERROR("Failed to open fan RPM file: %s", fan_rpm_path);
-         return -1;
-      }
+   rpm_file = fopen(fan_rpm_path, "r");
+   if (rpm_file == NULL) {
+      OLOG_ERROR("Failed to open fan RPM file: %s", fan_rpm_path);
+      return -1;
    }
 
    /* Read the RPM value */
    if (fscanf(rpm_file, "%d", &rpm) != 1) {
       OLOG_WARNING("Failed to read fan RPM value");
+      rpm = -1;
    }
 
-   if (rpm_file != NULL) {
-      fclose(rpm_file);
-      rpm_file = NULL;
-   }
+   fclose(rpm_file);
 
    return rpm;
 }
@@ -359,28 +466,24 @@ int fan_monitor_get_pwm(void) {
    FILE *pwm_file = NULL;
    int pwm = -1;
 
-   if (!fan_monitor_initialized) {
+   if (!fan_monitor_initialized || fan_pwm_path[0] == '\0') {
       return -1;
    }
 
-   /* Open PWM file if available */
-   if (fan_pwm_path[0] != '\0') {
-      pwm_file = fopen(fan_pwm_path, "r");
-      if (pwm_file == NULL) {
-         OLOG_WARNING("Failed to open fan PWM file: %s, using default max RPM", fan_pwm_path);
-      }
+   pwm_file = fopen(fan_pwm_path, "r");
+   if (pwm_file == NULL) {
+      OLOG_WARNING("Failed to open fan PWM file: %s, using default max RPM", fan_pwm_path);
+      return -1;
    }
 
    /* Read the PWM value */
    if (fscanf(pwm_file, "%d", &pwm) != 1) {
       OLOG_WARNING("Failed to read fan PWM value");
+      fclose(pwm_file);
       return -1;
    }
 
-   if (pwm_file != NULL) {
-      fclose(pwm_file);
-      pwm_file = NULL;
-   }
+   fclose(pwm_file);
 
    /* Ensure PWM value is in range 0-255 */
    if (pwm < 0)
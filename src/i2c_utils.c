@@ -38,7 +38,7 @@
 #include <time.h>
 #include <unistd.h>
 
-#include "logging.h"
+#include "stat_log.h"
 
 /**
  * @brief Open I2C device
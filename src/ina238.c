@@ -32,7 +32,7 @@
 
 #include "i2c_utils.h"
 #include "ina238_registers.h"
-#include "logging.h"
+#include "stat_log.h"
 
 /* Private function prototypes */
 static int ina238_probe(ina238_device_t *dev);
@@ -119,17 +119,12 @@ static int ina238_configure_device(ina238_device_t *dev) {
 }
 
 /**
- * @brief Initialize INA238 device
+ * @brief Compute scaling parameters without touching the bus
  */
-int ina238_init(ina238_device_t *dev,
-                const char *i2c_bus,
-                uint8_t i2c_addr,
-                float r_shunt,
-                float max_current) {
-   i2c_device_t i2c_dev;
-
+void ina238_init_params(ina238_device_t *dev, uint8_t i2c_addr, float r_shunt, float max_current) {
    /* Clear device structure */
    memset(dev, 0, sizeof(ina238_device_t));
+   dev->fd = -1;
 
    /* Store configuration parameters */
    dev->i2c_addr = i2c_addr;
@@ -149,6 +144,19 @@ int ina238_init(ina238_device_t *dev,
    if (dev->range == INA238_ADCRANGE_LOW) {
       dev->shunt_calibration *= 4;
    }
+}
+
+/**
+ * @brief Initialize INA238 device
+ */
+int ina238_init(ina238_device_t *dev,
+                const char *i2c_bus,
+                uint8_t i2c_addr,
+                float r_shunt,
+                float max_current) {
+   i2c_device_t i2c_dev;
+
+   ina238_init_params(dev, i2c_addr, r_shunt, max_current);
 
    /* Open I2C device */
    if (i2c_open_device(&i2c_dev, i2c_bus, i2c_addr) < 0) {
@@ -202,14 +210,61 @@ int ina238_read_measurements(ina238_device_t *dev, ina238_measurements_t *measur
       return -1;
    }
 
+   ina238_raw_t raw;
+   ina238_read_raw(dev, &raw);
+
+   return ina238_convert_raw(dev, &raw, measurements);
+}
+
+/**
+ * @brief Read the raw measurement registers from INA238
+ */
+int ina238_read_raw(ina238_device_t *dev, ina238_raw_t *raw) {
+   if (!dev || !dev->initialized || !raw) {
+      return -1;
+   }
+
+   i2c_device_t i2c_dev = { .fd = dev->fd, .address = dev->i2c_addr, .bus = NULL };
+   int failures = 0;
+
+   /* A failed register reads as 0, matching the scaled readers' error value */
+   if (i2c_read_register16(&i2c_dev, INA238_REG_VBUS, &raw->vbus) < 0) {
+      raw->vbus = 0;
+      failures++;
+   }
+   if (i2c_read_register16(&i2c_dev, INA238_REG_CURRENT, &raw->current) < 0) {
+      raw->current = 0;
+      failures++;
+   }
+   if (i2c_read_register24(&i2c_dev, INA238_REG_POWER, &raw->power) < 0) {
+      raw->power = 0;
+      failures++;
+   }
+   if (i2c_read_register16(&i2c_dev, INA238_REG_DIETEMP, &raw->dietemp) < 0) {
+      raw->dietemp = 0;
+      failures++;
+   }
+
+   return failures == 4 ? -1 : 0;
+}
+
+/**
+ * @brief Convert a raw register snapshot into scaled measurements
+ */
+int ina238_convert_raw(const ina238_device_t *dev,
+                       const ina238_raw_t *raw,
+                       ina238_measurements_t *measurements) {
+   if (!dev || !raw || !measurements) {
+      return -1;
+   }
+
    /* Clear measurements structure */
    memset(measurements, 0, sizeof(ina238_measurements_t));
 
-   /* Read individual measurements */
-   measurements->bus_voltage = ina238_read_bus_voltage(dev);
-   measurements->current = ina238_read_current(dev);
-   measurements->power = ina238_read_power(dev);
-   measurements->temperature = ina238_read_temperature(dev);
+   measurements->bus_voltage = (float)((int16_t)raw->vbus) * INA238_VSCALE;
+   measurements->current = (float)((int16_t)raw->current) * dev->current_lsb;
+   measurements->power = (float)raw->power * dev->power_lsb;
+   measurements->temperature = (float)((int16_t)raw->dietemp) * INA238_TSCALE;
 
    /* Mark as valid if we got reasonable values */
    measurements->valid = (measurements->bus_voltage != 0.0f || measurements->current != 0.0f ||
@@ -35,13 +35,15 @@
 #include <string.h>
 #include <unistd.h>
 
-#include "logging.h"
+#include "stat_log.h"
+#include "sysfs_discovery.h"
 
 /* Private function prototypes */
 static int ina3221_read_sysfs_file(const char *path, char *buffer, size_t buffer_size);
 static int ina3221_read_sysfs_int(const char *path, int *value);
 static int ina3221_init_channel(ina3221_device_t *dev, int channel);
 static int ina3221_find_hwmon_path(const char *base_path, char *hwmon_path, size_t path_size);
+static int ina3221_is_hwmon(const char *hwmon_path);
 
 /**
  * @brief Read a string value from a sysfs file
@@ -113,6 +115,23 @@ static int ina3221_find_hwmon_path(const char *base_path, char *hwmon_path, size
    return ret;
 }
 
+/**
+ * @brief Check that a hwmon directory belongs to an INA3221
+ */
+static int ina3221_is_hwmon(const char *hwmon_path) {
+   char name_path[1024]; /* Increased buffer size */
+   char name_buffer[64];
+
+   int len = snprintf(name_path, sizeof(name_path), "%s/name", hwmon_path);
+   if (len >= (int)sizeof(name_path)) {
+      OLOG_WARNING("Name path too long, skipping");
+      return 0;
+   }
+
+   return ina3221_read_sysfs_file(name_path, name_buffer, sizeof(name_buffer)) == 0 &&
+          strstr(name_buffer, "ina3221") != NULL;
+}
+
 /**
  * @brief Auto-detect INA3221 device in sysfs
  */
@@ -121,8 +140,13 @@ int ina3221_detect_device(char *sysfs_path, size_t path_size) {
    struct dirent *entry;
    char device_path[1024]; /* Increased buffer size */
    char hwmon_path[1024];  /* Increased buffer size */
-   char name_path[1024];   /* Increased buffer size */
-   char name_buffer[64];
+
+   /* The hwmon directory found last time, if it is still an INA3221 */
+   if (sysfs_discovery_get(SYSFS_KEY_INA3221, hwmon_path, sizeof(hwmon_path)) == 0 &&
+       ina3221_is_hwmon(hwmon_path) && strlen(hwmon_path) < path_size) {
+      strcpy(sysfs_path, hwmon_path);
+      return 0;
+   }
 
    /* Open the INA3221 driver directory */
    dir = opendir(INA3221_SYSFS_BASE);
@@ -148,29 +172,23 @@ int ina3221_detect_device(char *sysfs_path, size_t path_size) {
       /* Check if this device has hwmon interface */
       if (ina3221_find_hwmon_path(device_path, hwmon_path, sizeof(hwmon_path)) == 0) {
          /* Verify it's actually an INA3221 by checking the name */
-         len = snprintf(name_path, sizeof(name_path), "%s/name", hwmon_path);
-         if (len >= (int)sizeof(name_path)) {
-            OLOG_WARNING("Name path too long, skipping");
-            continue;
-         }
-
-         if (ina3221_read_sysfs_file(name_path, name_buffer, sizeof(name_buffer)) == 0) {
-            if (strstr(name_buffer, "ina3221") != NULL) {
-               /* Found it! */
-               size_t copy_len = strlen(hwmon_path);
-               if (copy_len < path_size) {
-                  strcpy(sysfs_path, hwmon_path);
-                  closedir(dir);
-                  return 0;
-               } else {
-                  OLOG_ERROR("sysfs path too long: %s", hwmon_path);
-               }
+         if (ina3221_is_hwmon(hwmon_path)) {
+            /* Found it! */
+            size_t copy_len = strlen(hwmon_path);
+            if (copy_len < path_size) {
+               strcpy(sysfs_path, hwmon_path);
+               closedir(dir);
+               sysfs_discovery_set(SYSFS_KEY_INA3221, sysfs_path);
+               return 0;
+            } else {
+               OLOG_ERROR("sysfs path too long: %s", hwmon_path);
             }
          }
       }
    }
 
    closedir(dir);
+   sysfs_discovery_set(SYSFS_KEY_INA3221, NULL);
    OLOG_ERROR("INA3221 device not found in sysfs");
    return -1;
 }
@@ -351,7 +369,6 @@ int ina3221_read_channel(ina3221_device_t *dev, int channel, ina3221_channel_t *
       OLOG_ERROR("Failed to read voltage for channel %d", channel);
       return -1;
    }
-   channel_data->voltage = (float)voltage_mv / 1000.0f; /* Convert mV to V */
 
    /* Read current (in mA) */
    len = snprintf(path, sizeof(path), "%s/curr%d_input", dev->sysfs_path, channel);
@@ -364,13 +381,24 @@ int ina3221_read_channel(ina3221_device_t *dev, int channel, ina3221_channel_t *
       OLOG_ERROR("Failed to read current for channel %d", channel);
       return -1;
    }
+
+   ina3221_apply_raw(channel_data, voltage_mv, current_ma);
+   return 0;
+}
+
+/**
+ * @brief Fill a channel's measurements from raw sysfs values
+ */
+void ina3221_apply_raw(ina3221_channel_t *channel_data, int voltage_mv, int current_ma) {
+   channel_data->raw_voltage_mv = voltage_mv;
+   channel_data->raw_current_ma = current_ma;
+   channel_data->voltage = (float)voltage_mv / 1000.0f; /* Convert mV to V */
    channel_data->current = (float)current_ma / 1000.0f; /* Convert mA to A */
 
    /* Calculate power */
    channel_data->power = channel_data->voltage * channel_data->current;
 
    channel_data->valid = true;
-   return 0;
 }
 
 /**
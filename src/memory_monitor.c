@@ -28,7 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "logging.h"
+#include "stat_log.h"
 
 /* Static variables */
 static float memory_usage = 0.0f;
@@ -71,12 +71,9 @@ float memory_monitor_get_usage(void) {
    float mem_avail = 0.0f;
    FILE *fp;
 
-   /* Check if initialized */
+   /* Initialized once at startup; a failed init is not retried per sample */
    if (!memory_monitor_initialized) {
-      /* Try to initialize */
-      if (memory_monitor_init() != 0) {
-         return -1.0f;
-      }
+      return -1.0f;
    }
 
    fp = fopen("/proc/meminfo", "r");
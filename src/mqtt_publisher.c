@@ -27,6 +27,7 @@
 #include <json-c/json.h>
 #include <math.h>
 #include <mosquitto.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,16 +36,49 @@
 
 #include "ina238.h"
 #include "ina3221.h"
-#include "logging.h"
 #include "mqtt_publisher_internal.h"
+#include "stat_events.h"
+#include "stat_log.h"
 
 /* Forward declaration of battery_config_t */
 struct battery_config_t;
 
 /* Static variables */
 static struct mosquitto *mosq = NULL;
+static struct mosquitto *priority_mosq = NULL; /* Alerts and status, with --mqtt-priority */
+static bool priority_mode = false;
 static bool mqtt_initialized = false;
 static char current_topic[64] = MQTT_DEFAULT_TOPIC;
+static bool bundle_mode = false;
+static struct json_object *bundle = NULL; /* This tick's sections, bundle mode only */
+
+/* MQTT v5 */
+static bool v5_mode = false;
+static unsigned int message_expiry_s = MQTT_DEFAULT_EXPIRY_S;
+static atomic_uint connection_generation = 0; /* Bumped per CONNACK; aliases are per connection */
+static atomic_uint server_alias_max = 0;      /* Topic Alias Maximum from the broker's CONNACK */
+
+/**
+ * @brief Outgoing topic alias (alias = index + 1); main loop only
+ */
+typedef struct {
+   char topic[96];
+   unsigned int generation; /* Connection that last received topic and alias together */
+} topic_alias_t;
+
+static topic_alias_t topic_aliases[MQTT_TOPIC_ALIASES];
+static int topic_alias_count = 0;
+
+/* Backpressure; all but the queue depths belong to the main loop */
+static atomic_int queued = 0; /* Published, not yet sent (QoS 0) or acknowledged (QoS 1) */
+static atomic_int priority_queued = 0; /* The same for the priority client */
+static mqtt_degrade_t degrade_level = MQTT_DEGRADE_NONE;
+static unsigned long update_count = 0;
+static unsigned long dropped_messages = 0;
+
+/* Alert state per source (main topic, then one per pack); main loop only */
+static mqtt_alert_source_t alert_sources[MQTT_ALERT_SOURCES];
+static struct json_object *alert_messages[MQTT_ALERT_SOURCES]; /* Worst message this update */
 
 /**
  * @brief Get current timestamp in milliseconds (OCP v1.4).
@@ -67,65 +101,658 @@ static void ocp_add_telemetry_envelope(struct json_object *root, const char *sub
    json_object_object_add(root, "timestamp", json_object_new_int64(get_timestamp_ms()));
 }
 
+/**
+ * @brief Render Daly fault flags as a JSON array of descriptions.
+ *
+ * This is the only place fault strings are produced for MQTT.
+ */
+static struct json_object *daly_fault_list_json(daly_fault_bits_t bits) {
+   struct json_object *list = json_object_new_array();
+   int code;
+
+   while ((code = daly_fault_next(&bits)) >= 0) {
+      json_object_array_add(list, json_object_new_string(daly_fault_description(code)));
+   }
+   return list;
+}
+
+/**
+ * @brief Names of the Daly fields the latest poll could not refresh
+ */
+static struct json_object *daly_stale_list_json(unsigned fields) {
+   /* In DALY_FIELD_* bit order */
+   static const char *const names[] = { "pack",  "extremes",     "temperature", "mos",   "status",
+                                        "cells", "temperatures", "balance",     "faults" };
+   struct json_object *list = json_object_new_array();
+
+   for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+      if (!(fields & (1u << i))) {
+         json_object_array_add(list, json_object_new_string(names[i]));
+      }
+   }
+   return list;
+}
+
+/**
+ * @brief Topic for a pack's messages: <topic>/pack/<n> with several packs
+ */
+static const char *pack_topic(int pack, char *buf, size_t size) {
+   if (pack < 0) {
+      return current_topic;
+   }
+   snprintf(buf, size, "%s/pack/%d", current_topic, pack + 1);
+   return buf;
+}
+
+/**
+ * @brief Whether telemetry has anywhere to go: the broker or the event stream
+ */
+static bool telemetry_wanted(void) {
+   return (mqtt_initialized && mosq) || stat_events_active();
+}
+
+/**
+ * @brief Client for status and alerts: the priority client when there is one
+ */
+static struct mosquitto *status_client(void) {
+   return priority_mosq ? priority_mosq : mosq;
+}
+
+/**
+ * @brief Alias for a telemetry topic on the current connection
+ */
+int mqtt_topic_alias(const char *topic, unsigned int generation, unsigned int alias_max,
+                     bool *send_topic) {
+   int index = -1;
+
+   *send_topic = true;
+   for (int i = 0; i < topic_alias_count; i++) {
+      if (strcmp(topic_aliases[i].topic, topic) == 0) {
+         index = i;
+         break;
+      }
+   }
+   if (index < 0) {
+      if (topic_alias_count >= MQTT_TOPIC_ALIASES ||
+          strlen(topic) >= sizeof(topic_aliases[0].topic)) {
+         return 0;
+      }
+      index = topic_alias_count++;
+      snprintf(topic_aliases[index].topic, sizeof(topic_aliases[index].topic), "%s", topic);
+      topic_aliases[index].generation = 0;
+   }
+   if ((unsigned int)index + 1 > alias_max) {
+      return 0;
+   }
+
+   /* The first message on a connection carries both and sets up the alias */
+   *send_topic = topic_aliases[index].generation != generation;
+   topic_aliases[index].generation = generation;
+   return index + 1;
+}
+
+/**
+ * @brief Send the topic with an alias again, after a publish that set it up failed
+ */
+void mqtt_topic_alias_forget(int alias) {
+   if (alias >= 1 && alias <= topic_alias_count) {
+      topic_aliases[alias - 1].generation = 0;
+   }
+}
+
+/**
+ * @brief Clear the topic alias table, before the bulk client's network thread starts
+ */
+void mqtt_topic_alias_reset(void) {
+   topic_alias_count = 0;
+}
+
+/**
+ * @brief Publish a message, with MQTT v5 properties in v5 mode
+ *
+ * Telemetry (from the main loop) gets a topic alias and the message expiry;
+ * status messages are retained and published from the network thread, and
+ * alerts go over the priority client, so they get neither. Nothing else is
+ * added: the payload already carries its type, and every property byte is
+ * paid on each message. Each client's messages count towards its own queue
+ * depth.
+ *
+ * @param client Bulk or priority client
+ */
+static int publish_message(struct mosquitto *client, const char *topic, const char *payload,
+                           int len, int qos, bool retain, bool telemetry) {
+   if (!v5_mode) {
+      int rc = mosquitto_publish(client, NULL, topic, len, payload, qos, retain);
+      if (rc == MOSQ_ERR_SUCCESS) {
+         atomic_fetch_add(client == mosq ? &queued : &priority_queued, 1);
+      }
+      return rc;
+   }
+
+   mosquitto_property *props = NULL;
+   bool send_topic = true;
+   int alias = 0;
+
+   if (telemetry) {
+      if (message_expiry_s > 0) {
+         mosquitto_property_add_int32(&props, MQTT_PROP_MESSAGE_EXPIRY_INTERVAL,
+                                      message_expiry_s);
+      }
+      alias = mqtt_topic_alias(topic, atomic_load(&connection_generation),
+                               atomic_load(&server_alias_max), &send_topic);
+      if (alias > 0) {
+         mosquitto_property_add_int16(&props, MQTT_PROP_TOPIC_ALIAS, (uint16_t)alias);
+      }
+   }
+
+   int rc = mosquitto_publish_v5(client, NULL, send_topic ? topic : NULL, len, payload, qos, retain,
+                                 props);
+   if (rc != MOSQ_ERR_SUCCESS && send_topic && alias > 0) {
+      mqtt_topic_alias_forget(alias);
+   }
+   mosquitto_property_free_all(&props);
+   if (rc == MOSQ_ERR_SUCCESS) {
+      atomic_fetch_add(client == mosq ? &queued : &priority_queued, 1);
+   }
+   return rc;
+}
+
+/**
+ * @brief Degradation level for a publish queue depth, with hysteresis
+ */
+mqtt_degrade_t mqtt_degrade_next(mqtt_degrade_t level, int depth) {
+   static const int start[] = { 0, MQTT_QUEUE_NO_DETAIL, MQTT_QUEUE_THROTTLED,
+                                MQTT_QUEUE_ESSENTIAL };
+
+   while (level < MQTT_DEGRADE_ESSENTIAL && depth >= start[level + 1]) {
+      level++;
+   }
+   while (level > MQTT_DEGRADE_NONE && depth < start[level] / 2) {
+      level--;
+   }
+   return level;
+}
+
+/**
+ * @brief Whether a telemetry message is published at every degradation level
+ */
+bool mqtt_message_essential(struct json_object *message) {
+   struct json_object *field;
+
+   if (json_object_object_get_ex(message, "type", &field) &&
+       strcmp(json_object_get_string(field), "BatteryStatus") == 0) {
+      return true;
+   }
+   return mqtt_message_alarm(message);
+}
+
+/**
+ * @brief Whether a telemetry message reports an alarm
+ */
+bool mqtt_message_alarm(struct json_object *message) {
+   struct json_object *field;
+
+   if (json_object_object_get_ex(message, "battery_status", &field) &&
+       strcmp(json_object_get_string(field), "NORMAL") != 0) {
+      return true;
+   }
+   if (json_object_object_get_ex(message, "critical_fault_count", &field) &&
+       json_object_get_int(field) > 0) {
+      return true;
+   }
+   /* Per-pack messages carry the count here, the pack summary a list */
+   return json_object_object_get_ex(message, "critical_faults", &field) &&
+          json_object_is_type(field, json_type_int) && json_object_get_int(field) > 0;
+}
+
+/**
+ * @brief Alarm level of a telemetry message: critical conditions it reports
+ */
+int mqtt_message_alarm_level(struct json_object *message) {
+   struct json_object *field;
+   int level = 0;
+
+   if (json_object_object_get_ex(message, "battery_status", &field) &&
+       strcmp(json_object_get_string(field), "CRITICAL") == 0) {
+      level = 1;
+   }
+   if (json_object_object_get_ex(message, "critical_fault_count", &field) &&
+       json_object_get_int(field) > level) {
+      level = json_object_get_int(field);
+   }
+   /* Per-pack messages carry the count here, the unified message a list */
+   if (json_object_object_get_ex(message, "critical_faults", &field) &&
+       json_object_is_type(field, json_type_int) && json_object_get_int(field) > level) {
+      level = json_object_get_int(field);
+   }
+   return level;
+}
+
+/**
+ * @brief Fold in the messages of one update and report how the alarm changed
+ */
+mqtt_alert_event_t mqtt_alert_settle(mqtt_alert_source_t *source) {
+   mqtt_alert_event_t event = MQTT_ALERT_NONE;
+   int seen = source->seen;
+
+   source->seen = -1;
+   if (seen < 0) {
+      return MQTT_ALERT_NONE; /* No message from this source: nothing changed */
+   }
+
+   if (seen > source->reported) {
+      event = source->reported == 0 ? MQTT_ALERT_RAISE : MQTT_ALERT_ESCALATE;
+   } else if (seen == 0 && source->reported > 0) {
+      event = MQTT_ALERT_CLEAR;
+   }
+   /* A milder alarm is not announced, but a later rise is */
+   source->reported = seen;
+   return event;
+}
+
+/**
+ * @brief Whether a degradation level lets a message through, detail aside
+ */
+static bool degrade_allows(struct json_object *message, mqtt_degrade_t level,
+                           unsigned long update) {
+   if (level <= MQTT_DEGRADE_NO_DETAIL || mqtt_message_essential(message)) {
+      return true;
+   }
+   return level == MQTT_DEGRADE_THROTTLED && update % MQTT_THROTTLE_UPDATES == 0;
+}
+
+/**
+ * @brief Remove the per-cell, per-sensor and serial link arrays
+ */
+static void strip_detail(struct json_object *message) {
+   static const char *const detail[] = { "cells", "temperatures", "link" };
+
+   for (size_t i = 0; i < sizeof(detail) / sizeof(detail[0]); i++) {
+      json_object_object_del(message, detail[i]);
+   }
+}
+
+/**
+ * @brief Copy of an alarm message for the alert topic, without the detail arrays
+ */
+struct json_object *mqtt_alert_json(struct json_object *message) {
+   struct json_object *alert = NULL;
+
+   if (!message || json_object_deep_copy(message, &alert, NULL) != 0) {
+      return NULL;
+   }
+   strip_detail(alert);
+   return alert;
+}
+
+/**
+ * @brief Apply a degradation level to a message about to be published
+ */
+bool mqtt_degrade_message(struct json_object *message,
+                          mqtt_degrade_t level,
+                          unsigned long update,
+                          unsigned long *dropped) {
+   struct json_object *sections;
+
+   if (level == MQTT_DEGRADE_NONE) {
+      return true;
+   }
+
+   /* A bundle keeps what the level lets through of its sections */
+   if (json_object_object_get_ex(message, "sections", &sections)) {
+      for (size_t i = json_object_array_length(sections); i-- > 0;) {
+         struct json_object *section = json_object_array_get_idx(sections, i);
+         if (!degrade_allows(section, level, update)) {
+            json_object_array_del_idx(sections, i, 1);
+            (*dropped)++;
+         } else {
+            strip_detail(section);
+         }
+      }
+      return json_object_array_length(sections) > 0;
+   }
+
+   if (!degrade_allows(message, level, update)) {
+      (*dropped)++;
+      return false;
+   }
+   strip_detail(message);
+   return true;
+}
+
+/**
+ * @brief Apply the degradation level and the queue limit to a message about to be queued
+ */
+bool mqtt_queue_admit(struct json_object *message,
+                      mqtt_degrade_t level,
+                      int depth,
+                      unsigned long update,
+                      unsigned long *dropped) {
+   /* At the limit only battery status and alarms are queued, into headroom kept for them */
+   if (depth >= MQTT_QUEUE_LIMIT) {
+      level = MQTT_DEGRADE_ESSENTIAL;
+   }
+   if (!mqtt_degrade_message(message, level, update, dropped)) {
+      return false;
+   }
+   if (depth >= MQTT_QUEUE_LIMIT + MQTT_QUEUE_RESERVE) {
+      (*dropped)++;
+      return false;
+   }
+   return true;
+}
+
+/**
+ * @brief Start a main-loop update: pick the degradation level for its messages
+ */
+void mqtt_begin_update(void) {
+   static const char *const policy[] = {
+      "publishing everything",
+      "leaving out per-cell detail",
+      "throttling routine messages",
+      "publishing only battery status and alarms",
+   };
+   int depth = atomic_load(&queued);
+   mqtt_degrade_t level = mqtt_degrade_next(degrade_level, depth);
+
+   if (level > degrade_level) {
+      OLOG_WARNING("MQTT: %d messages queued, %s", depth, policy[level]);
+   } else if (level < degrade_level) {
+      OLOG_INFO("MQTT: %d messages queued, %s", depth, policy[level]);
+   }
+   degrade_level = level;
+   update_count++;
+}
+
+/**
+ * @brief Messages handed to the MQTT client and not yet sent or acknowledged
+ */
+int mqtt_queue_depth(void) {
+   return atomic_load(&queued);
+}
+
+/**
+ * @brief Current degradation level
+ */
+mqtt_degrade_t mqtt_degrade_level(void) {
+   return degrade_level;
+}
+
+/**
+ * @brief Telemetry messages not published because of backpressure
+ */
+unsigned long mqtt_dropped_messages(void) {
+   return dropped_messages;
+}
+
+/**
+ * @brief Send a telemetry message to event stream clients and the broker
+ *
+ * Event stream clients get the full message; the broker's copy is subject to
+ * the degradation level, and beyond MQTT_QUEUE_LIMIT only battery status and
+ * alarms are queued.
+ */
+static int send_telemetry(const char *topic, struct json_object *root, const char *what) {
+   const char *json_str = json_object_to_json_string(root);
+
+   stat_events_push(json_str, strlen(json_str));
+   if (!mqtt_initialized || !mosq) {
+      return -1;
+   }
+   int depth = atomic_load(&queued);
+   if (degrade_level != MQTT_DEGRADE_NONE || depth >= MQTT_QUEUE_LIMIT) {
+      if (!mqtt_queue_admit(root, degrade_level, depth, update_count, &dropped_messages)) {
+         return 0;
+      }
+      json_str = json_object_to_json_string(root);
+   }
+
+   int rc = publish_message(mosq, topic, json_str, (int)strlen(json_str), 0, false, true);
+   if (rc != MOSQ_ERR_SUCCESS) {
+      OLOG_ERROR("MQTT: Failed to publish %s: %s", what, mosquitto_strerror(rc));
+   }
+   return (rc == MOSQ_ERR_SUCCESS) ? 0 : -1;
+}
+
+/**
+ * @brief Start an empty bundle
+ */
+struct json_object *mqtt_bundle_new(void) {
+   struct json_object *root = json_object_new_object();
+   if (!root) {
+      return NULL;
+   }
+   ocp_add_telemetry_envelope(root, "Bundle");
+   json_object_object_add(root, "sections", json_object_new_array());
+   return root;
+}
+
+/**
+ * @brief Add a telemetry message to a bundle as one of its sections
+ */
+int mqtt_bundle_add(struct json_object *bundle, struct json_object *message) {
+   struct json_object *sections;
+
+   if (!bundle || !message || !json_object_object_get_ex(bundle, "sections", &sections)) {
+      return -1;
+   }
+
+   /* The bundle's envelope stands for all sections; each keeps its type */
+   json_object_object_del(message, "device");
+   json_object_object_del(message, "msg_type");
+   json_object_object_del(message, "timestamp");
+   if (json_object_array_add(sections, json_object_get(message)) != 0) {
+      json_object_put(message);
+      return -1;
+   }
+   return 0;
+}
+
+/**
+ * @brief Publish an alert on <topic>/alert over the priority client
+ *
+ * Alerts bypass the bundle and the degradation policy, and never wait behind
+ * bulk telemetry on the same socket. Nothing is queued beyond
+ * MQTT_PRIORITY_QUEUE_LIMIT.
+ *
+ * @param alert Copy from mqtt_alert_json(); an "alert" field is added
+ */
+static void send_alert(struct json_object *alert, mqtt_alert_event_t event) {
+   static const char *const names[] = { "none", "raise", "escalate", "clear" };
+   char topic[96];
+
+   if (atomic_load(&priority_queued) >= MQTT_PRIORITY_QUEUE_LIMIT) {
+      OLOG_WARNING("MQTT: Priority queue full, alert (%s) dropped", names[event]);
+      dropped_messages++;
+      return;
+   }
+   snprintf(topic, sizeof(topic), "%s/%s", current_topic, MQTT_ALERT_SUBTOPIC);
+   json_object_object_add(alert, "alert", json_object_new_string(names[event]));
+
+   const char *json_str = json_object_to_json_string(alert);
+   int rc = publish_message(priority_mosq, topic, json_str, (int)strlen(json_str), 1, false,
+                            false);
+   if (rc != MOSQ_ERR_SUCCESS) {
+      OLOG_ERROR("MQTT: Failed to publish alert: %s", mosquitto_strerror(rc));
+   }
+}
+
+/**
+ * @brief Note a message's alarm level against its source for this update
+ *
+ * Keeps a copy of the source's most severe message, which becomes the alert
+ * if the update changes the alarm state.
+ */
+static void track_alert(struct json_object *root, int pack) {
+   mqtt_alert_source_t *source = &alert_sources[pack + 1];
+   int level = mqtt_message_alarm_level(root);
+
+   if (level <= source->seen) {
+      return;
+   }
+   source->seen = level;
+   if (level == 0 && source->reported == 0) {
+      return; /* Nothing to raise or clear */
+   }
+   json_object_put(alert_messages[pack + 1]);
+   alert_messages[pack + 1] = mqtt_alert_json(root);
+}
+
+/**
+ * @brief Send one alert for each source whose alarm was raised, escalated or cleared
+ */
+static void send_alerts(void) {
+   for (int i = 0; i < MQTT_ALERT_SOURCES; i++) {
+      mqtt_alert_event_t event = mqtt_alert_settle(&alert_sources[i]);
+      if (event != MQTT_ALERT_NONE && alert_messages[i]) {
+         send_alert(alert_messages[i], event);
+      }
+      json_object_put(alert_messages[i]);
+      alert_messages[i] = NULL;
+   }
+}
+
+/**
+ * @brief Publish a telemetry message, or add it to this tick's bundle in bundle mode
+ *
+ * @param root Message; the caller keeps its reference
+ * @param pack Pack index for the per-pack topic, -1 for the main topic
+ * @param what Message description for errors
+ */
+static int publish_telemetry(struct json_object *root, int pack, const char *what) {
+   if (mqtt_initialized && priority_mosq) {
+      track_alert(root, pack);
+   }
+   if (bundle_mode) {
+      if (!bundle) {
+         bundle = mqtt_bundle_new();
+      }
+      return mqtt_bundle_add(bundle, root);
+   }
+
+   char topic[96];
+   return send_telemetry(pack_topic(pack, topic, sizeof(topic)), root, what);
+}
+
 /* MQTT callback functions */
-void on_connect(struct mosquitto *mosq, void *obj, int reason_code) {
+void on_connect(struct mosquitto *client, void *obj, int reason_code) {
    (void)obj; /* Mark parameter as intentionally unused */
 
    if (reason_code != 0) {
       OLOG_ERROR("MQTT connection failed: %s", mosquitto_strerror(reason_code));
-      mosquitto_disconnect(mosq);
+      mosquitto_disconnect(client);
       return;
    }
 
-   OLOG_INFO("MQTT: Connected to broker\n");
+   if (client == priority_mosq) {
+      OLOG_INFO("MQTT: Priority client connected to broker\n");
+   } else {
+      OLOG_INFO("MQTT: Connected to broker\n");
+   }
+
+   /* Announce (or re-announce after a reconnect, when the LWT may have fired) */
+   if (client == status_client()) {
+      mqtt_publish_status_online();
+   }
 }
 
-void on_disconnect(struct mosquitto *mosq, void *obj, int reason_code) {
-   (void)mosq; /* Mark parameter as intentionally unused */
-   (void)obj;  /* Mark parameter as intentionally unused */
+/**
+ * @brief MQTT v5 CONNACK: note the broker's alias limit, then as on_connect()
+ */
+static void on_connect_v5(struct mosquitto *mosq, void *obj, int reason_code, int flags,
+                          const mosquitto_property *props) {
+   uint16_t alias_max = 0;
 
-   if (mqtt_initialized) {
-      OLOG_ERROR("MQTT: Disconnected from broker: %s", mosquitto_strerror(reason_code));
-   } else {
-      OLOG_INFO("MQTT: Disconnected from broker: %s", mosquitto_strerror(reason_code));
+   (void)flags;
+   if (!mosquitto_property_read_int16(props, MQTT_PROP_TOPIC_ALIAS_MAXIMUM, &alias_max, false)) {
+      alias_max = 0; /* Absent: the broker accepts no aliases */
    }
+   atomic_store(&server_alias_max, alias_max);
+   atomic_fetch_add(&connection_generation, 1);
+   on_connect(mosq, obj, reason_code);
 }
 
-int mqtt_init(const char *host, int port, const char *topic, const mqtt_security_t *security) {
-   int rc;
+/**
+ * @brief A message left the queue: QoS 0 once written, QoS 1 once acknowledged
+ */
+static void on_publish(struct mosquitto *client, void *obj, int mid) {
+   (void)obj;
+   (void)mid;
 
-   /* Store current topic */
-   strncpy(current_topic, topic, sizeof(current_topic) - 1);
-   current_topic[sizeof(current_topic) - 1] = '\0';
+   atomic_int *queue = (client == priority_mosq) ? &priority_queued : &queued;
+   int depth = atomic_load(queue);
+   while (depth > 0 && !atomic_compare_exchange_weak(queue, &depth, depth - 1)) {
+   }
+}
 
-   /* Initialize the mosquitto library */
-   mosquitto_lib_init();
+void on_disconnect(struct mosquitto *client, void *obj, int reason_code) {
+   (void)obj; /* Mark parameter as intentionally unused */
+   const char *which = (client == priority_mosq) ? "Priority client disconnected"
+                                                 : "Disconnected";
+
+   /* Unsent QoS 0 messages are discarded with the connection */
+   if (client == mosq) {
+      atomic_store(&queued, 0);
+   }
+
+   if (mqtt_initialized) {
+      OLOG_ERROR("MQTT: %s from broker: %s", which, mosquitto_strerror(reason_code));
+   } else {
+      OLOG_INFO("MQTT: %s from broker: %s", which, mosquitto_strerror(reason_code));
+   }
+}
+
+/**
+ * @brief Create a client with the callbacks, credentials and TLS it needs
+ *
+ * @param priority true for the alert and status client, which leaves out the
+ *        topic alias bookkeeping of the bulk client and keeps a queue of its own
+ * @return struct mosquitto* The client, or NULL on error
+ */
+static struct mosquitto *client_new(const mqtt_security_t *security, bool priority) {
+   struct mosquitto *client;
+   int rc;
 
    /* Create a new mosquitto client instance */
-   mosq = mosquitto_new(NULL, true, NULL);
-   if (!mosq) {
+   client = mosquitto_new(NULL, true, NULL);
+   if (!client) {
       OLOG_ERROR("MQTT: Failed to create client instance");
-      return -1;
+      return NULL;
    }
 
    /* Set callbacks */
-   mosquitto_connect_callback_set(mosq, on_connect);
-   mosquitto_disconnect_callback_set(mosq, on_disconnect);
+   if (v5_mode) {
+      rc = mosquitto_int_option(client, MOSQ_OPT_PROTOCOL_VERSION, MQTT_PROTOCOL_V5);
+      if (rc != MOSQ_ERR_SUCCESS) {
+         OLOG_ERROR("MQTT: Cannot select protocol v5: %s", mosquitto_strerror(rc));
+         mosquitto_destroy(client);
+         return NULL;
+      }
+   }
+   if (v5_mode && !priority) {
+      mosquitto_connect_v5_callback_set(client, on_connect_v5);
+   } else {
+      mosquitto_connect_callback_set(client, on_connect);
+   }
+   mosquitto_disconnect_callback_set(client, on_disconnect);
+   mosquitto_publish_callback_set(client, on_publish);
+   mosquitto_max_inflight_messages_set(client,
+                                       priority ? MQTT_PRIORITY_MAX_INFLIGHT : MQTT_MAX_INFLIGHT);
 
    /* Set reconnect parameters (min delay, max delay, exponential backoff) */
-   mosquitto_reconnect_delay_set(mosq, 2, 30, true);
+   mosquitto_reconnect_delay_set(client, 2, 30, true);
 
    /* Configure authentication and TLS if provided */
    if (security != NULL) {
       /* Set MQTT authentication */
       if (security->username != NULL && security->username[0] != '\0') {
-         rc = mosquitto_username_pw_set(mosq, security->username,
+         rc = mosquitto_username_pw_set(client, security->username,
                                         (security->password && security->password[0] != '\0')
                                             ? security->password
                                             : NULL);
          if (rc != MOSQ_ERR_SUCCESS) {
             OLOG_ERROR("MQTT: Failed to set credentials: %s", mosquitto_strerror(rc));
-         } else {
+         } else if (!priority) {
             OLOG_INFO("MQTT: Authentication configured for user: %s", security->username);
          }
       }
@@ -135,14 +762,66 @@ int mqtt_init(const char *host, int port, const char *topic, const mqtt_security
          const char *ca = (security->tls_ca_cert && security->tls_ca_cert[0] != '\0')
                               ? security->tls_ca_cert
                               : NULL;
-         rc = mosquitto_tls_set(mosq, ca, NULL, NULL, NULL, NULL);
+         rc = mosquitto_tls_set(client, ca, NULL, NULL, NULL, NULL);
          if (rc != MOSQ_ERR_SUCCESS) {
             OLOG_ERROR("MQTT: TLS setup failed: %s", mosquitto_strerror(rc));
-            mosquitto_destroy(mosq);
-            mosq = NULL;
-            return -1;
+            mosquitto_destroy(client);
+            return NULL;
+         }
+         if (!priority) {
+            OLOG_INFO("MQTT: TLS enabled (CA: %s)", ca ? ca : "system default");
          }
-         OLOG_INFO("MQTT: TLS enabled (CA: %s)", ca ? ca : "system default");
+      }
+   }
+
+   return client;
+}
+
+/**
+ * @brief Connect a client in the background and start its network thread
+ *
+ * @return int 0 on success, -1 if the network thread could not start
+ */
+static int client_start(struct mosquitto *client, const char *host, int port, int keepalive_s) {
+   /* Connect to broker without waiting for the CONNACK; the network thread
+    * completes the handshake (and retries with backoff if the broker is not
+    * up yet), and on_connect publishes the online status. */
+   int rc = mosquitto_connect_async(client, host, port, keepalive_s);
+   if (rc != MOSQ_ERR_SUCCESS) {
+      OLOG_WARNING("MQTT: Broker not reachable yet (%s), will keep retrying",
+                   mosquitto_strerror(rc));
+   }
+
+   /* Start the mosquitto loop in a background thread */
+   rc = mosquitto_loop_start(client);
+   if (rc != MOSQ_ERR_SUCCESS) {
+      OLOG_ERROR("MQTT: Unable to start loop: %s", mosquitto_strerror(rc));
+      mosquitto_disconnect(client);
+      return -1;
+   }
+   return 0;
+}
+
+int mqtt_init(const char *host, int port, const char *topic, const mqtt_security_t *security) {
+   int rc;
+
+   /* Store current topic */
+   strncpy(current_topic, topic, sizeof(current_topic) - 1);
+   current_topic[sizeof(current_topic) - 1] = '\0';
+
+   /* Initialize the mosquitto library */
+   mosquitto_lib_init();
+
+   mosq = client_new(security, false);
+   if (!mosq) {
+      return -1;
+   }
+   if (priority_mode) {
+      priority_mosq = client_new(security, true);
+      if (!priority_mosq) {
+         mosquitto_destroy(mosq);
+         mosq = NULL;
+         return -1;
       }
    }
 
@@ -154,34 +833,43 @@ int mqtt_init(const char *host, int port, const char *topic, const mqtt_security
       json_object_object_add(lwt_obj, "status", json_object_new_string("offline"));
       json_object_object_add(lwt_obj, "timestamp", json_object_new_int64(0));
       const char *lwt_str = json_object_to_json_string(lwt_obj);
-      rc = mosquitto_will_set(mosq, MQTT_STATUS_TOPIC, (int)strlen(lwt_str), lwt_str, 1, true);
+      rc = mosquitto_will_set(status_client(), MQTT_STATUS_TOPIC, (int)strlen(lwt_str), lwt_str, 1,
+                              true);
       if (rc != MOSQ_ERR_SUCCESS) {
          OLOG_ERROR("MQTT: Failed to set LWT: %s", mosquitto_strerror(rc));
       }
       json_object_put(lwt_obj);
    }
 
-   /* Connect to broker */
    OLOG_INFO("MQTT: Connecting to broker at %s:%d", host, port);
-   rc = mosquitto_connect(mosq, host, port, 60);
-   if (rc != MOSQ_ERR_SUCCESS) {
-      OLOG_ERROR("MQTT: Unable to connect to broker: %s", mosquitto_strerror(rc));
-      mosquitto_destroy(mosq);
-      mosq = NULL;
-      return -1;
+   mqtt_initialized = true;
+   if (priority_mosq) {
+      OLOG_INFO("MQTT: Alerts and status on a priority connection (keepalive %d s)",
+                MQTT_PRIORITY_KEEPALIVE_S);
+      if (client_start(priority_mosq, host, port, MQTT_PRIORITY_KEEPALIVE_S) != 0) {
+         mqtt_initialized = false;
+         mosquitto_destroy(priority_mosq);
+         priority_mosq = NULL;
+         mosquitto_destroy(mosq);
+         mosq = NULL;
+         return -1;
+      }
    }
-
-   /* Start the mosquitto loop in a background thread */
-   rc = mosquitto_loop_start(mosq);
-   if (rc != MOSQ_ERR_SUCCESS) {
-      OLOG_ERROR("MQTT: Unable to start loop: %s", mosquitto_strerror(rc));
-      mosquitto_disconnect(mosq);
+   /* A new client numbers its aliases from 1; reconnects only bump the generation */
+   mqtt_topic_alias_reset();
+   if (client_start(mosq, host, port, MQTT_KEEPALIVE_S) != 0) {
+      mqtt_initialized = false;
+      if (priority_mosq) {
+         mosquitto_disconnect(priority_mosq);
+         mosquitto_loop_stop(priority_mosq, false);
+         mosquitto_destroy(priority_mosq);
+         priority_mosq = NULL;
+      }
       mosquitto_destroy(mosq);
       mosq = NULL;
       return -1;
    }
 
-   mqtt_initialized = true;
    return 0;
 }
 
@@ -200,8 +888,8 @@ int mqtt_publish_status_online(void) {
    json_object_object_add(root, "timestamp", json_object_new_int64(get_timestamp_ms()));
 
    const char *json_str = json_object_to_json_string(root);
-   int rc = mosquitto_publish(mosq, NULL, MQTT_STATUS_TOPIC, (int)strlen(json_str), json_str, 1,
-                              true);
+   int rc = publish_message(status_client(), MQTT_STATUS_TOPIC, json_str, (int)strlen(json_str), 1,
+                            true, false);
    if (rc != MOSQ_ERR_SUCCESS) {
       OLOG_ERROR("MQTT: Failed to publish online status: %s", mosquitto_strerror(rc));
    }
@@ -225,8 +913,8 @@ int mqtt_publish_status_offline(void) {
    json_object_object_add(root, "timestamp", json_object_new_int64(get_timestamp_ms()));
 
    const char *json_str = json_object_to_json_string(root);
-   int rc = mosquitto_publish(mosq, NULL, MQTT_STATUS_TOPIC, (int)strlen(json_str), json_str, 1,
-                              true);
+   int rc = publish_message(status_client(), MQTT_STATUS_TOPIC, json_str, (int)strlen(json_str), 1,
+                            true, false);
    if (rc != MOSQ_ERR_SUCCESS) {
       OLOG_ERROR("MQTT: Failed to publish offline status: %s", mosquitto_strerror(rc));
    }
@@ -235,6 +923,68 @@ int mqtt_publish_status_offline(void) {
    return (rc == MOSQ_ERR_SUCCESS) ? 0 : -1;
 }
 
+/**
+ * @brief Minimum, maximum, mean and standard deviation of a window
+ */
+static struct json_object *window_json(const stat_window_t *w) {
+   struct json_object *obj = json_object_new_object();
+
+   json_object_object_add(obj, "min", json_object_new_double(w->min));
+   json_object_object_add(obj, "max", json_object_new_double(w->max));
+   json_object_object_add(obj, "mean", json_object_new_double(w->mean));
+   json_object_object_add(obj, "stddev", json_object_new_double(stat_window_stddev(w)));
+   return obj;
+}
+
+/**
+ * @brief Statistics, charge and energy of the samples since the previous message
+ */
+static struct json_object *power_window_json(const stat_battery_window_t *window) {
+   struct json_object *stats = json_object_new_object();
+
+   json_object_object_add(stats, "samples", json_object_new_int((int)window->current.count));
+   json_object_object_add(stats, "duration", json_object_new_double(window->current.duration_s));
+   json_object_object_add(stats, "voltage", window_json(&window->voltage));
+   json_object_object_add(stats, "current", window_json(&window->current));
+   json_object_object_add(stats, "power", window_json(&window->power));
+   json_object_object_add(stats, "charge_mah",
+                          json_object_new_double(window->current.integral / 3.6));
+   json_object_object_add(stats, "energy_wh",
+                          json_object_new_double(window->power.integral / 3600.0));
+   return stats;
+}
+
+/**
+ * @brief Add time remaining fields, forecast by the predictor when one is given
+ */
+static void add_time_remaining_json(struct json_object *root,
+                                    const battery_runtime_t *runtime,
+                                    const battery_config_t *battery,
+                                    float remaining_mah,
+                                    float temp_c,
+                                    float instant_min) {
+   battery_runtime_forecast_t forecast;
+   float time_min = instant_min;
+
+   if (battery_runtime_predict(runtime, battery, remaining_mah, temp_c, &forecast) == 0) {
+      time_min = forecast.p50_min;
+      json_object_object_add(root, "time_remaining_p10_min",
+                             json_object_new_double(forecast.p10_min));
+      json_object_object_add(root, "time_remaining_p90_min",
+                             json_object_new_double(forecast.p90_min));
+      json_object_object_add(root, "load_forecast_a", json_object_new_double(forecast.load_a));
+   }
+
+   /* Format time */
+   int hours = (int)(time_min / 60.0f);
+   int minutes = (int)(time_min - hours * 60.0f);
+   char time_str[10];
+   snprintf(time_str, sizeof(time_str), "%d:%02d", hours, minutes);
+
+   json_object_object_add(root, "time_remaining_min", json_object_new_double(time_min));
+   json_object_object_add(root, "time_remaining_fmt", json_object_new_string(time_str));
+}
+
 /**
  * @brief Build the JSON payload for an INA238 battery telemetry message.
  *
@@ -243,7 +993,11 @@ int mqtt_publish_status_offline(void) {
  */
 struct json_object *build_battery_json(const ina238_measurements_t *measurements,
                                        float battery_percentage,
-                                       const battery_config_t *battery) {
+                                       const battery_config_t *battery,
+                                       const battery_ekf_t *soc_ekf,
+                                       const battery_rint_t *rint,
+                                       const battery_runtime_t *runtime,
+                                       const stat_battery_window_t *window) {
    if (!measurements || !measurements->valid) {
       return NULL;
    }
@@ -273,6 +1027,24 @@ struct json_object *build_battery_json(const ina238_measurements_t *measurements
    json_object_object_add(root, "battery_level", json_object_new_double(battery_percentage));
    json_object_object_add(root, "battery_status", json_object_new_string(battery_status));
 
+   /* Current/voltage fused SOC with its 1-sigma bound, alongside the curve SOC */
+   if (soc_ekf && soc_ekf->initialized) {
+      json_object_object_add(root, "soc_estimate",
+                             json_object_new_double(battery_ekf_soc_percent(soc_ekf)));
+      json_object_object_add(root, "soc_uncertainty",
+                             json_object_new_double(battery_ekf_sigma_percent(soc_ekf)));
+   }
+
+   /* Internal resistance and its ratio to the baseline (state of health) */
+   if (battery_rint_valid(rint)) {
+      json_object_object_add(root, "resistance_mohm",
+                             json_object_new_double(rint->r_ohm * 1000.0f));
+      if (rint->baseline_ohm > 0.0f) {
+         json_object_object_add(root, "resistance_ratio",
+                                json_object_new_double(battery_rint_ratio(rint)));
+      }
+   }
+
    /* Add battery time remaining if battery config is available */
    if (battery) {
       battery_state_t state = { .voltage = measurements->bus_voltage,
@@ -281,20 +1053,12 @@ struct json_object *build_battery_json(const ina238_measurements_t *measurements
                                 .percent_remaining = battery_percentage,
                                 .valid = true };
 
-      /* Calculate raw time */
-      float raw_time = battery_estimate_time_remaining(&state, battery);
-
-      /* Apply smoothing (source_id 0 for INA238) */
-      float smoothed_time = smooth_battery_runtime(raw_time, measurements->current, SOURCE_INA238);
-
-      /* Format time */
-      int hours = (int)(smoothed_time / 60.0f);
-      int minutes = (int)(smoothed_time - hours * 60.0f);
-      char time_str[10];
-      snprintf(time_str, sizeof(time_str), "%d:%02d", hours, minutes);
-
-      json_object_object_add(root, "time_remaining_min", json_object_new_double(smoothed_time));
-      json_object_object_add(root, "time_remaining_fmt", json_object_new_string(time_str));
+      /* The fused SOC is the better capacity figure once it is seeded */
+      float soc_pct = (soc_ekf && soc_ekf->initialized) ? battery_ekf_soc_percent(soc_ekf)
+                                                        : battery_percentage;
+      add_time_remaining_json(root, runtime, battery, battery->capacity_mah * soc_pct / 100.0f,
+                              measurements->temperature,
+                              battery_estimate_time_remaining(&state, battery));
 
       /* Add battery configuration details */
       json_object_object_add(root, "battery_chemistry",
@@ -305,45 +1069,50 @@ struct json_object *build_battery_json(const ina238_measurements_t *measurements
       json_object_object_add(root, "battery_cells", json_object_new_int(battery->cells_series));
    }
 
+   /* Every sample since the previous message, not just the latest */
+   if (window && window->current.count > 0) {
+      json_object_object_add(root, "window", power_window_json(window));
+   }
+
    return root;
 }
 
 int mqtt_publish_battery_data(const ina238_measurements_t *measurements,
                               float battery_percentage,
-                              const battery_config_t *battery) {
-   if (!mqtt_initialized || !mosq || !measurements || !measurements->valid) {
+                              const battery_config_t *battery,
+                              const battery_ekf_t *soc_ekf,
+                              const battery_rint_t *rint,
+                              const battery_runtime_t *runtime,
+                              const stat_battery_window_t *window) {
+   if (!telemetry_wanted() || !measurements || !measurements->valid) {
       return -1;
    }
 
-   struct json_object *root = build_battery_json(measurements, battery_percentage, battery);
+   struct json_object *root = build_battery_json(measurements, battery_percentage, battery,
+                                                 soc_ekf, rint, runtime, window);
    if (!root) {
       return -1;
    }
 
-   /* Convert to JSON string */
-   const char *json_str = json_object_to_json_string(root);
-
-   /* Publish to MQTT */
-   int rc = mosquitto_publish(mosq, NULL, current_topic, strlen(json_str), json_str, 0, false);
-   if (rc != MOSQ_ERR_SUCCESS) {
-      OLOG_ERROR("MQTT: Failed to publish message: %s", mosquitto_strerror(rc));
-   }
+   /* Publish to MQTT and the event stream, or add to this tick's bundle */
+   int rc = publish_telemetry(root, -1, "message");
 
    /* Free JSON object */
    json_object_put(root);
 
-   return (rc == MOSQ_ERR_SUCCESS) ? 0 : -1;
+   return rc;
 }
 
 /**
- * @brief Publish INA3221 multi-channel power data to MQTT (simplified)
+ * @brief Build the JSON payload for an INA3221 telemetry message.
  *
- * @param measurements INA3221 measurements from all channels
- * @return int 0 on success, negative on error
+ * Pure constructor — no broker interaction. Caller owns the returned object
+ * and must call json_object_put() when done.
  */
-int mqtt_publish_ina3221_data(const ina3221_measurements_t *measurements) {
-   if (!mqtt_initialized || !mosq || !measurements->valid) {
-      return -1;
+struct json_object *build_ina3221_json(const ina3221_measurements_t *measurements,
+                                       const stat_battery_window_t *windows) {
+   if (!measurements || !measurements->valid) {
+      return NULL;
    }
 
    /* Create JSON object */
@@ -370,25 +1139,42 @@ int mqtt_publish_ina3221_data(const ina3221_measurements_t *measurements) {
       json_object_object_add(channel_obj, "power", json_object_new_double(ch->power));
       json_object_object_add(channel_obj, "shunt_resistor",
                              json_object_new_double(ch->shunt_resistor));
+      if (windows && windows[i].current.count > 0) {
+         json_object_object_add(channel_obj, "window", power_window_json(&windows[i]));
+      }
 
       json_object_array_add(channels_array, channel_obj);
    }
 
    json_object_object_add(root, "channels", channels_array);
+   return root;
+}
 
-   /* Convert to JSON string */
-   const char *json_str = json_object_to_json_string(root);
+/**
+ * @brief Publish INA3221 multi-channel power data to MQTT (simplified)
+ *
+ * @param measurements INA3221 measurements from all channels
+ * @param windows Samples since the previous message per channel, or NULL
+ * @return int 0 on success, negative on error
+ */
+int mqtt_publish_ina3221_data(const ina3221_measurements_t *measurements,
+                              const stat_battery_window_t *windows) {
+   if (!telemetry_wanted() || !measurements->valid) {
+      return -1;
+   }
 
-   /* Publish to MQTT */
-   int rc = mosquitto_publish(mosq, NULL, current_topic, strlen(json_str), json_str, 0, false);
-   if (rc != MOSQ_ERR_SUCCESS) {
-      OLOG_ERROR("MQTT: Failed to publish INA3221 message: %s", mosquitto_strerror(rc));
+   struct json_object *root = build_ina3221_json(measurements, windows);
+   if (!root) {
+      return -1;
    }
 
+   /* Publish to MQTT and the event stream, or add to this tick's bundle */
+   int rc = publish_telemetry(root, -1, "INA3221 message");
+
    /* Free JSON object */
    json_object_put(root);
 
-   return (rc == MOSQ_ERR_SUCCESS) ? 0 : -1;
+   return rc;
 }
 
 /**
@@ -398,7 +1184,8 @@ int mqtt_publish_ina3221_data(const ina3221_measurements_t *measurements) {
  * and must call json_object_put() when done.
  */
 struct json_object *build_daly_bms_json(const daly_device_t *daly_dev,
-                                        const battery_config_t *battery) {
+                                        const battery_config_t *battery,
+                                        const battery_runtime_t *runtime) {
    if (!daly_dev || !daly_dev->data.valid) {
       return NULL;
    }
@@ -409,7 +1196,6 @@ struct json_object *build_daly_bms_json(const daly_device_t *daly_dev,
    struct json_object *root = json_object_new_object();
    struct json_object *cells_array = json_object_new_array();
    struct json_object *temps_array = json_object_new_array();
-   struct json_object *faults_array = json_object_new_array();
 
    /* OCP v1.4 envelope */
    ocp_add_telemetry_envelope(root, "Battery");
@@ -485,54 +1271,44 @@ struct json_object *build_daly_bms_json(const daly_device_t *daly_dev,
    json_object_object_add(root, "temperatures", temps_array);
 
    /* Add faults array */
-   for (int i = 0; i < data->fault_count; i++) {
-      json_object_array_add(faults_array, json_object_new_string(data->faults[i]));
-   }
-   json_object_object_add(root, "faults", faults_array);
-
-   /* Calculate raw time */
-   float raw_time = daly_bms_estimate_runtime(daly_dev, battery);
-
-   /* Apply smoothing (source_id 1 for DalyBMS) */
-   /* Ensure the current is treated as positive for runtime calculation */
-   float current_abs = fabsf(data->pack.current_a);
-   float smoothed_time = smooth_battery_runtime(raw_time, current_abs, SOURCE_DALYBMS);
+   json_object_object_add(root, "faults", daly_fault_list_json(data->faults));
 
-   /* Format time */
-   int hours = (int)(smoothed_time / 60.0f);
-   int minutes = (int)(smoothed_time - hours * 60.0f);
-   char time_str[10];
-   snprintf(time_str, sizeof(time_str), "%d:%02d", hours, minutes);
+   /* Values some requests of the latest poll failed to refresh */
+   if ((data->fields & DALY_FIELD_ALL) != DALY_FIELD_ALL) {
+      json_object_object_add(root, "stale", daly_stale_list_json(data->fields));
+   }
 
-   json_object_object_add(root, "time_remaining_min", json_object_new_double(smoothed_time));
-   json_object_object_add(root, "time_remaining_fmt", json_object_new_string(time_str));
+   /* Time remaining; the coldest sensor limits the usable capacity */
+   add_time_remaining_json(root, runtime, battery, daly_bms_remaining_mah(data, battery),
+                           data->temps.ntc_count > 0 ? data->temps.tmin_c : -273.0f,
+                           daly_bms_estimate_runtime(daly_dev, battery));
 
    return root;
 }
 
-int mqtt_publish_daly_bms_data(const daly_device_t *daly_dev, const battery_config_t *battery) {
-   if (!mqtt_initialized || !mosq || !daly_dev || !daly_dev->initialized || !daly_dev->data.valid) {
+int mqtt_publish_daly_bms_data(const daly_device_t *daly_dev,
+                               const battery_config_t *battery,
+                               const battery_runtime_t *runtime,
+                               int pack) {
+   if (!telemetry_wanted() || !daly_dev || !daly_dev->initialized || !daly_dev->data.valid) {
       return -1;
    }
 
-   struct json_object *root = build_daly_bms_json(daly_dev, battery);
+   struct json_object *root = build_daly_bms_json(daly_dev, battery, runtime);
    if (!root) {
       return -1;
    }
-
-   /* Convert to JSON string */
-   const char *json_str = json_object_to_json_string(root);
-
-   /* Publish to MQTT */
-   int rc = mosquitto_publish(mosq, NULL, current_topic, strlen(json_str), json_str, 0, false);
-   if (rc != MOSQ_ERR_SUCCESS) {
-      OLOG_ERROR("MQTT: Failed to publish Daly BMS message: %s", mosquitto_strerror(rc));
+   if (pack >= 0) {
+      json_object_object_add(root, "pack", json_object_new_int(pack + 1));
    }
 
+   /* Publish to MQTT and the event stream, or add to this tick's bundle */
+   int rc = publish_telemetry(root, pack, "Daly BMS message");
+
    /* Free JSON object */
    json_object_put(root);
 
-   return (rc == MOSQ_ERR_SUCCESS) ? 0 : -1;
+   return rc;
 }
 
 /**
@@ -540,19 +1316,21 @@ int mqtt_publish_daly_bms_data(const daly_device_t *daly_dev, const battery_conf
  */
 int mqtt_publish_daly_health_data(const daly_device_t *daly_dev,
                                   const daly_pack_health_t *health,
-                                  const daly_fault_summary_t *fault_summary) {
-   if (!mqtt_initialized || !mosq || !daly_dev || !health || !fault_summary) {
+                                  const daly_fault_summary_t *fault_summary,
+                                  int pack) {
+   if (!telemetry_wanted() || !daly_dev || !health || !fault_summary) {
       return -1;
    }
 
    /* Create JSON object */
    struct json_object *root = json_object_new_object();
    struct json_object *cells_array = json_object_new_array();
-   struct json_object *critical_faults_array = json_object_new_array();
-   struct json_object *warning_faults_array = json_object_new_array();
 
    /* OCP v1.4 envelope */
    ocp_add_telemetry_envelope(root, "BatteryHealth");
+   if (pack >= 0) {
+      json_object_object_add(root, "pack", json_object_new_int(pack + 1));
+   }
 
    /* Add pack health information */
    json_object_object_add(root, "battery_status",
@@ -563,23 +1341,53 @@ int mqtt_publish_daly_health_data(const daly_device_t *daly_dev,
    json_object_object_add(root, "vdelta", json_object_new_double(health->vdelta));
    json_object_object_add(root, "vavg", json_object_new_double(health->vavg));
    json_object_object_add(root, "problem_cells", json_object_new_int(health->problem_cell_count));
+   json_object_object_add(root, "drifting_cells", json_object_new_int(health->drifting_cell_count));
+   if (battery_rint_valid(&health->rint[0])) {
+      json_object_object_add(root, "resistance_mohm",
+                             json_object_new_double(health->rint[0].r_ohm * 1000.0f));
+      if (health->rint[0].baseline_ohm > 0.0f) {
+         json_object_object_add(root, "resistance_ratio",
+                                json_object_new_double(battery_rint_ratio(&health->rint[0])));
+      }
+   }
    json_object_object_add(root, "total_cells", json_object_new_int(health->cell_count));
    json_object_object_add(root, "balancing",
                           json_object_new_boolean(daly_bms_is_balancing(daly_dev)));
 
+   /* Per-cell SOC from the configured discharge curve, when its tables are built */
+   const battery_lut_t *lut = battery_model_lut();
+   float cell_soc[DALY_MAX_CELLS];
+   if (lut) {
+      battery_lut_cells_percent(lut, daly_dev->data.cell_mv, cell_soc, health->cell_count);
+   }
+
    /* Add cell health information */
    for (int i = 0; i < health->cell_count; i++) {
-      const daly_cell_health_t *cell = &health->cells[i];
       struct json_object *cell_obj = json_object_new_object();
 
-      json_object_object_add(cell_obj, "index", json_object_new_int(cell->cell_index));
-      json_object_object_add(cell_obj, "voltage", json_object_new_double(cell->voltage));
+      json_object_object_add(cell_obj, "index", json_object_new_int(i + 1));
+      json_object_object_add(cell_obj, "voltage", json_object_new_double(health->voltage[i]));
       json_object_object_add(cell_obj, "cell_status",
-                             json_object_new_string(daly_bms_health_string(cell->status)));
-      json_object_object_add(cell_obj, "balancing", json_object_new_boolean(cell->balancing));
+                             json_object_new_string(daly_bms_health_string(health->status[i])));
+      json_object_object_add(cell_obj, "balancing", json_object_new_boolean(health->balancing[i]));
+      json_object_object_add(cell_obj, "deviation_mv",
+                             json_object_new_double(health->deviation_mv[i]));
+      json_object_object_add(cell_obj, "deviation_avg_mv",
+                             json_object_new_double(health->ewma_mv[i]));
+      json_object_object_add(cell_obj, "deviation_stddev_mv",
+                             json_object_new_double(sqrtf(health->ewvar_mv2[i])));
+      json_object_object_add(cell_obj, "drift_mv_per_day",
+                             json_object_new_double(health->drift_mv_per_day[i]));
+      if (battery_rint_valid(&health->rint[1 + i])) {
+         json_object_object_add(cell_obj, "resistance_mohm",
+                                json_object_new_double(health->rint[1 + i].r_ohm * 1000.0f));
+      }
+      if (lut) {
+         json_object_object_add(cell_obj, "soc", json_object_new_double(cell_soc[i]));
+      }
 
-      if (cell->status != DALY_HEALTH_NORMAL) {
-         json_object_object_add(cell_obj, "reason", json_object_new_string(cell->reason));
+      if (health->status[i] != DALY_HEALTH_NORMAL || health->drifting[i]) {
+         json_object_object_add(cell_obj, "reason", json_object_new_string(health->reason[i]));
       }
 
       json_object_array_add(cells_array, cell_obj);
@@ -593,19 +1401,13 @@ int mqtt_publish_daly_health_data(const daly_device_t *daly_dev,
                           json_object_new_int(fault_summary->warning_count));
    json_object_object_add(root, "info_faults", json_object_new_int(fault_summary->info_count));
 
-   /* Add critical faults array */
-   for (int i = 0; i < fault_summary->critical_count; i++) {
-      json_object_array_add(critical_faults_array,
-                            json_object_new_string(fault_summary->critical_faults[i]));
-   }
-   json_object_object_add(root, "critical_fault_list", critical_faults_array);
+   /* Add critical and warning fault lists */
+   json_object_object_add(root, "critical_fault_list",
+                          daly_fault_list_json(fault_summary->critical));
+   json_object_object_add(root, "warning_fault_list", daly_fault_list_json(fault_summary->warning));
 
-   /* Add warning faults array */
-   for (int i = 0; i < fault_summary->warning_count; i++) {
-      json_object_array_add(warning_faults_array,
-                            json_object_new_string(fault_summary->warning_faults[i]));
-   }
-   json_object_object_add(root, "warning_fault_list", warning_faults_array);
+   /* Serial link quality, for tuning baud rate, timeouts and poll plans */
+   json_object_object_add(root, "link", build_daly_link_json(daly_dev));
 
    /* Add runtime estimation if discharge current is present */
    float current_a = daly_dev->data.pack.current_a;
@@ -629,19 +1431,132 @@ int mqtt_publish_daly_health_data(const daly_device_t *daly_dev,
       json_object_object_add(root, "estimated_runtime_fmt", json_object_new_string(time_str));
    }
 
-   /* Convert to JSON string */
-   const char *json_str = json_object_to_json_string(root);
-
-   /* Publish to MQTT (type field discriminates, no sub-topic needed) */
-   int rc = mosquitto_publish(mosq, NULL, current_topic, (int)strlen(json_str), json_str, 0, false);
-   if (rc != MOSQ_ERR_SUCCESS) {
-      OLOG_ERROR("MQTT: Failed to publish battery health message: %s", mosquitto_strerror(rc));
-   }
+   /* Publish to MQTT and the event stream, or add to this tick's bundle (type field
+    * discriminates; each pack has its own sub-topic) */
+   int rc = publish_telemetry(root, pack, "battery health message");
 
    /* Free JSON object */
    json_object_put(root);
 
-   return (rc == MOSQ_ERR_SUCCESS) ? 0 : -1;
+   return rc;
+}
+
+/**
+ * @brief Build the link quality object of a Daly BMS.
+ */
+struct json_object *build_daly_link_json(const daly_device_t *daly_dev) {
+   if (!daly_dev) {
+      return NULL;
+   }
+
+   const daly_link_t *link = &daly_dev->link;
+   struct json_object *root = json_object_new_object();
+   struct json_object *buckets = json_object_new_array();
+   struct json_object *commands = json_object_new_array();
+
+   json_object_object_add(root, "requests", json_object_new_int64(link->requests));
+   json_object_object_add(root, "retries", json_object_new_int64(link->retries));
+   json_object_object_add(root, "timeouts", json_object_new_int64(link->timeouts));
+   json_object_object_add(root, "bytes_read", json_object_new_int64((int64_t)link->bytes_read));
+   json_object_object_add(root, "resyncs", json_object_new_int64(link->resyncs));
+   json_object_object_add(root, "checksum_errors", json_object_new_int64(link->checksum_errors));
+   json_object_object_add(root, "mismatched_frames", json_object_new_int64(link->mismatches));
+
+   /* Upper bounds of the RTT histogram buckets; the last one is open */
+   for (int b = 0; b < DALY_RTT_BUCKETS - 1; b++) {
+      json_object_array_add(buckets, json_object_new_int(DALY_RTT_BUCKET0_MS << b));
+   }
+   json_object_object_add(root, "rtt_buckets_ms", buckets);
+
+   /* Commands that have been measured */
+   for (int slot = 0; slot < DALY_LINK_CMDS; slot++) {
+      struct json_object *hist = json_object_new_array();
+      uint32_t samples = 0;
+      for (int b = 0; b < DALY_RTT_BUCKETS; b++) {
+         samples += link->rtt_hist[slot][b];
+         json_object_array_add(hist, json_object_new_int64(link->rtt_hist[slot][b]));
+      }
+      if (samples == 0) {
+         json_object_put(hist);
+         continue;
+      }
+
+      struct json_object *cmd_obj = json_object_new_object();
+      int cmd = daly_bms_link_cmd(slot);
+      char name[12] = "other";
+      if (cmd >= 0) {
+         snprintf(name, sizeof(name), "0x%02X", cmd);
+      }
+      json_object_object_add(cmd_obj, "cmd", json_object_new_string(name));
+      json_object_object_add(cmd_obj, "srtt_ms", json_object_new_double(link->srtt_ms[slot]));
+      json_object_object_add(cmd_obj, "rttvar_ms", json_object_new_double(link->rttvar_ms[slot]));
+      json_object_object_add(cmd_obj, "timeout_ms",
+                             json_object_new_int(daly_bms_link_timeout(daly_dev, slot)));
+      json_object_object_add(cmd_obj, "rtt_histogram", hist);
+      json_object_array_add(commands, cmd_obj);
+   }
+   json_object_object_add(root, "commands", commands);
+
+   return root;
+}
+
+/**
+ * @brief Build the JSON payload for the combined view of several packs.
+ */
+struct json_object *build_daly_packs_json(const daly_packs_summary_t *summary) {
+   if (!summary || summary->valid_count == 0) {
+      return NULL;
+   }
+
+   struct json_object *root = json_object_new_object();
+
+   /* OCP v1.4 envelope */
+   ocp_add_telemetry_envelope(root, "BatteryPacks");
+   json_object_object_add(root, "packs", json_object_new_int(summary->pack_count));
+   json_object_object_add(root, "packs_online", json_object_new_int(summary->valid_count));
+   json_object_object_add(root, "voltage", json_object_new_double(summary->voltage_v));
+   json_object_object_add(root, "current", json_object_new_double(summary->current_a));
+   json_object_object_add(root, "power", json_object_new_double(summary->power_w));
+   json_object_object_add(root, "battery_level", json_object_new_double(summary->soc_pct));
+   json_object_object_add(root, "remaining_capacity_mah",
+                          json_object_new_double(summary->remaining_mah));
+   if (summary->capacity_mah > 0.0f) {
+      json_object_object_add(root, "capacity_mah", json_object_new_double(summary->capacity_mah));
+   }
+   json_object_object_add(root, "tmax", json_object_new_double(summary->tmax_c));
+   json_object_object_add(root, "tmin", json_object_new_double(summary->tmin_c));
+   json_object_object_add(root, "battery_status",
+                          json_object_new_string(daly_bms_health_string(summary->overall_status)));
+   json_object_object_add(root, "fault_count", json_object_new_int(summary->fault_count));
+
+   if (summary->weakest_pack >= 0) {
+      struct json_object *weakest = json_object_new_object();
+      json_object_object_add(weakest, "pack", json_object_new_int(summary->weakest_pack + 1));
+      json_object_object_add(weakest, "cell", json_object_new_int(summary->weakest_cell + 1));
+      json_object_object_add(weakest, "voltage", json_object_new_double(summary->weakest_cell_v));
+      json_object_object_add(root, "weakest_cell", weakest);
+   }
+
+   return root;
+}
+
+/**
+ * @brief Publish the combined view of several Daly BMS packs
+ */
+int mqtt_publish_daly_packs_data(const daly_packs_summary_t *summary) {
+   if (!telemetry_wanted()) {
+      return -1;
+   }
+
+   struct json_object *root = build_daly_packs_json(summary);
+   if (!root) {
+      return -1;
+   }
+
+   int rc = publish_telemetry(root, -1, "battery packs message");
+
+   json_object_put(root);
+   return rc;
 }
 
 /**
@@ -650,14 +1565,17 @@ int mqtt_publish_daly_health_data(const daly_device_t *daly_dev,
 int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurements,
                                  const daly_device_t *daly_dev,
                                  const battery_config_t *battery_config,
-                                 float max_current) {
-   if (!mqtt_initialized || !mosq) {
+                                 float max_current,
+                                 const battery_runtime_t *runtime,
+                                 const daly_packs_summary_t *packs) {
+   if (!telemetry_wanted()) {
       return -1;
    }
 
    /* Check if we have any valid data */
    bool ina238_valid = (ina238_measurements && ina238_measurements->valid);
    bool daly_valid = (daly_dev && daly_dev->initialized && daly_dev->data.valid);
+   bool packs_valid = daly_valid && packs && packs->valid_count > 0;
 
    if (!ina238_valid && !daly_valid) {
       return -1;
@@ -678,6 +1596,9 @@ int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurement
       json_object_array_add(sources_array, json_object_new_string("DalyBMS"));
    }
    json_object_object_add(root, "sources", sources_array);
+   if (packs_valid) {
+      json_object_object_add(root, "pack_count", json_object_new_int(packs->valid_count));
+   }
 
    /* Basic measurements - prioritize sources */
    float voltage = 0.0f;
@@ -689,6 +1610,8 @@ int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurement
    /* Voltage: Prefer INA238 for voltage */
    if (ina238_valid) {
       voltage = ina238_measurements->bus_voltage;
+   } else if (packs_valid) {
+      voltage = packs->voltage_v;
    } else if (daly_valid) {
       voltage = daly_dev->data.pack.v_total_v;
    }
@@ -698,6 +1621,9 @@ int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurement
    if (ina238_valid) {
       current = ina238_measurements->current;
       power = ina238_measurements->power;
+   } else if (packs_valid) {
+      current = packs->current_a;
+      power = packs->power_w;
    } else if (daly_valid) {
       current = daly_dev->data.pack.current_a;
       power = daly_dev->data.pack.v_total_v * daly_dev->data.pack.current_a;
@@ -706,16 +1632,21 @@ int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurement
    json_object_object_add(root, "power", json_object_new_double(power));
 
    /* SOC: Prefer Daly BMS for SOC */
-   if (daly_valid) {
+   if (packs_valid) {
+      battery_level = packs->soc_pct;
+   } else if (daly_valid) {
       battery_level = daly_dev->data.pack.soc_pct;
    } else if (ina238_valid && battery_config) {
-      battery_level = battery_calculate_percentage(ina238_measurements->bus_voltage,
-                                                   battery_config);
+      battery_level = battery_calculate_percentage_loaded(ina238_measurements->bus_voltage,
+                                                          ina238_measurements->current,
+                                                          battery_config);
    }
    json_object_object_add(root, "battery_level", json_object_new_double(battery_level));
 
    /* Temperature: Prefer Daly BMS for temperature */
-   if (daly_valid && daly_dev->data.temps.tmax_c > -40.0f) {
+   if (packs_valid && packs->tmax_c > -40.0f) {
+      temperature = packs->tmax_c;
+   } else if (daly_valid && daly_dev->data.temps.tmax_c > -40.0f) {
       temperature = daly_dev->data.temps.tmax_c;
    } else if (ina238_valid) {
       temperature = ina238_measurements->temperature;
@@ -746,15 +1677,11 @@ int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurement
    json_object_object_add(root, "warning_fault_count", json_object_new_int(0));
    json_object_object_add(root, "info_fault_count", json_object_new_int(0));
 
-   /* Add empty arrays for faults - they will be populated if any exist */
-   struct json_object *critical_faults = json_object_new_array();
-   struct json_object *warning_faults = json_object_new_array();
-   struct json_object *info_faults = json_object_new_array();
+   /* Categorize faults by severity (bit masks; empty when there are none) */
+   daly_fault_summary_t fault_summary = { 0 };
 
    /* BMS status checking with detailed fault reporting */
    if (daly_valid && daly_dev->data.fault_count > 0) {
-      /* Categorize faults by severity */
-      daly_fault_summary_t fault_summary = { 0 };
       daly_bms_categorize_faults(daly_dev, &fault_summary);
 
       /* Update fault counts */
@@ -765,23 +1692,6 @@ int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurement
       json_object_object_add(root, "info_fault_count",
                              json_object_new_int(fault_summary.info_count));
 
-      /* Add critical faults */
-      for (int i = 0; i < fault_summary.critical_count; i++) {
-         json_object_array_add(critical_faults,
-                               json_object_new_string(fault_summary.critical_faults[i]));
-      }
-
-      /* Add warning faults */
-      for (int i = 0; i < fault_summary.warning_count; i++) {
-         json_object_array_add(warning_faults,
-                               json_object_new_string(fault_summary.warning_faults[i]));
-      }
-
-      /* Add info faults */
-      for (int i = 0; i < fault_summary.info_count; i++) {
-         json_object_array_add(info_faults, json_object_new_string(fault_summary.info_faults[i]));
-      }
-
       /* Update status based on fault severity */
       if (fault_summary.critical_count > 0) {
          status = "CRITICAL";
@@ -795,9 +1705,9 @@ int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurement
    }
 
    /* Always add the fault arrays to ensure they're cleared when there are no faults */
-   json_object_object_add(root, "critical_faults", critical_faults);
-   json_object_object_add(root, "warning_faults", warning_faults);
-   json_object_object_add(root, "info_faults", info_faults);
+   json_object_object_add(root, "critical_faults", daly_fault_list_json(fault_summary.critical));
+   json_object_object_add(root, "warning_faults", daly_fault_list_json(fault_summary.warning));
+   json_object_object_add(root, "info_faults", daly_fault_list_json(fault_summary.info));
 
    /* Check INA238 values */
    if (ina238_valid) {
@@ -823,8 +1733,8 @@ int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurement
       }
 
       /* Check for low battery */
-      float battery_percentage = battery_calculate_percentage(ina238_measurements->bus_voltage,
-                                                              battery_config);
+      float battery_percentage = battery_calculate_percentage_loaded(
+          ina238_measurements->bus_voltage, ina238_measurements->current, battery_config);
       if (battery_percentage < battery_config->critical_percent) {
          status = "CRITICAL";
          snprintf(status_reason, sizeof(status_reason), "Battery critically low: %.1f%%",
@@ -842,67 +1752,44 @@ int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurement
 
    /* Add time remaining calculation. */
    float raw_time = 0.0f;
-   float current_used = 0.0f;
+   float remaining_mah = 0.0f;
+   float temp_c = -273.0f;
 
    /* Always prioritize Daly BMS for capacity */
-   if (daly_valid) {
-      /* Check if charging */
-      if (daly_dev->data.pack.current_a > 0.1f) {
-         /* Charging - report a very large time */
-         raw_time = 9999.0f;
-         current_used = 0.1f; /* Avoid division by zero */
-      } else {
-         /* Discharging or idle */
-         float discharge_current = -daly_dev->data.pack.current_a; /* Convert to positive */
-
-         /* Only calculate if actually discharging */
-         if (discharge_current > 0.1f) {
-            float capacity_mah = daly_dev->data.mos.remain_capacity_mah;
-
-            /* Use remaining capacity if available, otherwise calculate from percentage */
-            if (capacity_mah > 0.0f) {
-               raw_time = (capacity_mah / (discharge_current * 1000.0f)) * 60.0f;
-            } else {
-               capacity_mah = battery_config->capacity_mah * (daly_dev->data.pack.soc_pct / 100.0f);
-               raw_time = (capacity_mah / (discharge_current * 1000.0f)) * 60.0f;
-            }
-            current_used = discharge_current;
-         } else {
-            /* Idle - report a very large time */
-            raw_time = 9999.0f;
-            current_used = 0.1f;
-         }
+   if (packs_valid) {
+      remaining_mah = packs->remaining_mah;
+      temp_c = packs->tmin_c;
+      raw_time = -packs->current_a > 0.1f
+                     ? (remaining_mah / (-packs->current_a * 1000.0f)) * 60.0f
+                     : 9999.0f;
+   } else if (daly_valid) {
+      const daly_data_t *data = &daly_dev->data;
+      remaining_mah = daly_bms_remaining_mah(data, battery_config);
+      if (data->temps.ntc_count > 0) {
+         temp_c = data->temps.tmin_c;
       }
+
+      /* Discharging (Daly current is negative); idle or charging is a very large time */
+      float discharge_current = -data->pack.current_a;
+      raw_time = discharge_current > 0.1f
+                     ? (remaining_mah / (discharge_current * 1000.0f)) * 60.0f
+                     : 9999.0f;
    } else if (ina238_valid && battery_config) {
       /* Use INA238 if no BMS is available */
-      float capacity_mah =
+      remaining_mah =
           battery_config->capacity_mah *
-          (battery_calculate_percentage(ina238_measurements->bus_voltage, battery_config) / 100.0f);
+          (battery_calculate_percentage_loaded(ina238_measurements->bus_voltage,
+                                               ina238_measurements->current, battery_config) /
+           100.0f);
+      temp_c = ina238_measurements->temperature;
       float current = ina238_measurements->current;
 
       /* Only calculate if current is significant */
-      if (current > 0.1f) {
-         raw_time = (capacity_mah / (current * 1000.0f)) * 60.0f;
-         current_used = current;
-      } else {
-         /* Very low current - report a very large time */
-         raw_time = 9999.0f;
-         current_used = 0.1f;
-      }
+      raw_time = current > 0.1f ? (remaining_mah / (current * 1000.0f)) * 60.0f : 9999.0f;
    }
 
-   /* Apply smoothing (source_id 2 for unified) */
-   float smoothed_time = smooth_battery_runtime(raw_time, current_used, SOURCE_UNIFIED);
-
-   /* Format time as HH:MM */
-   int hours = (int)(smoothed_time / 60.0f);
-   int minutes = (int)(smoothed_time - hours * 60.0f);
-   char time_str[10];
-   snprintf(time_str, sizeof(time_str), "%d:%02d", hours, minutes);
-
-   /* Add both numeric and formatted time */
-   json_object_object_add(root, "time_remaining_min", json_object_new_double(smoothed_time));
-   json_object_object_add(root, "time_remaining_fmt", json_object_new_string(time_str));
+   add_time_remaining_json(root, runtime, battery_config, remaining_mah, temp_c,
+                           raw_time < 9999.0f ? raw_time : 9999.0f);
 
    /* Add cell-level data if available */
    if (daly_valid && daly_dev->data.status.cell_count > 0) {
@@ -945,19 +1832,13 @@ int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurement
                              json_object_new_double(battery_config->nominal_voltage));
    }
 
-   /* Convert to JSON string */
-   const char *json_str = json_object_to_json_string(root);
-
-   /* Publish to MQTT */
-   int rc = mosquitto_publish(mosq, NULL, current_topic, strlen(json_str), json_str, 0, false);
-   if (rc != MOSQ_ERR_SUCCESS) {
-      OLOG_ERROR("MQTT: Failed to publish unified battery message: %s", mosquitto_strerror(rc));
-   }
+   /* Publish to MQTT and the event stream, or add to this tick's bundle */
+   int rc = publish_telemetry(root, -1, "unified battery message");
 
    /* Free JSON object */
    json_object_put(root);
 
-   return (rc == MOSQ_ERR_SUCCESS) ? 0 : -1;
+   return rc;
 }
 
 /**
@@ -969,7 +1850,7 @@ int mqtt_publish_unified_battery(const ina238_measurements_t *ina238_measurement
  * @return int 0 on success, negative on error
  */
 int mqtt_publish_system_monitoring_data(float cpu_usage, float memory_usage, float system_temp) {
-   if (!mqtt_initialized || !mosq) {
+   if (!telemetry_wanted()) {
       return -1;
    }
 
@@ -982,19 +1863,13 @@ int mqtt_publish_system_monitoring_data(float cpu_usage, float memory_usage, flo
    json_object_object_add(root, "memory_usage", json_object_new_double(memory_usage));
    json_object_object_add(root, "system_temp", json_object_new_double(system_temp));
 
-   /* Convert to JSON string */
-   const char *json_str = json_object_to_json_string(root);
-
-   /* Publish to MQTT */
-   int rc = mosquitto_publish(mosq, NULL, current_topic, strlen(json_str), json_str, 0, false);
-   if (rc != MOSQ_ERR_SUCCESS) {
-      OLOG_ERROR("MQTT: Failed to publish System Monitoring message: %s", mosquitto_strerror(rc));
-   }
+   /* Publish to MQTT and the event stream, or add to this tick's bundle */
+   int rc = publish_telemetry(root, -1, "System Monitoring message");
 
    /* Free JSON object */
    json_object_put(root);
 
-   return (rc == MOSQ_ERR_SUCCESS) ? 0 : -1;
+   return rc;
 }
 
 /**
@@ -1006,7 +1881,7 @@ int mqtt_publish_system_monitoring_data(float cpu_usage, float memory_usage, flo
  * @return int 0 on success, negative on error
  */
 int mqtt_publish_fan_data(int rpm, int load_percent, int pwm) {
-   if (!mqtt_initialized || !mosq) {
+   if (!telemetry_wanted()) {
       return -1;
    }
 
@@ -1024,28 +1899,75 @@ int mqtt_publish_fan_data(int rpm, int load_percent, int pwm) {
    json_object_object_add(root, "load", json_object_new_int(load_percent));
    json_object_object_add(root, "pwm", json_object_new_int(pwm));
 
-   /* Convert to JSON string */
-   const char *json_str = json_object_to_json_string(root);
-
-   /* Publish to MQTT */
-   int rc = mosquitto_publish(mosq, NULL, current_topic, strlen(json_str), json_str, 0, false);
-   if (rc != MOSQ_ERR_SUCCESS) {
-      OLOG_ERROR("MQTT: Failed to publish fan message: %s", mosquitto_strerror(rc));
-   }
+   /* Publish to MQTT and the event stream, or add to this tick's bundle */
+   int rc = publish_telemetry(root, -1, "fan message");
 
    /* Free JSON object */
    json_object_put(root);
 
-   return (rc == MOSQ_ERR_SUCCESS) ? 0 : -1;
+   return rc;
+}
+
+/**
+ * @brief Select MQTT v5 and its message expiry
+ */
+void mqtt_set_protocol_v5(bool enable, unsigned int expiry_s) {
+   v5_mode = enable;
+   message_expiry_s = expiry_s;
+}
+
+/**
+ * @brief Publish one message per tick instead of one per section
+ */
+void mqtt_set_bundle(bool enable) {
+   bundle_mode = enable;
+}
+
+/**
+ * @brief Send alerts and status over a connection of their own
+ */
+void mqtt_set_priority(bool enable) {
+   priority_mode = enable;
+}
+
+/**
+ * @brief Send this tick's bundle
+ */
+int mqtt_publish_bundle(void) {
+   if (mqtt_initialized && priority_mosq) {
+      send_alerts();
+   }
+   if (!bundle) {
+      return 0;
+   }
+
+   int rc = send_telemetry(current_topic, bundle, "bundle");
+   json_object_put(bundle);
+   bundle = NULL;
+   return rc;
 }
 
 void mqtt_cleanup(void) {
    mqtt_initialized = false;
+   if (bundle) {
+      json_object_put(bundle);
+      bundle = NULL;
+   }
+   for (int i = 0; i < MQTT_ALERT_SOURCES; i++) {
+      json_object_put(alert_messages[i]);
+      alert_messages[i] = NULL;
+   }
    if (mosq) {
       mosquitto_disconnect(mosq);
       mosquitto_loop_stop(mosq, false);
       mosquitto_destroy(mosq);
       mosq = NULL;
    }
+   if (priority_mosq) {
+      mosquitto_disconnect(priority_mosq);
+      mosquitto_loop_stop(priority_mosq, false);
+      mosquitto_destroy(priority_mosq);
+      priority_mosq = NULL;
+   }
    mosquitto_lib_cleanup();
 }
@@ -31,8 +31,11 @@
  * part of the project and are adopted by the project author(s).
  */
 
+#include <arpa/inet.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -42,19 +45,28 @@
 #include "ark_detection.h"
 #include "cpu_monitor.h"
 #include "daly_bms.h"
+#include "daly_packs.h"
 #include "fan_monitor.h"
 #include "i2c_utils.h"
 #include "ina238.h"
 #include "ina3221.h"
-#include "logging.h"
 #include "memory_monitor.h"
 #include "mqtt_publisher.h"
+#include "sample_rate.h"
+#include "stat_events.h"
+#include "stat_log.h"
+#include "stat_metrics.h"
+#include "stat_shm.h"
+#include "stat_socket.h"
+#include "sysfs_discovery.h"
 #include "system_temp_monitor.h"
+#include "telemetry_record.h"
 
 /* Application Configuration */
 #define DEFAULT_SAMPLING_INTERVAL_MS 1000
 #define MIN_SAMPLING_INTERVAL_MS 100
 #define MAX_SAMPLING_INTERVAL_MS 10000
+#define MAX_PUBLISH_INTERVAL_MS 60000
 
 typedef enum {
    BAT_4S_LI_ION,
@@ -74,28 +86,31 @@ typedef enum {
 static const battery_config_t battery_configs[] = {
    /* Standard Li-ion configurations */
    { 12.0f, 16.8f, 14.4f, 20.0f, 10.0f, 2600.0f, 4, 1, BATT_CHEMISTRY_LIION,
-     "4S_Li-ion" },  // 4S 18650
+     "4S_Li-ion", 0.0f },  // 4S 18650
    { 15.0f, 21.0f, 18.0f, 20.0f, 10.0f, 2600.0f, 5, 1, BATT_CHEMISTRY_LIION,
-     "5S_Li-ion" },  // 5S 18650
+     "5S_Li-ion", 0.0f },  // 5S 18650
    { 18.0f, 25.2f, 21.6f, 20.0f, 10.0f, 2600.0f, 6, 1, BATT_CHEMISTRY_LIION,
-     "6S_Li-ion" },  // 6S 18650
+     "6S_Li-ion", 0.0f },  // 6S 18650
 
    /* LiPo configurations */
-   { 6.0f, 8.4f, 7.4f, 20.0f, 10.0f, 5000.0f, 2, 1, BATT_CHEMISTRY_LIPO, "2S_LiPo" },     // 2S LiPo
-   { 9.0f, 12.6f, 11.1f, 20.0f, 10.0f, 5000.0f, 3, 1, BATT_CHEMISTRY_LIPO, "3S_LiPo" },   // 3S LiPo
-   { 18.0f, 25.2f, 22.2f, 20.0f, 10.0f, 5000.0f, 6, 1, BATT_CHEMISTRY_LIPO, "6S_LiPo" },  // 6S LiPo
+   { 6.0f, 8.4f, 7.4f, 20.0f, 10.0f, 5000.0f, 2, 1, BATT_CHEMISTRY_LIPO,
+     "2S_LiPo", 0.0f },  // 2S LiPo
+   { 9.0f, 12.6f, 11.1f, 20.0f, 10.0f, 5000.0f, 3, 1, BATT_CHEMISTRY_LIPO,
+     "3S_LiPo", 0.0f },  // 3S LiPo
+   { 18.0f, 25.2f, 22.2f, 20.0f, 10.0f, 5000.0f, 6, 1, BATT_CHEMISTRY_LIPO,
+     "6S_LiPo", 0.0f },  // 6S LiPo
 
    /* User-requested specific configurations */
    { 12.0f, 16.8f, 14.4f, 20.0f, 10.0f, 5000.0f, 4, 1, BATT_CHEMISTRY_LIION,
-     "4S1P_Samsung50E" },  // 4S1P Samsung 50E
+     "4S1P_Samsung50E", 0.0f },  // 4S1P Samsung 50E
    { 12.0f, 16.8f, 14.4f, 20.0f, 10.0f, 10000.0f, 4, 2, BATT_CHEMISTRY_LIION,
-     "4S2P_Samsung50E" },  // 4S2P Samsung 50E
+     "4S2P_Samsung50E", 0.0f },  // 4S2P Samsung 50E
    { 9.0f, 12.6f, 11.1f, 20.0f, 10.0f, 5200.0f, 3, 1, BATT_CHEMISTRY_LIPO,
-     "3S_5200mAh_LiPo" },  // 3S 5200mAh LiPo
+     "3S_5200mAh_LiPo", 0.0f },  // 3S 5200mAh LiPo
    { 9.0f, 12.6f, 11.1f, 20.0f, 10.0f, 2200.0f, 3, 1, BATT_CHEMISTRY_LIPO,
-     "3S_2200mAh_LiPo" },  // 3S 2200mAh LiPo
+     "3S_2200mAh_LiPo", 0.0f },  // 3S 2200mAh LiPo
    { 9.0f, 12.6f, 11.1f, 20.0f, 10.0f, 1500.0f, 3, 1, BATT_CHEMISTRY_LIPO,
-     "3S_1500mAh_LiPo" },  // 3S 1500mAh LiPo
+     "3S_1500mAh_LiPo", 0.0f },  // 3S 1500mAh LiPo
 };
 
 #define NUM_BATTERY_CONFIGS ((int)(sizeof(battery_configs) / sizeof(battery_configs[0])))
@@ -147,16 +162,71 @@ typedef struct {
    bool system_temp_available;
 } system_metrics_t;
 
+/* Hardware discovery shared with the startup threads */
+typedef struct {
+   /* Inputs */
+   const char *i2c_bus;
+   uint8_t i2c_addr;
+   float r_shunt;
+   float max_current;
+   bool bms_detect; /* Auto-detect the BMS port before initializing it */
+
+   /* Devices, left initialized for the main loop when found */
+   ina238_device_t *ina238_dev;
+   ina3221_device_t *ina3221_dev;
+   daly_pack_group_t *bms_packs;
+
+   /* Results */
+   bool ina238_ok;
+   bool ina3221_ok;
+   bool bms_ok;
+   atomic_bool bms_done; /* The BMS job has finished and bms_ok is final */
+} discovery_t;
+
+/* Startup profiling */
+#define STARTUP_MAX_STEPS 16
+
+typedef struct {
+   const char *name;
+   uint64_t start_us;    /* Since process start */
+   uint64_t duration_us;
+} startup_step_t;
+
 /* Global Variables */
 static volatile bool g_running = true;
 static bool bms_enable = false;
 static char bms_port[64];
 static int bms_baud = DALY_DEFAULT_BAUD;
+static daly_pack_group_t bms_packs; /* --bms-pack list, or the single --bms-port pack */
+static const char *bms_scan_specs[DALY_MAX_PACKS]; /* --bms-scan segments */
+static int bms_scan_count = 0;
+static int bms_diag_polls = 0; /* --bms-diag: poll this many times, report the link, exit */
 static int bms_interval_ms = 1000;
+static bool adaptive_enable = false; /* --adaptive: sampling interval follows the battery */
+static int adaptive_fast_ms = SAMPLE_RATE_DEFAULT_FAST_MS;
+static int adaptive_idle_ms = SAMPLE_RATE_DEFAULT_IDLE_MS;
+static int publish_interval_ms = 0; /* --publish-interval: 0 publishes every sample */
 static int bms_capacity = 0;
 static float bms_soc = -1.0f;
 static int cell_warning_threshold_mv = DALY_CELL_WARNING_THRESHOLD_MV;
 static int cell_critical_threshold_mv = DALY_CELL_CRITICAL_THRESHOLD_MV;
+static const char *record_path = NULL;
+static const char *replay_path = NULL;
+static double replay_speed = 1.0; /* 0 = as fast as possible */
+static bool startup_profile = false;
+static const char *sysfs_cache_path = SYSFS_DISCOVERY_CACHE_PATH;
+static bool log_sync = false;
+static const char *shm_name = NULL;    /* --shm: shared-memory snapshot object */
+static const char *socket_path = NULL; /* --socket: query and streaming socket */
+static bool metrics_enable = false;     /* --metrics: OpenMetrics exporter */
+static char metrics_addr[INET_ADDRSTRLEN];
+static int metrics_port = STAT_METRICS_DEFAULT_PORT;
+static bool events_enable = false;      /* --events: Server-Sent Events stream */
+static char events_addr[INET_ADDRSTRLEN];
+static int events_port = STAT_EVENTS_DEFAULT_PORT;
+static struct timespec startup_t0;
+static startup_step_t startup_steps[STARTUP_MAX_STEPS];
+static atomic_int startup_step_count = 0;
 
 /* Function Prototypes */
 static void print_usage(const char *prog_name);
@@ -215,6 +285,13 @@ static void print_usage(const char *prog_name) {
    printf("  -c, --current MAX      Maximum current in amps (default: 327.68, or 10.0 for ARK)\n");
    printf("  -i, --interval MS      Sampling interval in milliseconds (default: 1000, range: "
           "100-10000)\n");
+   printf("      --adaptive[=FAST:IDLE]  Sample every FAST ms during load transients and alarms,\n"
+          "                         back off to --interval when stable and to IDLE ms when\n"
+          "                         idle (default: %d:%d)\n",
+          SAMPLE_RATE_DEFAULT_FAST_MS, SAMPLE_RATE_DEFAULT_IDLE_MS);
+   printf("      --publish-interval MS  Publish every MS ms with min/max/mean/stddev of the\n"
+          "                         INA238 and INA3221 samples in between (default:\n"
+          "                         every sample)\n");
    printf("  -m, --monitor TYPE     Power monitor type: ina238, ina3221, both, auto (default: "
           "auto)\n");
    printf("\nPower Monitor Types:\n");
@@ -245,21 +322,56 @@ static void print_usage(const char *prog_name) {
    printf("      --mqtt-password PASS  MQTT password (or env MQTT_PASSWORD)\n");
    printf("      --mqtt-tls            Enable MQTT TLS encryption\n");
    printf("      --mqtt-ca-cert PATH   Path to CA certificate (implies --mqtt-tls)\n");
+   printf("      --mqtt-bundle         Publish one message per update holding all sections\n");
+   printf("      --mqtt-v5             Use MQTT v5: topic aliases, message expiry, content type\n");
+   printf("      --mqtt-expiry SEC     MQTT v5 telemetry expiry, 0 for none (default: %d)\n",
+          MQTT_DEFAULT_EXPIRY_S);
+   printf("      --mqtt-priority       Send alerts (QoS 1, <topic>/%s) and status on a second\n"
+          "                            connection\n",
+          MQTT_ALERT_SUBTOPIC);
    printf("\nDaly BMS Options:\n");
    printf("      --bms-enable         Enable Daly BMS monitoring\n");
    printf("      --bms-port PORT      Serial port for BMS (default: /dev/ttyTHS1)\n");
    printf("      --bms-baud BAUD      Baud rate (default: %d)\n", DALY_DEFAULT_BAUD);
+   printf("      --bms-pack PORT[:BAUD][@BOARD]  Add a BMS pack; repeat for up to %d packs.\n",
+          DALY_MAX_PACKS);
+   printf("                           Packs on separate ports are polled in parallel, packs\n");
+   printf("                           sharing an RS-485 port are told apart by board number\n");
+   printf("                           (implies --bms-enable)\n");
+   printf("      --bms-scan PORT[:BAUD]  Add every BMS answering on an RS-485 port\n");
+   printf("      --bms-diag[=N]       Poll the BMS N times back to back (default: 100), print\n");
+   printf("                           link quality and round-trip times, and exit\n");
    printf("      --bms-interval MS    Polling interval in ms (default: 1000)\n");
    printf("      --bms-set-capacity N Set BMS rated capacity in mAh\n");
    printf("      --bms-set-soc PCT    Set BMS state of charge (0-100)\n");
    printf("      --bms-warn-thresh MV Cell voltage warning threshold in mV (default: 70)\n");
    printf("      --bms-crit-thresh MV Cell voltage critical threshold in mV (default: 120)\n");
+   printf("      --bms-detect-cache FILE  Auto-detect cache file, \"\" to disable\n");
+   printf("                           (default: %s)\n", DALY_DETECT_CACHE_PATH);
+   printf("\nDiagnostic Options:\n");
+   printf("      --record FILE        Record raw sensor readings to FILE\n");
+   printf("      --replay FILE        Replay a recording instead of reading hardware\n");
+   printf("      --speed N|max        Replay speed multiplier, or max for no pacing (default: 1)\n");
+   printf("      --startup-profile    Log the time taken by each startup step\n");
+   printf("      --sysfs-cache FILE   Resolved sysfs path cache, \"\" to disable\n");
+   printf("                           (default: %s)\n", SYSFS_DISCOVERY_CACHE_PATH);
+   printf("      --log-sync           Write log lines on the calling thread (no rate limiting)\n");
+   printf("      --shm[=/NAME]        Keep the latest telemetry in shared memory for local\n");
+   printf("                           readers (default: %s)\n", STAT_SHM_DEFAULT_NAME);
+   printf("      --socket[=PATH]      Serve snapshots, history and streams on a local socket\n");
+   printf("                           (default: %s)\n", STAT_SOCKET_DEFAULT_PATH);
+   printf("      --metrics[=[ADDR:]PORT]  Serve OpenMetrics on http://ADDR:PORT/metrics\n");
+   printf("                           (default: 0.0.0.0:%d)\n", STAT_METRICS_DEFAULT_PORT);
+   printf("      --events[=[ADDR:]PORT]   Stream telemetry as Server-Sent Events on\n");
+   printf("                           http://ADDR:PORT/events (default: 0.0.0.0:%d)\n",
+          STAT_EVENTS_DEFAULT_PORT);
    printf("\nExamples:\n");
    printf("  ./oasis-stat                           # Auto-detect power monitors\n");
    printf("  ./oasis-stat --monitor ina3221         # Force INA3221 3-channel monitoring\n");
    printf("  ./oasis-stat --monitor ina238          # Force INA238 single-channel monitoring\n");
    printf("  ./oasis-stat --monitor both            # Use both monitors (if available)\n");
    printf("  ./oasis-stat --battery 4S2P_Samsung50E # Use specific battery configuration\n");
+   printf("  ./oasis-stat --replay run.rec --speed max # Benchmark the pipeline on a recording\n");
    printf("\nNote: If ARK Electronics Jetson Carrier is detected, optimized defaults are used.\n");
    printf("      Command-line options will override auto-detected settings.\n");
    printf("\nSTAT integrates with other OASIS modules:\n");
@@ -348,7 +460,8 @@ static void print_ina238_measurements(const ina238_measurements_t *measurements,
       printf("  Temperature:   %8.2f °C (INA238 die)\n", measurements->temperature);
 
       /* Battery status */
-      float battery_percent = battery_calculate_percentage(measurements->bus_voltage, battery);
+      float battery_percent = battery_calculate_percentage_loaded(measurements->bus_voltage,
+                                                                  measurements->current, battery);
       const char *battery_status = get_battery_status(battery_percent, battery);
 
       /* Calculate estimated runtime */
@@ -460,8 +573,9 @@ static void print_daly_bms_data(const daly_device_t *daly_dev) {
    /* Faults */
    if (data->fault_count > 0) {
       printf("  Faults:       %d active faults\n", data->fault_count);
-      for (int i = 0; i < data->fault_count && i < 3; i++) {  // Show first 3 faults
-         printf("    - %s\n", data->faults[i]);
+      daly_fault_bits_t bits = data->faults;
+      for (int i = 0, code; i < 3 && (code = daly_fault_next(&bits)) >= 0; i++) {  // First 3
+         printf("    - %s\n", daly_fault_description(code));
       }
       if (data->fault_count > 3) {
          printf("    - ... and %d more\n", data->fault_count - 3);
@@ -515,19 +629,20 @@ static void print_enhanced_daly_data(const daly_device_t *daly_dev,
    int cells_per_row = 4;  // Adjust based on your typical display width
 
    for (int i = 0; i < health->cell_count; i++) {
-      const daly_cell_health_t *cell = &health->cells[i];
       char status_indicator = ' ';
 
       // Add status indicator
-      if (cell->status == DALY_HEALTH_WARNING) {
+      if (health->status[i] == DALY_HEALTH_WARNING) {
          status_indicator = '!';
-      } else if (cell->status == DALY_HEALTH_CRITICAL) {
+      } else if (health->status[i] == DALY_HEALTH_CRITICAL) {
          status_indicator = '*';
+      } else if (health->drifting[i]) {
+         status_indicator = '~';
       }
 
       // Print cell with optional balancing indicator
-      printf("C%d: %.3fV%c%s  ", cell->cell_index, cell->voltage, status_indicator,
-             cell->balancing ? "[B]" : "");
+      printf("C%d: %.3fV%c%s  ", i + 1, health->voltage[i], status_indicator,
+             health->balancing[i] ? "[B]" : "");
 
       // Break line after cells_per_row cells
       if ((i + 1) % cells_per_row == 0 && i < health->cell_count - 1) {
@@ -537,8 +652,8 @@ static void print_enhanced_daly_data(const daly_device_t *daly_dev,
    printf("\n");
 
    /* Legend for status indicators */
-   if (health->problem_cell_count > 0) {
-      printf("    Legend: ! = Warning, * = Critical");
+   if (health->problem_cell_count > 0 || health->drifting_cell_count > 0) {
+      printf("    Legend: ! = Warning, * = Critical, ~ = Drifting");
       if (daly_bms_is_balancing(daly_dev)) {
          printf(", [B] = Balancing");
       }
@@ -550,9 +665,9 @@ static void print_enhanced_daly_data(const daly_device_t *daly_dev,
       printf("  Problem Cells: %d\n", health->problem_cell_count);
       int shown = 0;
       for (int i = 0; i < health->cell_count && shown < 3; i++) {
-         if (health->cells[i].status != DALY_HEALTH_NORMAL) {
-            printf("    Cell %-2d: %s - %s\n", health->cells[i].cell_index,
-                   daly_bms_health_string(health->cells[i].status), health->cells[i].reason);
+         if (health->status[i] != DALY_HEALTH_NORMAL) {
+            printf("    Cell %-2d: %s - %s\n", i + 1, daly_bms_health_string(health->status[i]),
+                   health->reason[i]);
             shown++;
          }
       }
@@ -561,6 +676,17 @@ static void print_enhanced_daly_data(const daly_device_t *daly_dev,
       }
    }
 
+   /* Cells still within limits but trending toward the warning threshold */
+   if (health->drifting_cell_count > 0) {
+      printf("  Drifting Cells: %d\n", health->drifting_cell_count);
+      for (int i = 0; i < health->cell_count; i++) {
+         if (health->drifting[i]) {
+            printf("    Cell %-2d: %+.1f mV now, %+.1f mV smoothed - %s\n", i + 1,
+                   health->deviation_mv[i], health->ewma_mv[i], health->reason[i]);
+         }
+      }
+   }
+
    /* Show all temperature sensors */
    printf("  Temperatures:  ");
    int temps_per_row = 4;  // Adjust based on display width
@@ -592,13 +718,15 @@ static void print_enhanced_daly_data(const daly_device_t *daly_dev,
              fault_summary->warning_count);
 
       /* Show critical faults first */
-      for (int i = 0; i < fault_summary->critical_count && i < 2; i++) {
-         printf("    CRITICAL: %s\n", fault_summary->critical_faults[i]);
+      daly_fault_bits_t bits = fault_summary->critical;
+      for (int i = 0, code; i < 2 && (code = daly_fault_next(&bits)) >= 0; i++) {
+         printf("    CRITICAL: %s\n", daly_fault_description(code));
       }
 
       /* Then show warnings */
-      for (int i = 0; i < fault_summary->warning_count && i < 2; i++) {
-         printf("    WARNING:  %s\n", fault_summary->warning_faults[i]);
+      bits = fault_summary->warning;
+      for (int i = 0, code; i < 2 && (code = daly_fault_next(&bits)) >= 0; i++) {
+         printf("    WARNING:  %s\n", daly_fault_description(code));
       }
 
       /* Indicate if there are more */
@@ -632,10 +760,566 @@ static void print_enhanced_daly_data(const daly_device_t *daly_dev,
    printf("\n");
 }
 
+/**
+ * @brief Microseconds elapsed on CLOCK_MONOTONIC since @p start
+ */
+static uint64_t elapsed_us_since(const struct timespec *start) {
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   int64_t us = ((int64_t)now.tv_sec - (int64_t)start->tv_sec) * 1000000 +
+                ((int64_t)now.tv_nsec - (int64_t)start->tv_nsec) / 1000;
+   return us > 0 ? (uint64_t)us : 0;
+}
+
+/**
+ * @brief Sleep until a replayed tick is due at the configured replay speed
+ */
+static void replay_pace(const struct timespec *start, uint64_t offset_us) {
+   if (replay_speed == 0.0) {
+      return;
+   }
+
+   uint64_t due_us = (uint64_t)((double)offset_us / replay_speed);
+   uint64_t now_us = elapsed_us_since(start);
+   if (due_us > now_us) {
+      i2c_msleep((int)((due_us - now_us) / 1000));
+   }
+}
+
+/**
+ * @brief Read INA238 measurements, from the replay tick when one is given
+ */
+static int read_ina238(ina238_device_t *dev,
+                       const telemetry_tick_t *replay_tick,
+                       ina238_measurements_t *measurements) {
+   ina238_raw_t raw;
+
+   if (replay_tick) {
+      if (!replay_tick->has_ina238) {
+         return -1;
+      }
+      raw = replay_tick->ina238;
+   } else {
+      if (ina238_read_raw(dev, &raw) != 0) {
+         return -1;
+      }
+      telemetry_record_ina238(&raw);
+   }
+
+   return ina238_convert_raw(dev, &raw, measurements);
+}
+
+/**
+ * @brief Read INA3221 measurements, from the replay tick when one is given
+ */
+static int read_ina3221(ina3221_device_t *dev,
+                        const telemetry_tick_t *replay_tick,
+                        ina3221_measurements_t *measurements) {
+   if (!replay_tick) {
+      int ret = ina3221_read_measurements(dev, measurements);
+      if (ret == 0) {
+         telemetry_record_ina3221(measurements);
+      }
+      return ret;
+   }
+
+   memset(measurements, 0, sizeof(*measurements));
+   for (int i = 0; i < replay_tick->ina3221_count && i < INA3221_MAX_CHANNELS; i++) {
+      const telemetry_ina3221_raw_t *raw = &replay_tick->ina3221[i];
+      ina3221_channel_t *ch = &measurements->channels[measurements->num_channels++];
+
+      ch->channel = raw->channel;
+      ch->enabled = true;
+      snprintf(ch->label, sizeof(ch->label), "%s", raw->label);
+      ina3221_apply_raw(ch, raw->voltage_mv, raw->current_ma);
+   }
+   measurements->valid = measurements->num_channels > 0;
+
+   return measurements->valid ? 0 : -1;
+}
+
+/**
+ * @brief Sample host metrics, from the replay tick when one is given
+ */
+static void sample_system_metrics(system_metrics_t *metrics, const telemetry_tick_t *replay_tick) {
+   if (replay_tick) {
+      if (replay_tick->has_proc) {
+         metrics->cpu_usage = replay_tick->proc.cpu_usage;
+         metrics->memory_usage = replay_tick->proc.memory_usage;
+         metrics->system_temperature = replay_tick->proc.system_temperature;
+         metrics->fan_available = replay_tick->proc.fan_available;
+         metrics->fan_rpm = replay_tick->proc.fan_rpm;
+         metrics->fan_load = replay_tick->proc.fan_load;
+         metrics->fan_pwm = replay_tick->proc.fan_pwm;
+      }
+      return;
+   }
+
+   metrics->cpu_usage = cpu_monitor_get_usage();
+   metrics->memory_usage = memory_monitor_get_usage();
+   metrics->system_temperature = system_temp_monitor_get_temp();
+
+   if (metrics->fan_available) {
+      metrics->fan_rpm = fan_monitor_get_rpm();
+      metrics->fan_load = fan_monitor_get_load_percent();
+      metrics->fan_pwm = fan_monitor_get_pwm();
+   }
+
+   telemetry_proc_sample_t sample = { .cpu_usage = metrics->cpu_usage,
+                                      .memory_usage = metrics->memory_usage,
+                                      .system_temperature = metrics->system_temperature,
+                                      .fan_available = metrics->fan_available,
+                                      .fan_rpm = metrics->fan_rpm,
+                                      .fan_load = metrics->fan_load,
+                                      .fan_pwm = metrics->fan_pwm };
+   telemetry_record_proc(&sample);
+}
+
+/**
+ * @brief Re-resolve the sysfs paths affected by hwmon/thermal hotplug events
+ */
+static void handle_sysfs_changes(unsigned changes,
+                                 ina3221_device_t *ina3221_dev,
+                                 bool use_ina3221,
+                                 system_metrics_t *metrics) {
+   if (changes & SYSFS_CHANGE_THERMAL) {
+      metrics->system_temp_available = system_temp_monitor_rescan() == 0;
+   }
+
+   if (changes & SYSFS_CHANGE_HWMON) {
+      metrics->fan_available = fan_monitor_rescan() == 0;
+
+      /* hwmon numbers are not stable across driver rebinds */
+      char path[INA3221_PATH_MAX_LEN];
+      if (use_ina3221 && ina3221_detect_device(path, sizeof(path)) == 0 &&
+          (!ina3221_dev->initialized || strcmp(path, ina3221_dev->sysfs_path) != 0)) {
+         OLOG_INFO("INA3221 moved to %s, reinitializing", path);
+         ina3221_close(ina3221_dev);
+         if (ina3221_init(ina3221_dev) != 0) {
+            OLOG_WARNING("INA3221 reinitialization failed");
+         }
+      }
+   }
+
+   sysfs_discovery_save();
+}
+
+/**
+ * @brief Microseconds since process start, for the startup profile
+ */
+static uint64_t startup_now_us(void) {
+   return elapsed_us_since(&startup_t0);
+}
+
+/**
+ * @brief Record a completed startup step (safe to call from discovery threads)
+ */
+static void startup_record(const char *name, uint64_t start_us) {
+   int idx = atomic_fetch_add(&startup_step_count, 1);
+   if (idx >= STARTUP_MAX_STEPS) {
+      return;
+   }
+
+   startup_steps[idx].name = name;
+   startup_steps[idx].start_us = start_us;
+   startup_steps[idx].duration_us = startup_now_us() - start_us;
+}
+
+/**
+ * @brief Log the startup profile (--startup-profile)
+ */
+static void startup_print_profile(uint64_t first_telemetry_us) {
+   int count = MIN(atomic_load(&startup_step_count), STARTUP_MAX_STEPS);
+
+   SLOG_EVENT_INFO("Startup profile (ms since start):");
+   for (int i = 0; i < count; i++) {
+      SLOG_EVENT_INFO("  %-24s start %8.1f  took %8.1f", startup_steps[i].name,
+                      startup_steps[i].start_us / 1000.0, startup_steps[i].duration_us / 1000.0);
+   }
+   SLOG_EVENT_INFO("  %-24s at    %8.1f", "First telemetry", first_telemetry_us / 1000.0);
+}
+
+/**
+ * @brief Discovery thread: probe and initialize the INA238
+ */
+static void *discover_ina238(void *arg) {
+   discovery_t *disc = (discovery_t *)arg;
+   uint64_t start = startup_now_us();
+
+   if (ina238_init(disc->ina238_dev, disc->i2c_bus, disc->i2c_addr, disc->r_shunt,
+                   disc->max_current) == 0) {
+      disc->ina238_ok = true;
+      OLOG_INFO("INA238 detected and initialized on %s", disc->i2c_bus);
+   } else {
+      OLOG_INFO("INA238 not found or not accessible");
+   }
+
+   startup_record("INA238 probe/init", start);
+   return NULL;
+}
+
+/**
+ * @brief Discovery thread: probe and initialize the INA3221
+ */
+static void *discover_ina3221(void *arg) {
+   discovery_t *disc = (discovery_t *)arg;
+   uint64_t start = startup_now_us();
+
+   if (access(INA3221_SYSFS_BASE, F_OK) != 0) {
+      OLOG_INFO("INA3221 driver not found in sysfs");
+   } else if (ina3221_init(disc->ina3221_dev) == 0) {
+      disc->ina3221_ok = true;
+      OLOG_INFO("INA3221 detected and initialized via sysfs interface");
+   } else {
+      OLOG_INFO("INA3221 driver found but device not accessible");
+   }
+
+   startup_record("INA3221 probe/init", start);
+   return NULL;
+}
+
+/**
+ * @brief Discovery thread: find (unless --bms-enable) and initialize the Daly BMS packs
+ */
+static void *discover_bms(void *arg) {
+   discovery_t *disc = (discovery_t *)arg;
+   daly_pack_group_t *packs = disc->bms_packs;
+   uint64_t start = startup_now_us();
+
+   /* Segments to scan for boards, after the packs listed one by one */
+   for (int i = 0; i < bms_scan_count; i++) {
+      char port[64];
+      int baud = bms_baud;
+      daly_packs_parse_spec(bms_scan_specs[i], port, sizeof(port), &baud, NULL);
+      int found = daly_packs_scan(packs, port, baud);
+      if (found < 0) {
+         OLOG_ERROR("Error: Cannot scan %s for Daly BMS boards", port);
+      } else {
+         OLOG_INFO("Found %d Daly BMS board(s) on %s", found, port);
+      }
+   }
+
+   /* Without --bms-pack/--bms-scan there is one pack, on --bms-port or wherever it is found */
+   bool explicit_packs = packs->count > 0 || bms_scan_count > 0;
+   if (!explicit_packs) {
+      if (disc->bms_detect) {
+         char detected_port[64];
+         int detected_baud;
+
+         if (!daly_bms_auto_detect(detected_port, &detected_baud)) {
+            startup_record("Daly BMS detect/init", start);
+            atomic_store(&disc->bms_done, true);
+            return NULL;
+         }
+         OLOG_INFO("Auto-detected Daly BMS on %s at %d baud", detected_port, detected_baud);
+         snprintf(bms_port, sizeof(bms_port), "%s", detected_port);
+         bms_baud = detected_baud; /* Use detected baud rate */
+      }
+      daly_packs_add(packs, bms_port, bms_baud, DALY_BMS_ADDR);
+   }
+   for (int i = 0; i < packs->count; i++) {
+      if (packs->packs[i].baud <= 0) {
+         packs->packs[i].baud = bms_baud;
+      }
+   }
+
+   /* Listed packs that are missing now are opened once they are plugged in */
+   int opened = daly_packs_open(packs, 500);
+   if (opened == 0) {
+      OLOG_ERROR("Error: Failed to initialize Daly BMS");
+   } else if (packs->count > 1) {
+      OLOG_INFO("Daly BMS initialized on %d of %d packs", opened, packs->count);
+   } else {
+      OLOG_INFO("Daly BMS initialized successfully");
+   }
+   disc->bms_ok = opened > 0 || explicit_packs;
+
+   startup_record("Daly BMS detect/init", start);
+   atomic_store(&disc->bms_done, true);
+   return NULL;
+}
+
+/**
+ * @brief Run a discovery job on its own thread, or inline if that fails
+ *
+ * @return bool true if a thread was started and must be joined
+ */
+static bool start_discovery(pthread_t *thread, void *(*job)(void *), discovery_t *disc) {
+   if (pthread_create(thread, NULL, job, disc) == 0) {
+      return true;
+   }
+
+   OLOG_WARNING("Failed to start discovery thread, probing inline");
+   job(disc);
+   return false;
+}
+
+/**
+ * @brief Adopt the result of BMS discovery and run the one-time BMS writes
+ */
+static void finish_bms_discovery(const discovery_t *disc) {
+   daly_pack_group_t *packs = disc->bms_packs;
+
+   bms_enable = disc->bms_ok;
+   if (!bms_enable) {
+      return;
+   }
+
+   /* Handle optional one-time operations (on every pack that is present) */
+   for (int i = 0; i < packs->count; i++) {
+      daly_device_t *daly_dev = &packs->packs[i].dev;
+      if (!daly_dev->initialized) {
+         continue;
+      }
+
+      if (bms_capacity > 0) {
+         OLOG_INFO("Setting Daly BMS capacity on %s to %d mAh", daly_dev->port, bms_capacity);
+         if (daly_bms_write_capacity(daly_dev, bms_capacity, 3600) < 0) {
+            OLOG_ERROR("Failed to set Daly BMS capacity");
+         } else {
+            OLOG_INFO("Daly BMS capacity set successfully");
+         }
+      }
+
+      if (bms_soc >= 0.0f) {
+         OLOG_INFO("Setting Daly BMS SOC on %s to %.1f%%", daly_dev->port, bms_soc);
+         if (daly_bms_write_soc(daly_dev, bms_soc) < 0) {
+            OLOG_ERROR("Failed to set Daly BMS SOC");
+         } else {
+            OLOG_INFO("Daly BMS SOC set successfully");
+         }
+      }
+   }
+
+   /* Resistance baselines learned on earlier runs, one file per pack */
+   for (int i = 0; i < packs->count; i++) {
+      char rint_path[sizeof(DALY_RINT_PATH) + 16];
+      daly_packs_rint_path(i, rint_path, sizeof(rint_path));
+      battery_rint_load_baselines(rint_path, packs->packs[i].health.rint, DALY_MAX_CELLS + 1);
+   }
+
+   /* Packs can be swapped while running; poll them side by side */
+   packs->reopen = true;
+   daly_packs_start(packs);
+}
+
+/**
+ * @brief First pack with valid data and health, or NULL
+ */
+static const daly_pack_t *first_valid_pack(const daly_pack_group_t *packs) {
+   for (int i = 0; i < packs->count; i++) {
+      if (packs->packs[i].health_valid && packs->packs[i].dev.data.valid) {
+         return &packs->packs[i];
+      }
+   }
+   return NULL;
+}
+
+/**
+ * @brief Next adaptive sampling interval from this iteration's battery readings
+ *
+ * The INA238 current is read every iteration, so it is preferred for the
+ * variance and rate of change; the charge state comes from the BMS, whose
+ * MOSFET flags tell a charger from a load, when a pack is available. With
+ * neither, the interval stays where it is.
+ */
+static int next_adaptive_interval(sample_rate_t *sr,
+                                  const ina238_measurements_t *ina238,
+                                  const daly_pack_t *bms_pack) {
+   float current_a;
+   int state;
+
+   if (ina238->valid) {
+      current_a = -ina238->current; /* BMS convention: positive while charging */
+   } else if (bms_pack) {
+      current_a = bms_pack->dev.data.pack.current_a;
+   } else {
+      return sr->interval_ms;
+   }
+
+   if (bms_pack) {
+      const daly_data_t *data = &bms_pack->dev.data;
+      state = daly_bms_infer_state(data->pack.current_a, data->mos.charge_mos,
+                                   data->mos.discharge_mos, DALY_CURRENT_DEADBAND);
+   } else {
+      state = daly_bms_infer_state(current_a, true, true, DALY_CURRENT_DEADBAND);
+   }
+
+   bool alarm = bms_pack && (bms_pack->faults.critical_count > 0 ||
+                             bms_pack->health.overall_status == DALY_HEALTH_CRITICAL);
+   int previous_ms = sr->interval_ms;
+   int next_ms = sample_rate_update(sr, current_a, state, alarm);
+   if (next_ms != previous_ms) {
+      OLOG_DEBUG("Adaptive sampling: every %d ms", next_ms);
+   }
+   return next_ms;
+}
+
+/**
+ * @brief Fill the shared-memory snapshot from this iteration's readings
+ *
+ * The battery section follows the unified BatteryStatus message: voltage and
+ * current from the INA238 when present, SOC and temperature from the BMS.
+ */
+static void fill_shm_snapshot(stat_shm_snapshot_t *snap,
+                              const ina238_measurements_t *ina238,
+                              float battery_percentage,
+                              const daly_pack_t *bms_pack,
+                              const daly_packs_summary_t *packs,
+                              const battery_runtime_t *runtime,
+                              const battery_config_t *battery,
+                              const ina3221_measurements_t *ina3221,
+                              const system_metrics_t *metrics) {
+   memset(snap, 0, sizeof(*snap));
+   struct timespec now;
+   clock_gettime(CLOCK_REALTIME, &now);
+   snap->timestamp_ms = (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+
+   bool ina238_valid = ina238 && ina238->valid;
+   const daly_data_t *daly = bms_pack && bms_pack->dev.data.valid ? &bms_pack->dev.data : NULL;
+   bool packs_valid = daly && packs && packs->valid_count > 0;
+
+   if (ina238_valid || daly) {
+      snap->valid |= STAT_SHM_BATTERY;
+
+      /* Daly reports charge current as positive */
+      if (ina238_valid) {
+         snap->battery_voltage_v = ina238->bus_voltage;
+         snap->battery_current_a = ina238->current;
+         snap->battery_power_w = ina238->power;
+      } else if (packs_valid) {
+         snap->battery_voltage_v = packs->voltage_v;
+         snap->battery_current_a = -packs->current_a;
+         snap->battery_power_w = -packs->power_w;
+      } else {
+         snap->battery_voltage_v = daly->pack.v_total_v;
+         snap->battery_current_a = -daly->pack.current_a;
+         snap->battery_power_w = -daly->pack.v_total_v * daly->pack.current_a;
+      }
+
+      snap->battery_level_pct = packs_valid ? packs->soc_pct
+                                : daly      ? daly->pack.soc_pct
+                                            : battery_percentage;
+      snap->battery_temp_c = STAT_SHM_TEMP_UNKNOWN;
+      if (packs_valid && packs->tmax_c > -40.0f) {
+         snap->battery_temp_c = packs->tmax_c;
+      } else if (daly && daly->temps.tmax_c > -40.0f) {
+         snap->battery_temp_c = daly->temps.tmax_c;
+      } else if (ina238_valid) {
+         snap->battery_temp_c = ina238->temperature;
+      }
+
+      /* Remaining capacity as the unified message computes it */
+      float remaining_mah = packs_valid ? packs->remaining_mah
+                            : daly      ? daly_bms_remaining_mah(daly, battery)
+                                        : battery->capacity_mah * battery_percentage / 100.0f;
+      battery_runtime_forecast_t forecast;
+      snap->time_remaining_min = battery_runtime_predict(runtime, battery, remaining_mah,
+                                                         snap->battery_temp_c, &forecast) == 0
+                                     ? forecast.p50_min
+                                     : -1.0f;
+
+      snap->charging_state = STAT_SHM_DISCHARGING;
+      if (daly) {
+         int state = daly_bms_infer_state(daly->pack.current_a, daly->mos.charge_mos,
+                                          daly->mos.discharge_mos, DALY_CURRENT_DEADBAND);
+         snap->charging_state = state == DALY_STATE_CHARGE ? STAT_SHM_CHARGING
+                                : state == DALY_STATE_IDLE ? STAT_SHM_IDLE
+                                                           : STAT_SHM_DISCHARGING;
+         snap->critical_faults = (uint16_t)bms_pack->faults.critical_count;
+         snap->warning_faults = (uint16_t)bms_pack->faults.warning_count;
+      }
+   }
+
+   if (daly && daly->status.cell_count > 0) {
+      snap->valid |= STAT_SHM_CELLS;
+      snap->cell_count = (uint32_t)MIN(daly->status.cell_count, STAT_SHM_MAX_CELLS);
+      for (uint32_t i = 0; i < snap->cell_count; i++) {
+         snap->cell_mv[i] = (uint16_t)daly->cell_mv[i];
+         snap->balancing |= daly->balance[i] ? 1u << i : 0u;
+      }
+   }
+
+   if (ina3221 && ina3221->valid) {
+      for (int i = 0; i < ina3221->num_channels && snap->rail_count < STAT_SHM_MAX_RAILS; i++) {
+         const ina3221_channel_t *ch = &ina3221->channels[i];
+         if (!ch->enabled || !ch->valid) {
+            continue;
+         }
+         stat_shm_rail_t *rail = &snap->rails[snap->rail_count++];
+         snprintf(rail->label, sizeof(rail->label), "%s", ch->label);
+         rail->voltage_v = ch->voltage;
+         rail->current_a = ch->current;
+         rail->power_w = ch->power;
+      }
+      if (snap->rail_count > 0) {
+         snap->valid |= STAT_SHM_RAILS;
+      }
+   }
+
+   snap->valid |= STAT_SHM_CPU | STAT_SHM_MEMORY;
+   snap->cpu_usage_pct = metrics->cpu_usage;
+   snap->memory_usage_pct = metrics->memory_usage;
+   if (metrics->system_temp_available) {
+      snap->valid |= STAT_SHM_THERMAL;
+      snap->system_temp_c = metrics->system_temperature;
+   }
+   if (metrics->fan_available) {
+      snap->valid |= STAT_SHM_FAN;
+      snap->fan_rpm = metrics->fan_rpm;
+      snap->fan_load_pct = metrics->fan_load;
+   }
+}
+
+/**
+ * @brief --bms-diag: poll the BMS packs back to back and report link quality
+ *
+ * @return int Process exit status
+ */
+static int run_bms_diag(int polls) {
+   discovery_t disc = { .bms_packs = &bms_packs, .bms_detect = !bms_enable };
+   discover_bms(&disc);
+   if (!disc.bms_ok || bms_packs.count == 0) {
+      OLOG_ERROR("Error: No Daly BMS to diagnose");
+      return EXIT_FAILURE;
+   }
+   daly_packs_start(&bms_packs);
+
+   signal(SIGINT, signal_handler);
+   signal(SIGTERM, signal_handler);
+
+   int ok[DALY_MAX_PACKS] = { 0 };
+   int done = 0;
+   struct timespec start, end;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   while (done < polls && g_running) {
+      daly_packs_poll(&bms_packs);
+      for (int i = 0; i < bms_packs.count; i++) {
+         ok[i] += bms_packs.packs[i].poll_result == 0;
+      }
+      done++;
+   }
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   double elapsed_s = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+   printf("\nDaly BMS link diagnostics: %d polls in %.1f s (%.0f ms per poll)\n\n", done,
+          elapsed_s, done > 0 ? elapsed_s * 1000.0 / done : 0.0);
+   for (int i = 0; i < bms_packs.count; i++) {
+      printf("Pack %d: %d of %d polls complete\n", i + 1, ok[i], done);
+      daly_bms_print_link(&bms_packs.packs[i].dev);
+      printf("\n");
+   }
+
+   daly_packs_close(&bms_packs);
+   return EXIT_SUCCESS;
+}
+
 /**
  * @brief Main application entry point
  */
 int main(int argc, char *argv[]) {
+   clock_gettime(CLOCK_MONOTONIC, &startup_t0);
+
    /* Command line options */
    const char *i2c_bus = "/dev/i2c-1";
    uint8_t i2c_addr = INA238_BASEADDR;
@@ -664,6 +1348,10 @@ int main(int argc, char *argv[]) {
    char mqtt_username[128] = "";
    char mqtt_password[128] = "";
    int mqtt_tls = 0;
+   bool mqtt_bundle = false;
+   bool mqtt_v5 = false;
+   bool mqtt_priority = false;
+   long mqtt_expiry_s = -1; /* -1 until set by option or environment */
    char mqtt_tls_ca_cert[256] = "";
 
    snprintf(bms_port, sizeof(bms_port), "%s", "/dev/ttyTHS1");
@@ -693,6 +1381,10 @@ int main(int argc, char *argv[]) {
                                            { "bms-set-soc", required_argument, 0, 2005 },
                                            { "bms-warn-thresh", required_argument, 0, 2006 },
                                            { "bms-crit-thresh", required_argument, 0, 2007 },
+                                           { "bms-detect-cache", required_argument, 0, 2008 },
+                                           { "bms-pack", required_argument, 0, 2009 },
+                                           { "bms-scan", required_argument, 0, 2010 },
+                                           { "bms-diag", optional_argument, 0, 2011 },
                                            { "mqtt-host", required_argument, 0, 'H' },
                                            { "mqtt-port", required_argument, 0, 'P' },
                                            { "mqtt-topic", required_argument, 0, 'T' },
@@ -700,13 +1392,32 @@ int main(int argc, char *argv[]) {
                                            { "mqtt-password", required_argument, 0, 3001 },
                                            { "mqtt-tls", no_argument, 0, 3002 },
                                            { "mqtt-ca-cert", required_argument, 0, 3003 },
+                                           { "mqtt-bundle", no_argument, 0, 3004 },
+                                           { "mqtt-v5", no_argument, 0, 3005 },
+                                           { "mqtt-expiry", required_argument, 0, 3006 },
+                                           { "mqtt-priority", no_argument, 0, 3007 },
+                                           { "record", required_argument, 0, 4000 },
+                                           { "replay", required_argument, 0, 4001 },
+                                           { "speed", required_argument, 0, 4002 },
+                                           { "startup-profile", no_argument, 0, 4003 },
+                                           { "sysfs-cache", required_argument, 0, 4004 },
+                                           { "log-sync", no_argument, 0, 4005 },
+                                           { "shm", optional_argument, 0, 4006 },
+                                           { "socket", optional_argument, 0, 4007 },
+                                           { "metrics", optional_argument, 0, 4008 },
+                                           { "events", optional_argument, 0, 4009 },
+                                           { "adaptive", optional_argument, 0, 4010 },
+                                           { "publish-interval", required_argument, 0, 4011 },
                                            { "service", no_argument, 0, 'e' },
                                            { "help", no_argument, 0, 'h' },
                                            { "version", no_argument, 0, 'v' },
                                            { 0, 0, 0, 0 } };
 
    /* Try to detect ARK Electronics Jetson Carrier */
-   if (ark_detect_jetson_carrier(&ark_info) == 0) {
+   uint64_t ark_start = startup_now_us();
+   int ark_rc = ark_detect_jetson_carrier(&ark_info);
+   startup_record("ARK detection", ark_start);
+   if (ark_rc == 0) {
       OLOG_INFO("ARK Electronics Jetson Carrier detected!");
       ark_print_board_info(&ark_info);
 
@@ -870,6 +1581,50 @@ int main(int argc, char *argv[]) {
                return EXIT_FAILURE;
             }
             break;
+         case 2008:  // --bms-detect-cache
+            daly_bms_set_detect_cache(optarg);
+            break;
+         case 2009: {  // --bms-pack
+            char pack_port[64];
+            int pack_baud = 0; /* --bms-baud unless given */
+            uint8_t pack_addr = DALY_BMS_ADDR;
+            if (daly_packs_parse_spec(optarg, pack_port, sizeof(pack_port), &pack_baud,
+                                      &pack_addr) != 0) {
+               OLOG_ERROR("Error: Invalid BMS pack \"%s\" (expected PORT[:BAUD][@BOARD])",
+                          optarg);
+               return EXIT_FAILURE;
+            }
+            if (daly_packs_add(&bms_packs, pack_port, pack_baud, pack_addr) < 0) {
+               OLOG_ERROR("Error: Too many BMS packs, or board %d listed twice on %s", pack_addr,
+                          pack_port);
+               return EXIT_FAILURE;
+            }
+            bms_enable = true;
+            break;
+         }
+         case 2010: {  // --bms-scan
+            char scan_port[64];
+            int scan_baud = 0;
+            if (daly_packs_parse_spec(optarg, scan_port, sizeof(scan_port), &scan_baud, NULL) !=
+                0) {
+               OLOG_ERROR("Error: Invalid BMS scan port \"%s\" (expected PORT[:BAUD])", optarg);
+               return EXIT_FAILURE;
+            }
+            if (bms_scan_count >= DALY_MAX_PACKS) {
+               OLOG_ERROR("Error: At most %d BMS scan ports are supported", DALY_MAX_PACKS);
+               return EXIT_FAILURE;
+            }
+            bms_scan_specs[bms_scan_count++] = optarg;
+            bms_enable = true;
+            break;
+         }
+         case 2011:  // --bms-diag
+            bms_diag_polls = optarg ? atoi(optarg) : 100;
+            if (bms_diag_polls <= 0) {
+               OLOG_ERROR("Error: Invalid BMS diagnostic poll count");
+               return EXIT_FAILURE;
+            }
+            break;
          case 'm':  // --monitor
             if (strcmp(optarg, "ina238") == 0) {
                power_monitor = POWER_MONITOR_INA238;
@@ -916,6 +1671,94 @@ int main(int argc, char *argv[]) {
             mqtt_tls_ca_cert[sizeof(mqtt_tls_ca_cert) - 1] = '\0';
             mqtt_tls = 1; /* Implies TLS */
             break;
+         case 3004:  // mqtt-bundle
+            mqtt_bundle = true;
+            break;
+         case 3005:  // mqtt-v5
+            mqtt_v5 = true;
+            break;
+         case 3006:  // mqtt-expiry
+            mqtt_expiry_s = strtol(optarg, NULL, 10);
+            if (mqtt_expiry_s < 0 || mqtt_expiry_s > 86400) {
+               OLOG_ERROR("Error: MQTT message expiry must be 0-86400 seconds");
+               return EXIT_FAILURE;
+            }
+            break;
+         case 3007:  // mqtt-priority
+            mqtt_priority = true;
+            break;
+         case 4000:  // --record
+            record_path = optarg;
+            break;
+         case 4001:  // --replay
+            replay_path = optarg;
+            break;
+         case 4002:  // --speed
+            if (strcmp(optarg, "max") == 0) {
+               replay_speed = 0.0;
+            } else {
+               replay_speed = atof(optarg);
+               if (replay_speed <= 0.0) {
+                  OLOG_ERROR("Error: Replay speed must be positive or 'max'");
+                  return EXIT_FAILURE;
+               }
+            }
+            break;
+         case 4003:  // --startup-profile
+            startup_profile = true;
+            break;
+         case 4004:  // --sysfs-cache
+            sysfs_cache_path = optarg;
+            break;
+         case 4005:  // --log-sync
+            log_sync = true;
+            break;
+         case 4006:  // --shm
+            shm_name = optarg ? optarg : STAT_SHM_DEFAULT_NAME;
+            if (shm_name[0] != '/' || strchr(shm_name + 1, '/')) {
+               OLOG_ERROR("Error: Shared memory name must be /NAME");
+               return EXIT_FAILURE;
+            }
+            break;
+         case 4007:  // --socket
+            socket_path = optarg ? optarg : STAT_SOCKET_DEFAULT_PATH;
+            break;
+         case 4008:  // --metrics
+            if (stat_metrics_parse_listen(optarg, STAT_METRICS_DEFAULT_PORT, metrics_addr,
+                                          sizeof(metrics_addr), &metrics_port) != 0) {
+               OLOG_ERROR("Error: Invalid metrics address '%s' (expected [ADDR:]PORT)", optarg);
+               return EXIT_FAILURE;
+            }
+            metrics_enable = true;
+            break;
+         case 4009:  // --events
+            if (stat_metrics_parse_listen(optarg, STAT_EVENTS_DEFAULT_PORT, events_addr,
+                                          sizeof(events_addr), &events_port) != 0) {
+               OLOG_ERROR("Error: Invalid events address '%s' (expected [ADDR:]PORT)", optarg);
+               return EXIT_FAILURE;
+            }
+            events_enable = true;
+            break;
+         case 4010:  // --adaptive
+            if (optarg && (sscanf(optarg, "%d:%d", &adaptive_fast_ms, &adaptive_idle_ms) != 2 ||
+                           adaptive_fast_ms < MIN_SAMPLING_INTERVAL_MS ||
+                           adaptive_idle_ms > MAX_SAMPLING_INTERVAL_MS ||
+                           adaptive_fast_ms > adaptive_idle_ms)) {
+               OLOG_ERROR("Error: Invalid adaptive intervals '%s' (expected FAST:IDLE, %d-%d ms)",
+                          optarg, MIN_SAMPLING_INTERVAL_MS, MAX_SAMPLING_INTERVAL_MS);
+               return EXIT_FAILURE;
+            }
+            adaptive_enable = true;
+            break;
+         case 4011:  // --publish-interval
+            publish_interval_ms = atoi(optarg);
+            if (publish_interval_ms < MIN_SAMPLING_INTERVAL_MS ||
+                publish_interval_ms > MAX_PUBLISH_INTERVAL_MS) {
+               OLOG_ERROR("Error: Publish interval must be between %d and %d ms",
+                          MIN_SAMPLING_INTERVAL_MS, MAX_PUBLISH_INTERVAL_MS);
+               return EXIT_FAILURE;
+            }
+            break;
          case 'e':  // service mode
             service_mode = true;
             break;
@@ -960,6 +1803,32 @@ int main(int argc, char *argv[]) {
          mqtt_tls = 1;
       }
    }
+   if (!mqtt_bundle) {
+      const char *env = getenv("MQTT_BUNDLE");
+      if (env && (strcmp(env, "1") == 0 || strcmp(env, "true") == 0)) {
+         mqtt_bundle = true;
+      }
+   }
+   if (!mqtt_v5) {
+      const char *env = getenv("MQTT_V5");
+      if (env && (strcmp(env, "1") == 0 || strcmp(env, "true") == 0)) {
+         mqtt_v5 = true;
+      }
+   }
+   if (!mqtt_priority) {
+      const char *env = getenv("MQTT_PRIORITY");
+      if (env && (strcmp(env, "1") == 0 || strcmp(env, "true") == 0)) {
+         mqtt_priority = true;
+      }
+   }
+   if (mqtt_expiry_s < 0) {
+      const char *env = getenv("MQTT_EXPIRY");
+      mqtt_expiry_s = env ? strtol(env, NULL, 10) : MQTT_DEFAULT_EXPIRY_S;
+      if (mqtt_expiry_s < 0 || mqtt_expiry_s > 86400) {
+         OLOG_WARNING("Warning: Ignoring MQTT_EXPIRY=%s (expected 0-86400)", env);
+         mqtt_expiry_s = MQTT_DEFAULT_EXPIRY_S;
+      }
+   }
 
    /* Battery configuration is now fully resolved (default -> env -> CLI). Log it
     * so the selected pack is visible in both interactive and service mode. */
@@ -968,101 +1837,47 @@ int main(int argc, char *argv[]) {
              battery_config.cells_parallel, battery_config.capacity_mah, battery_config.min_voltage,
              battery_config.max_voltage);
 
-   /* Auto-detect power monitors if not specified - Check INA3221 first */
-   if (power_monitor == POWER_MONITOR_NONE) {
-      bool ina238_available = false;
-      bool ina3221_available = false;
-
-      OLOG_INFO("Auto-detecting available power monitors...");
-
-      /* Check INA3221 first by looking for sysfs path */
-      if (access("/sys/bus/i2c/drivers/ina3221", F_OK) == 0) {
-         /* INA3221 driver exists, try to initialize */
-         ina3221_device_t test_ina3221;
-         if (ina3221_init(&test_ina3221) == 0) {
-            ina3221_available = true;
-            ina3221_close(&test_ina3221);
-            OLOG_INFO("INA3221 detected via sysfs interface");
-         } else {
-            OLOG_INFO("INA3221 driver found but device not accessible");
-         }
-      } else {
-         OLOG_INFO("INA3221 driver not found in sysfs");
-      }
-
-      /* Test INA238 availability (I2C direct access) */
-      ina238_device_t test_ina238;
-      if (ina238_init(&test_ina238, i2c_bus, i2c_addr, r_shunt, max_current) == 0) {
-         ina238_available = true;
-         ina238_close(&test_ina238);
-         OLOG_INFO("INA238 detected on I2C bus");
-      } else {
-         OLOG_INFO("INA238 not found or not accessible");
-      }
-
-      /* Determine which monitors to use - prefer INA3221 for modern systems */
-      if (ina3221_available && ina238_available) {
-         power_monitor = POWER_MONITOR_BOTH;
-         OLOG_INFO("Auto-selected: Both INA238 and INA3221 available");
-      } else if (ina3221_available) {
-         power_monitor = POWER_MONITOR_INA3221;
-         OLOG_INFO("Auto-selected: INA3221 (3-channel power monitoring)");
-      } else if (ina238_available) {
-         power_monitor = POWER_MONITOR_INA238;
-         OLOG_INFO("Auto-selected: INA238 (single-channel power monitoring)");
-      } else {
-         OLOG_ERROR("Error: No supported power monitors found");
-         OLOG_ERROR("  - INA3221: Check if driver is loaded: ls /sys/bus/i2c/drivers/ina3221/");
-         OLOG_ERROR("  - INA238: Check I2C bus %s and address 0x%02X", i2c_bus, i2c_addr);
+   /* A replay reproduces the acquisition settings it was recorded with */
+   if (record_path && replay_path) {
+      OLOG_ERROR("Error: --record and --replay cannot be used together");
+      return EXIT_FAILURE;
+   }
+   if ((record_path || replay_path) && (bms_packs.count > 1 || bms_scan_count > 0)) {
+      OLOG_ERROR("Error: --record and --replay support a single BMS pack");
+      return EXIT_FAILURE;
+   }
+   if (bms_diag_polls > 0) {
+      if (record_path || replay_path) {
+         OLOG_ERROR("Error: --bms-diag reads the serial ports and cannot record or replay");
          return EXIT_FAILURE;
       }
+      /* Interactive and synchronous: the report and the discovery log interleave */
+      init_logging(NULL, LOG_TO_CONSOLE);
+      int status = run_bms_diag(bms_diag_polls);
+      close_logging();
+      return status;
    }
-
-   /* Auto-detect Daly BMS if not explicitly enabled */
-   if (!bms_enable) {
-      char detected_port[64];
-      int detected_baud;
-
-      if (daly_bms_auto_detect(detected_port, &detected_baud)) {
-         OLOG_INFO("Auto-detected Daly BMS on %s at %d baud", detected_port, detected_baud);
-         bms_enable = true;
-         snprintf(bms_port, sizeof(bms_port), "%s", detected_port);
-         bms_baud = detected_baud; /* Use detected baud rate */
+   if (replay_path) {
+      telemetry_record_header_t header;
+      if (telemetry_replay_open(replay_path, &header) != 0) {
+         return EXIT_FAILURE;
       }
-   }
-
-   /* Initialize Daly BMS if enabled */
-   daly_device_t daly_dev;
-   if (bms_enable) {
-      /* Initialize BMS */
-      if (daly_bms_init(&daly_dev, bms_port, bms_baud, 500) < 0) {
-         OLOG_ERROR("Error: Failed to initialize Daly BMS");
-         bms_enable = false;
-      } else {
-         OLOG_INFO("Daly BMS initialized successfully");
-
-         /* Handle optional one-time operations */
-         if (bms_capacity > 0) {
-            OLOG_INFO("Setting Daly BMS capacity to %d mAh", bms_capacity);
-            if (daly_bms_write_capacity(&daly_dev, bms_capacity, 3600) < 0) {
-               OLOG_ERROR("Failed to set Daly BMS capacity");
-            } else {
-               OLOG_INFO("Daly BMS capacity set successfully");
-            }
-         }
-
-         if (bms_soc >= 0.0f) {
-            OLOG_INFO("Setting Daly BMS SOC to %.1f%%", bms_soc);
-            if (daly_bms_write_soc(&daly_dev, bms_soc) < 0) {
-               OLOG_ERROR("Failed to set Daly BMS SOC");
-            } else {
-               OLOG_INFO("Daly BMS SOC set successfully");
-            }
-         }
+      if (header.power_monitor <= POWER_MONITOR_NONE ||
+          header.power_monitor > POWER_MONITOR_BOTH) {
+         OLOG_ERROR("Error: Recording %s has no power monitor selection", replay_path);
+         telemetry_replay_close();
+         return EXIT_FAILURE;
       }
+      power_monitor = (power_monitor_type_t)header.power_monitor;
+      r_shunt = header.r_shunt;
+      max_current = header.max_current;
+      i2c_addr = header.i2c_addr;
+      bms_enable = header.bms_enable;
+      interval_ms = header.interval_ms;
+      bms_interval_ms = header.bms_interval_ms;
    }
 
-   /* Initialize logging based on mode */
+   /* Initialize logging based on mode (before the discovery threads log) */
    if (service_mode) {
       // Initialize syslog for service mode
       init_syslog("oasis-stat");
@@ -1072,77 +1887,194 @@ int main(int argc, char *argv[]) {
       init_logging(NULL, LOG_TO_CONSOLE);
    }
 
+   /* Keep sampling and MQTT callbacks off the blocking console/syslog writes */
+   if (!log_sync && stat_log_start_async() != 0) {
+      OLOG_WARNING("Failed to start the log writer thread, logging synchronously");
+   }
+
+   /* Validate custom battery configuration */
+   if (custom_battery && battery_config.max_voltage <= battery_config.min_voltage) {
+      OLOG_ERROR("Error: Battery max voltage must be greater than min voltage");
+      return EXIT_FAILURE;
+   }
+
+   /* SOC and derating lookups for the configured chemistry, and the SOC
+    * estimator fusing INA238 current and voltage on top of them */
+   static battery_ekf_t soc_ekf;
+   static battery_rint_t ina238_rint;
+   static battery_runtime_t ina238_runtime;
+   bool soc_ekf_enabled = false;
+   if (battery_model_init_lut(&battery_config) != 0) {
+      OLOG_INFO("No per-cell discharge curve for this battery, using linear SOC");
+   } else {
+      soc_ekf_enabled = battery_ekf_init(&soc_ekf, &battery_config, battery_model_lut()) == 0;
+   }
+
+   /* Hardware discovery. The INA238, the INA3221 and the Daly BMS are probed
+    * on their own threads while MQTT connects and the host monitors initialize
+    * below; whatever answers stays initialized for the main loop. A replay
+    * needs no hardware, only the INA238 calibration for recorded registers. */
+   discovery_t disc = { .i2c_bus = i2c_bus,
+                        .i2c_addr = i2c_addr,
+                        .r_shunt = r_shunt,
+                        .max_current = max_current,
+                        .ina238_dev = &ina238_dev,
+                        .ina3221_dev = &ina3221_dev,
+                        .bms_packs = &bms_packs };
+   pthread_t ina238_thread, ina3221_thread, bms_thread;
+   bool ina238_threaded = false, ina3221_threaded = false, bms_threaded = false;
+
+   if (replay_path) {
+      ina238_init_params(&ina238_dev, i2c_addr, r_shunt, max_current);
+      if (bms_enable) {
+         bms_packs.count = 0;
+         daly_packs_add(&bms_packs, "replay", bms_baud, DALY_BMS_ADDR);
+         daly_bms_init_offline(&bms_packs.packs[0].dev, "replay", 500);
+      }
+      system_metrics.system_temp_available = true;
+   } else {
+      /* Paths resolved last run; hotplug events from here on trigger a rescan */
+      sysfs_discovery_load(sysfs_cache_path);
+      sysfs_discovery_watch_open();
+
+      if (power_monitor == POWER_MONITOR_NONE) {
+         OLOG_INFO("Auto-detecting available power monitors...");
+      }
+      if (power_monitor != POWER_MONITOR_INA3221) {
+         ina238_threaded = start_discovery(&ina238_thread, discover_ina238, &disc);
+      }
+      if (power_monitor != POWER_MONITOR_INA238) {
+         ina3221_threaded = start_discovery(&ina3221_thread, discover_ina3221, &disc);
+      }
+      disc.bms_detect = !bms_enable;
+      bms_threaded = start_discovery(&bms_thread, discover_bms, &disc);
+   }
+
    /* Initialize MQTT */
+   uint64_t step_start = startup_now_us();
    mqtt_security_t mqtt_sec = {
       .username = mqtt_username[0] ? mqtt_username : NULL,
       .password = mqtt_password[0] ? mqtt_password : NULL,
       .tls = mqtt_tls,
       .tls_ca_cert = mqtt_tls_ca_cert[0] ? mqtt_tls_ca_cert : NULL,
    };
+   mqtt_set_bundle(mqtt_bundle);
+   mqtt_set_protocol_v5(mqtt_v5, (unsigned int)mqtt_expiry_s);
+   mqtt_set_priority(mqtt_priority);
    if (mqtt_init(mqtt_host, mqtt_port, mqtt_topic, &mqtt_sec) != 0) {
       OLOG_WARNING("Warning: Failed to initialize MQTT. Continuing without MQTT support.");
    } else {
       OLOG_INFO("MQTT publishing enabled. Topic: %s", mqtt_topic);
-      mqtt_publish_status_online();
    }
+   startup_record("MQTT init (async)", step_start);
 
-   /* Validate custom battery configuration */
-   if (custom_battery && battery_config.max_voltage <= battery_config.min_voltage) {
-      OLOG_ERROR("Error: Battery max voltage must be greater than min voltage");
-      return EXIT_FAILURE;
+   if (shm_name && stat_shm_writer_open(shm_name) != 0) {
+      OLOG_WARNING("Warning: Continuing without the shared-memory snapshot");
+      shm_name = NULL;
+   }
+   if (socket_path && stat_socket_start(socket_path) != 0) {
+      OLOG_WARNING("Warning: Continuing without the local socket");
+      socket_path = NULL;
+   }
+   if (metrics_enable && stat_metrics_start(metrics_addr, metrics_port) != 0) {
+      OLOG_WARNING("Warning: Continuing without the metrics exporter");
+      metrics_enable = false;
+   }
+   if (events_enable && stat_events_start(events_addr, events_port) != 0) {
+      OLOG_WARNING("Warning: Continuing without the event stream");
+      events_enable = false;
    }
 
    /* Initialize signal handler for graceful shutdown */
    signal(SIGINT, signal_handler);
    signal(SIGTERM, signal_handler);
 
-   /* Initialize the selected power monitor(s) */
-   if (power_monitor == POWER_MONITOR_INA238 || power_monitor == POWER_MONITOR_BOTH) {
-      if (ina238_init(&ina238_dev, i2c_bus, i2c_addr, r_shunt, max_current) < 0) {
-         OLOG_ERROR("Error: Failed to initialize INA238 device");
-         if (power_monitor == POWER_MONITOR_INA238) {
-            return EXIT_FAILURE;
-         }
+   if (!replay_path) {
+      step_start = startup_now_us();
+      if (cpu_monitor_init() == 0) {
+         OLOG_INFO("CPU monitoring initialized");
       } else {
-         OLOG_INFO("INA238 initialized successfully");
+         OLOG_WARNING("CPU monitoring initialization failed");
       }
-   }
 
-   if (power_monitor == POWER_MONITOR_INA3221 || power_monitor == POWER_MONITOR_BOTH) {
-      if (ina3221_init(&ina3221_dev) < 0) {
-         OLOG_ERROR("Error: Failed to initialize INA3221 device");
-         if (power_monitor == POWER_MONITOR_INA3221) {
-            return EXIT_FAILURE;
-         }
+      if (memory_monitor_init() == 0) {
+         OLOG_INFO("Memory monitoring initialized");
       } else {
-         OLOG_INFO("INA3221 initialized successfully");
+         OLOG_WARNING("Memory monitoring initialization failed");
       }
-   }
 
-   if (cpu_monitor_init() == 0) {
-      OLOG_INFO("CPU monitoring initialized");
-   } else {
-      OLOG_WARNING("CPU monitoring initialization failed");
-   }
+      if (system_temp_monitor_init() == 0) {
+         system_metrics.system_temp_available = true;
+         OLOG_INFO("System temperature monitoring initialized");
+      } else {
+         OLOG_WARNING("System temperature monitoring initialization failed");
+      }
 
-   if (memory_monitor_init() == 0) {
-      OLOG_INFO("Memory monitoring initialized");
-   } else {
-      OLOG_WARNING("Memory monitoring initialization failed");
-   }
+      if (fan_monitor_init() == 0) {
+         system_metrics.fan_available = true;
+         OLOG_INFO("Fan monitoring initialized");
+      } else {
+         OLOG_WARNING("Fan monitoring initialization failed");
+      }
+      startup_record("Host monitors init", step_start);
+
+      /* Wait for the power monitors. The BMS (whose auto-detect can take a
+       * serial timeout per baud rate) is picked up by the main loop once its
+       * thread finishes, unless recording, where the header needs it now. */
+      step_start = startup_now_us();
+      if (ina238_threaded) {
+         pthread_join(ina238_thread, NULL);
+      }
+      if (ina3221_threaded) {
+         pthread_join(ina3221_thread, NULL);
+      }
+      if (bms_threaded && record_path) {
+         pthread_join(bms_thread, NULL);
+         bms_threaded = false;
+      }
+      startup_record("Discovery wait", step_start);
+
+      /* Select power monitors - prefer INA3221 for modern systems */
+      if (power_monitor == POWER_MONITOR_NONE) {
+         if (disc.ina3221_ok && disc.ina238_ok) {
+            power_monitor = POWER_MONITOR_BOTH;
+            OLOG_INFO("Auto-selected: Both INA238 and INA3221 available");
+         } else if (disc.ina3221_ok) {
+            power_monitor = POWER_MONITOR_INA3221;
+            OLOG_INFO("Auto-selected: INA3221 (3-channel power monitoring)");
+         } else if (disc.ina238_ok) {
+            power_monitor = POWER_MONITOR_INA238;
+            OLOG_INFO("Auto-selected: INA238 (single-channel power monitoring)");
+         } else {
+            OLOG_ERROR("Error: No supported power monitors found");
+            OLOG_ERROR("  - INA3221: Check if driver is loaded: ls /sys/bus/i2c/drivers/ina3221/");
+            OLOG_ERROR("  - INA238: Check I2C bus %s and address 0x%02X", i2c_bus, i2c_addr);
+            return EXIT_FAILURE;
+         }
+      } else {
+         if ((power_monitor == POWER_MONITOR_INA238 || power_monitor == POWER_MONITOR_BOTH) &&
+             !disc.ina238_ok) {
+            OLOG_ERROR("Error: Failed to initialize INA238 device");
+            if (power_monitor == POWER_MONITOR_INA238) {
+               return EXIT_FAILURE;
+            }
+         }
+         if ((power_monitor == POWER_MONITOR_INA3221 || power_monitor == POWER_MONITOR_BOTH) &&
+             !disc.ina3221_ok) {
+            OLOG_ERROR("Error: Failed to initialize INA3221 device");
+            if (power_monitor == POWER_MONITOR_INA3221) {
+               return EXIT_FAILURE;
+            }
+         }
+      }
 
-   if (system_temp_monitor_init() == 0) {
-      system_metrics.system_temp_available = true;
-      OLOG_INFO("System temperature monitoring initialized");
-   } else {
-      OLOG_WARNING("System temperature monitoring initialization failed");
-   }
+      sysfs_discovery_save();
 
-   if (fan_monitor_init() == 0) {
-      system_metrics.fan_available = true;
-      OLOG_INFO("Fan monitoring initialized");
-   } else {
-      OLOG_WARNING("Fan monitoring initialization failed");
+      /* Until the BMS thread reports back, run without it */
+      bms_enable = false;
+      if (!bms_threaded) {
+         finish_bms_discovery(&disc);
+      }
    }
 
    /* Print device status */
@@ -1154,99 +2086,301 @@ int main(int argc, char *argv[]) {
    }
 
    static time_t last_bms_poll = 0;
-   static daly_pack_health_t bms_health = { 0 };
-   static daly_fault_summary_t bms_faults = { 0 };
-   static bool bms_health_valid = false;
+   static daly_packs_summary_t packs_summary = { 0 };
+   static battery_runtime_t packs_runtime;
+   time_t packs_last_ok = 0;
+
+   /* Resistance baselines learned on earlier runs (state-of-health reference;
+    * the BMS packs load theirs once discovery has finished) */
+   if (!replay_path) {
+      battery_rint_load_baselines(BATTERY_RINT_INA238_PATH, &ina238_rint, 1);
+   }
+
+   /* Record/replay setup. The replay tick is the Daly fetch-hook context, so
+    * daly_bms_poll() consumes the frames recorded for the current iteration. */
+   static telemetry_tick_t tick;
+   const telemetry_tick_t *replay_tick = replay_path ? &tick : NULL;
+   struct timespec run_start;
+   uint64_t replay_base_us = 0;
+   long ticks = 0;
+   long bms_polls = 0;
+   uint64_t last_sample_us = 0;
+   uint64_t last_publish_us = 0;
+   uint64_t last_ina3221_us = 0;
+   stat_battery_window_t battery_window;
+   stat_battery_window_t ina3221_windows[INA3221_MAX_CHANNELS];
+   stat_battery_window_reset(&battery_window);
+   for (int i = 0; i < INA3221_MAX_CHANNELS; i++) {
+      stat_battery_window_reset(&ina3221_windows[i]);
+   }
+
+   if (replay_path) {
+      daly_frame_hooks_t hooks = { .fetch_frame = telemetry_replay_fetch_daly_frame,
+                                   .ctx = &tick };
+      daly_bms_set_frame_hooks(&hooks);
+   } else if (record_path) {
+      telemetry_record_header_t header = { .r_shunt = r_shunt,
+                                           .max_current = max_current,
+                                           .i2c_addr = i2c_addr,
+                                           .power_monitor = power_monitor,
+                                           .bms_enable = bms_enable,
+                                           .interval_ms = interval_ms,
+                                           .bms_interval_ms = bms_interval_ms };
+      if (telemetry_record_open(record_path, &header) == 0) {
+         daly_frame_hooks_t hooks = { .on_frame = telemetry_record_daly_frame };
+         daly_bms_set_frame_hooks(&hooks);
+      }
+   }
+   clock_gettime(CLOCK_MONOTONIC, &run_start);
+
+   sample_rate_t sample_rate;
+   sample_rate_init(&sample_rate, adaptive_fast_ms, interval_ms, adaptive_idle_ms);
+   if (adaptive_enable) {
+      OLOG_INFO("Adaptive sampling: %d ms during events, %d ms steady, %d ms idle",
+                sample_rate.fast_ms, sample_rate.steady_ms, sample_rate.idle_ms);
+   }
 
    /* Main monitoring loop */
    while (g_running) {
       float battery_percentage = 0.0F;
 
+      if (replay_path) {
+         int ret = telemetry_replay_next(&tick);
+         if (ret <= 0) {
+            break;
+         }
+         if (ticks == 0) {
+            replay_base_us = tick.t_us;
+         }
+         replay_pace(&run_start, tick.t_us - replay_base_us);
+      } else {
+         telemetry_record_tick();
+      }
+      ticks++;
+      uint64_t tick_start_us = stat_metrics_now_us();
+      mqtt_begin_update();
+
+      /* With --publish-interval, sample every iteration but publish once per window */
+      uint64_t now_us = replay_path ? tick.t_us - replay_base_us : elapsed_us_since(&run_start);
+      bool publish_due = publish_interval_ms == 0 || ticks == 1 ||
+                         now_us - last_publish_us >= (uint64_t)publish_interval_ms * 1000;
+      if (publish_due) {
+         last_publish_us = now_us;
+      }
+
+      /* Deferred BMS bring-up */
+      if (bms_threaded && atomic_load(&disc.bms_done)) {
+         pthread_join(bms_thread, NULL);
+         bms_threaded = false;
+         finish_bms_discovery(&disc);
+      }
+
+      /* Follow hwmon/thermal devices that appeared, vanished or were renumbered */
+      if (!replay_path) {
+         unsigned changes = sysfs_discovery_watch_poll();
+         if (changes) {
+            handle_sysfs_changes(changes, &ina3221_dev,
+                                 power_monitor == POWER_MONITOR_INA3221 ||
+                                    power_monitor == POWER_MONITOR_BOTH,
+                                 &system_metrics);
+         }
+      }
+
       /* Read measurements from INA238 if enabled */
+      uint64_t stage_start_us = stat_metrics_now_us();
       if (power_monitor == POWER_MONITOR_INA238 || power_monitor == POWER_MONITOR_BOTH) {
-         if (ina238_read_measurements(&ina238_dev, &measurements) != 0) {
+         if (read_ina238(&ina238_dev, replay_tick, &measurements) != 0) {
             measurements.valid = false;
          }
 
          /* Calculate battery percentage and publish MQTT for INA238 */
          if (measurements.valid) {
-            battery_percentage = battery_calculate_percentage(measurements.bus_voltage,
-                                                              &battery_config);
-            mqtt_publish_battery_data(&measurements, battery_percentage, &battery_config);
+            /* Sample time from the recording when replaying */
+            uint64_t sample_us = replay_path ? tick.t_us - replay_base_us
+                                             : elapsed_us_since(&run_start);
+            float dt_s = (float)(sample_us - last_sample_us) / 1e6f;
+            last_sample_us = sample_us;
+
+            /* Pack resistance from load steps, then SOC at the curves' reference load */
+            battery_rint_update(&ina238_rint, measurements.bus_voltage, measurements.current, dt_s);
+            if (battery_rint_valid(&ina238_rint)) {
+               battery_config.resistance_ohm = ina238_rint.r_ohm;
+            }
+            battery_percentage = battery_calculate_percentage_loaded(
+                measurements.bus_voltage, measurements.current, &battery_config);
+
+            if (soc_ekf_enabled) {
+               battery_ekf_update(&soc_ekf, measurements.bus_voltage, measurements.current, dt_s);
+            }
+            battery_runtime_update(&ina238_runtime, measurements.current, dt_s);
+
+            if (publish_interval_ms > 0) {
+               stat_battery_window_add(&battery_window, measurements.bus_voltage,
+                                       measurements.current, measurements.power, dt_s);
+            }
+            if (publish_due) {
+               mqtt_publish_battery_data(&measurements, battery_percentage, &battery_config,
+                                         soc_ekf_enabled ? &soc_ekf : NULL, &ina238_rint,
+                                         &ina238_runtime,
+                                         publish_interval_ms > 0 ? &battery_window : NULL);
+            }
+         }
+         /* A window ends with its publish slot, even when this sample failed */
+         if (publish_due) {
+            stat_battery_window_reset(&battery_window);
          }
+         stage_start_us = stat_metrics_stage_done(STAT_STAGE_INA238, stage_start_us);
       }
 
       /* Read measurements from INA3221 if enabled */
       if (power_monitor == POWER_MONITOR_INA3221 || power_monitor == POWER_MONITOR_BOTH) {
-         if (ina3221_read_measurements(&ina3221_dev, &ina3221_measurements) != 0) {
+         if (read_ina3221(&ina3221_dev, replay_tick, &ina3221_measurements) != 0) {
             ina3221_measurements.valid = false;
          }
 
-         /* Publish MQTT for INA3221 */
+         /* Fold each channel into its window, then publish MQTT for INA3221 */
          if (ina3221_measurements.valid) {
-            mqtt_publish_ina3221_data(&ina3221_measurements);
+            uint64_t sample_us = replay_path ? tick.t_us - replay_base_us
+                                             : elapsed_us_since(&run_start);
+            float dt_s = (float)(sample_us - last_ina3221_us) / 1e6f;
+            last_ina3221_us = sample_us;
+
+            for (int i = 0; publish_interval_ms > 0 && i < ina3221_measurements.num_channels;
+                 i++) {
+               const ina3221_channel_t *ch = &ina3221_measurements.channels[i];
+               if (ch->valid) {
+                  stat_battery_window_add(&ina3221_windows[i], ch->voltage, ch->current,
+                                          ch->power, dt_s);
+               }
+            }
+            if (publish_due) {
+               mqtt_publish_ina3221_data(&ina3221_measurements,
+                                         publish_interval_ms > 0 ? ina3221_windows : NULL);
+            }
          }
+         if (publish_due) {
+            for (int i = 0; i < INA3221_MAX_CHANNELS; i++) {
+               stat_battery_window_reset(&ina3221_windows[i]);
+            }
+         }
+         stage_start_us = stat_metrics_stage_done(STAT_STAGE_INA3221, stage_start_us);
       }
 
       /* Read from Daly BMS if enabled */
       if (bms_enable) {
          time_t now = time(NULL);
-         if (now - last_bms_poll >= (bms_interval_ms / 1000)) {
-            if (daly_bms_poll(&daly_dev) == 0) {
-               /* Free previous health data if any */
-               if (bms_health_valid && bms_health.cells) {
-                  daly_bms_free_health(&bms_health);
+         bool poll_due = replay_path ? tick.daly_count > 0
+                                     : now - last_bms_poll >= (bms_interval_ms / 1000);
+         if (poll_due) {
+            bms_polls++;
+            if (daly_packs_poll(&bms_packs) > 0) {
+               for (int i = 0; i < bms_packs.count; i++) {
+                  daly_pack_t *pack = &bms_packs.packs[i];
+                  if (pack->poll_result != 0) {
+                     continue;
+                  }
+
+                  /* Analyze battery health (updates the rolling cell statistics) */
+                  daly_bms_analyze_health(&pack->dev, &pack->health, cell_warning_threshold_mv,
+                                          cell_critical_threshold_mv);
+
+                  /* Categorize faults */
+                  daly_bms_categorize_faults(&pack->dev, &pack->faults);
+
+                  pack->health_valid = true;
+
+                  /* Publish BMS data to MQTT, on a sub-topic per pack when there are several */
+                  int index = bms_packs.count > 1 ? i : -1;
+                  mqtt_publish_daly_bms_data(&pack->dev, &battery_config, &pack->health.runtime,
+                                             index);
+                  mqtt_publish_daly_health_data(&pack->dev, &pack->health, &pack->faults, index);
                }
 
-               /* Analyze battery health */
-               daly_bms_analyze_health(&daly_dev, &bms_health, cell_warning_threshold_mv,
-                                       cell_critical_threshold_mv);
-
-               /* Categorize faults */
-               daly_bms_categorize_faults(&daly_dev, &bms_faults);
-
-               bms_health_valid = true;
-
-               /* Publish BMS data to MQTT */
-               mqtt_publish_daly_bms_data(&daly_dev, &battery_config);
-               mqtt_publish_daly_health_data(&daly_dev, &bms_health, &bms_faults);
+               /* Combined view of parallel packs, with its own load history */
+               if (bms_packs.count > 1) {
+                  daly_packs_summarize(&bms_packs, &packs_summary);
+                  battery_runtime_update(&packs_runtime, -packs_summary.current_a,
+                                         packs_last_ok ? (float)difftime(packs_summary.last_ok,
+                                                                         packs_last_ok)
+                                                       : -1.0f);
+                  packs_last_ok = packs_summary.last_ok;
+                  mqtt_publish_daly_packs_data(&packs_summary);
+               }
 
                last_bms_poll = now;
             }
+            stage_start_us = stat_metrics_stage_done(STAT_STAGE_BMS, stage_start_us);
          }
       }
 
-      /* Now publish the unified data */
-      mqtt_publish_unified_battery((power_monitor == POWER_MONITOR_INA238 ||
-                                    power_monitor == POWER_MONITOR_BOTH)
-                                       ? &measurements
-                                       : NULL,
-                                   bms_enable ? &daly_dev : NULL, &battery_config, max_current);
-
-      /* Read CPU usage */
-      system_metrics.cpu_usage = cpu_monitor_get_usage();
-
-      /* Read memory usage */
-      system_metrics.memory_usage = memory_monitor_get_usage();
+      /* Now publish the unified data, forecast from the source it is based on */
+      const daly_pack_t *bms_pack = bms_enable ? first_valid_pack(&bms_packs) : NULL;
+      bool multi_pack = bms_pack && bms_packs.count > 1;
+      const battery_runtime_t *unified_runtime = multi_pack ? &packs_runtime
+                                                 : bms_pack ? &bms_pack->health.runtime
+                                                            : &ina238_runtime;
+      if (publish_due) {
+         mqtt_publish_unified_battery((power_monitor == POWER_MONITOR_INA238 ||
+                                       power_monitor == POWER_MONITOR_BOTH)
+                                          ? &measurements
+                                          : NULL,
+                                      bms_pack ? &bms_pack->dev : NULL, &battery_config,
+                                      max_current, unified_runtime,
+                                      multi_pack ? &packs_summary : NULL);
+      }
+      stage_start_us = stat_metrics_stage_done(STAT_STAGE_UNIFIED, stage_start_us);
 
-      /* Read system temperature */
-      system_metrics.system_temperature = system_temp_monitor_get_temp();
+      /* Read CPU, memory, system temperature and fan metrics */
+      sample_system_metrics(&system_metrics, replay_tick);
 
       /* Publish cpu, memory, and system temperature to mqtt */
-      mqtt_publish_system_monitoring_data(system_metrics.cpu_usage, system_metrics.memory_usage,
-                                          system_metrics.system_temperature);
+      if (publish_due) {
+         mqtt_publish_system_monitoring_data(system_metrics.cpu_usage,
+                                             system_metrics.memory_usage,
+                                             system_metrics.system_temperature);
+
+         if (system_metrics.fan_available) {
+            mqtt_publish_fan_data(system_metrics.fan_rpm, system_metrics.fan_load,
+                                  system_metrics.fan_pwm);
+         }
+      }
 
-      /* Read fan metrics */
-      if (system_metrics.fan_available) {
-         system_metrics.fan_rpm = fan_monitor_get_rpm();
-         system_metrics.fan_load = fan_monitor_get_load_percent();
-         system_metrics.fan_pwm = fan_monitor_get_pwm();
+      /* With --mqtt-bundle, everything above goes out now as one message */
+      mqtt_publish_bundle();
+      stage_start_us = stat_metrics_stage_done(STAT_STAGE_HOST, stage_start_us);
+
+      /* Same readings for local consumers and scrapers, without the broker */
+      if (shm_name || socket_path || metrics_enable) {
+         static stat_shm_snapshot_t shm_snapshot;
+         fill_shm_snapshot(&shm_snapshot,
+                           (power_monitor == POWER_MONITOR_INA238 ||
+                            power_monitor == POWER_MONITOR_BOTH)
+                               ? &measurements
+                               : NULL,
+                           battery_percentage, bms_pack, multi_pack ? &packs_summary : NULL,
+                           unified_runtime, &battery_config,
+                           (power_monitor == POWER_MONITOR_INA3221 ||
+                            power_monitor == POWER_MONITOR_BOTH)
+                               ? &ina3221_measurements
+                               : NULL,
+                           &system_metrics);
+         stat_shm_writer_publish(&shm_snapshot);
+         stat_socket_publish(&shm_snapshot);
+         if (metrics_enable) {
+            stat_metrics_publish(&shm_snapshot);
+            stat_metrics_publish_mqtt(mqtt_queue_depth(), mqtt_degrade_level(),
+                                      mqtt_dropped_messages());
+         }
+      }
+      stat_events_commit();
+      stat_metrics_stage_done(STAT_STAGE_LOCAL, stage_start_us);
 
-         mqtt_publish_fan_data(system_metrics.fan_rpm, system_metrics.fan_load,
-                               system_metrics.fan_pwm);
+      if (ticks == 1 && startup_profile) {
+         startup_print_profile(startup_now_us());
       }
 
-      if (!service_mode) {
+      /* A max-speed replay benchmarks the pipeline, not the terminal */
+      if (!service_mode && !(replay_path && replay_speed == 0.0)) {
          if (power_monitor == POWER_MONITOR_INA238 || power_monitor == POWER_MONITOR_BOTH) {
             print_header(&ark_info, &battery_config);
          } else {
@@ -1263,10 +2397,16 @@ int main(int argc, char *argv[]) {
          }
 
          /* Print Daly BMS data if enabled */
-         if (bms_enable && bms_health_valid) {
-            print_enhanced_daly_data(&daly_dev, &bms_health, &bms_faults);
-         } else if (bms_enable) {
-            print_daly_bms_data(&daly_dev);
+         for (int i = 0; bms_enable && i < bms_packs.count; i++) {
+            const daly_pack_t *pack = &bms_packs.packs[i];
+            if (bms_packs.count > 1) {
+               printf("\n--- Battery pack %d (%s) ---\n", i + 1, pack->port);
+            }
+            if (pack->health_valid) {
+               print_enhanced_daly_data(&pack->dev, &pack->health, &pack->faults);
+            } else {
+               print_daly_bms_data(&pack->dev);
+            }
          }
 
          print_system_monitoring(&system_metrics);
@@ -1274,31 +2414,65 @@ int main(int argc, char *argv[]) {
          printf("[STAT] Telemetry broadcast to MQTT subscribers.\n");
       }
 
-      /* Sleep for specified interval */
-      i2c_msleep(interval_ms);
+      stat_metrics_stage_done(STAT_STAGE_TICK, tick_start_us);
+
+      /* Sleep for specified interval; a replay is paced by its timestamps */
+      if (!replay_path) {
+         i2c_msleep(adaptive_enable ? next_adaptive_interval(&sample_rate, &measurements, bms_pack)
+                                    : interval_ms);
+      }
+   }
+
+   if (replay_path) {
+      double elapsed_s = (double)elapsed_us_since(&run_start) / 1e6;
+      OLOG_INFO("Replay finished: %ld ticks (%ld BMS polls) in %.3f s, %.1f ticks/s", ticks,
+                bms_polls, elapsed_s, elapsed_s > 0.0 ? (double)ticks / elapsed_s : 0.0);
+      daly_bms_set_frame_hooks(NULL);
+      telemetry_replay_close();
+   } else if (telemetry_record_active()) {
+      OLOG_INFO("Recorded %ld ticks to %s", ticks, record_path);
+      daly_bms_set_frame_hooks(NULL);
+      telemetry_record_close();
+   }
+
+   /* Don't tear down while the BMS is still being probed */
+   if (bms_threaded) {
+      pthread_join(bms_thread, NULL);
+      bms_enable = disc.bms_ok;
    }
 
    /* Cleanup */
    OLOG_INFO("[STAT] Shutting down telemetry collection...");
    OLOG_INFO("[STAT] OFFLINE - Telemetry collection stopped");
-   cpu_monitor_cleanup();
-   memory_monitor_cleanup();
-   system_temp_monitor_cleanup();
-   fan_monitor_cleanup();
+   if (!replay_path) {
+      cpu_monitor_cleanup();
+      memory_monitor_cleanup();
+      system_temp_monitor_cleanup();
+      fan_monitor_cleanup();
+      sysfs_discovery_cleanup();
+      battery_rint_save_baselines(BATTERY_RINT_INA238_PATH, &ina238_rint, 1);
+      for (int i = 0; i < bms_packs.count; i++) {
+         char rint_path[sizeof(DALY_RINT_PATH) + 16];
+         daly_packs_rint_path(i, rint_path, sizeof(rint_path));
+         battery_rint_save_baselines(rint_path, bms_packs.packs[i].health.rint,
+                                     DALY_MAX_CELLS + 1);
+      }
+   }
    mqtt_publish_status_offline();
    mqtt_cleanup();
+   stat_shm_writer_close();
+   stat_socket_stop();
+   stat_metrics_stop();
+   stat_events_stop();
    if (power_monitor == POWER_MONITOR_INA238 || power_monitor == POWER_MONITOR_BOTH) {
       ina238_close(&ina238_dev);
    }
-   if (power_monitor == POWER_MONITOR_INA3221 || power_monitor == POWER_MONITOR_BOTH) {
+   if (!replay_path &&
+       (power_monitor == POWER_MONITOR_INA3221 || power_monitor == POWER_MONITOR_BOTH)) {
       ina3221_close(&ina3221_dev);
    }
-   if (bms_enable && bms_health_valid && bms_health.cells) {
-      daly_bms_free_health(&bms_health);
-   }
-   if (bms_enable) {
-      daly_bms_close(&daly_dev);
-   }
+   daly_packs_close(&bms_packs);
+   stat_log_stop_async();
    close_logging();
 
    return EXIT_SUCCESS;
@@ -0,0 +1,83 @@
+/**
+ * @file sample_rate.c
+ * @brief Adaptive main-loop sampling interval
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * The mean and variance are exponentially weighted per sample, so a load step
+ * keeps the variance high for a few samples after the current settles, and
+ * the interval stays fast until it decays below the threshold.
+ */
+
+#include "sample_rate.h"
+
+#include <math.h>
+
+#include "daly_bms.h"
+
+/**
+ * @brief Start at the steady interval
+ */
+void sample_rate_init(sample_rate_t *sr, int fast_ms, int steady_ms, int idle_ms) {
+   sr->fast_ms = fast_ms;
+   sr->steady_ms = steady_ms < fast_ms ? fast_ms : steady_ms;
+   sr->idle_ms = idle_ms < sr->steady_ms ? sr->steady_ms : idle_ms;
+   sr->interval_ms = sr->steady_ms;
+   sr->mean_a = 0.0f;
+   sr->var_a2 = 0.0f;
+   sr->last_a = 0.0f;
+   sr->primed = false;
+   sr->calm = 0;
+}
+
+/**
+ * @brief Fold in one iteration's readings and pick the next interval
+ */
+int sample_rate_update(sample_rate_t *sr, float current_a, int state, bool alarm) {
+   bool event = alarm;
+
+   if (!sr->primed) {
+      sr->mean_a = current_a;
+      sr->primed = true;
+   } else {
+      float diff = current_a - sr->mean_a;
+      float slew = fabsf(current_a - sr->last_a) / ((float)sr->interval_ms / 1000.0f);
+
+      sr->mean_a += SAMPLE_RATE_ALPHA * diff;
+      sr->var_a2 = (1.0f - SAMPLE_RATE_ALPHA) * (sr->var_a2 + SAMPLE_RATE_ALPHA * diff * diff);
+      event = event || sr->var_a2 > SAMPLE_RATE_EVENT_STDDEV_A * SAMPLE_RATE_EVENT_STDDEV_A ||
+              slew > SAMPLE_RATE_EVENT_SLEW_A_S;
+   }
+   sr->last_a = current_a;
+
+   int ceiling = (state == DALY_STATE_IDLE) ? sr->idle_ms : sr->steady_ms;
+   if (event) {
+      sr->interval_ms = sr->fast_ms;
+      sr->calm = 0;
+   } else if (sr->interval_ms > ceiling) {
+      /* Idle ended: no slower than the steady rate */
+      sr->interval_ms = ceiling;
+      sr->calm = 0;
+   } else if (++sr->calm >= SAMPLE_RATE_CALM_SAMPLES) {
+      sr->interval_ms = sr->interval_ms * 2 > ceiling ? ceiling : sr->interval_ms * 2;
+      sr->calm = 0;
+   }
+   return sr->interval_ms;
+}
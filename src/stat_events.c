@@ -0,0 +1,768 @@
+/**
+ * @file stat_events.c
+ * @brief Server-Sent Events stream of the telemetry messages
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * Messages are framed as SSE events ("data: <json>\n\n") as they are pushed.
+ * The main loop takes batch_lock only to copy its finished batch in; the
+ * server copies it out before touching any client.
+ *
+ * The server keeps the latest event of each kind (message type, and pack for
+ * per-pack messages) with its position in the stream. A client that is due
+ * gets every kind that changed since its last delivery, oldest first, so the
+ * batches skipped for its rate are merged rather than lost.
+ */
+
+#include "stat_events_internal.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stat_log.h"
+
+#define REQUEST_MAX 512
+#define HOUSEKEEPING_MS 1000
+#define LATEST_MAX 64 /* Event kinds kept for merging (types x packs) */
+#define KEY_MAX 48
+
+/* epoll tags beyond the client slots */
+#define TAG_LISTEN STAT_EVENTS_MAX_CLIENTS
+#define TAG_WAKE (STAT_EVENTS_MAX_CLIENTS + 1)
+
+/**
+ * @brief One HTTP client
+ */
+typedef struct {
+   int fd;                    /**< -1 when the slot is free */
+   bool streaming;            /**< Request answered, receiving batches */
+   char request[REQUEST_MAX]; /**< Request headers read so far */
+   size_t request_len;
+   uint64_t accepted_ms;
+   uint8_t *ring;             /**< Pending output, STAT_EVENTS_CLIENT_RING bytes */
+   size_t head;               /**< Offset of the first pending byte */
+   size_t len;                /**< Pending bytes */
+   bool want_out;             /**< EPOLLOUT armed */
+   uint32_t interval_ms;      /**< Minimum time between batches */
+   uint64_t next_due_ms;      /**< When the next batch is due, 0 for the first */
+   uint64_t sent_seq;         /**< Stream position of the last event queued */
+   uint64_t last_write_ms;    /**< When anything was last queued, for keepalives */
+} client_t;
+
+/**
+ * @brief Latest event of one kind
+ */
+typedef struct {
+   char key[KEY_MAX]; /**< "" when the slot is free */
+   char *event;       /**< Framed event */
+   size_t len;
+   size_t cap;
+   uint64_t seq;      /**< Stream position */
+} latest_t;
+
+/* Main loop only */
+static char building[STAT_EVENTS_BATCH_SIZE];
+static size_t building_len = 0;
+static unsigned long oversized_messages = 0;
+
+/* Shared with the main loop, under batch_lock */
+static pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;
+static char ready[STAT_EVENTS_BATCH_SIZE];
+static size_t ready_len = 0;
+
+/* Server state */
+static int listen_fd = -1;
+static int epoll_fd = -1;
+static int wake_fd = -1;
+static int bound_port = -1;
+static pthread_t server_thread;
+static atomic_bool serving = false;
+static atomic_bool stop_requested = false;
+static atomic_ulong dropped_clients = 0;
+static atomic_int streaming_clients = 0;
+
+/* Server thread only */
+static client_t clients[STAT_EVENTS_MAX_CLIENTS];
+static char sending[STAT_EVENTS_BATCH_SIZE];
+static latest_t latest[LATEST_MAX];
+static uint64_t event_seq = 0;
+
+/**
+ * @brief Monotonic clock in milliseconds
+ */
+static uint64_t monotonic_ms(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+/**
+ * @brief Whether the stream is being served
+ */
+bool stat_events_active(void) {
+   return atomic_load(&serving);
+}
+
+/**
+ * @brief Add a JSON message to this iteration's batch
+ */
+void stat_events_push(const char *json, size_t len) {
+   static const char prefix[] = "data: ";
+   size_t framed = sizeof(prefix) - 1 + len + 2;
+
+   if (!atomic_load(&serving) || !json) {
+      return;
+   }
+   if (building_len + framed > sizeof(building)) {
+      if (oversized_messages++ == 0) {
+         OLOG_WARNING("Event batch full (%d bytes); dropping messages",
+                      STAT_EVENTS_BATCH_SIZE);
+      }
+      return;
+   }
+
+   memcpy(building + building_len, prefix, sizeof(prefix) - 1);
+   memcpy(building + building_len + sizeof(prefix) - 1, json, len);
+   memcpy(building + building_len + framed - 2, "\n\n", 2);
+   building_len += framed;
+}
+
+/**
+ * @brief Hand this iteration's batch to the server and start a new one
+ */
+void stat_events_commit(void) {
+   if (!atomic_load(&serving) || building_len == 0) {
+      return;
+   }
+
+   pthread_mutex_lock(&batch_lock);
+   memcpy(ready, building, building_len);
+   ready_len = building_len;
+   pthread_mutex_unlock(&batch_lock);
+   building_len = 0;
+
+   uint64_t one = 1;
+   if (write(wake_fd, &one, sizeof(one)) < 0) {
+      /* Counter saturated: the server is already due to wake */
+   }
+}
+
+/**
+ * @brief Disconnect a client and free its slot
+ */
+static void client_close(client_t *client) {
+   if (client->fd < 0) {
+      return;
+   }
+   if (client->streaming) {
+      atomic_fetch_sub(&streaming_clients, 1);
+   }
+   epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+   close(client->fd);
+   free(client->ring);
+   memset(client, 0, sizeof(*client));
+   client->fd = -1;
+}
+
+/**
+ * @brief Append bytes to a client's ring, -1 if they do not fit
+ */
+static int ring_put(client_t *client, const void *data, size_t len) {
+   if (client->len + len > STAT_EVENTS_CLIENT_RING) {
+      return -1;
+   }
+
+   size_t tail = (client->head + client->len) % STAT_EVENTS_CLIENT_RING;
+   size_t first = STAT_EVENTS_CLIENT_RING - tail;
+   if (first > len) {
+      first = len;
+   }
+   memcpy(client->ring + tail, data, first);
+   memcpy(client->ring, (const uint8_t *)data + first, len - first);
+   client->len += len;
+   return 0;
+}
+
+/**
+ * @brief Write out as much of the ring as the socket takes
+ */
+static void client_flush(client_t *client, int slot) {
+   while (client->len > 0) {
+      size_t chunk = STAT_EVENTS_CLIENT_RING - client->head;
+      if (chunk > client->len) {
+         chunk = client->len;
+      }
+      ssize_t n = send(client->fd, client->ring + client->head, chunk,
+                       MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+         }
+         client_close(client);
+         return;
+      }
+      client->head = (client->head + (size_t)n) % STAT_EVENTS_CLIENT_RING;
+      client->len -= (size_t)n;
+   }
+
+   bool want_out = client->len > 0;
+   if (want_out != client->want_out) {
+      struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP | (want_out ? EPOLLOUT : 0),
+                                .data.u32 = (uint32_t)slot };
+      client->want_out = want_out;
+      epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &ev);
+   }
+}
+
+/**
+ * @brief Best-effort error response, then disconnect
+ */
+static void client_reject(client_t *client, const char *status) {
+   char response[160];
+   int n = snprintf(response, sizeof(response),
+                    "HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+   if (send(client->fd, response, (size_t)n, MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {
+      /* Closing anyway */
+   }
+   client_close(client);
+}
+
+/**
+ * @brief Minimum batch interval for a "?hz=N" query, capped at STAT_EVENTS_MAX_HZ
+ */
+static uint32_t interval_for_query(const char *query, size_t len) {
+   uint32_t floor_ms = 1000 / STAT_EVENTS_MAX_HZ;
+
+   for (size_t i = 0; i + 3 < len; i++) {
+      if ((i == 0 || query[i - 1] == '&') && strncmp(query + i, "hz=", 3) == 0) {
+         double hz = strtod(query + i + 3, NULL);
+         if (hz > 0.0) {
+            double ms = 1000.0 / hz;
+            return ms > floor_ms ? (ms < 3600000.0 ? (uint32_t)ms : 3600000u) : floor_ms;
+         }
+      }
+   }
+   return floor_ms;
+}
+
+/**
+ * @brief Parse a complete request; start the stream or reject it
+ */
+static void client_start(client_t *client, int slot) {
+   if (strncmp(client->request, "GET ", 4) != 0) {
+      client_reject(client, "405 Method Not Allowed");
+      return;
+   }
+
+   const char *target = client->request + 4;
+   size_t path_len = strcspn(target, "? \r\n");
+   if (path_len != strlen("/events") || strncmp(target, "/events", path_len) != 0) {
+      client_reject(client, "404 Not Found");
+      return;
+   }
+   size_t query_len = 0;
+   if (target[path_len] == '?') {
+      query_len = strcspn(target + path_len + 1, " \r\n");
+   }
+   client->interval_ms = interval_for_query(target + path_len + 1, query_len);
+
+   /* Any origin: dashboards are often opened from a file or another host */
+   char header[320];
+   int n = snprintf(header, sizeof(header),
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: text/event-stream\r\n"
+                    "Cache-Control: no-cache\r\n"
+                    "Connection: keep-alive\r\n"
+                    "Access-Control-Allow-Origin: *\r\n"
+                    "\r\n"
+                    "retry: %d\n\n",
+                    STAT_EVENTS_RETRY_MS);
+   ring_put(client, header, (size_t)n);
+   client->streaming = true;
+   client->next_due_ms = 0;
+   client->sent_seq = event_seq;
+   client->last_write_ms = monotonic_ms();
+   atomic_fetch_add(&streaming_clients, 1);
+   client_flush(client, slot);
+}
+
+/**
+ * @brief Read from a client: its request, or just end of stream
+ */
+static void client_read(client_t *client, int slot) {
+   for (;;) {
+      char discard[256];
+      char *buf = client->streaming ? discard : client->request + client->request_len;
+      size_t room = client->streaming ? sizeof(discard)
+                                      : sizeof(client->request) - 1 - client->request_len;
+      if (room == 0) {
+         client_reject(client, "431 Request Header Fields Too Large");
+         return;
+      }
+
+      ssize_t n = recv(client->fd, buf, room, MSG_DONTWAIT);
+      if (n < 0 && errno == EINTR) {
+         continue;
+      }
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+         return;
+      }
+      if (n <= 0) {
+         client_close(client);
+         return;
+      }
+      if (client->streaming) {
+         continue;
+      }
+
+      client->request_len += (size_t)n;
+      client->request[client->request_len] = '\0';
+      if (strstr(client->request, "\r\n\r\n") || strstr(client->request, "\n\n")) {
+         client_start(client, slot);
+         return;
+      }
+   }
+}
+
+/**
+ * @brief Accept pending connections into free slots
+ */
+static void accept_clients(void) {
+   for (;;) {
+      int fd = accept(listen_fd, NULL, NULL);
+      if (fd < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         return;
+      }
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+      int slot = -1;
+      for (int i = 0; i < STAT_EVENTS_MAX_CLIENTS; i++) {
+         if (clients[i].fd < 0) {
+            slot = i;
+            break;
+         }
+      }
+      uint8_t *ring = slot >= 0 ? malloc(STAT_EVENTS_CLIENT_RING) : NULL;
+      if (!ring) {
+         static const char busy[] =
+             "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+         if (send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {
+            /* Closing anyway */
+         }
+         close(fd);
+         continue;
+      }
+
+      client_t *client = &clients[slot];
+      memset(client, 0, sizeof(*client));
+      client->fd = fd;
+      client->ring = ring;
+      client->accepted_ms = monotonic_ms();
+      struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u32 = (uint32_t)slot };
+      if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+         close(fd);
+         free(ring);
+         client->fd = -1;
+         client->ring = NULL;
+      }
+   }
+}
+
+/**
+ * @brief Find a quoted JSON key in an event and return its value, or NULL
+ */
+static const char *event_field(const char *event, size_t len, const char *name) {
+   size_t name_len = strlen(name);
+
+   for (size_t i = 0; i + name_len + 2 < len; i++) {
+      if (event[i] == '"' && strncmp(event + i + 1, name, name_len) == 0 &&
+          event[i + 1 + name_len] == '"') {
+         const char *p = event + i + name_len + 2;
+         while (p < event + len && (*p == ' ' || *p == ':')) {
+            p++;
+         }
+         return p < event + len ? p : NULL;
+      }
+   }
+   return NULL;
+}
+
+/**
+ * @brief Kind of an event: its type and pack, or its place in the batch if untyped
+ */
+static void event_key(const char *event, size_t len, int index, char *key) {
+   const char *type = event_field(event, len, "type");
+   const char *pack = event_field(event, len, "pack");
+
+   if (!type || *type != '"') {
+      snprintf(key, KEY_MAX, "#%d", index);
+      return;
+   }
+   int type_len = (int)strcspn(type + 1, "\"\n");
+   snprintf(key, KEY_MAX, "%.*s/%ld", type_len < KEY_MAX ? type_len : KEY_MAX, type + 1,
+            pack ? strtol(pack, NULL, 10) : 0L);
+}
+
+/**
+ * @brief Make each event of a batch the latest of its kind
+ */
+static void merge_batch(const char *batch, size_t len) {
+   size_t pos = 0;
+
+   for (int index = 0; pos < len; index++) {
+      size_t event_len = len - pos;
+      for (size_t i = pos; i + 1 < len; i++) {
+         if (batch[i] == '\n' && batch[i + 1] == '\n') {
+            event_len = i + 2 - pos;
+            break;
+         }
+      }
+      char key[KEY_MAX];
+      latest_t *slot = NULL;
+
+      event_key(batch + pos, event_len, index, key);
+      for (int i = 0; i < LATEST_MAX && !slot; i++) {
+         if (strcmp(latest[i].key, key) == 0) {
+            slot = &latest[i];
+         }
+      }
+      /* A new kind takes a free slot, or the one that changed longest ago */
+      for (int i = 0; i < LATEST_MAX && !slot; i++) {
+         if (!latest[i].key[0]) {
+            slot = &latest[i];
+         }
+      }
+      for (int i = 0; i < LATEST_MAX && !slot; i++) {
+         slot = &latest[i];
+         for (int j = i + 1; j < LATEST_MAX; j++) {
+            slot = latest[j].seq < slot->seq ? &latest[j] : slot;
+         }
+      }
+
+      if (slot->cap < event_len) {
+         char *grown = realloc(slot->event, event_len);
+         if (!grown) {
+            pos += event_len;
+            continue;
+         }
+         slot->event = grown;
+         slot->cap = event_len;
+      }
+      memcpy(slot->event, batch + pos, event_len);
+      snprintf(slot->key, sizeof(slot->key), "%s", key);
+      slot->len = event_len;
+      slot->seq = ++event_seq;
+      pos += event_len;
+   }
+}
+
+/**
+ * @brief Next unsent latest event after stream position seq, or NULL
+ */
+static const latest_t *latest_after(uint64_t seq) {
+   const latest_t *next = NULL;
+
+   for (int i = 0; i < LATEST_MAX; i++) {
+      if (latest[i].key[0] && latest[i].seq > seq && (!next || latest[i].seq < next->seq)) {
+         next = &latest[i];
+      }
+   }
+   return next;
+}
+
+/**
+ * @brief Whether a client is due; a quarter interval early absorbs main-loop jitter
+ */
+static bool client_due(const client_t *client, uint64_t now) {
+   return now + client->interval_ms / 4 >= client->next_due_ms;
+}
+
+/**
+ * @brief Merge the latest batch in and queue what changed for every client that is due
+ */
+static void distribute_batch(void) {
+   size_t len;
+   uint64_t now = monotonic_ms();
+
+   pthread_mutex_lock(&batch_lock);
+   len = ready_len;
+   memcpy(sending, ready, len);
+   pthread_mutex_unlock(&batch_lock);
+   merge_batch(sending, len);
+
+   for (int i = 0; i < STAT_EVENTS_MAX_CLIENTS; i++) {
+      client_t *client = &clients[i];
+      if (client->fd < 0 || !client->streaming || !client_due(client, now)) {
+         continue;
+      }
+
+      size_t pending = 0;
+      for (const latest_t *e = latest_after(client->sent_seq); e; e = latest_after(e->seq)) {
+         pending += e->len;
+      }
+      if (client->len + pending > STAT_EVENTS_CLIENT_RING) {
+         /* Slowest reader: let it go rather than hold the batch for it */
+         OLOG_WARNING("Event client too slow (%zu bytes pending); disconnecting", client->len);
+         atomic_fetch_add(&dropped_clients, 1);
+         client_close(client);
+         continue;
+      }
+      for (const latest_t *e = latest_after(client->sent_seq); e; e = latest_after(e->seq)) {
+         ring_put(client, e->event, e->len);
+      }
+      client->sent_seq = event_seq;
+
+      /* Keep to the schedule, but start over after falling a whole interval behind */
+      client->next_due_ms = client->next_due_ms ? client->next_due_ms + client->interval_ms
+                                                : now + client->interval_ms;
+      if (client->next_due_ms + client->interval_ms / 4 <= now) {
+         client->next_due_ms = now + client->interval_ms;
+      }
+      client->last_write_ms = now;
+      client_flush(client, i);
+   }
+}
+
+/**
+ * @brief Time out stalled requests and keep idle streams alive
+ */
+static void housekeeping(void) {
+   static const char keepalive[] = ": keepalive\n\n";
+   uint64_t now = monotonic_ms();
+
+   for (int i = 0; i < STAT_EVENTS_MAX_CLIENTS; i++) {
+      client_t *client = &clients[i];
+      if (client->fd < 0) {
+         continue;
+      }
+      if (!client->streaming) {
+         if (now - client->accepted_ms > STAT_EVENTS_REQUEST_TIMEOUT_MS) {
+            client_reject(client, "408 Request Timeout");
+         }
+      } else if (now - client->last_write_ms > STAT_EVENTS_KEEPALIVE_MS) {
+         if (ring_put(client, keepalive, sizeof(keepalive) - 1) == 0) {
+            client->last_write_ms = now;
+            client_flush(client, i);
+         }
+      }
+   }
+}
+
+/**
+ * @brief Server thread: the epoll loop
+ */
+static void *server_main(void *arg) {
+   (void)arg;
+   struct epoll_event events[STAT_EVENTS_MAX_CLIENTS + 2];
+   uint64_t last_housekeeping = monotonic_ms();
+
+   while (!atomic_load(&stop_requested)) {
+      int n = epoll_wait(epoll_fd, events, STAT_EVENTS_MAX_CLIENTS + 2, HOUSEKEEPING_MS);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         OLOG_ERROR("Event server epoll failed: %s", strerror(errno));
+         break;
+      }
+
+      for (int i = 0; i < n; i++) {
+         uint32_t tag = events[i].data.u32;
+         if (tag == TAG_LISTEN) {
+            accept_clients();
+         } else if (tag == TAG_WAKE) {
+            uint64_t count;
+            if (read(wake_fd, &count, sizeof(count)) == sizeof(count) &&
+                !atomic_load(&stop_requested)) {
+               distribute_batch();
+            }
+         } else {
+            client_t *client = &clients[tag];
+            if (client->fd < 0) {
+               continue;
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+               client_close(client);
+               continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+               client_read(client, (int)tag);
+            }
+            if (client->fd >= 0 && (events[i].events & EPOLLOUT)) {
+               client_flush(client, (int)tag);
+            }
+         }
+      }
+
+      uint64_t now = monotonic_ms();
+      if (now - last_housekeeping >= HOUSEKEEPING_MS) {
+         housekeeping();
+         last_housekeeping = now;
+      }
+   }
+   return NULL;
+}
+
+/**
+ * @brief Close the server's descriptors
+ */
+static void server_close_fds(void) {
+   if (epoll_fd >= 0) {
+      close(epoll_fd);
+      epoll_fd = -1;
+   }
+   if (wake_fd >= 0) {
+      close(wake_fd);
+      wake_fd = -1;
+   }
+   if (listen_fd >= 0) {
+      close(listen_fd);
+      listen_fd = -1;
+   }
+   bound_port = -1;
+}
+
+/**
+ * @brief Start the HTTP listener
+ */
+int stat_events_start(const char *addr, int port) {
+   if (listen_fd >= 0) {
+      return 0;
+   }
+
+   struct sockaddr_in sin = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+   if (!addr || inet_pton(AF_INET, addr, &sin.sin_addr) != 1) {
+      OLOG_ERROR("Invalid events listen address: %s", addr ? addr : "(null)");
+      return -1;
+   }
+
+   for (int i = 0; i < STAT_EVENTS_MAX_CLIENTS; i++) {
+      clients[i].fd = -1;
+   }
+
+   int one = 1;
+   listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   if (listen_fd < 0) {
+      OLOG_ERROR("Cannot create events socket: %s", strerror(errno));
+      return -1;
+   }
+   setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+   if (bind(listen_fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 ||
+       listen(listen_fd, STAT_EVENTS_MAX_CLIENTS) < 0) {
+      OLOG_ERROR("Cannot listen for events on %s:%d: %s", addr, port, strerror(errno));
+      server_close_fds();
+      return -1;
+   }
+
+   socklen_t sin_len = sizeof(sin);
+   getsockname(listen_fd, (struct sockaddr *)&sin, &sin_len);
+   bound_port = ntohs(sin.sin_port);
+
+   wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+   struct epoll_event listen_ev = { .events = EPOLLIN, .data.u32 = TAG_LISTEN };
+   struct epoll_event wake_ev = { .events = EPOLLIN, .data.u32 = TAG_WAKE };
+   if (wake_fd < 0 || epoll_fd < 0 ||
+       epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_ev) < 0 ||
+       epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &wake_ev) < 0) {
+      OLOG_ERROR("Cannot serve events: %s", strerror(errno));
+      server_close_fds();
+      return -1;
+   }
+
+   atomic_store(&stop_requested, false);
+   if (pthread_create(&server_thread, NULL, server_main, NULL) != 0) {
+      OLOG_ERROR("Cannot start event server thread");
+      server_close_fds();
+      return -1;
+   }
+
+   building_len = 0;
+   atomic_store(&serving, true);
+   OLOG_INFO("Streaming events on http://%s:%d/events", addr, bound_port);
+   return 0;
+}
+
+/**
+ * @brief Port the listener is bound to
+ */
+int stat_events_bound_port(void) {
+   return bound_port;
+}
+
+/**
+ * @brief Clients disconnected because their ring was full
+ */
+unsigned long stat_events_dropped_clients(void) {
+   return atomic_load(&dropped_clients);
+}
+
+/**
+ * @brief Clients currently streaming
+ */
+int stat_events_streaming_clients(void) {
+   return atomic_load(&streaming_clients);
+}
+
+/**
+ * @brief Stop the listener and disconnect the clients
+ */
+void stat_events_stop(void) {
+   if (listen_fd < 0) {
+      return;
+   }
+
+   uint64_t one = 1;
+   atomic_store(&serving, false);
+   atomic_store(&stop_requested, true);
+   if (write(wake_fd, &one, sizeof(one)) < 0) {
+      /* Already woken */
+   }
+   pthread_join(server_thread, NULL);
+
+   for (int i = 0; i < STAT_EVENTS_MAX_CLIENTS; i++) {
+      client_close(&clients[i]);
+   }
+   for (int i = 0; i < LATEST_MAX; i++) {
+      free(latest[i].event);
+   }
+   memset(latest, 0, sizeof(latest));
+   server_close_fds();
+}
@@ -0,0 +1,337 @@
+/**
+ * @file stat_log.c
+ * @brief Asynchronous, rate-limited front end for the shared OASIS logger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * Callers format their message straight into a slot of a bounded lock-free
+ * MPSC ring (per-slot sequence numbers, no locks on the logging path) and
+ * return. A single writer thread drains the ring and passes each line to
+ * log_message(), which does the blocking fprintf()/syslog(). The writer
+ * keys the repeat limit on the formatted text, so one call site logging
+ * different values is never folded together.
+ */
+
+#include "stat_log.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* LOG_ASYNC_SLOTS must be a power of two */
+#define LOG_ASYNC_SLOTS 128
+#define LOG_RATE_BURST 5
+#define LOG_RATE_WINDOW_S 10
+#define LOG_RATE_KEYS 64
+#define LOG_RATE_PROBE 4
+
+typedef struct {
+   atomic_size_t seq; /* == position when free, position + 1 when filled */
+   log_level_t level;
+   const char *file;
+   int line;
+   bool limit;
+   time_t when; /* CLOCK_MONOTONIC seconds at the call */
+   char msg[MAX_LOG_LENGTH];
+} log_record_t;
+
+/* Repeat state for one distinct message (writer thread only) */
+typedef struct {
+   uint64_t hash; /* level + formatted text; 0 = free slot */
+   log_level_t level;
+   const char *file; /* first call site, for the summary line */
+   int line;
+   time_t window_start;
+   int count;
+   unsigned long suppressed;
+   char msg[MAX_LOG_LENGTH];
+} log_rate_key_t;
+
+static log_record_t ring[LOG_ASYNC_SLOTS];
+static atomic_size_t ring_head = 0; /* next position claimed by a producer */
+static size_t ring_tail = 0;        /* next position read by the writer */
+static atomic_ulong ring_dropped = 0;
+static atomic_int async_active = 0;
+static atomic_int async_stop = 0;
+static atomic_int async_producers = 0; /* callers currently inside async_enqueue() */
+static sem_t ring_sem;
+static pthread_t writer_thread;
+static log_rate_key_t rate_keys[LOG_RATE_KEYS];
+
+static time_t monotonic_s(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec;
+}
+
+/* FNV-1a over the level and message text; never returns 0 */
+static uint64_t message_hash(log_level_t level, const char *msg) {
+   uint64_t hash = 14695981039346656037ull;
+
+   hash = (hash ^ (uint64_t)level) * 1099511628211ull;
+   for (const unsigned char *p = (const unsigned char *)msg; *p; p++) {
+      hash = (hash ^ *p) * 1099511628211ull;
+   }
+   return hash ? hash : 1;
+}
+
+/* Claim a ring slot, format into it and publish it. Returns 0 if the ring
+ * was full (the record is counted as dropped). */
+static int async_enqueue(log_level_t level,
+                         const char *file,
+                         int line,
+                         bool limit,
+                         const char *fmt,
+                         va_list args) {
+   size_t pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+   log_record_t *rec;
+
+   for (;;) {
+      rec = &ring[pos & (LOG_ASYNC_SLOTS - 1)];
+      size_t seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+      if (diff == 0) {
+         if (atomic_compare_exchange_weak_explicit(&ring_head, &pos, pos + 1,
+                                                   memory_order_relaxed, memory_order_relaxed)) {
+            break;
+         }
+      } else if (diff < 0) {
+         atomic_fetch_add_explicit(&ring_dropped, 1, memory_order_relaxed);
+         return 0;
+      } else {
+         pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+      }
+   }
+
+   rec->level = level;
+   rec->file = file;
+   rec->line = line;
+   rec->limit = limit;
+   rec->when = monotonic_s();
+   vsnprintf(rec->msg, sizeof(rec->msg), fmt, args);
+
+   atomic_store_explicit(&rec->seq, pos + 1, memory_order_release);
+   sem_post(&ring_sem);
+   return 1;
+}
+
+/* Emit the "suppressed" summary for a message, if anything was held back */
+static void rate_summarize(log_rate_key_t *key) {
+   if (key->suppressed == 0) {
+      return;
+   }
+
+   log_message(key->level, key->file, key->line, "Suppressed %lu times in %ds: %s",
+               key->suppressed, LOG_RATE_WINDOW_S, key->msg);
+   key->suppressed = 0;
+}
+
+/* Find (or claim) the repeat state for a message */
+static log_rate_key_t *rate_key(const log_record_t *rec) {
+   uint64_t hash = message_hash(rec->level, rec->msg);
+   log_rate_key_t *oldest = NULL;
+
+   for (int i = 0; i < LOG_RATE_PROBE; i++) {
+      log_rate_key_t *key = &rate_keys[(hash + (uint64_t)i) % LOG_RATE_KEYS];
+      if (key->hash == hash) {
+         return key;
+      }
+      if (!key->hash) {
+         oldest = key;
+         break;
+      }
+      if (!oldest || key->window_start < oldest->window_start) {
+         oldest = key;
+      }
+   }
+
+   /* Evict the least recently started window */
+   if (oldest->hash) {
+      rate_summarize(oldest);
+   }
+   oldest->hash = hash;
+   oldest->level = rec->level;
+   oldest->file = rec->file;
+   oldest->line = rec->line;
+   oldest->window_start = rec->when;
+   oldest->count = 0;
+   oldest->suppressed = 0;
+   snprintf(oldest->msg, sizeof(oldest->msg), "%s", rec->msg);
+   return oldest;
+}
+
+/* Writer-side handling of one record: rate limit, then emit */
+static void async_handle_record(const log_record_t *rec) {
+   if (!rec->limit) {
+      log_message(rec->level, rec->file, rec->line, "%s", rec->msg);
+      return;
+   }
+
+   log_rate_key_t *key = rate_key(rec);
+
+   if (rec->when - key->window_start >= LOG_RATE_WINDOW_S) {
+      rate_summarize(key);
+      key->window_start = rec->when;
+      key->count = 0;
+   }
+
+   if (key->count < LOG_RATE_BURST) {
+      key->count++;
+      log_message(rec->level, rec->file, rec->line, "%s", rec->msg);
+   } else {
+      key->suppressed++;
+   }
+}
+
+/* Summarize messages whose window has ended (all of them when final) */
+static void rate_flush(int final) {
+   time_t now = monotonic_s();
+
+   for (int i = 0; i < LOG_RATE_KEYS; i++) {
+      log_rate_key_t *key = &rate_keys[i];
+      if (key->hash && (final || now - key->window_start >= LOG_RATE_WINDOW_S)) {
+         rate_summarize(key);
+         key->hash = 0;
+      }
+   }
+}
+
+/* Drain every published record */
+static void async_drain(void) {
+   for (;;) {
+      log_record_t *rec = &ring[ring_tail & (LOG_ASYNC_SLOTS - 1)];
+      if (atomic_load_explicit(&rec->seq, memory_order_acquire) != ring_tail + 1) {
+         break;
+      }
+      async_handle_record(rec);
+      atomic_store_explicit(&rec->seq, ring_tail + LOG_ASYNC_SLOTS, memory_order_release);
+      ring_tail++;
+   }
+
+   unsigned long dropped = atomic_exchange_explicit(&ring_dropped, 0, memory_order_relaxed);
+   if (dropped) {
+      log_message(LOGLEVEL_WARNING, __FILE__, __LINE__, "Log buffer full, dropped %lu messages",
+                  dropped);
+   }
+}
+
+/* Writer thread: wait for records (or the 1 s summary tick) and drain */
+static void *async_writer(void *arg) {
+   (void)arg;
+
+   for (;;) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += 1;
+      while (sem_timedwait(&ring_sem, &deadline) != 0 && errno == EINTR) {
+      }
+
+      async_drain();
+      rate_flush(0);
+
+      if (atomic_load_explicit(&async_stop, memory_order_acquire)) {
+         async_drain();
+         rate_flush(1);
+         break;
+      }
+   }
+
+   return NULL;
+}
+
+void stat_log_message(log_level_t level,
+                      const char *file,
+                      int line,
+                      bool limit,
+                      const char *fmt,
+                      ...) {
+   va_list args;
+   va_start(args, fmt);
+
+   atomic_fetch_add(&async_producers, 1);
+   if (atomic_load(&async_active)) {
+      async_enqueue(level, file, line, limit, fmt, args);
+      atomic_fetch_sub(&async_producers, 1);
+      va_end(args);
+      return;
+   }
+   atomic_fetch_sub(&async_producers, 1);
+
+   log_message_v(level, file, line, fmt, args);
+   va_end(args);
+}
+
+int stat_log_start_async(void) {
+   if (atomic_load_explicit(&async_active, memory_order_acquire)) {
+      return 0;
+   }
+
+   for (size_t i = 0; i < LOG_ASYNC_SLOTS; i++) {
+      atomic_store_explicit(&ring[i].seq, i, memory_order_relaxed);
+   }
+   atomic_store_explicit(&ring_head, 0, memory_order_relaxed);
+   ring_tail = 0;
+   memset(rate_keys, 0, sizeof(rate_keys));
+   atomic_store_explicit(&async_stop, 0, memory_order_relaxed);
+
+   if (sem_init(&ring_sem, 0, 0) != 0) {
+      return -1;
+   }
+   if (pthread_create(&writer_thread, NULL, async_writer, NULL) != 0) {
+      sem_destroy(&ring_sem);
+      return -1;
+   }
+
+   /* Early exit() paths still drain the ring */
+   static int atexit_registered = 0;
+   if (!atexit_registered) {
+      atexit(stat_log_stop_async);
+      atexit_registered = 1;
+   }
+
+   atomic_store_explicit(&async_active, 1, memory_order_release);
+   return 0;
+}
+
+void stat_log_stop_async(void) {
+   if (!atomic_exchange(&async_active, 0)) {
+      return;
+   }
+
+   /* Let callers that already saw async_active publish their record, so the
+    * writer's final drain sees it and nobody posts a destroyed semaphore. */
+   while (atomic_load(&async_producers) > 0) {
+      sched_yield();
+   }
+
+   atomic_store_explicit(&async_stop, 1, memory_order_release);
+   sem_post(&ring_sem);
+   pthread_join(writer_thread, NULL);
+   sem_destroy(&ring_sem);
+}
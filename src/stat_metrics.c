@@ -0,0 +1,667 @@
+/**
+ * @file stat_metrics.c
+ * @brief OpenMetrics (Prometheus) exporter
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * The main loop writes the latest snapshot under an in-process sequence lock
+ * (as for the shared-memory segment) and bumps relaxed atomic histogram
+ * counters, so it never takes a lock a scrape could hold. The listener thread
+ * serves one connection at a time, renders into a static buffer and bounds
+ * every socket call with a timeout; a slow scraper only delays other scrapes.
+ */
+
+#include "stat_metrics_internal.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stat_log.h"
+
+#define SNAPSHOT_READ_ATTEMPTS 1000
+#define REQUEST_MAX 1024
+
+/* Histogram bucket upper bounds (microseconds); +Inf is implicit */
+static const uint32_t bucket_bounds_us[] = { 100,   250,    500,    1000,   2500,   5000,   10000,
+                                             25000, 50000,  100000, 250000, 500000, 1000000 };
+#define BUCKET_COUNT (sizeof(bucket_bounds_us) / sizeof(bucket_bounds_us[0]))
+
+static const char *const stage_names[STAT_STAGE_COUNT] = {
+   [STAT_STAGE_INA238] = "ina238",
+   [STAT_STAGE_INA3221] = "ina3221",
+   [STAT_STAGE_BMS] = "bms",
+   [STAT_STAGE_UNIFIED] = "unified",
+   [STAT_STAGE_HOST] = "host",
+   [STAT_STAGE_LOCAL] = "local",
+   [STAT_STAGE_TICK] = "tick",
+};
+
+/**
+ * @brief Latency histogram of one stage (buckets not cumulative)
+ */
+typedef struct {
+   atomic_uint_fast64_t buckets[BUCKET_COUNT + 1];
+   atomic_uint_fast64_t sum_us;
+} stage_histogram_t;
+
+/**
+ * @brief Bounded text output
+ */
+typedef struct {
+   char *buf;
+   size_t size;
+   size_t len;
+   bool overflow;
+} out_t;
+
+/* Written by the main loop */
+static stat_shm_snapshot_t latest;
+static uint32_t latest_seq = 0; /* Odd while latest is being written, 0 before the first */
+static stage_histogram_t histograms[STAT_STAGE_COUNT];
+static atomic_int mqtt_queue = -1; /* -1 until the first report */
+static atomic_int mqtt_level = 0;
+static atomic_ulong mqtt_dropped = 0;
+
+/* Listener */
+static int listen_fd = -1;
+static int wake_fd = -1;
+static int bound_port = -1;
+static pthread_t server_thread;
+
+/* Listener thread only */
+static char request_buf[REQUEST_MAX];
+static char render_buf[STAT_METRICS_BUFFER_SIZE];
+static uint64_t scrapes = 0;
+
+/**
+ * @brief Parse a "[ADDR:]PORT" listen address
+ */
+int stat_metrics_parse_listen(const char *spec, int default_port, char *addr, size_t addr_size,
+                              int *port) {
+   if (!addr || addr_size < INET_ADDRSTRLEN || !port) {
+      return -1;
+   }
+   snprintf(addr, addr_size, "0.0.0.0");
+   *port = default_port;
+   if (!spec || spec[0] == '\0') {
+      return 0;
+   }
+
+   const char *port_str = spec;
+   const char *colon = strrchr(spec, ':');
+   if (colon) {
+      size_t len = (size_t)(colon - spec);
+      struct in_addr parsed;
+      char host[INET_ADDRSTRLEN];
+      if (len == 0 || len >= sizeof(host)) {
+         return -1;
+      }
+      memcpy(host, spec, len);
+      host[len] = '\0';
+      if (inet_pton(AF_INET, host, &parsed) != 1) {
+         return -1;
+      }
+      snprintf(addr, addr_size, "%s", host);
+      port_str = colon + 1;
+   }
+
+   char *end;
+   long value = strtol(port_str, &end, 10);
+   if (end == port_str || *end != '\0' || value < 1 || value > 65535) {
+      return -1;
+   }
+   *port = (int)value;
+   return 0;
+}
+
+/**
+ * @brief Monotonic time for stage timing
+ */
+uint64_t stat_metrics_now_us(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/**
+ * @brief Record one stage duration
+ */
+void stat_metrics_observe(stat_stage_t stage, uint64_t duration_us) {
+   if ((unsigned)stage >= STAT_STAGE_COUNT) {
+      return;
+   }
+
+   size_t bucket = 0;
+   while (bucket < BUCKET_COUNT && duration_us > bucket_bounds_us[bucket]) {
+      bucket++;
+   }
+   stage_histogram_t *h = &histograms[stage];
+   atomic_fetch_add_explicit(&h->buckets[bucket], 1, memory_order_relaxed);
+   atomic_fetch_add_explicit(&h->sum_us, duration_us, memory_order_relaxed);
+}
+
+/**
+ * @brief Record the duration of a stage that began at start_us
+ */
+uint64_t stat_metrics_stage_done(stat_stage_t stage, uint64_t start_us) {
+   uint64_t now = stat_metrics_now_us();
+   stat_metrics_observe(stage, now - start_us);
+   return now;
+}
+
+/**
+ * @brief Store the snapshot later scrapes report
+ */
+void stat_metrics_publish(const stat_shm_snapshot_t *snapshot) {
+   if (!snapshot) {
+      return;
+   }
+
+   /* Single writer: nobody else changes latest_seq */
+   uint32_t seq = latest_seq;
+   __atomic_store_n(&latest_seq, seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   memcpy(&latest, snapshot, sizeof(*snapshot));
+   __atomic_store_n(&latest_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Store the MQTT publish queue state later scrapes report
+ */
+void stat_metrics_publish_mqtt(int queue_depth, int degrade_level, unsigned long dropped) {
+   atomic_store(&mqtt_queue, queue_depth);
+   atomic_store(&mqtt_level, degrade_level);
+   atomic_store(&mqtt_dropped, dropped);
+}
+
+/**
+ * @brief Copy out the latest snapshot, false before the first one
+ */
+static bool read_latest(stat_shm_snapshot_t *snapshot) {
+   for (int attempt = 0; attempt < SNAPSHOT_READ_ATTEMPTS; attempt++) {
+      uint32_t before = __atomic_load_n(&latest_seq, __ATOMIC_ACQUIRE);
+      if (before == 0) {
+         return false;
+      }
+      if (before & 1u) {
+         continue;
+      }
+      memcpy(snapshot, &latest, sizeof(*snapshot));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&latest_seq, __ATOMIC_RELAXED) == before) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * @brief Forget the snapshot and clear the histograms
+ */
+void stat_metrics_reset(void) {
+   __atomic_store_n(&latest_seq, 0, __ATOMIC_RELEASE);
+   memset(&latest, 0, sizeof(latest));
+   for (int s = 0; s < STAT_STAGE_COUNT; s++) {
+      for (size_t b = 0; b <= BUCKET_COUNT; b++) {
+         atomic_store(&histograms[s].buckets[b], 0);
+      }
+      atomic_store(&histograms[s].sum_us, 0);
+   }
+   atomic_store(&mqtt_queue, -1);
+   atomic_store(&mqtt_level, 0);
+   atomic_store(&mqtt_dropped, 0);
+}
+
+/**
+ * @brief Append formatted text, remembering if it did not fit
+ */
+static void out_printf(out_t *out, const char *fmt, ...) {
+   if (out->overflow) {
+      return;
+   }
+   va_list args;
+   va_start(args, fmt);
+   int n = vsnprintf(out->buf + out->len, out->size - out->len, fmt, args);
+   va_end(args);
+   if (n < 0 || (size_t)n >= out->size - out->len) {
+      out->overflow = true;
+      return;
+   }
+   out->len += (size_t)n;
+}
+
+/**
+ * @brief Append a label value with OpenMetrics escaping
+ */
+static void out_label_value(out_t *out, const char *value, size_t max_len) {
+   for (size_t i = 0; i < max_len && value[i] != '\0'; i++) {
+      char c = value[i];
+      if (c == '\\' || c == '"') {
+         out_printf(out, "\\%c", c);
+      } else if (c == '\n') {
+         out_printf(out, "\\n");
+      } else {
+         out_printf(out, "%c", c);
+      }
+   }
+}
+
+/**
+ * @brief Append the TYPE, UNIT and HELP lines of a metric family
+ */
+static void out_family(out_t *out,
+                       const char *name,
+                       const char *type,
+                       const char *unit,
+                       const char *help) {
+   out_printf(out, "# TYPE %s %s\n", name, type);
+   if (unit) {
+      out_printf(out, "# UNIT %s %s\n", name, unit);
+   }
+   out_printf(out, "# HELP %s %s\n", name, help);
+}
+
+/**
+ * @brief Append a family with a single gauge sample
+ */
+static void out_gauge(out_t *out,
+                      const char *name,
+                      const char *unit,
+                      const char *help,
+                      double value) {
+   out_family(out, name, "gauge", unit, help);
+   out_printf(out, "%s %.6g\n", name, value);
+}
+
+/**
+ * @brief Append the battery, cell and rail families
+ */
+static void render_power(out_t *out, const stat_shm_snapshot_t *snap) {
+   if (snap->valid & STAT_SHM_BATTERY) {
+      out_gauge(out, "oasis_stat_battery_voltage_volts", "volts", "Pack voltage.",
+                snap->battery_voltage_v);
+      out_gauge(out, "oasis_stat_battery_current_amperes", "amperes",
+                "Pack current, positive when discharging.", snap->battery_current_a);
+      out_gauge(out, "oasis_stat_battery_power_watts", "watts", "Power drawn from the pack.",
+                snap->battery_power_w);
+      out_gauge(out, "oasis_stat_battery_level_percent", NULL, "State of charge.",
+                snap->battery_level_pct);
+      if (snap->battery_temp_c > STAT_SHM_TEMP_UNKNOWN) {
+         out_gauge(out, "oasis_stat_battery_temperature_celsius", "celsius",
+                   "Warmest pack temperature.", snap->battery_temp_c);
+      }
+      if (snap->time_remaining_min >= 0.0f) {
+         out_gauge(out, "oasis_stat_battery_time_remaining_seconds", "seconds",
+                   "Median time to empty.", snap->time_remaining_min * 60.0);
+      }
+      out_gauge(out, "oasis_stat_battery_charging_state", NULL,
+                "0 discharging, 1 idle, 2 charging.", snap->charging_state);
+      out_gauge(out, "oasis_stat_battery_critical_faults", NULL, "Active critical BMS faults.",
+                snap->critical_faults);
+      out_gauge(out, "oasis_stat_battery_warning_faults", NULL, "Active BMS warnings.",
+                snap->warning_faults);
+   }
+
+   if ((snap->valid & STAT_SHM_CELLS) && snap->cell_count > 0) {
+      uint32_t cells = snap->cell_count < STAT_SHM_MAX_CELLS ? snap->cell_count
+                                                             : STAT_SHM_MAX_CELLS;
+      out_family(out, "oasis_stat_cell_voltage_volts", "gauge", "volts",
+                 "Cell voltage of the first pack.");
+      for (uint32_t i = 0; i < cells; i++) {
+         out_printf(out, "oasis_stat_cell_voltage_volts{cell=\"%u\"} %.3f\n", i + 1,
+                    snap->cell_mv[i] / 1000.0);
+      }
+      out_family(out, "oasis_stat_cell_balancing", "gauge", NULL,
+                 "1 while the cell is being balanced.");
+      for (uint32_t i = 0; i < cells; i++) {
+         out_printf(out, "oasis_stat_cell_balancing{cell=\"%u\"} %u\n", i + 1,
+                    (snap->balancing >> i) & 1u);
+      }
+   }
+
+   if ((snap->valid & STAT_SHM_RAILS) && snap->rail_count > 0) {
+      static const struct {
+         const char *name;
+         const char *unit;
+         const char *help;
+         size_t offset;
+      } rail_metrics[] = {
+         { "oasis_stat_rail_voltage_volts", "volts", "Rail bus voltage.",
+           offsetof(stat_shm_rail_t, voltage_v) },
+         { "oasis_stat_rail_current_amperes", "amperes", "Rail current.",
+           offsetof(stat_shm_rail_t, current_a) },
+         { "oasis_stat_rail_power_watts", "watts", "Rail power.",
+           offsetof(stat_shm_rail_t, power_w) },
+      };
+      uint32_t rails = snap->rail_count < STAT_SHM_MAX_RAILS ? snap->rail_count
+                                                             : STAT_SHM_MAX_RAILS;
+      for (size_t m = 0; m < sizeof(rail_metrics) / sizeof(rail_metrics[0]); m++) {
+         out_family(out, rail_metrics[m].name, "gauge", rail_metrics[m].unit,
+                    rail_metrics[m].help);
+         for (uint32_t i = 0; i < rails; i++) {
+            const stat_shm_rail_t *rail = &snap->rails[i];
+            float value;
+            memcpy(&value, (const char *)rail + rail_metrics[m].offset, sizeof(value));
+            out_printf(out, "%s{rail=\"", rail_metrics[m].name);
+            out_label_value(out, rail->label, sizeof(rail->label));
+            out_printf(out, "\"} %.6g\n", value);
+         }
+      }
+   }
+}
+
+/**
+ * @brief Append the host families
+ */
+static void render_host(out_t *out, const stat_shm_snapshot_t *snap) {
+   if (snap->valid & STAT_SHM_CPU) {
+      out_gauge(out, "oasis_stat_cpu_usage_percent", NULL, "CPU usage.", snap->cpu_usage_pct);
+   }
+   if (snap->valid & STAT_SHM_MEMORY) {
+      out_gauge(out, "oasis_stat_memory_usage_percent", NULL, "Memory usage.",
+                snap->memory_usage_pct);
+   }
+   if (snap->valid & STAT_SHM_THERMAL) {
+      out_gauge(out, "oasis_stat_soc_temperature_celsius", "celsius", "SoC temperature.",
+                snap->system_temp_c);
+   }
+   if (snap->valid & STAT_SHM_FAN) {
+      out_gauge(out, "oasis_stat_fan_speed_rpm", NULL, "Fan speed.", snap->fan_rpm);
+      out_gauge(out, "oasis_stat_fan_load_percent", NULL, "Fan load.", snap->fan_load_pct);
+   }
+}
+
+/**
+ * @brief Append the stage latency histograms
+ */
+static void render_stages(out_t *out) {
+   out_family(out, "oasis_stat_stage_duration_seconds", "histogram", "seconds",
+              "Time spent in each stage of the main loop.");
+   for (int s = 0; s < STAT_STAGE_COUNT; s++) {
+      const stage_histogram_t *h = &histograms[s];
+
+      /* Relaxed counters: a scrape racing an update can be one sample apart */
+      uint64_t cumulative = 0;
+      for (size_t b = 0; b < BUCKET_COUNT; b++) {
+         cumulative += atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+         out_printf(out,
+                    "oasis_stat_stage_duration_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n",
+                    stage_names[s], bucket_bounds_us[b] / 1e6, (unsigned long long)cumulative);
+      }
+      cumulative += atomic_load_explicit(&h->buckets[BUCKET_COUNT], memory_order_relaxed);
+      out_printf(out, "oasis_stat_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n",
+                 stage_names[s], (unsigned long long)cumulative);
+      out_printf(out, "oasis_stat_stage_duration_seconds_count{stage=\"%s\"} %llu\n",
+                 stage_names[s], (unsigned long long)cumulative);
+      out_printf(out, "oasis_stat_stage_duration_seconds_sum{stage=\"%s\"} %.6f\n",
+                 stage_names[s],
+                 atomic_load_explicit(&h->sum_us, memory_order_relaxed) / 1e6);
+   }
+}
+
+/**
+ * @brief Render the exposition from the latest snapshot and the histograms
+ */
+size_t stat_metrics_render(char *buf, size_t size) {
+   out_t out = { .buf = buf, .size = size };
+   stat_shm_snapshot_t snap;
+
+   if (read_latest(&snap)) {
+      out_family(&out, "oasis_stat_snapshot_timestamp_seconds", "gauge", "seconds",
+                 "Wall clock of the main-loop iteration reported.");
+      out_printf(&out, "oasis_stat_snapshot_timestamp_seconds %.3f\n", snap.timestamp_ms / 1000.0);
+      render_power(&out, &snap);
+      render_host(&out, &snap);
+   }
+   render_stages(&out);
+   if (atomic_load(&mqtt_queue) >= 0) {
+      out_family(&out, "oasis_stat_mqtt_queue_depth", "gauge", NULL,
+                 "MQTT messages published and not yet sent or acknowledged.");
+      out_printf(&out, "oasis_stat_mqtt_queue_depth %d\n", atomic_load(&mqtt_queue));
+      out_family(&out, "oasis_stat_mqtt_degrade_level", "gauge", NULL,
+                 "Telemetry held back under backpressure: 0 none, 1 no per-cell detail, "
+                 "2 throttled, 3 battery status and alarms only.");
+      out_printf(&out, "oasis_stat_mqtt_degrade_level %d\n", atomic_load(&mqtt_level));
+      out_family(&out, "oasis_stat_mqtt_dropped_messages", "counter", NULL,
+                 "Telemetry messages not published because of backpressure.");
+      out_printf(&out, "oasis_stat_mqtt_dropped_messages_total %lu\n", atomic_load(&mqtt_dropped));
+   }
+   out_family(&out, "oasis_stat_scrapes", "counter", NULL, "Scrapes served.");
+   out_printf(&out, "oasis_stat_scrapes_total %llu\n", (unsigned long long)scrapes);
+   out_printf(&out, "# EOF\n");
+
+   return out.overflow ? 0 : out.len;
+}
+
+/**
+ * @brief Write all of buf, giving up on error or timeout
+ */
+static int send_all(int fd, const char *buf, size_t len) {
+   while (len > 0) {
+      ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         return -1;
+      }
+      buf += n;
+      len -= (size_t)n;
+   }
+   return 0;
+}
+
+/**
+ * @brief Send a complete HTTP/1.0 response
+ */
+static void send_response(int fd,
+                          const char *status,
+                          const char *content_type,
+                          const char *body,
+                          size_t body_len,
+                          bool head) {
+   char header[256];
+   int n = snprintf(header, sizeof(header),
+                    "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+                    "Connection: close\r\n\r\n",
+                    status, content_type, body_len);
+   if (send_all(fd, header, (size_t)n) == 0 && !head) {
+      send_all(fd, body, body_len);
+   }
+}
+
+/**
+ * @brief Answer one connection
+ */
+static void handle_connection(int fd) {
+   static const char text_type[] = "text/plain; charset=utf-8";
+   struct timeval timeout = { .tv_sec = STAT_METRICS_IO_TIMEOUT_S };
+   size_t len = 0;
+
+   setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+   setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+   /* Only the request line matters; read until the end of the headers */
+   while (len < sizeof(request_buf) - 1) {
+      ssize_t n = recv(fd, request_buf + len, sizeof(request_buf) - 1 - len, 0);
+      if (n < 0 && errno == EINTR) {
+         continue;
+      }
+      if (n <= 0) {
+         break;
+      }
+      len += (size_t)n;
+      request_buf[len] = '\0';
+      if (strstr(request_buf, "\r\n\r\n") || strstr(request_buf, "\n\n")) {
+         break;
+      }
+   }
+   request_buf[len] = '\0';
+
+   bool head = strncmp(request_buf, "HEAD ", 5) == 0;
+   if (!head && strncmp(request_buf, "GET ", 4) != 0) {
+      static const char body[] = "Method not allowed\n";
+      send_response(fd, "405 Method Not Allowed", text_type, body, sizeof(body) - 1, false);
+      return;
+   }
+
+   const char *path = request_buf + (head ? 5 : 4);
+   size_t path_len = strcspn(path, " ?\r\n");
+   if (path_len != strlen("/metrics") || strncmp(path, "/metrics", path_len) != 0) {
+      static const char body[] = "Not found; metrics are at /metrics\n";
+      send_response(fd, "404 Not Found", text_type, body, sizeof(body) - 1, head);
+      return;
+   }
+
+   scrapes++;
+   size_t body_len = stat_metrics_render(render_buf, sizeof(render_buf));
+   if (body_len == 0) {
+      static const char body[] = "Exposition too large\n";
+      OLOG_WARNING("Metrics exposition exceeds %d bytes", STAT_METRICS_BUFFER_SIZE);
+      send_response(fd, "500 Internal Server Error", text_type, body, sizeof(body) - 1, head);
+      return;
+   }
+   send_response(fd, "200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8",
+                 render_buf, body_len, head);
+}
+
+/**
+ * @brief Listener thread
+ */
+static void *server_main(void *arg) {
+   (void)arg;
+   struct pollfd fds[2] = { { .fd = listen_fd, .events = POLLIN },
+                            { .fd = wake_fd, .events = POLLIN } };
+
+   for (;;) {
+      if (poll(fds, 2, -1) < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         OLOG_ERROR("Metrics listener poll failed: %s", strerror(errno));
+         break;
+      }
+      if (fds[1].revents) {
+         break;
+      }
+      if (fds[0].revents & POLLIN) {
+         int fd = accept(listen_fd, NULL, NULL);
+         if (fd >= 0) {
+            handle_connection(fd);
+            close(fd);
+         }
+      }
+   }
+   return NULL;
+}
+
+/**
+ * @brief Close the listener's descriptors
+ */
+static void server_close_fds(void) {
+   if (listen_fd >= 0) {
+      close(listen_fd);
+      listen_fd = -1;
+   }
+   if (wake_fd >= 0) {
+      close(wake_fd);
+      wake_fd = -1;
+   }
+   bound_port = -1;
+}
+
+/**
+ * @brief Start the HTTP listener
+ */
+int stat_metrics_start(const char *addr, int port) {
+   if (listen_fd >= 0) {
+      return 0;
+   }
+
+   struct sockaddr_in sin = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+   if (!addr || inet_pton(AF_INET, addr, &sin.sin_addr) != 1) {
+      OLOG_ERROR("Invalid metrics listen address: %s", addr ? addr : "(null)");
+      return -1;
+   }
+
+   int one = 1;
+   listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (listen_fd < 0) {
+      OLOG_ERROR("Cannot create metrics socket: %s", strerror(errno));
+      return -1;
+   }
+   setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+   if (bind(listen_fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 || listen(listen_fd, 8) < 0) {
+      OLOG_ERROR("Cannot listen for metrics on %s:%d: %s", addr, port, strerror(errno));
+      server_close_fds();
+      return -1;
+   }
+
+   socklen_t sin_len = sizeof(sin);
+   getsockname(listen_fd, (struct sockaddr *)&sin, &sin_len);
+   bound_port = ntohs(sin.sin_port);
+
+   wake_fd = eventfd(0, EFD_CLOEXEC);
+   if (wake_fd < 0 || pthread_create(&server_thread, NULL, server_main, NULL) != 0) {
+      OLOG_ERROR("Cannot start metrics listener thread");
+      server_close_fds();
+      return -1;
+   }
+
+   OLOG_INFO("Serving OpenMetrics on http://%s:%d/metrics", addr, bound_port);
+   return 0;
+}
+
+/**
+ * @brief Port the listener is bound to
+ */
+int stat_metrics_bound_port(void) {
+   return bound_port;
+}
+
+/**
+ * @brief Stop the listener
+ */
+void stat_metrics_stop(void) {
+   if (listen_fd < 0) {
+      return;
+   }
+
+   uint64_t one = 1;
+   if (write(wake_fd, &one, sizeof(one)) < 0) {
+      /* Already woken */
+   }
+   pthread_join(server_thread, NULL);
+   server_close_fds();
+}
@@ -0,0 +1,116 @@
+/**
+ * @file stat_shm.c
+ * @brief Writer of the shared-memory telemetry snapshot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * A segment left behind by a previous run is replaced rather than reused, so
+ * readers still mapping it see its magic cleared and reopen the new one.
+ */
+
+#include "stat_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "stat_log.h"
+
+_Static_assert(sizeof(stat_shm_snapshot_t) % 8 == 0, "snapshot must keep 8-byte alignment");
+_Static_assert(offsetof(stat_shm_segment_t, data) == 24, "segment header layout changed");
+
+/* Writer state */
+static stat_shm_segment_t *segment = NULL;
+static char segment_name[64] = "";
+
+/**
+ * @brief Create (or replace) the segment
+ */
+int stat_shm_writer_open(const char *name) {
+   if (segment) {
+      return 0;
+   }
+   snprintf(segment_name, sizeof(segment_name), "%s", name ? name : STAT_SHM_DEFAULT_NAME);
+
+   /* Readers of a stale segment keep their mapping; give them a new object */
+   shm_unlink(segment_name);
+   int fd = shm_open(segment_name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+   if (fd < 0) {
+      OLOG_ERROR("Cannot create shared memory %s: %s", segment_name, strerror(errno));
+      return -1;
+   }
+   if (ftruncate(fd, sizeof(stat_shm_segment_t)) < 0) {
+      OLOG_ERROR("Cannot size shared memory %s: %s", segment_name, strerror(errno));
+      close(fd);
+      shm_unlink(segment_name);
+      return -1;
+   }
+
+   void *map = mmap(NULL, sizeof(stat_shm_segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      OLOG_ERROR("Cannot map shared memory %s: %s", segment_name, strerror(errno));
+      shm_unlink(segment_name);
+      return -1;
+   }
+
+   /* ftruncate() zero-filled it: sequence 0, no valid sections */
+   segment = map;
+   segment->version = STAT_SHM_VERSION;
+   segment->header_size = offsetof(stat_shm_segment_t, data);
+   segment->snapshot_size = sizeof(stat_shm_snapshot_t);
+   __atomic_store_n(&segment->magic, STAT_SHM_MAGIC, __ATOMIC_RELEASE);
+
+   OLOG_INFO("Publishing telemetry snapshots to shared memory %s", segment_name);
+   return 0;
+}
+
+/**
+ * @brief Publish a snapshot under the sequence lock
+ */
+void stat_shm_writer_publish(const stat_shm_snapshot_t *snapshot) {
+   if (!segment || !snapshot) {
+      return;
+   }
+
+   /* Single writer: nobody else changes seq */
+   uint32_t seq = segment->seq;
+   __atomic_store_n(&segment->seq, seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   memcpy((void *)&segment->data, snapshot, sizeof(*snapshot));
+   __atomic_store_n(&segment->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Mark the segment closed for readers and remove it
+ */
+void stat_shm_writer_close(void) {
+   if (!segment) {
+      return;
+   }
+
+   __atomic_store_n(&segment->magic, 0, __ATOMIC_RELEASE);
+   munmap(segment, sizeof(stat_shm_segment_t));
+   segment = NULL;
+   shm_unlink(segment_name);
+}
@@ -0,0 +1,128 @@
+/**
+ * @file stat_shm_reader.c
+ * @brief Reader for the shared-memory telemetry snapshot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * Kept free of the rest of STAT (no logging) so consumers can build it on
+ * its own. The sequence is read with the GCC/Clang __atomic builtins, which
+ * lets the shared layout stay plain integers that C++ can include too.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "stat_shm.h"
+
+/**
+ * @brief Map the segment for reading
+ */
+int stat_shm_reader_open(stat_shm_reader_t *reader, const char *name) {
+   if (!reader) {
+      errno = EINVAL;
+      return -1;
+   }
+   reader->seg = NULL;
+   reader->size = 0;
+
+   int fd = shm_open(name ? name : STAT_SHM_DEFAULT_NAME, O_RDONLY | O_CLOEXEC, 0);
+   if (fd < 0) {
+      return -1;
+   }
+
+   struct stat st;
+   if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(stat_shm_segment_t)) {
+      close(fd);
+      errno = EPROTO;
+      return -1;
+   }
+
+   void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      return -1;
+   }
+
+   /* The writer stores the magic last, once the rest of the header is set */
+   const stat_shm_segment_t *seg = map;
+   if (__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != STAT_SHM_MAGIC ||
+       seg->version != STAT_SHM_VERSION ||
+       seg->header_size != offsetof(stat_shm_segment_t, data) ||
+       seg->snapshot_size < sizeof(stat_shm_snapshot_t)) {
+      munmap(map, (size_t)st.st_size);
+      errno = EPROTO;
+      return -1;
+   }
+
+   reader->seg = seg;
+   reader->size = (size_t)st.st_size;
+   return 0;
+}
+
+/**
+ * @brief Copy out a consistent snapshot
+ */
+int stat_shm_read(const stat_shm_reader_t *reader,
+                  stat_shm_snapshot_t *snapshot,
+                  uint32_t *generation) {
+   if (!reader || !reader->seg || !snapshot) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   const stat_shm_segment_t *seg = reader->seg;
+   for (int attempt = 0; attempt < STAT_SHM_READ_ATTEMPTS; attempt++) {
+      if (__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != STAT_SHM_MAGIC) {
+         errno = ENOENT;
+         return -1;
+      }
+
+      uint32_t before = __atomic_load_n(&seg->seq, __ATOMIC_ACQUIRE);
+      if (before & 1u) {
+         continue;
+      }
+      memcpy(snapshot, (const void *)&seg->data, sizeof(*snapshot));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&seg->seq, __ATOMIC_RELAXED) == before) {
+         if (generation) {
+            *generation = before / 2;
+         }
+         return 0;
+      }
+   }
+
+   errno = EAGAIN;
+   return -1;
+}
+
+/**
+ * @brief Unmap the segment
+ */
+void stat_shm_reader_close(stat_shm_reader_t *reader) {
+   if (reader && reader->seg) {
+      munmap((void *)reader->seg, reader->size);
+      reader->seg = NULL;
+      reader->size = 0;
+   }
+}
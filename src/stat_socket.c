@@ -0,0 +1,688 @@
+/**
+ * @file stat_socket.c
+ * @brief Local query and streaming socket
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * The main loop only takes history_lock long enough to copy one snapshot in
+ * and then bumps an eventfd; everything that can wait on a client (accepting,
+ * parsing requests, writing replies and streams) happens on the server thread.
+ * Each client has a bounded output buffer: a stream frame that does not fit
+ * is skipped rather than queued, so a stalled reader only loses updates.
+ */
+
+#include "stat_socket.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stat_log.h"
+
+/* epoll tags beyond the client slots */
+#define TAG_LISTEN STAT_SOCKET_MAX_CLIENTS
+#define TAG_WAKE (STAT_SOCKET_MAX_CLIENTS + 1)
+
+/**
+ * @brief A snapshot and the generation it was published as
+ */
+typedef struct {
+   stat_shm_snapshot_t snapshot;
+   uint32_t generation;
+} history_entry_t;
+
+/**
+ * @brief One connected client
+ */
+typedef struct {
+   int fd;                            /**< -1 when the slot is free */
+   uint8_t rx[STAT_SOCKET_MAX_FRAME]; /**< Partial request */
+   size_t rx_len;
+   uint8_t *tx;                       /**< Pending output */
+   size_t tx_len;
+   bool want_out;                     /**< EPOLLOUT armed */
+   bool subscribed;
+   uint32_t sections;                 /**< Subscribed STAT_SHM_* sections */
+   uint32_t interval_ms;              /**< Minimum time between stream frames */
+   uint64_t last_sent_ms;             /**< Monotonic time of the last stream frame */
+   uint32_t last_generation;          /**< Last generation streamed */
+} client_t;
+
+/**
+ * @brief Byte range of one snapshot section
+ */
+typedef struct {
+   uint32_t bit;
+   size_t offset;
+   size_t size;
+} section_t;
+
+#define SECTION(bit, first, end)                                                                 \
+   { bit, offsetof(stat_shm_snapshot_t, first),                                                  \
+     offsetof(stat_shm_snapshot_t, end) - offsetof(stat_shm_snapshot_t, first) }
+
+/* In STAT_SHM_* bit order, which is also the order on the wire */
+static const section_t sections_table[] = {
+   SECTION(STAT_SHM_BATTERY, battery_voltage_v, cell_count),
+   SECTION(STAT_SHM_CELLS, cell_count, rail_count),
+   SECTION(STAT_SHM_RAILS, rail_count, cpu_usage_pct),
+   SECTION(STAT_SHM_CPU, cpu_usage_pct, memory_usage_pct),
+   SECTION(STAT_SHM_MEMORY, memory_usage_pct, system_temp_c),
+   SECTION(STAT_SHM_THERMAL, system_temp_c, fan_rpm),
+   SECTION(STAT_SHM_FAN, fan_rpm, reserved2),
+};
+#define SECTION_COUNT (sizeof(sections_table) / sizeof(sections_table[0]))
+#define SECTIONS_ALL                                                                             \
+   (STAT_SHM_BATTERY | STAT_SHM_CELLS | STAT_SHM_RAILS | STAT_SHM_CPU | STAT_SHM_MEMORY |      \
+    STAT_SHM_THERMAL | STAT_SHM_FAN)
+
+/* Shared with the main loop, under history_lock */
+static pthread_mutex_t history_lock = PTHREAD_MUTEX_INITIALIZER;
+static history_entry_t history[STAT_SOCKET_HISTORY];
+static int history_head = 0; /* Next slot to write */
+static int history_count = 0;
+static uint32_t history_generation = 0;
+
+/* Server state */
+static int listen_fd = -1;
+static int epoll_fd = -1;
+static int wake_fd = -1;
+static pthread_t server_thread;
+static atomic_bool stop_requested = false;
+static char socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)] = "";
+
+/* Server thread only */
+static client_t clients[STAT_SOCKET_MAX_CLIENTS];
+static history_entry_t history_copy[STAT_SOCKET_HISTORY];
+
+/**
+ * @brief Monotonic clock in milliseconds
+ */
+static uint64_t monotonic_ms(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+/**
+ * @brief Encode a SNAPSHOT frame
+ */
+size_t stat_socket_encode_snapshot(const stat_shm_snapshot_t *snapshot,
+                                   uint32_t generation,
+                                   uint32_t sections,
+                                   uint8_t *frame) {
+   uint32_t present = snapshot->valid & (sections ? sections : SECTIONS_ALL);
+   size_t pos = STAT_SOCK_HEADER_LEN;
+
+   memcpy(frame + pos, &snapshot->timestamp_ms, sizeof(uint64_t));
+   memcpy(frame + pos + 8, &generation, sizeof(uint32_t));
+   memcpy(frame + pos + 12, &present, sizeof(uint32_t));
+   pos += STAT_SOCK_SNAPSHOT_HEADER_LEN;
+
+   for (size_t i = 0; i < SECTION_COUNT; i++) {
+      if (present & sections_table[i].bit) {
+         memcpy(frame + pos, (const uint8_t *)snapshot + sections_table[i].offset,
+                sections_table[i].size);
+         pos += sections_table[i].size;
+      }
+   }
+
+   uint32_t length = (uint32_t)(pos - sizeof(uint32_t));
+   memcpy(frame, &length, sizeof(length));
+   frame[4] = STAT_SOCK_SNAPSHOT;
+   return pos;
+}
+
+/**
+ * @brief Decode the payload of a SNAPSHOT frame
+ */
+int stat_socket_decode_snapshot(const uint8_t *payload,
+                                size_t len,
+                                stat_shm_snapshot_t *snapshot,
+                                uint32_t *generation) {
+   if (!payload || !snapshot || len < STAT_SOCK_SNAPSHOT_HEADER_LEN) {
+      return -1;
+   }
+
+   uint32_t gen, present;
+   memset(snapshot, 0, sizeof(*snapshot));
+   memcpy(&snapshot->timestamp_ms, payload, sizeof(uint64_t));
+   memcpy(&gen, payload + 8, sizeof(gen));
+   memcpy(&present, payload + 12, sizeof(present));
+
+   /* Sections a newer server adds come after the known ones */
+   size_t pos = STAT_SOCK_SNAPSHOT_HEADER_LEN;
+   for (size_t i = 0; i < SECTION_COUNT; i++) {
+      if (!(present & sections_table[i].bit)) {
+         continue;
+      }
+      if (len - pos < sections_table[i].size) {
+         return -1;
+      }
+      memcpy((uint8_t *)snapshot + sections_table[i].offset, payload + pos,
+             sections_table[i].size);
+      pos += sections_table[i].size;
+   }
+
+   snapshot->valid = present & SECTIONS_ALL;
+   if (generation) {
+      *generation = gen;
+   }
+   return 0;
+}
+
+/**
+ * @brief Re-arm a client's epoll events after want_out changed
+ */
+static void client_update_events(client_t *client, int slot) {
+   struct epoll_event ev = {
+      .events = EPOLLIN | EPOLLRDHUP | (client->want_out ? EPOLLOUT : 0),
+      .data.u32 = (uint32_t)slot,
+   };
+   epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &ev);
+}
+
+/**
+ * @brief Disconnect a client and free its slot
+ */
+static void client_close(client_t *client) {
+   if (client->fd < 0) {
+      return;
+   }
+   epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+   close(client->fd);
+   free(client->tx);
+   memset(client, 0, sizeof(*client));
+   client->fd = -1;
+}
+
+/**
+ * @brief Append bytes to a client's output, -1 if they do not fit
+ */
+static int client_queue(client_t *client, const void *data, size_t len) {
+   if (client->tx_len + len > STAT_SOCKET_TX_BUFFER) {
+      return -1;
+   }
+   memcpy(client->tx + client->tx_len, data, len);
+   client->tx_len += len;
+   return 0;
+}
+
+/**
+ * @brief Queue a frame with a uint32 payload
+ */
+static int client_queue_u32(client_t *client, uint8_t type, uint32_t value) {
+   uint8_t frame[STAT_SOCK_HEADER_LEN + sizeof(uint32_t)];
+   uint32_t length = 1 + sizeof(uint32_t);
+
+   memcpy(frame, &length, sizeof(length));
+   frame[4] = type;
+   memcpy(frame + STAT_SOCK_HEADER_LEN, &value, sizeof(value));
+   return client_queue(client, frame, sizeof(frame));
+}
+
+/**
+ * @brief Write out as much pending output as the socket takes
+ */
+static void client_flush(client_t *client, int slot) {
+   size_t sent = 0;
+   while (sent < client->tx_len) {
+      ssize_t n = send(client->fd, client->tx + sent, client->tx_len - sent,
+                       MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+         }
+         client_close(client);
+         return;
+      }
+      sent += (size_t)n;
+   }
+
+   memmove(client->tx, client->tx + sent, client->tx_len - sent);
+   client->tx_len -= sent;
+
+   bool want_out = client->tx_len > 0;
+   if (want_out != client->want_out) {
+      client->want_out = want_out;
+      client_update_events(client, slot);
+   }
+}
+
+/**
+ * @brief Copy the latest snapshot, 0 if there is none yet
+ */
+static int latest_snapshot(history_entry_t *entry) {
+   int found = 0;
+   pthread_mutex_lock(&history_lock);
+   if (history_count > 0) {
+      *entry = history[(history_head + STAT_SOCKET_HISTORY - 1) % STAT_SOCKET_HISTORY];
+      found = 1;
+   }
+   pthread_mutex_unlock(&history_lock);
+   return found;
+}
+
+/**
+ * @brief Queue the latest snapshot, or ENODATA before the first one
+ */
+static void send_latest(client_t *client, uint32_t sections) {
+   history_entry_t entry;
+   uint8_t frame[STAT_SOCK_SNAPSHOT_MAX];
+
+   if (!latest_snapshot(&entry)) {
+      client_queue_u32(client, STAT_SOCK_ERROR, ENODATA);
+      return;
+   }
+   size_t len = stat_socket_encode_snapshot(&entry.snapshot, entry.generation, sections, frame);
+   if (client_queue(client, frame, len) == 0) {
+      client->last_generation = entry.generation;
+   }
+}
+
+/**
+ * @brief Queue up to count recent snapshots, oldest first, and HISTORY_END
+ */
+static void send_history(client_t *client, uint32_t sections, uint32_t count) {
+   uint8_t frame[STAT_SOCK_SNAPSHOT_MAX];
+   int n;
+
+   pthread_mutex_lock(&history_lock);
+   n = count < (uint32_t)history_count ? (int)count : history_count;
+   for (int i = 0; i < n; i++) {
+      int idx = (history_head - n + i + STAT_SOCKET_HISTORY) % STAT_SOCKET_HISTORY;
+      history_copy[i] = history[idx];
+   }
+   pthread_mutex_unlock(&history_lock);
+
+   /* All or nothing, so a reply is never cut short */
+   size_t needed = (size_t)n * STAT_SOCK_SNAPSHOT_MAX + STAT_SOCK_HEADER_LEN + sizeof(uint32_t);
+   if (client->tx_len + needed > STAT_SOCKET_TX_BUFFER) {
+      client_queue_u32(client, STAT_SOCK_ERROR, ENOBUFS);
+      return;
+   }
+   for (int i = 0; i < n; i++) {
+      size_t len = stat_socket_encode_snapshot(&history_copy[i].snapshot,
+                                               history_copy[i].generation, sections, frame);
+      client_queue(client, frame, len);
+   }
+   client_queue_u32(client, STAT_SOCK_HISTORY_END, (uint32_t)n);
+}
+
+/**
+ * @brief Act on one complete request
+ */
+static void handle_request(client_t *client, uint8_t type, const uint8_t *payload, size_t len) {
+   uint32_t args[2] = { 0, 0 };
+   size_t nargs = 0;
+
+   switch (type) {
+      case STAT_SOCK_GET_SNAPSHOT:
+         nargs = 1;
+         break;
+      case STAT_SOCK_GET_HISTORY:
+      case STAT_SOCK_SUBSCRIBE:
+         nargs = 2;
+         break;
+      case STAT_SOCK_UNSUBSCRIBE:
+         break;
+      default:
+         client_queue_u32(client, STAT_SOCK_ERROR, EINVAL);
+         return;
+   }
+   if (len != nargs * sizeof(uint32_t)) {
+      client_queue_u32(client, STAT_SOCK_ERROR, EINVAL);
+      return;
+   }
+   memcpy(args, payload, len);
+
+   switch (type) {
+      case STAT_SOCK_GET_SNAPSHOT:
+         send_latest(client, args[0]);
+         break;
+      case STAT_SOCK_GET_HISTORY:
+         send_history(client, args[0], args[1]);
+         break;
+      case STAT_SOCK_SUBSCRIBE:
+         client->subscribed = true;
+         client->sections = args[0];
+         client->interval_ms = args[1];
+         client->last_sent_ms = monotonic_ms();
+         /* Start the stream from the current state */
+         send_latest(client, client->sections);
+         break;
+      case STAT_SOCK_UNSUBSCRIBE:
+         client->subscribed = false;
+         break;
+   }
+}
+
+/**
+ * @brief Read what a client sent and handle every complete request
+ */
+static void client_read(client_t *client, int slot) {
+   for (;;) {
+      ssize_t n = recv(client->fd, client->rx + client->rx_len,
+                       sizeof(client->rx) - client->rx_len, MSG_DONTWAIT);
+      if (n < 0 && errno == EINTR) {
+         continue;
+      }
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+         break;
+      }
+      if (n <= 0) {
+         client_close(client);
+         return;
+      }
+      client->rx_len += (size_t)n;
+
+      while (client->rx_len >= sizeof(uint32_t)) {
+         uint32_t length;
+         memcpy(&length, client->rx, sizeof(length));
+         if (length == 0 || length > STAT_SOCKET_MAX_FRAME - sizeof(uint32_t)) {
+            /* Not our protocol; nothing sensible to resync on */
+            client_close(client);
+            return;
+         }
+         size_t total = sizeof(uint32_t) + length;
+         if (client->rx_len < total) {
+            break;
+         }
+         handle_request(client, client->rx[4], client->rx + STAT_SOCK_HEADER_LEN, length - 1);
+         memmove(client->rx, client->rx + total, client->rx_len - total);
+         client->rx_len -= total;
+      }
+   }
+   client_flush(client, slot);
+}
+
+/**
+ * @brief Accept pending connections into free slots
+ */
+static void accept_clients(void) {
+   for (;;) {
+      int fd = accept(listen_fd, NULL, NULL);
+      if (fd < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         return;
+      }
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+      int slot = -1;
+      for (int i = 0; i < STAT_SOCKET_MAX_CLIENTS; i++) {
+         if (clients[i].fd < 0) {
+            slot = i;
+            break;
+         }
+      }
+      uint8_t *tx = slot >= 0 ? malloc(STAT_SOCKET_TX_BUFFER) : NULL;
+      if (!tx) {
+         OLOG_WARNING("Socket client refused: %s",
+                      slot < 0 ? "too many clients" : "out of memory");
+         close(fd);
+         continue;
+      }
+
+      client_t *client = &clients[slot];
+      memset(client, 0, sizeof(*client));
+      client->fd = fd;
+      client->tx = tx;
+      struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u32 = (uint32_t)slot };
+      if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+         close(fd);
+         free(tx);
+         client->fd = -1;
+         client->tx = NULL;
+      }
+   }
+}
+
+/**
+ * @brief Stream the latest snapshot to subscribers that are due
+ */
+static void stream_latest(void) {
+   history_entry_t entry;
+   uint8_t frame[STAT_SOCK_SNAPSHOT_MAX];
+   uint64_t now = monotonic_ms();
+
+   if (!latest_snapshot(&entry)) {
+      return;
+   }
+   for (int i = 0; i < STAT_SOCKET_MAX_CLIENTS; i++) {
+      client_t *client = &clients[i];
+      if (client->fd < 0 || !client->subscribed ||
+          client->last_generation == entry.generation ||
+          now - client->last_sent_ms < client->interval_ms) {
+         continue;
+      }
+      size_t len = stat_socket_encode_snapshot(&entry.snapshot, entry.generation,
+                                               client->sections, frame);
+      if (client_queue(client, frame, len) == 0) {
+         client->last_generation = entry.generation;
+         client->last_sent_ms = now;
+      }
+      client_flush(client, i);
+   }
+}
+
+/**
+ * @brief Server thread: the epoll loop
+ */
+static void *server_main(void *arg) {
+   (void)arg;
+   struct epoll_event events[STAT_SOCKET_MAX_CLIENTS + 2];
+
+   while (!atomic_load(&stop_requested)) {
+      int n = epoll_wait(epoll_fd, events, STAT_SOCKET_MAX_CLIENTS + 2, -1);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         OLOG_ERROR("Socket server epoll failed: %s", strerror(errno));
+         break;
+      }
+
+      for (int i = 0; i < n; i++) {
+         uint32_t tag = events[i].data.u32;
+         if (tag == TAG_LISTEN) {
+            accept_clients();
+         } else if (tag == TAG_WAKE) {
+            uint64_t count;
+            if (read(wake_fd, &count, sizeof(count)) == sizeof(count)) {
+               stream_latest();
+            }
+         } else {
+            client_t *client = &clients[tag];
+            if (client->fd < 0) {
+               continue;
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+               client_close(client);
+               continue;
+            }
+            /* A hang-up reads as end of stream */
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+               client_read(client, (int)tag);
+            }
+            if (client->fd >= 0 && (events[i].events & EPOLLOUT)) {
+               client_flush(client, (int)tag);
+            }
+         }
+      }
+   }
+   return NULL;
+}
+
+/**
+ * @brief Close the server's descriptors
+ */
+static void server_close_fds(void) {
+   if (epoll_fd >= 0) {
+      close(epoll_fd);
+      epoll_fd = -1;
+   }
+   if (wake_fd >= 0) {
+      close(wake_fd);
+      wake_fd = -1;
+   }
+   if (listen_fd >= 0) {
+      close(listen_fd);
+      listen_fd = -1;
+      unlink(socket_path);
+   }
+}
+
+/**
+ * @brief Start serving on a socket path
+ */
+int stat_socket_start(const char *path) {
+   if (listen_fd >= 0) {
+      return 0;
+   }
+   if (!path) {
+      path = STAT_SOCKET_DEFAULT_PATH;
+   }
+   if (strlen(path) >= sizeof(socket_path)) {
+      OLOG_ERROR("Socket path too long: %s", path);
+      return -1;
+   }
+   snprintf(socket_path, sizeof(socket_path), "%s", path);
+
+   /* Replace a socket left by a previous run, but nothing else */
+   struct stat st;
+   if (lstat(socket_path, &st) == 0) {
+      if (!S_ISSOCK(st.st_mode)) {
+         OLOG_ERROR("Cannot create socket %s: a file of that name exists", socket_path);
+         return -1;
+      }
+      unlink(socket_path);
+   }
+
+   for (int i = 0; i < STAT_SOCKET_MAX_CLIENTS; i++) {
+      clients[i].fd = -1;
+   }
+
+   struct sockaddr_un addr = { .sun_family = AF_UNIX };
+   memcpy(addr.sun_path, socket_path, strlen(socket_path) + 1);
+
+   listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      OLOG_ERROR("Cannot create socket %s: %s", socket_path, strerror(errno));
+      if (listen_fd >= 0) {
+         close(listen_fd);
+         listen_fd = -1;
+      }
+      return -1;
+   }
+
+   /* Same audience as the world-readable shared-memory snapshot */
+   chmod(socket_path, 0666);
+
+   wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+   struct epoll_event listen_ev = { .events = EPOLLIN, .data.u32 = TAG_LISTEN };
+   struct epoll_event wake_ev = { .events = EPOLLIN, .data.u32 = TAG_WAKE };
+   if (listen(listen_fd, STAT_SOCKET_MAX_CLIENTS) < 0 || wake_fd < 0 || epoll_fd < 0 ||
+       epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_ev) < 0 ||
+       epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &wake_ev) < 0) {
+      OLOG_ERROR("Cannot serve socket %s: %s", socket_path, strerror(errno));
+      server_close_fds();
+      return -1;
+   }
+
+   atomic_store(&stop_requested, false);
+   if (pthread_create(&server_thread, NULL, server_main, NULL) != 0) {
+      OLOG_ERROR("Cannot start socket server thread");
+      server_close_fds();
+      return -1;
+   }
+
+   OLOG_INFO("Serving telemetry on socket %s", socket_path);
+   return 0;
+}
+
+/**
+ * @brief Hand the server this iteration's snapshot
+ */
+void stat_socket_publish(const stat_shm_snapshot_t *snapshot) {
+   if (listen_fd < 0 || !snapshot) {
+      return;
+   }
+
+   pthread_mutex_lock(&history_lock);
+   history_entry_t *entry = &history[history_head];
+   entry->snapshot = *snapshot;
+   entry->generation = ++history_generation;
+   history_head = (history_head + 1) % STAT_SOCKET_HISTORY;
+   if (history_count < STAT_SOCKET_HISTORY) {
+      history_count++;
+   }
+   pthread_mutex_unlock(&history_lock);
+
+   uint64_t one = 1;
+   if (write(wake_fd, &one, sizeof(one)) < 0) {
+      /* Counter saturated: the server is already due to wake */
+   }
+}
+
+/**
+ * @brief Stop the server, disconnect the clients and remove the socket
+ */
+void stat_socket_stop(void) {
+   if (listen_fd < 0) {
+      return;
+   }
+
+   uint64_t one = 1;
+   atomic_store(&stop_requested, true);
+   if (write(wake_fd, &one, sizeof(one)) < 0) {
+      /* Already woken */
+   }
+   pthread_join(server_thread, NULL);
+
+   for (int i = 0; i < STAT_SOCKET_MAX_CLIENTS; i++) {
+      client_close(&clients[i]);
+   }
+   server_close_fds();
+
+   pthread_mutex_lock(&history_lock);
+   history_head = 0;
+   history_count = 0;
+   history_generation = 0;
+   pthread_mutex_unlock(&history_lock);
+}
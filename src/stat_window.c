@@ -0,0 +1,97 @@
+/**
+ * @file stat_window.c
+ * @brief Streaming statistics over the samples between two publishes
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include "stat_window.h"
+
+#include <math.h>
+
+/**
+ * @brief Empty a window
+ */
+void stat_window_reset(stat_window_t *w) {
+   w->count = 0;
+   w->mean = 0.0;
+   w->m2 = 0.0;
+   w->min = 0.0f;
+   w->max = 0.0f;
+   w->integral = 0.0;
+   w->duration_s = 0.0;
+}
+
+/**
+ * @brief Fold in one sample
+ */
+void stat_window_add(stat_window_t *w, float value, float dt_s) {
+   if (w->count == 0) {
+      w->min = value;
+      w->max = value;
+   } else if (value < w->min) {
+      w->min = value;
+   } else if (value > w->max) {
+      w->max = value;
+   }
+
+   /* Welford: numerically stable without keeping the samples */
+   w->count++;
+   double delta = value - w->mean;
+   w->mean += delta / w->count;
+   w->m2 += delta * (value - w->mean);
+
+   if (dt_s > 0.0f) {
+      w->integral += (double)value * dt_s;
+      w->duration_s += dt_s;
+   }
+}
+
+/**
+ * @brief Population standard deviation of the window's samples
+ */
+float stat_window_stddev(const stat_window_t *w) {
+   if (w->count < 2) {
+      return 0.0f;
+   }
+   return (float)sqrt(w->m2 / w->count);
+}
+
+/**
+ * @brief Empty the voltage, current and power windows
+ */
+void stat_battery_window_reset(stat_battery_window_t *w) {
+   stat_window_reset(&w->voltage);
+   stat_window_reset(&w->current);
+   stat_window_reset(&w->power);
+}
+
+/**
+ * @brief Fold in one voltage/current/power sample
+ */
+void stat_battery_window_add(stat_battery_window_t *w,
+                             float voltage,
+                             float current,
+                             float power,
+                             float dt_s) {
+   stat_window_add(&w->voltage, voltage, dt_s);
+   stat_window_add(&w->current, current, dt_s);
+   stat_window_add(&w->power, power, dt_s);
+}
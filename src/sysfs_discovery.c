@@ -0,0 +1,316 @@
+/**
+ * @file sysfs_discovery.c
+ * @brief Cache of resolved sysfs paths and hotplug notification
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * Cache file format (one entry per line):
+ *
+ *   # comment
+ *   <key> <path>
+ *
+ * sysfs attributes do not generate inotify events, so hotplug is followed
+ * through the kernel uevent netlink socket instead, which announces every
+ * hwmon and thermal device that appears, disappears or is renamed.
+ */
+
+#include "sysfs_discovery.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/netlink.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "stat_log.h"
+
+#define SYSFS_DISCOVERY_MAX_ENTRIES 8
+#define SYSFS_DISCOVERY_KEY_MAX 32
+#define SYSFS_UEVENT_BUF 8192
+
+typedef struct {
+   char key[SYSFS_DISCOVERY_KEY_MAX];
+   char value[PATH_MAX];
+} sysfs_entry_t;
+
+/* Cache state; entries are set from the discovery threads, hence the lock */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static sysfs_entry_t cache_entries[SYSFS_DISCOVERY_MAX_ENTRIES];
+static int cache_count = 0;
+static bool cache_dirty = false;
+static char cache_path[PATH_MAX] = "";
+
+/* Uevent socket */
+static int uevent_fd = -1;
+
+/**
+ * @brief Find the slot for key (caller holds cache_lock)
+ */
+static sysfs_entry_t *find_entry(const char *key) {
+   for (int i = 0; i < cache_count; i++) {
+      if (strcmp(cache_entries[i].key, key) == 0) {
+         return &cache_entries[i];
+      }
+   }
+   return NULL;
+}
+
+/**
+ * @brief Load the discovery cache
+ */
+int sysfs_discovery_load(const char *path) {
+   pthread_mutex_lock(&cache_lock);
+   cache_count = 0;
+   cache_dirty = false;
+   snprintf(cache_path, sizeof(cache_path), "%s", path ? path : "");
+   if (cache_path[0] == '\0') {
+      pthread_mutex_unlock(&cache_lock);
+      return -1;
+   }
+
+   FILE *fp = fopen(cache_path, "r");
+   if (!fp) {
+      pthread_mutex_unlock(&cache_lock);
+      return 0;
+   }
+
+   char line[SYSFS_DISCOVERY_KEY_MAX + PATH_MAX + 2];
+   while (fgets(line, sizeof(line), fp) && cache_count < SYSFS_DISCOVERY_MAX_ENTRIES) {
+      line[strcspn(line, "\n")] = '\0';
+      if (line[0] == '#' || line[0] == '\0') {
+         continue;
+      }
+
+      char *sep = strchr(line, ' ');
+      if (!sep || sep == line || (size_t)(sep - line) >= SYSFS_DISCOVERY_KEY_MAX ||
+          sep[1] == '\0') {
+         continue;
+      }
+      size_t key_len = (size_t)(sep - line);
+      bool is_name = key_len > 5 && strncmp(sep - 5, "_name", 5) == 0;
+      if (!is_name && sep[1] != '/') {
+         continue;
+      }
+
+      sysfs_entry_t *e = &cache_entries[cache_count++];
+      memcpy(e->key, line, key_len);
+      e->key[key_len] = '\0';
+      snprintf(e->value, sizeof(e->value), "%s", sep + 1);
+   }
+   fclose(fp);
+
+   int count = cache_count;
+   pthread_mutex_unlock(&cache_lock);
+   OLOG_DEBUG("Loaded %d cached sysfs paths from %s", count, path);
+   return count;
+}
+
+/**
+ * @brief Look up a cached path
+ */
+int sysfs_discovery_get(const char *key, char *value, size_t size) {
+   int ret = -1;
+
+   pthread_mutex_lock(&cache_lock);
+   sysfs_entry_t *e = find_entry(key);
+   if (e && strlen(e->value) < size) {
+      memcpy(value, e->value, strlen(e->value) + 1);
+      ret = 0;
+   }
+   pthread_mutex_unlock(&cache_lock);
+   return ret;
+}
+
+/**
+ * @brief Store (or with NULL/"" drop) a resolved path
+ */
+void sysfs_discovery_set(const char *key, const char *value) {
+   if (!key || strlen(key) >= SYSFS_DISCOVERY_KEY_MAX) {
+      return;
+   }
+   if (value && strlen(value) >= PATH_MAX) {
+      value = NULL;
+   }
+
+   pthread_mutex_lock(&cache_lock);
+   sysfs_entry_t *e = find_entry(key);
+   if (!value || value[0] == '\0') {
+      if (e) {
+         *e = cache_entries[--cache_count];
+         cache_dirty = true;
+      }
+   } else if (e) {
+      if (strcmp(e->value, value) != 0) {
+         snprintf(e->value, sizeof(e->value), "%s", value);
+         cache_dirty = true;
+      }
+   } else if (cache_count < SYSFS_DISCOVERY_MAX_ENTRIES) {
+      e = &cache_entries[cache_count++];
+      snprintf(e->key, sizeof(e->key), "%s", key);
+      snprintf(e->value, sizeof(e->value), "%s", value);
+      cache_dirty = true;
+   }
+   pthread_mutex_unlock(&cache_lock);
+}
+
+/**
+ * @brief Write the cache back to its file if anything changed
+ */
+int sysfs_discovery_save(void) {
+   int ret = 0;
+
+   pthread_mutex_lock(&cache_lock);
+   if (!cache_dirty || cache_path[0] == '\0') {
+      pthread_mutex_unlock(&cache_lock);
+      return 0;
+   }
+
+   char tmp_path[PATH_MAX + 8];
+   snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cache_path);
+   FILE *fp = fopen(tmp_path, "w");
+   if (!fp) {
+      OLOG_DEBUG("Cannot write sysfs discovery cache %s: %s", tmp_path, strerror(errno));
+      pthread_mutex_unlock(&cache_lock);
+      return -1;
+   }
+
+   fprintf(fp, "# oasis-stat resolved sysfs paths\n");
+   for (int i = 0; i < cache_count; i++) {
+      fprintf(fp, "%s %s\n", cache_entries[i].key, cache_entries[i].value);
+   }
+
+   if (fclose(fp) != 0 || rename(tmp_path, cache_path) != 0) {
+      OLOG_DEBUG("Cannot replace sysfs discovery cache %s: %s", cache_path, strerror(errno));
+      unlink(tmp_path);
+      ret = -1;
+   } else {
+      cache_dirty = false;
+   }
+   pthread_mutex_unlock(&cache_lock);
+   return ret;
+}
+
+/**
+ * @brief Start listening for kernel hwmon/thermal uevents
+ */
+int sysfs_discovery_watch_open(void) {
+   if (uevent_fd >= 0) {
+      return 0;
+   }
+
+   int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+   if (fd < 0) {
+      OLOG_WARNING("Cannot open uevent socket: %s", strerror(errno));
+      return -1;
+   }
+
+   /* Multicast group 1 carries the kernel's own events */
+   struct sockaddr_nl addr = { .nl_family = AF_NETLINK, .nl_pid = 0, .nl_groups = 1 };
+   if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      OLOG_WARNING("Cannot bind uevent socket: %s", strerror(errno));
+      close(fd);
+      return -1;
+   }
+
+   uevent_fd = fd;
+   return 0;
+}
+
+/**
+ * @brief Classify one uevent message
+ */
+unsigned sysfs_discovery_parse_uevent(const char *msg, size_t len) {
+   bool relevant_action = false;
+   unsigned subsystem = 0;
+
+   /* "action@devpath" header followed by NUL-separated KEY=VALUE fields */
+   size_t pos = strnlen(msg, len) + 1;
+   while (pos < len) {
+      const char *field = msg + pos;
+      size_t flen = strnlen(field, len - pos);
+
+      if (strncmp(field, "ACTION=", 7) == 0) {
+         /* "change" is also sent on every thermal trip crossing; skip it */
+         const char *action = field + 7;
+         relevant_action = strcmp(action, "add") == 0 || strcmp(action, "remove") == 0 ||
+                           strcmp(action, "move") == 0;
+      } else if (strcmp(field, "SUBSYSTEM=hwmon") == 0) {
+         subsystem = SYSFS_CHANGE_HWMON;
+      } else if (strcmp(field, "SUBSYSTEM=thermal") == 0) {
+         subsystem = SYSFS_CHANGE_THERMAL;
+      }
+      pos += flen + 1;
+   }
+
+   return relevant_action ? subsystem : 0;
+}
+
+/**
+ * @brief Drain pending uevents without blocking
+ */
+unsigned sysfs_discovery_watch_poll(void) {
+   static char buf[SYSFS_UEVENT_BUF];
+   unsigned changes = 0;
+
+   if (uevent_fd < 0) {
+      return 0;
+   }
+
+   for (;;) {
+      ssize_t n = recv(uevent_fd, buf, sizeof(buf) - 1, 0);
+      if (n < 0) {
+         if (errno == ENOBUFS) {
+            /* Events were dropped; assume anything may have moved */
+            changes |= SYSFS_CHANGE_HWMON | SYSFS_CHANGE_THERMAL;
+            continue;
+         }
+         if (errno == EINTR) {
+            continue;
+         }
+         break;
+      }
+      if (n == 0) {
+         break;
+      }
+      buf[n] = '\0';
+      changes |= sysfs_discovery_parse_uevent(buf, (size_t)n);
+   }
+
+   return changes;
+}
+
+/**
+ * @brief Stop listening for uevents and forget the cache
+ */
+void sysfs_discovery_cleanup(void) {
+   if (uevent_fd >= 0) {
+      close(uevent_fd);
+      uevent_fd = -1;
+   }
+
+   pthread_mutex_lock(&cache_lock);
+   cache_count = 0;
+   cache_dirty = false;
+   pthread_mutex_unlock(&cache_lock);
+}
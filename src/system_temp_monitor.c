@@ -31,7 +31,8 @@
 #include <string.h>
 #include <unistd.h>
 
-#include "logging.h"
+#include "stat_log.h"
+#include "sysfs_discovery.h"
 
 /* Path for thermal zones */
 #define THERMAL_ZONE_PATH "/sys/devices/virtual/thermal/thermal_zone"
@@ -110,6 +111,68 @@ static int find_system_thermal_zone(void) {
    return -1;
 }
 
+/**
+ * @brief Check that a cached temperature path still belongs to a suitable zone
+ *
+ * Only the zone's type file is read, instead of scanning every zone.
+ *
+ * @return int Index of the thermal zone or -1 if the cached path is stale
+ */
+static int validate_cached_thermal_zone(void) {
+   char cached[PATH_MAX];
+   char type_path[PATH_MAX];
+   char type_buffer[64] = "";
+   int zone = -1;
+
+   if (sysfs_discovery_get(SYSFS_KEY_THERMAL, cached, sizeof(cached)) != 0 ||
+       sscanf(cached, THERMAL_ZONE_PATH "%d/temp", &zone) != 1) {
+      return -1;
+   }
+
+   snprintf(type_path, sizeof(type_path), "%s%d/type", THERMAL_ZONE_PATH, zone);
+   FILE *type_file = fopen(type_path, "r");
+   if (type_file == NULL) {
+      return -1;
+   }
+   if (fgets(type_buffer, sizeof(type_buffer), type_file) == NULL) {
+      type_buffer[0] = '\0';
+   }
+   fclose(type_file);
+
+   if (strstr(type_buffer, "tj-thermal") == NULL && strstr(type_buffer, "cpu-thermal") == NULL &&
+       strstr(type_buffer, "CPU-therm") == NULL) {
+      return -1;
+   }
+
+   snprintf(system_temp_path, sizeof(system_temp_path), "%s%d/temp", THERMAL_ZONE_PATH, zone);
+   OLOG_INFO("Using cached thermal zone %d", zone);
+   return zone;
+}
+
+/**
+ * @brief Resolve the thermal zone, from the cache if allowed, and update the cache
+ */
+static int resolve_system_thermal_zone(int use_cache) {
+   system_temp_monitor_initialized = 0;
+   system_temp_path[0] = '\0';
+
+   system_temp_zone_index = use_cache ? validate_cached_thermal_zone() : -1;
+   if (system_temp_zone_index == -1) {
+      system_temp_zone_index = find_system_thermal_zone();
+      if (system_temp_zone_index == -1) {
+         system_temp_path[0] = '\0';
+      }
+      sysfs_discovery_set(SYSFS_KEY_THERMAL, system_temp_path);
+   }
+
+   if (system_temp_zone_index == -1) {
+      return -1;
+   }
+
+   system_temp_monitor_initialized = 1;
+   return 0;
+}
+
 /**
  * @brief Initialize system temperature monitoring
  *
@@ -121,16 +184,11 @@ int system_temp_monitor_init(void) {
       return 0;
    }
 
-   /* Find system thermal zone */
-   system_temp_zone_index = find_system_thermal_zone();
-   if (system_temp_zone_index == -1) {
+   if (resolve_system_thermal_zone(1) != 0) {
       OLOG_ERROR("System temperature monitoring initialization failed");
       return -1;
    }
 
-   /* Set initialized flag before getting temperature to prevent recursion */
-   system_temp_monitor_initialized = 1;
-
    /* Get initial temperature */
    system_temp = system_temp_monitor_get_temp();
    OLOG_INFO("System temperature monitoring initialized (zone: %d)", system_temp_zone_index);
@@ -138,6 +196,21 @@ int system_temp_monitor_init(void) {
    return 0;
 }
 
+/**
+ * @brief Resolve the thermal zone again after a thermal hotplug event
+ *
+ * @return int 0 on success, -1 if no suitable zone exists
+ */
+int system_temp_monitor_rescan(void) {
+   int old_zone = system_temp_zone_index;
+
+   int ret = resolve_system_thermal_zone(0);
+   if (system_temp_zone_index != old_zone) {
+      OLOG_INFO("System thermal zone changed: %d -> %d", old_zone, system_temp_zone_index);
+   }
+   return ret;
+}
+
 /**
  * @brief Get system temperature in Celsius
  *
@@ -148,13 +221,9 @@ float system_temp_monitor_get_temp(void) {
    char temp_buffer[16];
    float temperature = -1.0f;
 
-   /* Check if initialized */
+   /* The zone is resolved by system_temp_monitor_init()/_rescan(), never here */
    if (!system_temp_monitor_initialized) {
-      /* Try to initialize but avoid recursive calls */
-      if (system_temp_monitor_init() != 0) {
-         return -1.0f;
-      }
-      return system_temp; /* Return value set during initialization */
+      return -1.0f;
    }
 
    /* Open temperature file */
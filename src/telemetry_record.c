@@ -0,0 +1,444 @@
+/**
+ * @file telemetry_record.c
+ * @brief Record and replay of raw sensor readings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ *
+ * File format (one record per line, fields separated by single spaces):
+ *
+ *   # comment
+ *   V <version>
+ *   H key=value ...                         acquisition settings
+ *   T <t_us> <wall_ms>                      start of an iteration
+ *   R <vbus> <current> <power> <dietemp>    INA238 registers (hex)
+ *   C <channel> <mv> <ma> <label>           INA3221 channel (label is rest of line)
+ *   D <cmd> <frame|->                       Daly exchange (hex), "-" if it failed
+ *   P <cpu> <mem> <temp> <fan> <rpm> <load> <pwm>
+ */
+
+#include "telemetry_record.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stat_log.h"
+
+#define TELEMETRY_LINE_MAX 256
+
+/* Recording state */
+static FILE *record_fp = NULL;
+static struct timespec record_start;
+static int record_daly_frames = 0;
+
+/* Replay state */
+static FILE *replay_fp = NULL;
+static char replay_line[TELEMETRY_LINE_MAX];
+static bool replay_have_line = false;
+static int replay_line_no = 0;
+
+/** @brief Microseconds elapsed on CLOCK_MONOTONIC since @p start */
+static uint64_t elapsed_us(const struct timespec *start) {
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   int64_t sec = (int64_t)now.tv_sec - (int64_t)start->tv_sec;
+   int64_t nsec = (int64_t)now.tv_nsec - (int64_t)start->tv_nsec;
+   return (uint64_t)(sec * 1000000 + nsec / 1000);
+}
+
+/** @brief Current wall-clock time in milliseconds since the epoch */
+static int64_t wall_ms_now(void) {
+   struct timespec now;
+   clock_gettime(CLOCK_REALTIME, &now);
+   return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/** @brief Start recording to a file */
+int telemetry_record_open(const char *path, const telemetry_record_header_t *header) {
+   if (!path || !header) {
+      return -1;
+   }
+
+   telemetry_record_close();
+
+   record_fp = fopen(path, "w");
+   if (!record_fp) {
+      OLOG_ERROR("Failed to open recording file %s", path);
+      return -1;
+   }
+
+   fprintf(record_fp, "# oasis-stat telemetry recording\n");
+   fprintf(record_fp, "V %d\n", TELEMETRY_RECORD_VERSION);
+   fprintf(record_fp,
+           "H shunt=%.6f max_current=%.3f addr=0x%02X monitor=%d bms=%d interval_ms=%d "
+           "bms_interval_ms=%d\n",
+           header->r_shunt, header->max_current, header->i2c_addr, header->power_monitor,
+           header->bms_enable ? 1 : 0, header->interval_ms, header->bms_interval_ms);
+
+   clock_gettime(CLOCK_MONOTONIC, &record_start);
+   record_daly_frames = 0;
+
+   OLOG_INFO("Recording telemetry to %s", path);
+   return 0;
+}
+
+/** @brief Check whether a recording is in progress */
+bool telemetry_record_active(void) {
+   return record_fp != NULL;
+}
+
+/** @brief Mark the start of a main-loop iteration */
+void telemetry_record_tick(void) {
+   if (!record_fp) {
+      return;
+   }
+
+   /* Flush the previous iteration as a unit so a crash leaves whole ticks */
+   fflush(record_fp);
+   fprintf(record_fp, "T %" PRIu64 " %" PRId64 "\n", elapsed_us(&record_start), wall_ms_now());
+   record_daly_frames = 0;
+}
+
+/** @brief Record an INA238 register snapshot */
+void telemetry_record_ina238(const ina238_raw_t *raw) {
+   if (!record_fp || !raw) {
+      return;
+   }
+
+   fprintf(record_fp, "R %04X %04X %06" PRIX32 " %04X\n", raw->vbus, raw->current, raw->power,
+           raw->dietemp);
+}
+
+/** @brief Record the raw sysfs values of all valid INA3221 channels */
+void telemetry_record_ina3221(const ina3221_measurements_t *measurements) {
+   if (!record_fp || !measurements) {
+      return;
+   }
+
+   for (int i = 0; i < measurements->num_channels && i < INA3221_MAX_CHANNELS; i++) {
+      const ina3221_channel_t *ch = &measurements->channels[i];
+      if (!ch->valid) {
+         continue;
+      }
+      fprintf(record_fp, "C %d %d %d %s\n", ch->channel, ch->raw_voltage_mv, ch->raw_current_ma,
+              ch->label);
+   }
+}
+
+/** @brief Record one Daly exchange */
+void telemetry_record_daly_frame(void *ctx,
+                                 const daly_device_t *dev,
+                                 uint8_t cmd,
+                                 const uint8_t *frame) {
+   (void)ctx;
+   (void)dev;
+
+   if (!record_fp) {
+      return;
+   }
+
+   if (record_daly_frames >= TELEMETRY_MAX_DALY_FRAMES) {
+      return;
+   }
+   record_daly_frames++;
+
+   fprintf(record_fp, "D %02X ", cmd);
+   if (!frame) {
+      fputs("-\n", record_fp);
+      return;
+   }
+   for (int i = 0; i < DALY_FRAME_LEN; i++) {
+      fprintf(record_fp, "%02X", frame[i]);
+   }
+   fputc('\n', record_fp);
+}
+
+/** @brief Record the host metrics for this iteration */
+void telemetry_record_proc(const telemetry_proc_sample_t *sample) {
+   if (!record_fp || !sample) {
+      return;
+   }
+
+   fprintf(record_fp, "P %.9g %.9g %.9g %d %d %d %d\n", sample->cpu_usage, sample->memory_usage,
+           sample->system_temperature, sample->fan_available ? 1 : 0, sample->fan_rpm,
+           sample->fan_load, sample->fan_pwm);
+}
+
+/** @brief Flush and close the recording */
+void telemetry_record_close(void) {
+   if (!record_fp) {
+      return;
+   }
+
+   fclose(record_fp);
+   record_fp = NULL;
+}
+
+/** @brief Read the next line into replay_line, honouring the one-line lookahead */
+static bool replay_read_line(void) {
+   if (replay_have_line) {
+      return true;
+   }
+
+   while (fgets(replay_line, sizeof(replay_line), replay_fp)) {
+      replay_line_no++;
+      replay_line[strcspn(replay_line, "\r\n")] = '\0';
+      if (replay_line[0] == '\0' || replay_line[0] == '#') {
+         continue;
+      }
+      replay_have_line = true;
+      return true;
+   }
+
+   return false;
+}
+
+/** @brief Parse the key=value pairs of an "H" line; unknown keys are ignored */
+static void replay_parse_header(char *line, telemetry_record_header_t *header) {
+   char *saveptr = NULL;
+
+   for (char *tok = strtok_r(line, " ", &saveptr); tok; tok = strtok_r(NULL, " ", &saveptr)) {
+      char *eq = strchr(tok, '=');
+      if (!eq) {
+         continue;
+      }
+      *eq = '\0';
+      const char *value = eq + 1;
+
+      if (strcmp(tok, "shunt") == 0) {
+         header->r_shunt = strtof(value, NULL);
+      } else if (strcmp(tok, "max_current") == 0) {
+         header->max_current = strtof(value, NULL);
+      } else if (strcmp(tok, "addr") == 0) {
+         header->i2c_addr = (uint8_t)strtol(value, NULL, 0);
+      } else if (strcmp(tok, "monitor") == 0) {
+         header->power_monitor = atoi(value);
+      } else if (strcmp(tok, "bms") == 0) {
+         header->bms_enable = atoi(value) != 0;
+      } else if (strcmp(tok, "interval_ms") == 0) {
+         header->interval_ms = atoi(value);
+      } else if (strcmp(tok, "bms_interval_ms") == 0) {
+         header->bms_interval_ms = atoi(value);
+      }
+   }
+}
+
+/** @brief Decode @p len bytes of hex from @p hex into @p out */
+static int parse_hex_bytes(const char *hex, uint8_t *out, int len) {
+   if ((int)strlen(hex) != len * 2) {
+      return -1;
+   }
+
+   for (int i = 0; i < len; i++) {
+      unsigned int byte;
+      if (sscanf(hex + i * 2, "%2X", &byte) != 1) {
+         return -1;
+      }
+      out[i] = (uint8_t)byte;
+   }
+
+   return 0;
+}
+
+/** @brief Open a recording for replay and read its header */
+int telemetry_replay_open(const char *path, telemetry_record_header_t *header) {
+   if (!path || !header) {
+      return -1;
+   }
+
+   telemetry_replay_close();
+
+   replay_fp = fopen(path, "r");
+   if (!replay_fp) {
+      OLOG_ERROR("Failed to open replay file %s", path);
+      return -1;
+   }
+
+   memset(header, 0, sizeof(*header));
+   bool have_version = false;
+
+   /* Header lines run until the first tick */
+   while (replay_read_line() && replay_line[0] != 'T') {
+      replay_have_line = false;
+
+      if (replay_line[0] == 'V') {
+         int version = atoi(replay_line + 1);
+         if (version != TELEMETRY_RECORD_VERSION) {
+            OLOG_ERROR("Unsupported recording version %d in %s", version, path);
+            telemetry_replay_close();
+            return -1;
+         }
+         have_version = true;
+      } else if (replay_line[0] == 'H') {
+         replay_parse_header(replay_line + 1, header);
+      }
+   }
+
+   if (!have_version) {
+      OLOG_ERROR("%s is not an oasis-stat recording", path);
+      telemetry_replay_close();
+      return -1;
+   }
+
+   OLOG_INFO("Replaying telemetry from %s", path);
+   return 0;
+}
+
+/** @brief Parse one data line into the current tick */
+static int replay_parse_record(const char *line, telemetry_tick_t *tick) {
+   switch (line[0]) {
+      case 'R': {
+         unsigned int vbus, current, power, dietemp;
+         if (sscanf(line + 1, "%X %X %X %X", &vbus, &current, &power, &dietemp) != 4) {
+            return -1;
+         }
+         tick->ina238.vbus = (uint16_t)vbus;
+         tick->ina238.current = (uint16_t)current;
+         tick->ina238.power = (uint32_t)power;
+         tick->ina238.dietemp = (uint16_t)dietemp;
+         tick->has_ina238 = true;
+         return 0;
+      }
+      case 'C': {
+         if (tick->ina3221_count >= INA3221_MAX_CHANNELS) {
+            return -1;
+         }
+         telemetry_ina3221_raw_t *ch = &tick->ina3221[tick->ina3221_count];
+         int consumed = 0;
+         if (sscanf(line + 1, "%d %d %d %n", &ch->channel, &ch->voltage_mv, &ch->current_ma,
+                    &consumed) != 3) {
+            return -1;
+         }
+         snprintf(ch->label, sizeof(ch->label), "%s", line + 1 + consumed);
+         tick->ina3221_count++;
+         return 0;
+      }
+      case 'D': {
+         if (tick->daly_count >= TELEMETRY_MAX_DALY_FRAMES) {
+            return -1;
+         }
+         telemetry_daly_frame_t *df = &tick->daly[tick->daly_count];
+         unsigned int cmd;
+         char hex[DALY_FRAME_LEN * 2 + 2];
+         if (sscanf(line + 1, "%X %27s", &cmd, hex) != 2) {
+            return -1;
+         }
+         df->cmd = (uint8_t)cmd;
+         if (strcmp(hex, "-") == 0) {
+            df->ok = false;
+         } else if (parse_hex_bytes(hex, df->frame, DALY_FRAME_LEN) == 0) {
+            df->ok = true;
+         } else {
+            return -1;
+         }
+         tick->daly_count++;
+         return 0;
+      }
+      case 'P': {
+         telemetry_proc_sample_t *p = &tick->proc;
+         int fan_available;
+         if (sscanf(line + 1, "%f %f %f %d %d %d %d", &p->cpu_usage, &p->memory_usage,
+                    &p->system_temperature, &fan_available, &p->fan_rpm, &p->fan_load,
+                    &p->fan_pwm) != 7) {
+            return -1;
+         }
+         p->fan_available = fan_available != 0;
+         tick->has_proc = true;
+         return 0;
+      }
+      default:
+         /* Unknown record types are skipped for forward compatibility */
+         return 0;
+   }
+}
+
+/** @brief Read the next iteration from the recording */
+int telemetry_replay_next(telemetry_tick_t *tick) {
+   if (!replay_fp || !tick) {
+      return -1;
+   }
+
+   memset(tick, 0, sizeof(*tick));
+
+   if (!replay_read_line()) {
+      return 0;
+   }
+   replay_have_line = false;
+
+   if (replay_line[0] != 'T' ||
+       sscanf(replay_line + 1, "%" SCNu64 " %" SCNd64, &tick->t_us, &tick->wall_ms) != 2) {
+      OLOG_ERROR("Malformed replay tick at line %d", replay_line_no);
+      return -1;
+   }
+
+   while (replay_read_line()) {
+      if (replay_line[0] == 'T') {
+         /* Leave it for the next call */
+         break;
+      }
+      replay_have_line = false;
+
+      if (replay_parse_record(replay_line, tick) != 0) {
+         OLOG_ERROR("Malformed replay record at line %d", replay_line_no);
+         return -1;
+      }
+   }
+
+   return 1;
+}
+
+/** @brief Serve a recorded Daly exchange */
+int telemetry_replay_fetch_daly_frame(void *ctx,
+                                      const daly_device_t *dev,
+                                      uint8_t cmd,
+                                      uint8_t *frame) {
+   telemetry_tick_t *tick = (telemetry_tick_t *)ctx;
+   (void)dev;
+
+   if (!tick || !frame || tick->daly_next >= tick->daly_count) {
+      return -1;
+   }
+
+   const telemetry_daly_frame_t *df = &tick->daly[tick->daly_next];
+   if (df->cmd != cmd) {
+      /* The poll sequence diverged from the recording; don't consume */
+      return -1;
+   }
+   tick->daly_next++;
+
+   if (!df->ok) {
+      return -1;
+   }
+
+   memcpy(frame, df->frame, DALY_FRAME_LEN);
+   return 0;
+}
+
+/** @brief Close the replay file */
+void telemetry_replay_close(void) {
+   if (replay_fp) {
+      fclose(replay_fp);
+      replay_fp = NULL;
+   }
+   replay_have_line = false;
+   replay_line_no = 0;
+}
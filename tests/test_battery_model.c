@@ -20,7 +20,9 @@
  * voltage clamping. Pure-logic tests with no hardware dependency.
  */
 
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "battery_model.h"
 #include "unity.h"
@@ -29,6 +31,9 @@ void setUp(void) {
 }
 
 void tearDown(void) {
+   /* Drop any default tables a test built */
+   battery_config_t none = { .chemistry = BATT_CHEMISTRY_UNKNOWN };
+   battery_model_init_lut(&none);
 }
 
 /* Helpers */
@@ -217,6 +222,335 @@ void test_chemistry_from_string_garbage_returns_unknown(void) {
    TEST_ASSERT_EQUAL_INT(BATT_CHEMISTRY_UNKNOWN, battery_chemistry_from_string("not-a-chemistry"));
 }
 
+/* Dense lookup tables */
+
+void test_lut_matches_curve_interpolation(void) {
+   battery_config_t cfgs[] = { make_liion_5s(), make_lipo_3s(), make_lifepo4_4s() };
+   static battery_lut_t lut;
+
+   for (size_t c = 0; c < sizeof(cfgs) / sizeof(cfgs[0]); c++) {
+      TEST_ASSERT_EQUAL_INT(0, battery_lut_build(&lut, &cfgs[c]));
+      for (float v = cfgs[c].min_voltage - 0.5f; v < cfgs[c].max_voltage + 0.5f; v += 0.0137f) {
+         /* Half a millivolt of rounding on the steepest segment (LiFePO4, 0.5 %/mV) */
+         float expected = battery_calculate_percentage(v, &cfgs[c]);
+         float pct = battery_lut_cell_percent(&lut, v / cfgs[c].cells_series);
+         TEST_ASSERT_FLOAT_WITHIN(0.26f, expected, pct);
+      }
+   }
+}
+
+void test_lut_inverse_round_trip(void) {
+   battery_config_t cfg = make_liion_5s();
+   static battery_lut_t lut;
+   TEST_ASSERT_EQUAL_INT(0, battery_lut_build(&lut, &cfg));
+
+   TEST_ASSERT_FLOAT_WITHIN(0.0005f, 2.85f, battery_lut_cell_voltage(&lut, 0.0f));
+   TEST_ASSERT_FLOAT_WITHIN(0.0005f, 3.68f, battery_lut_cell_voltage(&lut, 50.0f));
+   TEST_ASSERT_FLOAT_WITHIN(0.0005f, 4.17f, battery_lut_cell_voltage(&lut, 100.0f));
+   for (float pct = 2.5f; pct < 100.0f; pct += 7.5f) {
+      float v = battery_lut_cell_voltage(&lut, pct);
+      TEST_ASSERT_FLOAT_WITHIN(0.3f, pct, battery_lut_cell_percent(&lut, v));
+   }
+}
+
+void test_lut_temperature_factor(void) {
+   battery_config_t cfg = make_liion_5s();
+   static battery_lut_t lut;
+   TEST_ASSERT_EQUAL_INT(0, battery_lut_build(&lut, &cfg));
+
+   TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.00f, battery_lut_temp_factor(&lut, 40.0f));
+   TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.88f, battery_lut_temp_factor(&lut, 0.0f));
+   TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.81f, battery_lut_temp_factor(&lut, -5.0f));
+   TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.40f, battery_lut_temp_factor(&lut, -45.0f));
+}
+
+void test_lut_batch_matches_single(void) {
+   battery_config_t cfg = make_lifepo4_4s();
+   static battery_lut_t lut;
+   TEST_ASSERT_EQUAL_INT(0, battery_lut_build(&lut, &cfg));
+
+   int cell_mv[32];
+   float pack_v[32];
+   float cells_pct[32];
+   float pack_pct[32];
+   for (int i = 0; i < 32; i++) {
+      cell_mv[i] = 2400 + i * 33;
+      pack_v[i] = cell_mv[i] * 4 / 1000.0f;
+   }
+   battery_lut_cells_percent(&lut, cell_mv, cells_pct, 32);
+   battery_lut_pack_percent(&lut, pack_v, pack_pct, 32);
+
+   for (int i = 0; i < 32; i++) {
+      float single = battery_lut_cell_percent(&lut, cell_mv[i] / 1000.0f);
+      TEST_ASSERT_EQUAL_FLOAT(single, cells_pct[i]);
+      TEST_ASSERT_EQUAL_FLOAT(single, pack_pct[i]);
+   }
+}
+
+void test_default_lut_used_for_matching_config(void) {
+   battery_config_t cfg = make_lipo_3s();
+   float before = battery_calculate_percentage(11.19f, &cfg);
+
+   TEST_ASSERT_EQUAL_INT(0, battery_model_init_lut(&cfg));
+   TEST_ASSERT_NOT_NULL(battery_model_lut());
+   TEST_ASSERT_FLOAT_WITHIN(0.15f, before, battery_calculate_percentage(11.19f, &cfg));
+
+   /* A different pack still gets the curve */
+   battery_config_t other = make_liion_5s();
+   TEST_ASSERT_FLOAT_WITHIN(0.5f, 100.0f, battery_calculate_percentage(other.max_voltage, &other));
+}
+
+void test_lut_rejects_unknown_chemistry(void) {
+   battery_config_t cfg = make_unknown_linear();
+   static battery_lut_t lut;
+   TEST_ASSERT_EQUAL_INT(-1, battery_lut_build(&lut, &cfg));
+   TEST_ASSERT_EQUAL_INT(-1, battery_model_init_lut(&cfg));
+   TEST_ASSERT_NULL(battery_model_lut());
+}
+
+/* EKF SOC estimator */
+
+/* Terminal voltage of a pack at a given SOC and steady current, per the
+ * estimator's own model (RC pair settled) */
+static float model_voltage(const battery_lut_t *lut, const battery_ekf_t *ekf, float soc,
+                           float current_a) {
+   float cell_v = battery_lut_cell_voltage(lut, soc * 100.0f);
+   return cell_v * ekf->cells_series - (ekf->r0 + ekf->r1) * current_a;
+}
+
+void test_ekf_tracks_coulomb_counting_on_flat_curve(void) {
+   battery_config_t cfg = make_lifepo4_4s(); /* 10 Ah */
+   static battery_lut_t lut;
+   battery_ekf_t ekf;
+   TEST_ASSERT_EQUAL_INT(0, battery_lut_build(&lut, &cfg));
+   TEST_ASSERT_EQUAL_INT(0, battery_ekf_init(&ekf, &cfg, &lut));
+
+   /* 5 A discharge for 30 min from 80 %: 2.5 Ah, 25 % */
+   float soc = 0.80f;
+   for (int t = 0; t <= 1800; t++) {
+      battery_ekf_update(&ekf, model_voltage(&lut, &ekf, soc, 5.0f), 5.0f, 1.0f);
+      soc -= 5.0f / 36000.0f;
+   }
+
+   TEST_ASSERT_FLOAT_WITHIN(3.0f, 55.0f, battery_ekf_soc_percent(&ekf));
+   TEST_ASSERT_TRUE(battery_ekf_sigma_percent(&ekf) > 0.0f);
+   TEST_ASSERT_TRUE(battery_ekf_sigma_percent(&ekf) < 10.0f);
+}
+
+void test_ekf_corrects_wrong_start_on_sloped_curve(void) {
+   battery_config_t cfg = make_liion_5s(); /* 5 Ah */
+   static battery_lut_t lut;
+   battery_ekf_t ekf;
+   TEST_ASSERT_EQUAL_INT(0, battery_lut_build(&lut, &cfg));
+   TEST_ASSERT_EQUAL_INT(0, battery_ekf_init(&ekf, &cfg, &lut));
+
+   float soc = 0.60f;
+   battery_ekf_update(&ekf, model_voltage(&lut, &ekf, soc, 1.0f), 1.0f, 1.0f);
+   ekf.soc = 0.30f; /* e.g. seeded under a load spike */
+
+   for (int t = 0; t < 1200; t++) {
+      soc -= 1.0f / 18000.0f;
+      battery_ekf_update(&ekf, model_voltage(&lut, &ekf, soc, 1.0f), 1.0f, 1.0f);
+   }
+
+   TEST_ASSERT_FLOAT_WITHIN(2.0f, soc * 100.0f, battery_ekf_soc_percent(&ekf));
+}
+
+void test_ekf_clamps_and_bounds_dt(void) {
+   battery_config_t cfg = make_liion_5s();
+   static battery_lut_t lut;
+   battery_ekf_t ekf;
+   TEST_ASSERT_EQUAL_INT(0, battery_lut_build(&lut, &cfg));
+   TEST_ASSERT_EQUAL_INT(0, battery_ekf_init(&ekf, &cfg, &lut));
+
+   battery_ekf_update(&ekf, cfg.min_voltage, 0.0f, 1.0f);
+   /* A huge gap is integrated as BATTERY_EKF_MAX_DT_S; SOC cannot go negative */
+   battery_ekf_update(&ekf, cfg.min_voltage, 50.0f, 1e6f);
+   TEST_ASSERT_TRUE(battery_ekf_soc_percent(&ekf) >= 0.0f);
+   TEST_ASSERT_TRUE(battery_ekf_sigma_percent(&ekf) == battery_ekf_sigma_percent(&ekf));
+}
+
+void test_ekf_init_rejects_missing_capacity(void) {
+   battery_config_t cfg = make_liion_5s();
+   static battery_lut_t lut;
+   battery_ekf_t ekf;
+   TEST_ASSERT_EQUAL_INT(0, battery_lut_build(&lut, &cfg));
+   cfg.capacity_mah = 0.0f;
+   TEST_ASSERT_EQUAL_INT(-1, battery_ekf_init(&ekf, &cfg, &lut));
+   TEST_ASSERT_EQUAL_INT(-1, battery_ekf_init(&ekf, &cfg, NULL));
+}
+
+/* Internal resistance */
+
+/* Alternate between two loads on a source with the given OCV and resistance */
+static void feed_steps(battery_rint_t *est, float ocv, float r_ohm, int n) {
+   for (int k = 0; k < n; k++) {
+      float i = (k % 2) ? 4.0f : 1.0f;
+      battery_rint_update(est, ocv - r_ohm * i, i, 1.0f);
+   }
+}
+
+void test_rint_recovers_resistance_from_steps(void) {
+   battery_rint_t est = { 0 };
+   feed_steps(&est, 16.0f, 0.050f, 12);
+   TEST_ASSERT_TRUE(battery_rint_valid(&est));
+   TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.050f, est.r_ohm);
+   TEST_ASSERT_EQUAL_INT(11, est.steps);
+}
+
+void test_rint_ignores_non_steps(void) {
+   battery_rint_t est = { 0 };
+   TEST_ASSERT_FALSE(battery_rint_update(&est, 16.0f, 1.0f, 1.0f));
+   /* Too small */
+   TEST_ASSERT_FALSE(battery_rint_update(&est, 15.99f, 1.2f, 1.0f));
+   /* Too far apart */
+   TEST_ASSERT_FALSE(battery_rint_update(&est, 15.8f, 5.0f, 60.0f));
+   /* Voltage moving with the current (e.g. charger connected) */
+   TEST_ASSERT_FALSE(battery_rint_update(&est, 16.2f, 8.0f, 1.0f));
+   TEST_ASSERT_EQUAL_INT(0, est.steps);
+   TEST_ASSERT_FALSE(battery_rint_valid(&est));
+   TEST_ASSERT_EQUAL_FLOAT(0.0f, battery_rint_ratio(&est));
+}
+
+void test_rint_ratio_tracks_ageing(void) {
+   battery_rint_t est = { 0 };
+   feed_steps(&est, 16.0f, 0.050f, BATTERY_RINT_BASELINE_STEPS + 2);
+   TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.050f, est.baseline_ohm);
+   TEST_ASSERT_FLOAT_WITHIN(0.02f, 1.0f, battery_rint_ratio(&est));
+
+   /* Forgetting lets the estimate follow a 20 % rise */
+   feed_steps(&est, 16.0f, 0.060f, 400);
+   TEST_ASSERT_FLOAT_WITHIN(0.02f, 1.2f, battery_rint_ratio(&est));
+   TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.050f, est.baseline_ohm);
+}
+
+void test_rint_baselines_round_trip(void) {
+   char path[64];
+   snprintf(path, sizeof(path), "/tmp/test_rint_%d", (int)getpid());
+   battery_rint_t saved[3];
+   battery_rint_t loaded[3];
+   memset(saved, 0, sizeof(saved));
+   memset(loaded, 0, sizeof(loaded));
+   saved[0].baseline_ohm = 0.05f;
+   saved[2].baseline_ohm = 0.002f;
+
+   TEST_ASSERT_EQUAL_INT(0, battery_rint_save_baselines(path, saved, 3));
+   TEST_ASSERT_EQUAL_INT(2, battery_rint_load_baselines(path, loaded, 3));
+   TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.05f, loaded[0].baseline_ohm);
+   TEST_ASSERT_EQUAL_FLOAT(0.0f, loaded[1].baseline_ohm);
+   TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.002f, loaded[2].baseline_ohm);
+   unlink(path);
+
+   TEST_ASSERT_EQUAL_INT(-1, battery_rint_load_baselines(path, loaded, 3));
+}
+
+void test_loaded_percentage_compensates_to_reference_load(void) {
+   battery_config_t cfg = make_liion_5s(); /* 5 Ah: reference load 1 A */
+   float v = 18.4f;
+
+   /* Without a resistance, nothing changes */
+   TEST_ASSERT_EQUAL_FLOAT(battery_calculate_percentage(v, &cfg),
+                           battery_calculate_percentage_loaded(v, 5.0f, &cfg));
+
+   cfg.resistance_ohm = 0.1f;
+   TEST_ASSERT_EQUAL_FLOAT(battery_calculate_percentage(v, &cfg),
+                           battery_calculate_percentage_loaded(v, 1.0f, &cfg));
+   /* 5 A sags 0.4 V more than the reference load; at rest it reads 0.1 V high */
+   TEST_ASSERT_EQUAL_FLOAT(battery_calculate_percentage(v + 0.4f, &cfg),
+                           battery_calculate_percentage_loaded(v, 5.0f, &cfg));
+   TEST_ASSERT_EQUAL_FLOAT(battery_calculate_percentage(v - 0.1f, &cfg),
+                           battery_calculate_percentage_loaded(v, 0.0f, &cfg));
+}
+
+/* Constant load for a number of seconds, sampled every 10 s */
+static void feed_load(battery_runtime_t *rt, float current_a, int seconds) {
+   for (int t = 0; t < seconds; t += 10) {
+      battery_runtime_update(rt, current_a, 10.0f);
+   }
+}
+
+void test_runtime_steady_load(void) {
+   battery_runtime_t rt;
+   battery_runtime_forecast_t fc;
+   memset(&rt, 0, sizeof(rt));
+   TEST_ASSERT_EQUAL_INT(-1, battery_runtime_predict(&rt, NULL, 2500.0f, -273.0f, &fc));
+
+   feed_load(&rt, 1.0f, 2 * 3600);
+   TEST_ASSERT_EQUAL_INT(0, battery_runtime_predict(&rt, NULL, 2500.0f, -273.0f, &fc));
+   TEST_ASSERT_FLOAT_WITHIN(0.01f, 1.0f, fc.load_a);
+   TEST_ASSERT_FLOAT_WITHIN(1.0f, 150.0f, fc.p50_min);
+   TEST_ASSERT_FLOAT_WITHIN(1.0f, 150.0f, fc.p10_min);
+   TEST_ASSERT_FLOAT_WITHIN(1.0f, 150.0f, fc.p90_min);
+}
+
+void test_runtime_duty_cycle_bounds(void) {
+   battery_runtime_t rt;
+   battery_runtime_forecast_t fc;
+   memset(&rt, 0, sizeof(rt));
+   for (int cycle = 0; cycle < 12; cycle++) {
+      feed_load(&rt, 3.0f, 600);
+      feed_load(&rt, 0.5f, 600);
+   }
+
+   TEST_ASSERT_EQUAL_INT(0, battery_runtime_predict(&rt, NULL, 2500.0f, -273.0f, &fc));
+   /* Bounds come from the heavy and light phases, the median from the recent level */
+   TEST_ASSERT_FLOAT_WITHIN(2.0f, 50.0f, fc.p10_min);
+   TEST_ASSERT_FLOAT_WITHIN(20.0f, 300.0f, fc.p90_min);
+   TEST_ASSERT_TRUE(fc.p10_min <= fc.p50_min);
+   TEST_ASSERT_TRUE(fc.p50_min <= fc.p90_min);
+}
+
+void test_runtime_peukert_and_temperature(void) {
+   battery_config_t cfg = make_liion_5s();
+   cfg.chemistry = BATT_CHEMISTRY_LEAD_ACID;
+   cfg.capacity_mah = 100000.0f; /* Rated at 5 A over 20 h */
+   battery_runtime_t rt;
+   battery_runtime_forecast_t fc;
+
+   /* 4x the rated load: (1/4)^0.25 of the capacity is usable */
+   memset(&rt, 0, sizeof(rt));
+   feed_load(&rt, 20.0f, 600);
+   TEST_ASSERT_EQUAL_INT(0, battery_runtime_predict(&rt, &cfg, 50000.0f, 25.0f, &fc));
+   TEST_ASSERT_FLOAT_WITHIN(0.5f, 150.0f * 0.7071f, fc.p50_min);
+
+   /* Cold lead acid keeps less than half its capacity */
+   TEST_ASSERT_EQUAL_INT(0, battery_runtime_predict(&rt, &cfg, 50000.0f, 0.0f, &fc));
+   TEST_ASSERT_FLOAT_WITHIN(0.5f, 150.0f * 0.7071f * 0.46f, fc.p50_min);
+
+   /* Below the rated load the capacity is not stretched */
+   memset(&rt, 0, sizeof(rt));
+   feed_load(&rt, 2.0f, 600);
+   TEST_ASSERT_EQUAL_INT(0, battery_runtime_predict(&rt, &cfg, 50000.0f, 25.0f, &fc));
+   TEST_ASSERT_FLOAT_WITHIN(1.0f, 1500.0f, fc.p50_min);
+}
+
+void test_runtime_trend_and_idle(void) {
+   battery_runtime_t rt;
+   battery_runtime_forecast_t fc;
+
+   /* A rising load (1 A/h) shows as a trend (damped to a third of the slope
+    * at these time constants) that raises the forecast */
+   memset(&rt, 0, sizeof(rt));
+   for (int t = 0; t < 3600; t += 10) {
+      battery_runtime_update(&rt, 1.0f + t / 3600.0f, 10.0f);
+   }
+   TEST_ASSERT_EQUAL_INT(0, battery_runtime_predict(&rt, NULL, 5000.0f, -273.0f, &fc));
+   TEST_ASSERT_TRUE(rt.trend_a_per_h > 0.25f);
+   battery_runtime_t flat = rt;
+   battery_runtime_forecast_t flat_fc;
+   flat.trend_a_per_h = 0.0f;
+   TEST_ASSERT_EQUAL_INT(0, battery_runtime_predict(&flat, NULL, 5000.0f, -273.0f, &flat_fc));
+   TEST_ASSERT_TRUE(fc.load_a > flat_fc.load_a);
+   TEST_ASSERT_TRUE(fc.p50_min < flat_fc.p50_min);
+
+   /* Idle or charging never runs out */
+   memset(&rt, 0, sizeof(rt));
+   feed_load(&rt, -2.0f, 600);
+   TEST_ASSERT_EQUAL_INT(0, battery_runtime_predict(&rt, NULL, 5000.0f, -273.0f, &fc));
+   TEST_ASSERT_EQUAL_FLOAT(BATTERY_RUNTIME_MAX_MIN, fc.p10_min);
+   TEST_ASSERT_EQUAL_FLOAT(BATTERY_RUNTIME_MAX_MIN, fc.p50_min);
+}
+
 int main(void) {
    UNITY_BEGIN();
 
@@ -245,5 +579,28 @@ int main(void) {
    RUN_TEST(test_chemistry_from_string_null_returns_unknown);
    RUN_TEST(test_chemistry_from_string_garbage_returns_unknown);
 
+   RUN_TEST(test_lut_matches_curve_interpolation);
+   RUN_TEST(test_lut_inverse_round_trip);
+   RUN_TEST(test_lut_temperature_factor);
+   RUN_TEST(test_lut_batch_matches_single);
+   RUN_TEST(test_default_lut_used_for_matching_config);
+   RUN_TEST(test_lut_rejects_unknown_chemistry);
+
+   RUN_TEST(test_ekf_tracks_coulomb_counting_on_flat_curve);
+   RUN_TEST(test_ekf_corrects_wrong_start_on_sloped_curve);
+   RUN_TEST(test_ekf_clamps_and_bounds_dt);
+   RUN_TEST(test_ekf_init_rejects_missing_capacity);
+
+   RUN_TEST(test_rint_recovers_resistance_from_steps);
+   RUN_TEST(test_rint_ignores_non_steps);
+   RUN_TEST(test_rint_ratio_tracks_ageing);
+   RUN_TEST(test_rint_baselines_round_trip);
+   RUN_TEST(test_loaded_percentage_compensates_to_reference_load);
+
+   RUN_TEST(test_runtime_steady_load);
+   RUN_TEST(test_runtime_duty_cycle_bounds);
+   RUN_TEST(test_runtime_peukert_and_temperature);
+   RUN_TEST(test_runtime_trend_and_idle);
+
    return UNITY_END();
 }
@@ -0,0 +1,228 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s).
+ *
+ * Unit tests for Daly BMS auto-detection: the probe frame assembler fed with
+ * in-memory byte streams, and the port/baud cache read back from files under
+ * /tmp. No serial port required.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "daly_bms.h"
+#include "daly_bms_internal.h"
+#include "unity.h"
+
+static char cache_file[64];
+static daly_probe_t probe;
+
+void setUp(void) {
+   snprintf(cache_file, sizeof(cache_file), "/tmp/test_daly_bms_%d", (int)getpid());
+   daly_bms_set_detect_cache(cache_file);
+   memset(&probe, 0, sizeof(probe));
+   probe.fd = -1;
+}
+
+void tearDown(void) {
+   unlink(cache_file);
+   daly_bms_set_detect_cache(NULL);
+}
+
+/* Helpers */
+
+static void make_reply(uint8_t addr, uint8_t cmd, uint8_t *frame) {
+   const uint8_t data[8] = { 0x01, 0xC8, 0x00, 0x00, 0x75, 0x30, 0x03, 0xE8 };
+   frame[0] = DALY_START_BYTE;
+   frame[1] = addr;
+   frame[2] = cmd;
+   frame[3] = DALY_LEN_FIXED;
+   memcpy(frame + 4, data, 8);
+   frame[12] = daly_checksum(frame, 12);
+}
+
+static void write_cache(const char *text) {
+   FILE *fp = fopen(cache_file, "w");
+   TEST_ASSERT_NOT_NULL(fp);
+   fputs(text, fp);
+   fclose(fp);
+}
+
+/* Probe frame assembly */
+
+void test_probe_accepts_pack_info_reply(void) {
+   uint8_t frame[DALY_FRAME_LEN];
+   make_reply(DALY_BMS_ADDR, DALY_CMD_PACK_INFO, frame);
+   TEST_ASSERT_TRUE(daly_probe_feed(&probe, frame, sizeof(frame)));
+}
+
+void test_probe_assembles_reply_split_across_reads(void) {
+   uint8_t frame[DALY_FRAME_LEN];
+   make_reply(DALY_BMS_ADDR, DALY_CMD_PACK_INFO, frame);
+
+   TEST_ASSERT_FALSE(daly_probe_feed(&probe, frame, 1));
+   TEST_ASSERT_FALSE(daly_probe_feed(&probe, frame + 1, 6));
+   TEST_ASSERT_TRUE(daly_probe_feed(&probe, frame + 7, DALY_FRAME_LEN - 7));
+}
+
+void test_probe_skips_noise_before_start_byte(void) {
+   uint8_t bytes[3 + DALY_FRAME_LEN] = { 0x00, 0xFF, 0x13 };
+   make_reply(DALY_BMS_ADDR, DALY_CMD_PACK_INFO, bytes + 3);
+   TEST_ASSERT_TRUE(daly_probe_feed(&probe, bytes, sizeof(bytes)));
+}
+
+void test_probe_resyncs_after_corrupt_frame(void) {
+   uint8_t bytes[2 * DALY_FRAME_LEN];
+   make_reply(DALY_BMS_ADDR, DALY_CMD_PACK_INFO, bytes);
+   bytes[DALY_FRAME_LEN - 1] ^= 0x01;
+   make_reply(DALY_BMS_ADDR, DALY_CMD_PACK_INFO, bytes + DALY_FRAME_LEN);
+
+   TEST_ASSERT_FALSE(daly_probe_feed(&probe, bytes, DALY_FRAME_LEN));
+   TEST_ASSERT_TRUE(daly_probe_feed(&probe, bytes + DALY_FRAME_LEN, DALY_FRAME_LEN));
+}
+
+void test_probe_rejects_truncated_reply(void) {
+   uint8_t frame[DALY_FRAME_LEN];
+   make_reply(DALY_BMS_ADDR, DALY_CMD_PACK_INFO, frame);
+   TEST_ASSERT_FALSE(daly_probe_feed(&probe, frame, DALY_FRAME_LEN - 1));
+}
+
+void test_probe_rejects_other_board_address(void) {
+   /* Detection talks to the first board; a reply from board 2 is not it */
+   uint8_t frame[DALY_FRAME_LEN];
+   make_reply(DALY_BMS_ADDR + 1, DALY_CMD_PACK_INFO, frame);
+   TEST_ASSERT_FALSE(daly_probe_feed(&probe, frame, sizeof(frame)));
+}
+
+void test_probe_rejects_other_command(void) {
+   uint8_t frame[DALY_FRAME_LEN];
+   make_reply(DALY_BMS_ADDR, DALY_CMD_STATUS, frame);
+   TEST_ASSERT_FALSE(daly_probe_feed(&probe, frame, sizeof(frame)));
+}
+
+/* Detect cache */
+
+void test_cache_round_trip(void) {
+   char port[64];
+   int baud = 0;
+
+   daly_write_detect_cache("/dev/ttyUSB3", 115200);
+   TEST_ASSERT_TRUE(daly_read_detect_cache(port, sizeof(port), &baud));
+   TEST_ASSERT_EQUAL_STRING("/dev/ttyUSB3", port);
+   TEST_ASSERT_EQUAL_INT(115200, baud);
+
+   /* The temporary file is renamed into place */
+   char tmp_path[80];
+   snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cache_file);
+   TEST_ASSERT_EQUAL_INT(-1, access(tmp_path, F_OK));
+}
+
+void test_cache_missing_file(void) {
+   char port[64];
+   int baud = 0;
+   TEST_ASSERT_FALSE(daly_read_detect_cache(port, sizeof(port), &baud));
+}
+
+void test_cache_disabled(void) {
+   char port[64];
+   int baud = 0;
+
+   write_cache("/dev/ttyUSB0 9600\n");
+   daly_bms_set_detect_cache(NULL);
+   TEST_ASSERT_FALSE(daly_read_detect_cache(port, sizeof(port), &baud));
+}
+
+void test_cache_rejects_corrupt_file(void) {
+   char port[64] = "unchanged";
+   int baud = 0;
+
+   write_cache("");
+   TEST_ASSERT_FALSE(daly_read_detect_cache(port, sizeof(port), &baud));
+   write_cache("\x01\x02\xff garbage\n");
+   TEST_ASSERT_FALSE(daly_read_detect_cache(port, sizeof(port), &baud));
+   TEST_ASSERT_EQUAL_STRING("unchanged", port);
+   TEST_ASSERT_EQUAL_INT(0, baud);
+}
+
+void test_cache_rejects_partial_line(void) {
+   char port[64] = "unchanged";
+   int baud = 0;
+
+   /* Cut off before the baud rate, and in the middle of it */
+   write_cache("/dev/ttyUSB0");
+   TEST_ASSERT_FALSE(daly_read_detect_cache(port, sizeof(port), &baud));
+   write_cache("/dev/ttyUSB0 96");
+   TEST_ASSERT_FALSE(daly_read_detect_cache(port, sizeof(port), &baud));
+   TEST_ASSERT_EQUAL_STRING("unchanged", port);
+}
+
+void test_cache_rejects_baud_not_probed(void) {
+   char port[64] = "unchanged";
+   int baud = 0;
+
+   write_cache("/dev/ttyUSB0 19200\n");
+   TEST_ASSERT_FALSE(daly_read_detect_cache(port, sizeof(port), &baud));
+   write_cache("/dev/ttyUSB0 -9600\n");
+   TEST_ASSERT_FALSE(daly_read_detect_cache(port, sizeof(port), &baud));
+   TEST_ASSERT_EQUAL_INT(0, baud);
+}
+
+void test_cache_rejects_port_too_long(void) {
+   char port[8];
+   int baud = 0;
+
+   write_cache("/dev/serial/by-id/usb-FTDI_FT232R-if00-port0 9600\n");
+   TEST_ASSERT_FALSE(daly_read_detect_cache(port, sizeof(port), &baud));
+}
+
+void test_cache_is_replaced_when_port_moves(void) {
+   char port[64];
+   int baud = 0;
+
+   /* A stale entry is overwritten by the next detection, not appended to */
+   daly_write_detect_cache("/dev/ttyUSB0", 9600);
+   daly_write_detect_cache("/dev/ttyACM0", 115200);
+   TEST_ASSERT_TRUE(daly_read_detect_cache(port, sizeof(port), &baud));
+   TEST_ASSERT_EQUAL_STRING("/dev/ttyACM0", port);
+   TEST_ASSERT_EQUAL_INT(115200, baud);
+}
+
+int main(void) {
+   UNITY_BEGIN();
+
+   RUN_TEST(test_probe_accepts_pack_info_reply);
+   RUN_TEST(test_probe_assembles_reply_split_across_reads);
+   RUN_TEST(test_probe_skips_noise_before_start_byte);
+   RUN_TEST(test_probe_resyncs_after_corrupt_frame);
+   RUN_TEST(test_probe_rejects_truncated_reply);
+   RUN_TEST(test_probe_rejects_other_board_address);
+   RUN_TEST(test_probe_rejects_other_command);
+
+   RUN_TEST(test_cache_round_trip);
+   RUN_TEST(test_cache_missing_file);
+   RUN_TEST(test_cache_disabled);
+   RUN_TEST(test_cache_rejects_corrupt_file);
+   RUN_TEST(test_cache_rejects_partial_line);
+   RUN_TEST(test_cache_rejects_baud_not_probed);
+   RUN_TEST(test_cache_rejects_port_too_long);
+   RUN_TEST(test_cache_is_replaced_when_port_moves);
+
+   return UNITY_END();
+}
@@ -24,6 +24,7 @@
 #include <string.h>
 
 #include "daly_bms.h"
+#include "daly_packs.h"
 #include "unity.h"
 
 /* Thresholds matching DALY_CELL_WARNING_THRESHOLD_MV / DALY_CELL_CRITICAL_THRESHOLD_MV */
@@ -38,10 +39,11 @@ void setUp(void) {
    memset(&g_health, 0, sizeof(g_health));
    g_dev.initialized = true;
    g_dev.data.valid = true;
+   g_dev.data.fields = DALY_FIELD_ALL;
 }
 
 void tearDown(void) {
-   daly_bms_free_health(&g_health);
+   daly_bms_reset_health(&g_health);
 }
 
 /* Fixture helper: populate an N-cell pack with all cells at the given millivolts.
@@ -58,6 +60,7 @@ static void fixture_balanced_pack(int cell_count, int cell_mv) {
    g_dev.data.extremes.vmin_cell = 1;
    g_dev.data.pack.v_total_v = (cell_count * cell_mv) / 1000.0f;
    g_dev.data.fault_count = 0;
+   g_dev.data.faults = 0;
 }
 
 /* analyze_health */
@@ -102,12 +105,12 @@ void test_health_cell_below_2v_flagged_as_warning(void) {
     * The low cell is tagged WARNING individually. Overall should be at least WARNING. */
    TEST_ASSERT_TRUE(status == DALY_HEALTH_WARNING || status == DALY_HEALTH_CRITICAL);
    TEST_ASSERT_TRUE(g_health.problem_cell_count >= 1);
-   TEST_ASSERT_EQUAL_INT(DALY_HEALTH_WARNING, g_health.cells[0].status);
+   TEST_ASSERT_EQUAL_INT(DALY_HEALTH_WARNING, g_health.status[0]);
 }
 
 void test_health_faults_elevate_to_warning(void) {
    fixture_balanced_pack(4, 3700);
-   snprintf(g_dev.data.faults[0], sizeof(g_dev.data.faults[0]), "%s", "Some fault");
+   g_dev.data.faults = 1ULL << 41; /* Voltage collect dropped (info) */
    g_dev.data.fault_count = 1;
    int status = daly_bms_analyze_health(&g_dev, &g_health, WARN_MV, CRIT_MV);
    TEST_ASSERT_EQUAL_INT(DALY_HEALTH_WARNING, status);
@@ -124,10 +127,164 @@ void test_health_null_health_safe(void) {
    TEST_ASSERT_EQUAL_INT(DALY_HEALTH_NORMAL, status);
 }
 
+/* Poll the fixture every step_s for the given span, cell 3 offset by
+ * mv_at(t) above the others */
+static void run_polls(int span_s, int step_s, int (*mv_at)(int t)) {
+   for (int t = 0; t <= span_s; t += step_s) {
+      g_dev.data.cell_mv[2] = 3700 + mv_at(t);
+      g_dev.data.last_ok = 1700000000 + t;
+      daly_bms_analyze_health(&g_dev, &g_health, WARN_MV, CRIT_MV);
+   }
+}
+
+/* 20 mV/day rise: the cell is 15 mV/day further from the 4-cell mean */
+static int rising_offset(int t) {
+   return (int)(20.0 * t / 86400.0);
+}
+
+static int fixed_offset(int t) {
+   (void)t;
+   return 40;
+}
+
+void test_health_reason_formatted_only_on_change(void) {
+   fixture_balanced_pack(4, 3700);
+   g_dev.data.cell_mv[1] = 3800;
+   g_dev.data.last_ok = 1000;
+   daly_bms_analyze_health(&g_dev, &g_health, WARN_MV, CRIT_MV);
+   TEST_ASSERT_EQUAL_UINT32(1u << 1, g_health.changed);
+   TEST_ASSERT_NOT_NULL(strstr(g_health.reason[1], "warning threshold"));
+
+   /* Same status on the next poll: reason is left alone */
+   g_health.reason[1][0] = 'X';
+   g_dev.data.last_ok = 1010;
+   daly_bms_analyze_health(&g_dev, &g_health, WARN_MV, CRIT_MV);
+   TEST_ASSERT_EQUAL_UINT32(0, g_health.changed);
+   TEST_ASSERT_EQUAL_CHAR('X', g_health.reason[1][0]);
+
+   /* Back to normal: reason cleared */
+   g_dev.data.cell_mv[1] = 3700;
+   g_dev.data.last_ok = 1020;
+   daly_bms_analyze_health(&g_dev, &g_health, WARN_MV, CRIT_MV);
+   TEST_ASSERT_EQUAL_UINT32(1u << 1, g_health.changed);
+   TEST_ASSERT_EQUAL_INT(DALY_HEALTH_NORMAL, g_health.status[1]);
+   TEST_ASSERT_EQUAL_STRING("", g_health.reason[1]);
+}
+
+void test_health_slow_drift_flagged_before_warning(void) {
+   fixture_balanced_pack(4, 3700);
+   run_polls(2 * 86400, 600, rising_offset);
+
+   /* ~30 mV off after two days: still normal, but heading for 70 mV */
+   TEST_ASSERT_EQUAL_INT(DALY_HEALTH_NORMAL, g_health.overall_status);
+   TEST_ASSERT_EQUAL_INT(DALY_HEALTH_NORMAL, g_health.status[2]);
+   TEST_ASSERT_FLOAT_WITHIN(2.0f, 15.0f, g_health.drift_mv_per_day[2]);
+   TEST_ASSERT_TRUE(g_health.drifting[2]);
+   TEST_ASSERT_EQUAL_INT(1, g_health.drifting_cell_count);
+   TEST_ASSERT_NOT_NULL(strstr(g_health.reason[2], "Drifting"));
+   TEST_ASSERT_FALSE(g_health.drifting[0]);
+}
+
+void test_health_stable_offset_is_not_drift(void) {
+   fixture_balanced_pack(4, 3700);
+   run_polls(2 * 86400, 600, fixed_offset);
+
+   /* Offset of 40 mV is 30 mV from the mean, with no trend */
+   TEST_ASSERT_FLOAT_WITHIN(0.5f, 30.0f, g_health.ewma_mv[2]);
+   TEST_ASSERT_FLOAT_WITHIN(0.1f, 0.0f, g_health.ewvar_mv2[2]);
+   TEST_ASSERT_FLOAT_WITHIN(0.5f, 0.0f, g_health.drift_mv_per_day[2]);
+   TEST_ASSERT_EQUAL_INT(0, g_health.drifting_cell_count);
+}
+
+void test_health_no_trend_before_min_span(void) {
+   fixture_balanced_pack(4, 3700);
+   run_polls(DALY_HEALTH_DRIFT_MIN_SPAN_S - 600, 600, rising_offset);
+   TEST_ASSERT_EQUAL_FLOAT(0.0f, g_health.drift_mv_per_day[2]);
+   TEST_ASSERT_EQUAL_INT(0, g_health.drifting_cell_count);
+}
+
+void test_health_cell_count_change_resets_statistics(void) {
+   fixture_balanced_pack(4, 3700);
+   run_polls(86400, 3600, fixed_offset);
+   TEST_ASSERT_TRUE(g_health.samples > 1);
+
+   fixture_balanced_pack(8, 3700);
+   g_dev.data.last_ok = 1800000000;
+   daly_bms_analyze_health(&g_dev, &g_health, WARN_MV, CRIT_MV);
+   TEST_ASSERT_EQUAL_INT(1, g_health.samples);
+   TEST_ASSERT_EQUAL_INT(8, g_health.cell_count);
+   TEST_ASSERT_EQUAL_FLOAT(0.0f, g_health.ewma_mv[2]);
+}
+
+void test_health_estimates_cell_resistance(void) {
+   fixture_balanced_pack(4, 3300);
+   for (int k = 0; k < 12; k++) {
+      /* Daly current is negative when discharging: 2 A / 12 A load */
+      float load = (k % 2) ? 12.0f : 2.0f;
+      g_dev.data.pack.current_a = -load;
+      for (int i = 0; i < 4; i++) {
+         g_dev.data.cell_mv[i] = 3300 - (int)(load * (i == 3 ? 4.0f : 2.0f));
+      }
+      g_dev.data.pack.v_total_v = (4 * 3300 - load * 10.0f) / 1000.0f;
+      g_dev.data.last_ok = 1000 + k;
+      daly_bms_analyze_health(&g_dev, &g_health, WARN_MV, CRIT_MV);
+   }
+
+   TEST_ASSERT_TRUE(battery_rint_valid(&g_health.rint[0]));
+   TEST_ASSERT_FLOAT_WITHIN(0.0005f, 0.010f, g_health.rint[0].r_ohm);
+   TEST_ASSERT_FLOAT_WITHIN(0.0002f, 0.002f, g_health.rint[1].r_ohm);
+   TEST_ASSERT_FLOAT_WITHIN(0.0002f, 0.004f, g_health.rint[4].r_ohm);
+}
+
+void test_health_stale_cells_leave_statistics_alone(void) {
+   fixture_balanced_pack(4, 3700);
+   run_polls(3600, 600, fixed_offset);
+   int samples = g_health.samples;
+   float ewma = g_health.ewma_mv[2];
+   float deviation = g_health.deviation_mv[2];
+
+   /* 0x95 failed: cell_mv still holds whatever was there before */
+   g_dev.data.fields = DALY_FIELD_ALL & ~DALY_FIELD_CELLS;
+   g_dev.data.cell_mv[2] = 3900;
+   g_dev.data.last_ok += 600;
+   daly_bms_analyze_health(&g_dev, &g_health, WARN_MV, CRIT_MV);
+
+   TEST_ASSERT_EQUAL_INT(samples, g_health.samples);
+   TEST_ASSERT_EQUAL_FLOAT(ewma, g_health.ewma_mv[2]);
+   TEST_ASSERT_EQUAL_FLOAT(deviation, g_health.deviation_mv[2]);
+   TEST_ASSERT_EQUAL_INT(DALY_HEALTH_NORMAL, g_health.status[2]);
+   TEST_ASSERT_EQUAL_UINT32(0, g_health.changed);
+}
+
+void test_health_stale_pack_skips_resistance(void) {
+   fixture_balanced_pack(4, 3300);
+   g_dev.data.fields = DALY_FIELD_ALL & ~DALY_FIELD_PACK;
+   for (int k = 0; k < 12; k++) {
+      g_dev.data.pack.current_a = (k % 2) ? -12.0f : -2.0f;
+      g_dev.data.last_ok = 1000 + k;
+      daly_bms_analyze_health(&g_dev, &g_health, WARN_MV, CRIT_MV);
+   }
+
+   /* Cell statistics still advance; the load steps are not trusted */
+   TEST_ASSERT_EQUAL_INT(12, g_health.samples);
+   TEST_ASSERT_EQUAL_INT(0, (int)g_health.last_pack_sample);
+   TEST_ASSERT_FALSE(battery_rint_valid(&g_health.rint[0]));
+   TEST_ASSERT_FALSE(battery_rint_valid(&g_health.rint[1]));
+}
+
 /* categorize_faults */
 
+/* Set the given fault codes on the fixture device */
+static void set_faults(const int *codes, int n) {
+   g_dev.data.faults = 0;
+   for (int i = 0; i < n; i++) {
+      g_dev.data.faults |= 1ULL << codes[i];
+   }
+   g_dev.data.fault_count = n;
+}
+
 void test_categorize_empty_faults(void) {
-   g_dev.data.fault_count = 0;
+   set_faults(NULL, 0);
    daly_fault_summary_t summary;
    TEST_ASSERT_EQUAL_INT(0, daly_bms_categorize_faults(&g_dev, &summary));
    TEST_ASSERT_EQUAL_INT(0, summary.critical_count);
@@ -136,59 +293,236 @@ void test_categorize_empty_faults(void) {
 }
 
 void test_categorize_l2_fault_is_critical(void) {
-   snprintf(g_dev.data.faults[0], sizeof(g_dev.data.faults[0]), "%s", "Cell volt high L2");
-   g_dev.data.fault_count = 1;
+   const int codes[] = { 1 }; /* Cell volt high L2 */
+   set_faults(codes, 1);
    daly_fault_summary_t summary;
    TEST_ASSERT_EQUAL_INT(0, daly_bms_categorize_faults(&g_dev, &summary));
    TEST_ASSERT_EQUAL_INT(1, summary.critical_count);
-   TEST_ASSERT_EQUAL_STRING("Cell volt high L2", summary.critical_faults[0]);
+   TEST_ASSERT_EQUAL_STRING("Cell volt high L2",
+                            daly_fault_description(daly_fault_next(&summary.critical)));
 }
 
 void test_categorize_l1_fault_is_warning(void) {
-   snprintf(g_dev.data.faults[0], sizeof(g_dev.data.faults[0]), "%s", "Cell volt high L1");
-   g_dev.data.fault_count = 1;
+   const int codes[] = { 0 }; /* Cell volt high L1 */
+   set_faults(codes, 1);
    daly_fault_summary_t summary;
    TEST_ASSERT_EQUAL_INT(0, daly_bms_categorize_faults(&g_dev, &summary));
    TEST_ASSERT_EQUAL_INT(1, summary.warning_count);
-   TEST_ASSERT_EQUAL_STRING("Cell volt high L1", summary.warning_faults[0]);
+   TEST_ASSERT_EQUAL_STRING("Cell volt high L1",
+                            daly_fault_description(daly_fault_next(&summary.warning)));
 }
 
 void test_categorize_short_circuit_is_critical(void) {
-   snprintf(g_dev.data.faults[0], sizeof(g_dev.data.faults[0]), "%s",
-            "Short circuit protect fault");
-   g_dev.data.fault_count = 1;
+   const int codes[] = { 50 }; /* Short circuit protect fault */
+   set_faults(codes, 1);
    daly_fault_summary_t summary;
    TEST_ASSERT_EQUAL_INT(0, daly_bms_categorize_faults(&g_dev, &summary));
    TEST_ASSERT_EQUAL_INT(1, summary.critical_count);
 }
 
-void test_categorize_failure_keyword_is_critical(void) {
-   snprintf(g_dev.data.faults[0], sizeof(g_dev.data.faults[0]), "%s", "Temp sensor failure");
-   g_dev.data.fault_count = 1;
+void test_categorize_failure_is_critical(void) {
+   const int codes[] = { 46 }; /* Communication failure */
+   set_faults(codes, 1);
    daly_fault_summary_t summary;
    TEST_ASSERT_EQUAL_INT(0, daly_bms_categorize_faults(&g_dev, &summary));
    TEST_ASSERT_EQUAL_INT(1, summary.critical_count);
 }
 
 void test_categorize_mixed_severities(void) {
-   snprintf(g_dev.data.faults[0], sizeof(g_dev.data.faults[0]), "%s", "Cell volt low L2");
-   snprintf(g_dev.data.faults[1], sizeof(g_dev.data.faults[1]), "%s", "SOC low L1");
-   snprintf(g_dev.data.faults[2], sizeof(g_dev.data.faults[2]), "%s", "Charger adhesion");
-   snprintf(g_dev.data.faults[3], sizeof(g_dev.data.faults[3]), "%s", "Miscellaneous thing");
-   g_dev.data.fault_count = 4;
+   /* Cell volt low L2, SOC low L1, Chg MOS adhesion err, Reserved */
+   const int codes[] = { 3, 22, 36, 28 };
+   set_faults(codes, 4);
 
    daly_fault_summary_t summary;
    TEST_ASSERT_EQUAL_INT(0, daly_bms_categorize_faults(&g_dev, &summary));
    TEST_ASSERT_EQUAL_INT(1, summary.critical_count);
-   TEST_ASSERT_EQUAL_INT(2, summary.warning_count); /* L1 + adhesion keyword */
+   TEST_ASSERT_EQUAL_INT(2, summary.warning_count); /* L1 + adhesion error */
    TEST_ASSERT_EQUAL_INT(1, summary.info_count);
 }
 
 void test_categorize_null_summary_returns_error(void) {
-   g_dev.data.fault_count = 0;
+   set_faults(NULL, 0);
    TEST_ASSERT_NOT_EQUAL(0, daly_bms_categorize_faults(&g_dev, NULL));
 }
 
+/* daly_packs */
+
+/* Add a pack with valid data to the group */
+static daly_pack_t *add_pack(daly_pack_group_t *group, float soc, int remain_mah,
+                             float current_a, int low_cell, int low_mv) {
+   int index = daly_packs_add(group, "/dev/null", DALY_DEFAULT_BAUD, DALY_BMS_ADDR + group->count);
+   TEST_ASSERT_TRUE(index >= 0);
+   daly_pack_t *pack = &group->packs[index];
+   daly_data_t *data = &pack->dev.data;
+
+   pack->dev.initialized = true;
+   pack->poll_result = 0;
+   data->valid = true;
+   data->fields = DALY_FIELD_ALL;
+   data->pack.v_total_v = 13.2f;
+   data->pack.current_a = current_a;
+   data->pack.soc_pct = soc;
+   data->mos.remain_capacity_mah = remain_mah;
+   data->status.cell_count = 4;
+   for (int i = 0; i < 4; i++) {
+      data->cell_mv[i] = 3300;
+   }
+   data->cell_mv[low_cell] = low_mv;
+   data->temps.tmax_c = 25.0f;
+   data->temps.tmin_c = 20.0f;
+   return pack;
+}
+
+void test_packs_parse_spec(void) {
+   char port[64];
+   int baud = 9600;
+   uint8_t addr = DALY_BMS_ADDR;
+
+   TEST_ASSERT_EQUAL_INT(0, daly_packs_parse_spec("/dev/ttyUSB1", port, sizeof(port), &baud,
+                                                  &addr));
+   TEST_ASSERT_EQUAL_STRING("/dev/ttyUSB1", port);
+   TEST_ASSERT_EQUAL_INT(9600, baud);
+   TEST_ASSERT_EQUAL_UINT8(1, addr);
+
+   TEST_ASSERT_EQUAL_INT(0, daly_packs_parse_spec("/dev/ttyUSB2:115200", port, sizeof(port),
+                                                  &baud, &addr));
+   TEST_ASSERT_EQUAL_STRING("/dev/ttyUSB2", port);
+   TEST_ASSERT_EQUAL_INT(115200, baud);
+
+   TEST_ASSERT_EQUAL_INT(0, daly_packs_parse_spec("/dev/ttyUSB3:19200@3", port, sizeof(port),
+                                                  &baud, &addr));
+   TEST_ASSERT_EQUAL_STRING("/dev/ttyUSB3", port);
+   TEST_ASSERT_EQUAL_INT(19200, baud);
+   TEST_ASSERT_EQUAL_UINT8(3, addr);
+
+   TEST_ASSERT_EQUAL_INT(0, daly_packs_parse_spec("/dev/ttyUSB4@2", port, sizeof(port), &baud,
+                                                  &addr));
+   TEST_ASSERT_EQUAL_STRING("/dev/ttyUSB4", port);
+   TEST_ASSERT_EQUAL_UINT8(2, addr);
+
+   TEST_ASSERT_EQUAL_INT(-1, daly_packs_parse_spec("/dev/ttyUSB1:fast", port, sizeof(port), &baud,
+                                                   &addr));
+   TEST_ASSERT_EQUAL_INT(-1, daly_packs_parse_spec("/dev/ttyUSB1@0", port, sizeof(port), &baud,
+                                                   &addr));
+   TEST_ASSERT_EQUAL_INT(-1, daly_packs_parse_spec("/dev/ttyUSB1@2", port, sizeof(port), &baud,
+                                                   NULL));
+   TEST_ASSERT_EQUAL_INT(-1, daly_packs_parse_spec(":9600", port, sizeof(port), &baud, &addr));
+   TEST_ASSERT_EQUAL_INT(-1, daly_packs_parse_spec("", port, sizeof(port), &baud, &addr));
+}
+
+void test_packs_group_is_bounded(void) {
+   static daly_pack_group_t group;
+   memset(&group, 0, sizeof(group));
+   for (int i = 0; i < DALY_MAX_PACKS; i++) {
+      TEST_ASSERT_EQUAL_INT(i, daly_packs_add(&group, "/dev/null", DALY_DEFAULT_BAUD, i + 1));
+   }
+   TEST_ASSERT_EQUAL_INT(-1, daly_packs_add(&group, "/dev/null", DALY_DEFAULT_BAUD, 9));
+}
+
+void test_packs_share_a_port_by_board_number(void) {
+   static daly_pack_group_t group;
+   memset(&group, 0, sizeof(group));
+   TEST_ASSERT_EQUAL_INT(0, daly_packs_add(&group, "/dev/ttyUSB0", 9600, 1));
+   TEST_ASSERT_EQUAL_INT(1, daly_packs_add(&group, "/dev/ttyUSB1", 9600, 1));
+   TEST_ASSERT_EQUAL_INT(2, daly_packs_add(&group, "/dev/ttyUSB0", 9600, 2));
+   TEST_ASSERT_EQUAL_INT(-1, daly_packs_add(&group, "/dev/ttyUSB0", 9600, 2)); /* Duplicate */
+
+   TEST_ASSERT_EQUAL_INT(0, group.packs[0].bus);
+   TEST_ASSERT_EQUAL_INT(1, group.packs[1].bus);
+   TEST_ASSERT_EQUAL_INT(0, group.packs[2].bus);
+}
+
+void test_packs_soc_weighted_by_capacity(void) {
+   static daly_pack_group_t group;
+   memset(&group, 0, sizeof(group));
+   add_pack(&group, 50.0f, 50000, -10.0f, 0, 3290);  /* 100 Ah pack */
+   add_pack(&group, 100.0f, 20000, -2.0f, 2, 3250);  /* 20 Ah pack, lowest cell */
+   add_pack(&group, 80.0f, 8000, 0.0f, 1, 3280);     /* 10 Ah pack */
+   group.packs[2].dev.data.valid = false;                /* Not answering */
+
+   daly_packs_summary_t summary;
+   daly_packs_summarize(&group, &summary);
+
+   TEST_ASSERT_EQUAL_INT(3, summary.pack_count);
+   TEST_ASSERT_EQUAL_INT(2, summary.valid_count);
+   TEST_ASSERT_FLOAT_WITHIN(1.0f, 120000.0f, summary.capacity_mah);
+   TEST_ASSERT_FLOAT_WITHIN(1.0f, 70000.0f, summary.remaining_mah);
+   TEST_ASSERT_FLOAT_WITHIN(0.01f, 58.33f, summary.soc_pct);
+   TEST_ASSERT_FLOAT_WITHIN(0.01f, -12.0f, summary.current_a);
+   TEST_ASSERT_FLOAT_WITHIN(0.01f, 13.2f, summary.voltage_v);
+   TEST_ASSERT_EQUAL_INT(1, summary.weakest_pack);
+   TEST_ASSERT_EQUAL_INT(2, summary.weakest_cell);
+   TEST_ASSERT_FLOAT_WITHIN(0.0001f, 3.25f, summary.weakest_cell_v);
+}
+
+void test_packs_summary_leaves_out_failed_poll(void) {
+   static daly_pack_group_t group;
+   memset(&group, 0, sizeof(group));
+   add_pack(&group, 50.0f, 50000, -10.0f, 0, 3300);
+   add_pack(&group, 90.0f, 90000, -10.0f, 1, 3000)->poll_result = -1; /* Stopped answering */
+
+   daly_packs_summary_t summary;
+   daly_packs_summarize(&group, &summary);
+
+   /* The second pack's last good reading is not part of the combined view */
+   TEST_ASSERT_EQUAL_INT(2, summary.pack_count);
+   TEST_ASSERT_EQUAL_INT(1, summary.valid_count);
+   TEST_ASSERT_FLOAT_WITHIN(0.01f, 50.0f, summary.soc_pct);
+   TEST_ASSERT_FLOAT_WITHIN(1.0f, 50000.0f, summary.remaining_mah);
+   TEST_ASSERT_FLOAT_WITHIN(1.0f, 100000.0f, summary.capacity_mah);
+   TEST_ASSERT_FLOAT_WITHIN(0.01f, -10.0f, summary.current_a);
+   TEST_ASSERT_EQUAL_INT(0, summary.weakest_pack);
+}
+
+void test_packs_weakest_cell_ignores_missing_readings(void) {
+   static daly_pack_group_t group;
+   memset(&group, 0, sizeof(group));
+   add_pack(&group, 50.0f, 50000, 0.0f, 1, 3280);
+   add_pack(&group, 50.0f, 50000, 0.0f, 0, 0);          /* Cell 1 not reported */
+   add_pack(&group, 50.0f, 50000, 0.0f, 3, 3100)->dev.data.fields &= ~DALY_FIELD_CELLS;
+
+   daly_packs_summary_t summary;
+   daly_packs_summarize(&group, &summary);
+
+   /* Neither the 0 V cell nor the stale 3.1 V reading of pack 3 counts */
+   TEST_ASSERT_EQUAL_INT(0, summary.weakest_pack);
+   TEST_ASSERT_EQUAL_INT(1, summary.weakest_cell);
+   TEST_ASSERT_FLOAT_WITHIN(0.0001f, 3.28f, summary.weakest_cell_v);
+
+   /* No fresh cell readings at all: no weakest cell */
+   for (int i = 0; i < group.count; i++) {
+      group.packs[i].dev.data.fields &= ~DALY_FIELD_CELLS;
+   }
+   daly_packs_summarize(&group, &summary);
+   TEST_ASSERT_EQUAL_INT(-1, summary.weakest_pack);
+}
+
+void test_packs_soc_equal_weight_without_capacity(void) {
+   static daly_pack_group_t group;
+   memset(&group, 0, sizeof(group));
+   add_pack(&group, 40.0f, 40000, 0.0f, 0, 3300);
+   add_pack(&group, 60.0f, 0, 0.0f, 0, 3300); /* No capacity reported */
+
+   daly_packs_summary_t summary;
+   daly_packs_summarize(&group, &summary);
+
+   TEST_ASSERT_FLOAT_WITHIN(0.01f, 50.0f, summary.soc_pct);
+   TEST_ASSERT_EQUAL_FLOAT(0.0f, summary.capacity_mah);
+}
+
+void test_packs_worst_health_wins(void) {
+   static daly_pack_group_t group;
+   memset(&group, 0, sizeof(group));
+   add_pack(&group, 50.0f, 50000, 0.0f, 0, 3300)->health_valid = true;
+   daly_pack_t *bad = add_pack(&group, 50.0f, 50000, 0.0f, 0, 3300);
+   bad->health_valid = true;
+   bad->health.overall_status = DALY_HEALTH_WARNING;
+
+   daly_packs_summary_t summary;
+   daly_packs_summarize(&group, &summary);
+   TEST_ASSERT_EQUAL_INT(DALY_HEALTH_WARNING, summary.overall_status);
+}
+
 int main(void) {
    UNITY_BEGIN();
 
@@ -199,14 +533,31 @@ int main(void) {
    RUN_TEST(test_health_faults_elevate_to_warning);
    RUN_TEST(test_health_null_device_safe);
    RUN_TEST(test_health_null_health_safe);
+   RUN_TEST(test_health_reason_formatted_only_on_change);
+   RUN_TEST(test_health_slow_drift_flagged_before_warning);
+   RUN_TEST(test_health_stable_offset_is_not_drift);
+   RUN_TEST(test_health_no_trend_before_min_span);
+   RUN_TEST(test_health_cell_count_change_resets_statistics);
+   RUN_TEST(test_health_estimates_cell_resistance);
+   RUN_TEST(test_health_stale_cells_leave_statistics_alone);
+   RUN_TEST(test_health_stale_pack_skips_resistance);
 
    RUN_TEST(test_categorize_empty_faults);
    RUN_TEST(test_categorize_l2_fault_is_critical);
    RUN_TEST(test_categorize_l1_fault_is_warning);
    RUN_TEST(test_categorize_short_circuit_is_critical);
-   RUN_TEST(test_categorize_failure_keyword_is_critical);
+   RUN_TEST(test_categorize_failure_is_critical);
    RUN_TEST(test_categorize_mixed_severities);
    RUN_TEST(test_categorize_null_summary_returns_error);
 
+   RUN_TEST(test_packs_parse_spec);
+   RUN_TEST(test_packs_group_is_bounded);
+   RUN_TEST(test_packs_share_a_port_by_board_number);
+   RUN_TEST(test_packs_soc_weighted_by_capacity);
+   RUN_TEST(test_packs_summary_leaves_out_failed_poll);
+   RUN_TEST(test_packs_weakest_cell_ignores_missing_readings);
+   RUN_TEST(test_packs_soc_equal_weight_without_capacity);
+   RUN_TEST(test_packs_worst_health_wins);
+
    return UNITY_END();
 }
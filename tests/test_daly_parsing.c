@@ -17,7 +17,8 @@
  * the project author(s).
  *
  * Unit tests for Daly BMS protocol frame parsing. Exercises the per-command
- * decoders (0x90, 0x91, 0x92, 0x93, 0x97, 0x98) plus checksum validation.
+ * decoders (0x90, 0x91, 0x92, 0x93, 0x97, 0x98) plus checksum and address
+ * validation, and the RS-485 bus scheduler through the frame fetch hook.
  * Operates entirely on in-memory byte arrays — no serial port required.
  */
 
@@ -184,24 +185,26 @@ void test_parse_0x97_high_byte_cells(void) {
    TEST_ASSERT_FALSE(balance[25]);
 }
 
-/* 0x98: Fault flags — 8 bytes × 8 bits = 64 possible faults mapped via daly_faults[] table. */
+/* 0x98: Fault flags — 8 bytes × 8 bits = 64 fault codes, code = byte * 8 + bit. */
 
 void test_parse_0x98_no_faults(void) {
    uint8_t data[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
-   char faults[DALY_MAX_FAULTS][64];
+   daly_fault_bits_t faults = ~0ULL;
    int count = -1;
-   daly_parse_0x98(data, faults, &count);
+   daly_parse_0x98(data, &faults, &count);
    TEST_ASSERT_EQUAL_INT(0, count);
+   TEST_ASSERT_TRUE(faults == 0);
 }
 
 void test_parse_0x98_single_cell_high_l2(void) {
    /* Byte 0 bit 1 → "Cell volt high L2" */
    uint8_t data[8] = { 0x02, 0, 0, 0, 0, 0, 0, 0 };
-   char faults[DALY_MAX_FAULTS][64];
+   daly_fault_bits_t faults = 0;
    int count = 0;
-   daly_parse_0x98(data, faults, &count);
+   daly_parse_0x98(data, &faults, &count);
    TEST_ASSERT_EQUAL_INT(1, count);
-   TEST_ASSERT_EQUAL_STRING("Cell volt high L2", faults[0]);
+   TEST_ASSERT_EQUAL_INT(1, daly_fault_next(&faults));
+   TEST_ASSERT_EQUAL_STRING("Cell volt high L2", daly_fault_description(1));
 }
 
 void test_parse_0x98_multiple_faults(void) {
@@ -209,13 +212,49 @@ void test_parse_0x98_multiple_faults(void) {
     * Byte 0 bit 2 → "Cell volt low L1"
     * Byte 2 bit 3 → "Dischg OC L2" */
    uint8_t data[8] = { 0x05, 0, 0x08, 0, 0, 0, 0, 0 };
-   char faults[DALY_MAX_FAULTS][64];
+   daly_fault_bits_t faults = 0;
    int count = 0;
-   daly_parse_0x98(data, faults, &count);
+   daly_parse_0x98(data, &faults, &count);
    TEST_ASSERT_EQUAL_INT(3, count);
-   TEST_ASSERT_EQUAL_STRING("Cell volt high L1", faults[0]);
-   TEST_ASSERT_EQUAL_STRING("Cell volt low L1", faults[1]);
-   TEST_ASSERT_EQUAL_STRING("Dischg OC L2", faults[2]);
+   TEST_ASSERT_EQUAL_STRING("Cell volt high L1", daly_fault_description(daly_fault_next(&faults)));
+   TEST_ASSERT_EQUAL_STRING("Cell volt low L1", daly_fault_description(daly_fault_next(&faults)));
+   TEST_ASSERT_EQUAL_STRING("Dischg OC L2", daly_fault_description(daly_fault_next(&faults)));
+   TEST_ASSERT_EQUAL_INT(-1, daly_fault_next(&faults));
+}
+
+void test_parse_0x98_last_byte_maps_to_high_codes(void) {
+   uint8_t data[8] = { 0, 0, 0, 0, 0, 0, 0, 0x80 };
+   daly_fault_bits_t faults = 0;
+   int count = 0;
+   daly_parse_0x98(data, &faults, &count);
+   TEST_ASSERT_EQUAL_INT(1, count);
+   TEST_ASSERT_EQUAL_INT(63, daly_fault_next(&faults));
+}
+
+void test_fault_masks_match_table(void) {
+   daly_fault_bits_t critical = daly_fault_mask(DALY_FAULT_CRITICAL);
+   daly_fault_bits_t warning = daly_fault_mask(DALY_FAULT_WARNING);
+   daly_fault_bits_t info = daly_fault_mask(DALY_FAULT_INFO);
+
+   /* Every code is in exactly one severity mask, the one its table entry names */
+   TEST_ASSERT_TRUE((critical | warning | info) == ~0ULL);
+   TEST_ASSERT_TRUE((critical & warning) == 0 && (critical & info) == 0 && (warning & info) == 0);
+   for (int code = 0; code < DALY_FAULT_CODES; code++) {
+      daly_fault_bits_t bit = 1ULL << code;
+      daly_fault_severity_t severity = daly_fault_severity(code);
+      TEST_ASSERT_EQUAL_INT(severity == DALY_FAULT_CRITICAL, (critical & bit) != 0);
+      TEST_ASSERT_EQUAL_INT(severity == DALY_FAULT_WARNING, (warning & bit) != 0);
+      TEST_ASSERT_EQUAL_INT(severity == DALY_FAULT_INFO, (info & bit) != 0);
+   }
+
+   /* Spot checks: byte 0 bit 1 is a level 2 alarm, bit 0 its level 1 */
+   TEST_ASSERT_TRUE((critical & (1ULL << 1)) != 0);
+   TEST_ASSERT_TRUE((warning & (1ULL << 0)) != 0);
+}
+
+void test_fault_description_out_of_range(void) {
+   TEST_ASSERT_EQUAL_STRING("Unknown", daly_fault_description(-1));
+   TEST_ASSERT_EQUAL_STRING("Unknown", daly_fault_description(DALY_FAULT_CODES));
 }
 
 /* Checksum */
@@ -246,6 +285,303 @@ void test_checksum_detects_single_bit_tampering(void) {
    TEST_ASSERT_NOT_EQUAL(csum_good, csum_bad);
 }
 
+/* Frame validation */
+
+/* Build a valid reply frame from the given board */
+static void make_reply(uint8_t addr, uint8_t cmd, const uint8_t data[8], uint8_t *frame) {
+   frame[0] = DALY_START_BYTE;
+   frame[1] = addr;
+   frame[2] = cmd;
+   frame[3] = DALY_LEN_FIXED;
+   memcpy(frame + 4, data, 8);
+   frame[12] = daly_checksum(frame, 12);
+}
+
+void test_validate_frame_checks_board_address(void) {
+   const uint8_t data[8] = { 0 };
+   uint8_t frame[DALY_FRAME_LEN];
+
+   make_reply(2, DALY_CMD_PACK_INFO, data, frame);
+   TEST_ASSERT_EQUAL_INT(DALY_CMD_PACK_INFO,
+                         daly_validate_frame(frame, 2, DALY_CMD_PACK_INFO, NULL));
+   TEST_ASSERT_EQUAL_INT(-1, daly_validate_frame(frame, 1, DALY_CMD_PACK_INFO, NULL));
+   TEST_ASSERT_EQUAL_INT(DALY_CMD_PACK_INFO, daly_validate_frame(frame, 0, 0, NULL));
+}
+
+void test_validate_frame_rejects_host_requests(void) {
+   const uint8_t data[8] = { 0 };
+   uint8_t frame[DALY_FRAME_LEN];
+
+   /* Our own request echoed back by a half-duplex adapter */
+   make_reply(DALY_HOST_ADDR, DALY_CMD_PACK_INFO, data, frame);
+   TEST_ASSERT_EQUAL_INT(-1, daly_validate_frame(frame, 0, 0, NULL));
+}
+
+/* Bus scheduling */
+
+#define BUS_LOG_MAX 128
+
+static struct {
+   uint8_t addr[BUS_LOG_MAX];
+   uint8_t cmd[BUS_LOG_MAX];
+   int count;
+   uint8_t dead_addr; /* Board that never answers */
+   uint8_t dead_cmd;  /* Request that is never answered */
+   uint8_t bad_cmd;   /* Request answered with a bad checksum */
+} bus_log;
+
+/* Fetch hook standing in for the segment: 4 cells, 1 sensor, no faults, 50 % SOC,
+ * 10000 mAh rated at 3700 mV nominal */
+static int bus_fetch(void *ctx, const daly_device_t *dev, uint8_t cmd, uint8_t *frame) {
+   (void)ctx;
+   if (bus_log.count < BUS_LOG_MAX) {
+      bus_log.addr[bus_log.count] = dev->addr;
+      bus_log.cmd[bus_log.count++] = cmd;
+   }
+   if (dev->addr == bus_log.dead_addr || cmd == bus_log.dead_cmd) {
+      return -1;
+   }
+
+   uint8_t data[8] = { 0 };
+   if (cmd == DALY_CMD_PACK_INFO) {
+      data[6] = 0x01; /* 500 tenths */
+      data[7] = 0xF4;
+   } else if (cmd == DALY_CMD_READ_CAPACITY) {
+      data[2] = 0x27; /* 10000 mAh */
+      data[3] = 0x10;
+      data[6] = 0x0E; /* 3700 mV */
+      data[7] = 0x74;
+   } else if (cmd == DALY_CMD_STATUS) {
+      data[0] = 4;
+      data[1] = 1;
+   } else if (cmd == DALY_CMD_CELL_VOLTAGES) {
+      static int next_frame = 0;
+      data[0] = (uint8_t)(next_frame++ % 2 + 1);
+   } else if (cmd == DALY_CMD_TEMPERATURES) {
+      data[0] = 1;
+   }
+   make_reply(dev->addr, cmd, data, frame);
+   if (cmd == bus_log.bad_cmd) {
+      frame[DALY_FRAME_LEN - 1] ^= 0x01;
+   }
+   return 0;
+}
+
+static void bus_setup(daly_device_t *devs, daly_device_t **ptrs, int count) {
+   memset(&bus_log, 0, sizeof(bus_log));
+   for (int i = 0; i < count; i++) {
+      daly_bms_init_offline(&devs[i], "bus", 100);
+      devs[i].addr = (uint8_t)(i + 1);
+      ptrs[i] = &devs[i];
+   }
+   daly_frame_hooks_t hooks = { .fetch_frame = bus_fetch };
+   daly_bms_set_frame_hooks(&hooks);
+}
+
+void test_bus_poll_polls_boards_in_turn(void) {
+   static daly_device_t devs[2];
+   daly_device_t *ptrs[2];
+   int results[2];
+   bus_setup(devs, ptrs, 2);
+
+   TEST_ASSERT_EQUAL_INT(2, daly_bms_poll_bus(ptrs, 2, 0, results));
+   daly_bms_set_frame_hooks(NULL);
+
+   TEST_ASSERT_EQUAL_INT(0, results[0]);
+   TEST_ASSERT_EQUAL_INT(0, results[1]);
+   TEST_ASSERT_TRUE(devs[1].data.valid);
+   TEST_ASSERT_EQUAL_INT(4, devs[1].data.status.cell_count);
+
+   /* Same requests for both boards, board 1's all before board 2's: the
+    * address changes once, so there is a single turnaround */
+   int half = bus_log.count / 2;
+   TEST_ASSERT_EQUAL_INT(0, bus_log.count % 2);
+   for (int i = 0; i < half; i++) {
+      TEST_ASSERT_EQUAL_UINT8(1, bus_log.addr[i]);
+      TEST_ASSERT_EQUAL_UINT8(2, bus_log.addr[half + i]);
+      TEST_ASSERT_EQUAL_HEX8(bus_log.cmd[i], bus_log.cmd[half + i]);
+   }
+}
+
+void test_bus_poll_drops_silent_board(void) {
+   static daly_device_t devs[3];
+   daly_device_t *ptrs[3];
+   int results[3];
+   bus_setup(devs, ptrs, 3);
+   bus_log.dead_addr = 2;
+
+   TEST_ASSERT_EQUAL_INT(2, daly_bms_poll_bus(ptrs, 3, 0, results));
+   daly_bms_set_frame_hooks(NULL);
+
+   TEST_ASSERT_EQUAL_INT(0, results[0]);
+   TEST_ASSERT_TRUE(results[1] < 0);
+   TEST_ASSERT_EQUAL_INT(0, results[2]);
+
+   /* Board 2 was asked for pack info (and retried), then skipped */
+   int asked = 0;
+   for (int i = 0; i < bus_log.count; i++) {
+      asked += bus_log.addr[i] == 2;
+   }
+   TEST_ASSERT_EQUAL_INT(1 + DALY_REQUEST_RETRIES, asked);
+}
+
+void test_poll_keeps_fields_of_answered_requests(void) {
+   static daly_device_t devs[1];
+   daly_device_t *ptrs[1];
+   bus_setup(devs, ptrs, 1);
+   bus_log.dead_cmd = DALY_CMD_TEMPERATURE;
+
+   TEST_ASSERT_EQUAL_INT(0, daly_bms_poll(&devs[0]));
+   daly_bms_set_frame_hooks(NULL);
+
+   TEST_ASSERT_TRUE(devs[0].data.valid);
+   TEST_ASSERT_EQUAL_HEX16(DALY_FIELD_ALL & ~DALY_FIELD_TEMPS, devs[0].data.fields);
+   TEST_ASSERT_EQUAL_INT(4, devs[0].data.status.cell_count);
+
+   /* Only the failed request was retried */
+   int temps = 0, status = 0;
+   for (int i = 0; i < bus_log.count; i++) {
+      temps += bus_log.cmd[i] == DALY_CMD_TEMPERATURE;
+      status += bus_log.cmd[i] == DALY_CMD_STATUS;
+   }
+   TEST_ASSERT_EQUAL_INT(1 + DALY_REQUEST_RETRIES, temps);
+   TEST_ASSERT_EQUAL_INT(1, status);
+}
+
+void test_poll_fails_without_pack_info(void) {
+   static daly_device_t devs[1];
+   daly_device_t *ptrs[1];
+   bus_setup(devs, ptrs, 1);
+   bus_log.dead_cmd = DALY_CMD_PACK_INFO;
+
+   TEST_ASSERT_EQUAL_INT(-1, daly_bms_poll(&devs[0]));
+   daly_bms_set_frame_hooks(NULL);
+
+   TEST_ASSERT_FALSE(devs[0].data.valid);
+   TEST_ASSERT_EQUAL_INT(1 + DALY_REQUEST_RETRIES, bus_log.count);
+   TEST_ASSERT_EQUAL_UINT32(1 + DALY_REQUEST_RETRIES, devs[0].link.timeouts);
+   TEST_ASSERT_EQUAL_UINT32(0, devs[0].link.checksum_errors);
+}
+
+void test_link_counts_rejected_replies(void) {
+   static daly_device_t devs[1];
+   daly_device_t *ptrs[1];
+   bus_setup(devs, ptrs, 1);
+   bus_log.bad_cmd = DALY_CMD_MOS_STATUS;
+
+   TEST_ASSERT_EQUAL_INT(0, daly_bms_poll(&devs[0]));
+   daly_bms_set_frame_hooks(NULL);
+
+   const daly_link_t *link = &devs[0].link;
+   TEST_ASSERT_EQUAL_UINT32(bus_log.count, link->requests);
+   TEST_ASSERT_EQUAL_UINT32(DALY_REQUEST_RETRIES, link->retries);
+   /* Every reply came back, just corrupted: none of them timed out */
+   TEST_ASSERT_EQUAL_UINT32(0, link->timeouts);
+   TEST_ASSERT_EQUAL_UINT32(1 + DALY_REQUEST_RETRIES, link->checksum_errors);
+   TEST_ASSERT_EQUAL_UINT32(0, link->mismatches);
+   TEST_ASSERT_EQUAL_HEX16(DALY_FIELD_ALL & ~DALY_FIELD_MOS, devs[0].data.fields);
+}
+
+/* Requests for cmd in the bus log */
+static int bus_count(uint8_t cmd) {
+   int n = 0;
+   for (int i = 0; i < bus_log.count; i++) {
+      n += bus_log.cmd[i] == cmd;
+   }
+   return n;
+}
+
+void test_write_capacity_sent_once_and_read_back(void) {
+   static daly_device_t devs[1];
+   daly_device_t *ptrs[1];
+   bus_setup(devs, ptrs, 1);
+   bus_log.dead_cmd = DALY_CMD_WRITE_CAPACITY;
+
+   /* The acknowledgement is lost, but the BMS holds the new value */
+   TEST_ASSERT_EQUAL_INT(0, daly_bms_write_capacity(&devs[0], 10000, 3700));
+   TEST_ASSERT_EQUAL_INT(1, bus_count(DALY_CMD_WRITE_CAPACITY));
+   TEST_ASSERT_EQUAL_INT(1, bus_count(DALY_CMD_READ_CAPACITY));
+   TEST_ASSERT_EQUAL_UINT32(0, devs[0].link.retries);
+
+   /* Read-back disagrees */
+   bus_log.dead_cmd = 0;
+   TEST_ASSERT_EQUAL_INT(-1, daly_bms_write_capacity(&devs[0], 20000, 3700));
+   daly_bms_set_frame_hooks(NULL);
+   TEST_ASSERT_EQUAL_INT(2, bus_count(DALY_CMD_WRITE_CAPACITY));
+}
+
+void test_write_soc_confirmed_by_pack_info(void) {
+   static daly_device_t devs[1];
+   daly_device_t *ptrs[1];
+   bus_setup(devs, ptrs, 1);
+
+   TEST_ASSERT_EQUAL_INT(0, daly_bms_write_soc(&devs[0], 50.0f));
+   TEST_ASSERT_EQUAL_INT(-1, daly_bms_write_soc(&devs[0], 80.0f));
+   daly_bms_set_frame_hooks(NULL);
+
+   TEST_ASSERT_EQUAL_INT(2, bus_count(DALY_CMD_WRITE_SOC));
+   TEST_ASSERT_EQUAL_INT(2, bus_count(DALY_CMD_PACK_INFO));
+   TEST_ASSERT_EQUAL_UINT32(0, devs[0].link.retries);
+}
+
+void test_link_slots_map_to_commands(void) {
+   TEST_ASSERT_EQUAL_INT(DALY_CMD_PACK_INFO, daly_bms_link_cmd(0));
+   TEST_ASSERT_EQUAL_INT(DALY_CMD_FAULTS, daly_bms_link_cmd(DALY_LINK_OTHER - 1));
+   TEST_ASSERT_EQUAL_INT(-1, daly_bms_link_cmd(DALY_LINK_OTHER));
+}
+
+void test_link_timeout_follows_rtt_estimate(void) {
+   static daly_device_t dev;
+   daly_bms_init_offline(&dev, "bus", 500);
+
+   /* Unmeasured: the configured timeout */
+   TEST_ASSERT_EQUAL_INT(500, daly_bms_link_timeout(&dev, 0));
+
+   /* Smoothed RTT plus four deviations, never below the floor or above the configured one */
+   dev.link.srtt_ms[0] = 100.0f;
+   dev.link.rttvar_ms[0] = 25.0f;
+   TEST_ASSERT_EQUAL_INT(200, daly_bms_link_timeout(&dev, 0));
+   dev.link.srtt_ms[0] = 10.0f;
+   dev.link.rttvar_ms[0] = 2.0f;
+   TEST_ASSERT_EQUAL_INT(DALY_RTT_FLOOR_MS, daly_bms_link_timeout(&dev, 0));
+   dev.link.srtt_ms[0] = 400.0f;
+   dev.link.rttvar_ms[0] = 100.0f;
+   TEST_ASSERT_EQUAL_INT(500, daly_bms_link_timeout(&dev, 0));
+
+   /* Each backoff step doubles it, up to the configured timeout */
+   dev.link.srtt_ms[0] = 10.0f;
+   dev.link.rttvar_ms[0] = 2.0f;
+   dev.link.backoff[0] = 2;
+   TEST_ASSERT_EQUAL_INT(4 * DALY_RTT_FLOOR_MS, daly_bms_link_timeout(&dev, 0));
+   dev.link.backoff[0] = 200;
+   TEST_ASSERT_EQUAL_INT(500, daly_bms_link_timeout(&dev, 0));
+}
+
+void test_link_backoff_persists_until_first_attempt_reply(void) {
+   static daly_device_t devs[1];
+   daly_device_t *ptrs[1];
+   bus_setup(devs, ptrs, 1);
+
+   /* A fast link brought the pack info timeout down to the floor, then the unit slowed */
+   devs[0].link.srtt_ms[0] = 10.0f;
+   devs[0].link.rttvar_ms[0] = 2.0f;
+   bus_log.dead_cmd = DALY_CMD_PACK_INFO;
+   TEST_ASSERT_EQUAL_INT(-1, daly_bms_poll(&devs[0]));
+
+   /* Both attempts doubled it; the next poll starts from there, not from the floor */
+   TEST_ASSERT_EQUAL_UINT8(2, devs[0].link.backoff[0]);
+   TEST_ASSERT_EQUAL_INT(100, daly_bms_link_timeout(&devs[0], 0));
+   TEST_ASSERT_EQUAL_INT(-1, daly_bms_poll(&devs[0]));
+   TEST_ASSERT_EQUAL_UINT8(2, devs[0].link.backoff[0]);
+
+   /* The first attempt that is answered ends it */
+   bus_log.dead_cmd = 0;
+   TEST_ASSERT_EQUAL_INT(0, daly_bms_poll(&devs[0]));
+   daly_bms_set_frame_hooks(NULL);
+   TEST_ASSERT_EQUAL_UINT8(0, devs[0].link.backoff[0]);
+   TEST_ASSERT_EQUAL_INT(DALY_RTT_FLOOR_MS, daly_bms_link_timeout(&devs[0], 0));
+}
+
 int main(void) {
    UNITY_BEGIN();
 
@@ -271,11 +607,28 @@ int main(void) {
    RUN_TEST(test_parse_0x98_no_faults);
    RUN_TEST(test_parse_0x98_single_cell_high_l2);
    RUN_TEST(test_parse_0x98_multiple_faults);
+   RUN_TEST(test_parse_0x98_last_byte_maps_to_high_codes);
+   RUN_TEST(test_fault_masks_match_table);
+   RUN_TEST(test_fault_description_out_of_range);
 
    RUN_TEST(test_checksum_zero_bytes);
    RUN_TEST(test_checksum_known_sum);
    RUN_TEST(test_checksum_truncates_to_8_bits);
    RUN_TEST(test_checksum_detects_single_bit_tampering);
 
+   RUN_TEST(test_validate_frame_checks_board_address);
+   RUN_TEST(test_validate_frame_rejects_host_requests);
+
+   RUN_TEST(test_bus_poll_polls_boards_in_turn);
+   RUN_TEST(test_bus_poll_drops_silent_board);
+   RUN_TEST(test_poll_keeps_fields_of_answered_requests);
+   RUN_TEST(test_poll_fails_without_pack_info);
+   RUN_TEST(test_link_counts_rejected_replies);
+   RUN_TEST(test_write_capacity_sent_once_and_read_back);
+   RUN_TEST(test_write_soc_confirmed_by_pack_info);
+   RUN_TEST(test_link_slots_map_to_commands);
+   RUN_TEST(test_link_timeout_follows_rtt_estimate);
+   RUN_TEST(test_link_backoff_persists_until_first_attempt_reply);
+
    return UNITY_END();
 }
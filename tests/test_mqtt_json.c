@@ -23,10 +23,12 @@
 
 #include <json-c/json.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "battery_model.h"
 #include "daly_bms.h"
+#include "daly_packs.h"
 #include "ina238.h"
 #include "mqtt_publisher_internal.h"
 #include "unity.h"
@@ -92,13 +94,13 @@ static double json_get_double(struct json_object *root, const char *key) {
 void test_battery_json_invalid_measurements_returns_null(void) {
    ina238_measurements_t m = { 0 };
    m.valid = false;
-   g_root = build_battery_json(&m, 50.0f, NULL);
+   g_root = build_battery_json(&m, 50.0f, NULL, NULL, NULL, NULL, NULL);
    TEST_ASSERT_NULL(g_root);
 }
 
 void test_battery_json_ocp_envelope_fields(void) {
    ina238_measurements_t m = make_measurements(17.0f, 2.5f);
-   g_root = build_battery_json(&m, 60.0f, NULL);
+   g_root = build_battery_json(&m, 60.0f, NULL, NULL, NULL, NULL, NULL);
    TEST_ASSERT_NOT_NULL(g_root);
    TEST_ASSERT_EQUAL_STRING("stat", json_get_string(g_root, "device"));
    TEST_ASSERT_EQUAL_STRING("telemetry", json_get_string(g_root, "msg_type"));
@@ -111,25 +113,25 @@ void test_battery_json_ocp_envelope_fields(void) {
 
 void test_battery_json_status_critical_at_10pct(void) {
    ina238_measurements_t m = make_measurements(14.5f, 2.0f);
-   g_root = build_battery_json(&m, 5.0f, NULL);
+   g_root = build_battery_json(&m, 5.0f, NULL, NULL, NULL, NULL, NULL);
    TEST_ASSERT_EQUAL_STRING("CRITICAL", json_get_string(g_root, "battery_status"));
 }
 
 void test_battery_json_status_warning_between_10_and_20pct(void) {
    ina238_measurements_t m = make_measurements(16.0f, 2.0f);
-   g_root = build_battery_json(&m, 15.0f, NULL);
+   g_root = build_battery_json(&m, 15.0f, NULL, NULL, NULL, NULL, NULL);
    TEST_ASSERT_EQUAL_STRING("WARNING", json_get_string(g_root, "battery_status"));
 }
 
 void test_battery_json_status_normal_above_20pct(void) {
    ina238_measurements_t m = make_measurements(18.5f, 2.0f);
-   g_root = build_battery_json(&m, 75.0f, NULL);
+   g_root = build_battery_json(&m, 75.0f, NULL, NULL, NULL, NULL, NULL);
    TEST_ASSERT_EQUAL_STRING("NORMAL", json_get_string(g_root, "battery_status"));
 }
 
 void test_battery_json_measurement_fields_match(void) {
    ina238_measurements_t m = make_measurements(18.5f, 2.5f);
-   g_root = build_battery_json(&m, 60.0f, NULL);
+   g_root = build_battery_json(&m, 60.0f, NULL, NULL, NULL, NULL, NULL);
    TEST_ASSERT_DOUBLE_WITHIN(0.01, 18.5, json_get_double(g_root, "voltage"));
    TEST_ASSERT_DOUBLE_WITHIN(0.01, 2.5, json_get_double(g_root, "current"));
    TEST_ASSERT_DOUBLE_WITHIN(0.01, 46.25, json_get_double(g_root, "power"));
@@ -138,17 +140,39 @@ void test_battery_json_measurement_fields_match(void) {
 
 void test_battery_json_null_battery_omits_detail_fields(void) {
    ina238_measurements_t m = make_measurements(18.0f, 2.0f);
-   g_root = build_battery_json(&m, 50.0f, NULL);
+   g_root = build_battery_json(&m, 50.0f, NULL, NULL, NULL, NULL, NULL);
    struct json_object *f;
    TEST_ASSERT_FALSE(json_object_object_get_ex(g_root, "battery_chemistry", &f));
    TEST_ASSERT_FALSE(json_object_object_get_ex(g_root, "battery_capacity_mah", &f));
    TEST_ASSERT_FALSE(json_object_object_get_ex(g_root, "time_remaining_min", &f));
 }
 
+void test_battery_json_soc_estimate_fields(void) {
+   ina238_measurements_t m = make_measurements(18.0f, 2.0f);
+   battery_config_t cfg = make_liion_config();
+   static battery_lut_t lut;
+   battery_ekf_t ekf;
+   TEST_ASSERT_EQUAL_INT(0, battery_lut_build(&lut, &cfg));
+   TEST_ASSERT_EQUAL_INT(0, battery_ekf_init(&ekf, &cfg, &lut));
+
+   /* Not seeded yet: no estimate */
+   g_root = build_battery_json(&m, 50.0f, &cfg, &ekf, NULL, NULL, NULL);
+   struct json_object *f;
+   TEST_ASSERT_FALSE(json_object_object_get_ex(g_root, "soc_estimate", &f));
+   json_object_put(g_root);
+
+   battery_ekf_update(&ekf, 18.0f, 2.0f, 1.0f);
+   g_root = build_battery_json(&m, 50.0f, &cfg, &ekf, NULL, NULL, NULL);
+   TEST_ASSERT_DOUBLE_WITHIN(0.01, battery_ekf_soc_percent(&ekf),
+                             json_get_double(g_root, "soc_estimate"));
+   TEST_ASSERT_DOUBLE_WITHIN(0.01, battery_ekf_sigma_percent(&ekf),
+                             json_get_double(g_root, "soc_uncertainty"));
+}
+
 void test_battery_json_with_battery_adds_detail_fields(void) {
    ina238_measurements_t m = make_measurements(18.0f, 2.0f);
    battery_config_t cfg = make_liion_config();
-   g_root = build_battery_json(&m, 50.0f, &cfg);
+   g_root = build_battery_json(&m, 50.0f, &cfg, NULL, NULL, NULL, NULL);
    TEST_ASSERT_EQUAL_STRING("Li-ion", json_get_string(g_root, "battery_chemistry"));
    TEST_ASSERT_EQUAL_INT(5, json_get_int(g_root, "battery_cells"));
    TEST_ASSERT_DOUBLE_WITHIN(0.01, 5000.0, json_get_double(g_root, "battery_capacity_mah"));
@@ -159,6 +183,94 @@ void test_battery_json_with_battery_adds_detail_fields(void) {
    TEST_ASSERT_NOT_NULL(strchr(fmt_str, ':'));
 }
 
+void test_battery_json_runtime_forecast_fields(void) {
+   ina238_measurements_t m = make_measurements(18.0f, 2.0f);
+   battery_config_t cfg = make_liion_config();
+   battery_runtime_t rt;
+   memset(&rt, 0, sizeof(rt));
+   for (int t = 0; t < 1800; t += 10) {
+      battery_runtime_update(&rt, 2.0f, 10.0f);
+   }
+
+   g_root = build_battery_json(&m, 50.0f, &cfg, NULL, NULL, &rt, NULL);
+   double p10 = json_get_double(g_root, "time_remaining_p10_min");
+   double p50 = json_get_double(g_root, "time_remaining_min");
+   double p90 = json_get_double(g_root, "time_remaining_p90_min");
+   TEST_ASSERT_TRUE(p10 > 0.0 && p10 <= p50 && p50 <= p90);
+   TEST_ASSERT_DOUBLE_WITHIN(0.01, 2.0, json_get_double(g_root, "load_forecast_a"));
+}
+
+void test_battery_json_window_statistics(void) {
+   ina238_measurements_t m = make_measurements(15.0f, 1.0f);
+   stat_battery_window_t window;
+   struct json_object *stats, *current;
+
+   g_root = build_battery_json(&m, 50.0f, NULL, NULL, NULL, NULL, NULL);
+   TEST_ASSERT_FALSE(json_object_object_get_ex(g_root, "window", NULL));
+   json_object_put(g_root);
+
+   /* A 9 A spike between two 1 A samples, 0.5 s apart */
+   stat_battery_window_reset(&window);
+   stat_battery_window_add(&window, 15.0f, 1.0f, 15.0f, 0.5f);
+   stat_battery_window_add(&window, 14.0f, 9.0f, 126.0f, 0.5f);
+   stat_battery_window_add(&window, 15.0f, 1.0f, 15.0f, 0.5f);
+   g_root = build_battery_json(&m, 50.0f, NULL, NULL, NULL, NULL, &window);
+
+   TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "window", &stats));
+   TEST_ASSERT_EQUAL_INT(3, json_get_int(stats, "samples"));
+   TEST_ASSERT_DOUBLE_WITHIN(0.001, 1.5, json_get_double(stats, "duration"));
+   TEST_ASSERT_TRUE(json_object_object_get_ex(stats, "current", &current));
+   TEST_ASSERT_DOUBLE_WITHIN(0.001, 1.0, json_get_double(current, "min"));
+   TEST_ASSERT_DOUBLE_WITHIN(0.001, 9.0, json_get_double(current, "max"));
+   TEST_ASSERT_DOUBLE_WITHIN(0.001, 11.0 / 3.0, json_get_double(current, "mean"));
+   TEST_ASSERT_TRUE(json_get_double(current, "stddev") > 3.0);
+   TEST_ASSERT_DOUBLE_WITHIN(0.001, 5.5 / 3.6, json_get_double(stats, "charge_mah"));
+   TEST_ASSERT_DOUBLE_WITHIN(0.001, 78.0 / 3600.0, json_get_double(stats, "energy_wh"));
+}
+
+/* build_ina3221_json */
+
+void test_ina3221_json_window_per_channel(void) {
+   ina3221_measurements_t m;
+   stat_battery_window_t windows[INA3221_MAX_CHANNELS];
+   struct json_object *channels, *ch, *stats, *current;
+
+   memset(&m, 0, sizeof(m));
+   m.valid = true;
+   m.num_channels = 2;
+   for (int i = 0; i < 2; i++) {
+      m.channels[i].channel = i + 1;
+      m.channels[i].voltage = 12.0f;
+      m.channels[i].current = 0.5f;
+      m.channels[i].power = 6.0f;
+      m.channels[i].valid = true;
+      stat_battery_window_reset(&windows[i]);
+   }
+
+   /* Channel 1 saw a 3 A spike; channel 2 has no samples in its window */
+   stat_battery_window_add(&windows[0], 12.0f, 0.5f, 6.0f, 0.5f);
+   stat_battery_window_add(&windows[0], 11.8f, 3.0f, 35.4f, 0.5f);
+   g_root = build_ina3221_json(&m, windows);
+
+   TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "channels", &channels));
+   TEST_ASSERT_EQUAL_INT(2, (int)json_object_array_length(channels));
+   ch = json_object_array_get_idx(channels, 0);
+   TEST_ASSERT_TRUE(json_object_object_get_ex(ch, "window", &stats));
+   TEST_ASSERT_EQUAL_INT(2, json_get_int(stats, "samples"));
+   TEST_ASSERT_TRUE(json_object_object_get_ex(stats, "current", &current));
+   TEST_ASSERT_DOUBLE_WITHIN(0.001, 3.0, json_get_double(current, "max"));
+   TEST_ASSERT_DOUBLE_WITHIN(0.001, 1.75 / 3.6, json_get_double(stats, "charge_mah"));
+   ch = json_object_array_get_idx(channels, 1);
+   TEST_ASSERT_FALSE(json_object_object_get_ex(ch, "window", NULL));
+   json_object_put(g_root);
+
+   /* Without --publish-interval there are no windows */
+   g_root = build_ina3221_json(&m, NULL);
+   TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "channels", &channels));
+   ch = json_object_array_get_idx(channels, 0);
+   TEST_ASSERT_FALSE(json_object_object_get_ex(ch, "window", NULL));
+}
+
 /* build_daly_bms_json */
 
 /* Fill-by-pointer to avoid a ~2.6 KB struct copy per test invocation. */
@@ -166,6 +278,7 @@ static void fill_daly_device(daly_device_t *dev, int cell_count, int fault_count
    memset(dev, 0, sizeof(*dev));
    dev->initialized = true;
    dev->data.valid = true;
+   dev->data.fields = DALY_FIELD_ALL;
    dev->data.status.cell_count = cell_count;
    dev->data.status.ntc_count = 2;
    dev->data.pack.v_total_v = 48.0f;
@@ -191,22 +304,20 @@ static void fill_daly_device(daly_device_t *dev, int cell_count, int fault_count
       dev->data.balance[i] = false;
    }
    dev->data.fault_count = fault_count;
-   for (int i = 0; i < fault_count; i++) {
-      snprintf(dev->data.faults[i], sizeof(dev->data.faults[i]), "Fault %d", i);
-   }
+   dev->data.faults = fault_count > 0 ? (1ULL << fault_count) - 1 : 0; /* codes 0..n-1 */
 }
 
 void test_daly_json_invalid_device_returns_null(void) {
    daly_device_t dev = { 0 };
    dev.initialized = false;
-   g_root = build_daly_bms_json(&dev, NULL);
+   g_root = build_daly_bms_json(&dev, NULL, NULL);
    TEST_ASSERT_NULL(g_root);
 }
 
 void test_daly_json_ocp_envelope(void) {
    daly_device_t dev;
    fill_daly_device(&dev, 16, 0);
-   g_root = build_daly_bms_json(&dev, NULL);
+   g_root = build_daly_bms_json(&dev, NULL, NULL);
    TEST_ASSERT_NOT_NULL(g_root);
    TEST_ASSERT_EQUAL_STRING("stat", json_get_string(g_root, "device"));
    TEST_ASSERT_EQUAL_STRING("telemetry", json_get_string(g_root, "msg_type"));
@@ -217,7 +328,7 @@ void test_daly_json_ocp_envelope(void) {
 void test_daly_json_cells_array_size_matches_cell_count(void) {
    daly_device_t dev;
    fill_daly_device(&dev, 13, 0);
-   g_root = build_daly_bms_json(&dev, NULL);
+   g_root = build_daly_bms_json(&dev, NULL, NULL);
    struct json_object *cells;
    TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "cells", &cells));
    TEST_ASSERT_EQUAL_INT(13, json_object_array_length(cells));
@@ -226,17 +337,62 @@ void test_daly_json_cells_array_size_matches_cell_count(void) {
 void test_daly_json_faults_array_matches_fault_count(void) {
    daly_device_t dev;
    fill_daly_device(&dev, 4, 3);
-   g_root = build_daly_bms_json(&dev, NULL);
+   g_root = build_daly_bms_json(&dev, NULL, NULL);
    struct json_object *faults;
    TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "faults", &faults));
    TEST_ASSERT_EQUAL_INT(3, json_object_array_length(faults));
+   TEST_ASSERT_EQUAL_STRING("Cell volt high L1",
+                            json_object_get_string(json_object_array_get_idx(faults, 0)));
+}
+
+void test_daly_json_lists_stale_fields(void) {
+   daly_device_t dev;
+   fill_daly_device(&dev, 4, 0);
+   g_root = build_daly_bms_json(&dev, NULL, NULL);
+   struct json_object *stale;
+   TEST_ASSERT_FALSE(json_object_object_get_ex(g_root, "stale", &stale));
+   json_object_put(g_root);
+
+   dev.data.fields = DALY_FIELD_ALL & ~(DALY_FIELD_TEMPS | DALY_FIELD_CELLS);
+   g_root = build_daly_bms_json(&dev, NULL, NULL);
+   TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "stale", &stale));
+   TEST_ASSERT_EQUAL_INT(2, json_object_array_length(stale));
+   TEST_ASSERT_EQUAL_STRING("temperature",
+                            json_object_get_string(json_object_array_get_idx(stale, 0)));
+   TEST_ASSERT_EQUAL_STRING("cells", json_object_get_string(json_object_array_get_idx(stale, 1)));
+}
+
+void test_daly_link_json_lists_measured_commands(void) {
+   daly_device_t dev;
+   fill_daly_device(&dev, 4, 0);
+   dev.timeout_ms = DALY_DEFAULT_TIMEOUT_MS;
+   dev.link.requests = 12;
+   dev.link.checksum_errors = 2;
+   dev.link.srtt_ms[0] = 30.0f;
+   dev.link.rttvar_ms[0] = 5.0f;
+   dev.link.rtt_hist[0][2] = 10;
+
+   g_root = build_daly_link_json(&dev);
+   TEST_ASSERT_NOT_NULL(g_root);
+   TEST_ASSERT_EQUAL_INT(12, json_get_int(g_root, "requests"));
+   TEST_ASSERT_EQUAL_INT(2, json_get_int(g_root, "checksum_errors"));
+
+   struct json_object *buckets, *commands;
+   TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "rtt_buckets_ms", &buckets));
+   TEST_ASSERT_EQUAL_INT(DALY_RTT_BUCKETS - 1, json_object_array_length(buckets));
+   TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "commands", &commands));
+   TEST_ASSERT_EQUAL_INT(1, json_object_array_length(commands));
+
+   struct json_object *cmd = json_object_array_get_idx(commands, 0);
+   TEST_ASSERT_EQUAL_STRING("0x90", json_get_string(cmd, "cmd"));
+   TEST_ASSERT_EQUAL_INT(50, json_get_int(cmd, "timeout_ms"));
 }
 
 void test_daly_json_derived_state_discharging(void) {
    daly_device_t dev;
    fill_daly_device(&dev, 4, 0);
    dev.data.pack.current_a = -5.0f; /* discharging */
-   g_root = build_daly_bms_json(&dev, NULL);
+   g_root = build_daly_bms_json(&dev, NULL, NULL);
    TEST_ASSERT_EQUAL_STRING("discharging", json_get_string(g_root, "charging_state"));
 }
 
@@ -244,20 +400,292 @@ void test_daly_json_derived_state_charging(void) {
    daly_device_t dev;
    fill_daly_device(&dev, 4, 0);
    dev.data.pack.current_a = +5.0f;
-   g_root = build_daly_bms_json(&dev, NULL);
+   g_root = build_daly_bms_json(&dev, NULL, NULL);
    TEST_ASSERT_EQUAL_STRING("charging", json_get_string(g_root, "charging_state"));
 }
 
 void test_daly_json_pack_fields_match(void) {
    daly_device_t dev;
    fill_daly_device(&dev, 4, 0);
-   g_root = build_daly_bms_json(&dev, NULL);
+   g_root = build_daly_bms_json(&dev, NULL, NULL);
    TEST_ASSERT_DOUBLE_WITHIN(0.01, 48.0, json_get_double(g_root, "voltage"));
    TEST_ASSERT_DOUBLE_WITHIN(0.01, -5.0, json_get_double(g_root, "current"));
    TEST_ASSERT_DOUBLE_WITHIN(0.01, 75.0, json_get_double(g_root, "battery_level"));
    TEST_ASSERT_DOUBLE_WITHIN(0.001, 0.04, json_get_double(g_root, "vdelta"));
 }
 
+void test_packs_json_empty_summary_returns_null(void) {
+   daly_packs_summary_t summary = { 0 };
+   g_root = build_daly_packs_json(&summary);
+   TEST_ASSERT_NULL(g_root);
+}
+
+void test_packs_json_fields_match(void) {
+   daly_packs_summary_t summary = { .pack_count = 3,
+                                    .valid_count = 2,
+                                    .voltage_v = 13.2f,
+                                    .current_a = -12.0f,
+                                    .soc_pct = 58.3f,
+                                    .remaining_mah = 70000.0f,
+                                    .capacity_mah = 120000.0f,
+                                    .weakest_pack = 1,
+                                    .weakest_cell = 2,
+                                    .weakest_cell_v = 3.25f,
+                                    .overall_status = DALY_HEALTH_WARNING };
+   g_root = build_daly_packs_json(&summary);
+   TEST_ASSERT_NOT_NULL(g_root);
+   TEST_ASSERT_EQUAL_STRING("BatteryPacks", json_get_string(g_root, "type"));
+   TEST_ASSERT_DOUBLE_WITHIN(0.01, 58.3, json_get_double(g_root, "battery_level"));
+   TEST_ASSERT_DOUBLE_WITHIN(0.5, 120000.0, json_get_double(g_root, "capacity_mah"));
+   TEST_ASSERT_EQUAL_STRING("WARNING", json_get_string(g_root, "battery_status"));
+
+   struct json_object *weakest, *pack;
+   TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "weakest_cell", &weakest));
+   TEST_ASSERT_TRUE(json_object_object_get_ex(weakest, "pack", &pack));
+   TEST_ASSERT_EQUAL_INT(2, json_object_get_int(pack)); /* 1-based */
+}
+
+void test_bundle_sections_share_one_envelope(void) {
+   ina238_measurements_t m = make_measurements(15.0f, 1.0f);
+   daly_packs_summary_t summary = { .pack_count = 2, .valid_count = 2, .soc_pct = 50.0f };
+   struct json_object *battery = build_battery_json(&m, 60.0f, NULL, NULL, NULL, NULL, NULL);
+   struct json_object *packs = build_daly_packs_json(&summary);
+
+   g_root = mqtt_bundle_new();
+   TEST_ASSERT_NOT_NULL(g_root);
+   TEST_ASSERT_EQUAL_INT(0, mqtt_bundle_add(g_root, battery));
+   TEST_ASSERT_EQUAL_INT(0, mqtt_bundle_add(g_root, packs));
+   json_object_put(battery);
+   json_object_put(packs);
+
+   TEST_ASSERT_EQUAL_STRING("stat", json_get_string(g_root, "device"));
+   TEST_ASSERT_EQUAL_STRING("telemetry", json_get_string(g_root, "msg_type"));
+   TEST_ASSERT_EQUAL_STRING("Bundle", json_get_string(g_root, "type"));
+   TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "timestamp", NULL));
+
+   struct json_object *sections;
+   TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "sections", &sections));
+   TEST_ASSERT_EQUAL_size_t(2, json_object_array_length(sections));
+   struct json_object *first = json_object_array_get_idx(sections, 0);
+   TEST_ASSERT_EQUAL_STRING("Battery", json_get_string(first, "type"));
+   TEST_ASSERT_EQUAL_STRING("INA238", json_get_string(first, "sensor"));
+   TEST_ASSERT_DOUBLE_WITHIN(0.001, 15.0, json_get_double(first, "voltage"));
+   TEST_ASSERT_FALSE(json_object_object_get_ex(first, "device", NULL));
+   TEST_ASSERT_FALSE(json_object_object_get_ex(first, "msg_type", NULL));
+   TEST_ASSERT_FALSE(json_object_object_get_ex(first, "timestamp", NULL));
+   TEST_ASSERT_EQUAL_STRING("BatteryPacks",
+                            json_get_string(json_object_array_get_idx(sections, 1), "type"));
+}
+
+void test_topic_alias_sends_topic_once_per_connection(void) {
+   bool send_topic;
+
+   mqtt_topic_alias_reset();
+   TEST_ASSERT_EQUAL_INT(1, mqtt_topic_alias("stat/telemetry", 1, 10, &send_topic));
+   TEST_ASSERT_TRUE(send_topic);
+   TEST_ASSERT_EQUAL_INT(1, mqtt_topic_alias("stat/telemetry", 1, 10, &send_topic));
+   TEST_ASSERT_FALSE(send_topic);
+   TEST_ASSERT_EQUAL_INT(2, mqtt_topic_alias("stat/telemetry/pack/1", 1, 10, &send_topic));
+   TEST_ASSERT_TRUE(send_topic);
+
+   /* A reconnect forgets the broker's mapping */
+   TEST_ASSERT_EQUAL_INT(1, mqtt_topic_alias("stat/telemetry", 2, 10, &send_topic));
+   TEST_ASSERT_TRUE(send_topic);
+
+   /* A failed publish must not leave the broker without the mapping */
+   mqtt_topic_alias_forget(1);
+   TEST_ASSERT_EQUAL_INT(1, mqtt_topic_alias("stat/telemetry", 2, 10, &send_topic));
+   TEST_ASSERT_TRUE(send_topic);
+}
+
+void test_topic_alias_respects_broker_maximum(void) {
+   bool send_topic;
+
+   mqtt_topic_alias_reset();
+   TEST_ASSERT_EQUAL_INT(0, mqtt_topic_alias("stat/telemetry", 1, 0, &send_topic));
+   TEST_ASSERT_TRUE(send_topic);
+   TEST_ASSERT_EQUAL_INT(0, mqtt_topic_alias("stat/telemetry/pack/1", 1, 1, &send_topic));
+   TEST_ASSERT_TRUE(send_topic);
+   TEST_ASSERT_EQUAL_INT(1, mqtt_topic_alias("stat/telemetry", 1, 1, &send_topic));
+   TEST_ASSERT_TRUE(send_topic);
+
+   /* Only MQTT_TOPIC_ALIASES topics get one, whatever the broker allows */
+   for (int i = 2; i <= MQTT_TOPIC_ALIASES + 1; i++) {
+      char topic[32];
+      snprintf(topic, sizeof(topic), "stat/telemetry/pack/%d", i);
+      mqtt_topic_alias(topic, 1, 65535, &send_topic);
+   }
+   TEST_ASSERT_EQUAL_INT(0, mqtt_topic_alias("stat/other", 1, 65535, &send_topic));
+   TEST_ASSERT_TRUE(send_topic);
+}
+
+void test_degrade_level_hysteresis(void) {
+   mqtt_degrade_t level = MQTT_DEGRADE_NONE;
+
+   level = mqtt_degrade_next(level, MQTT_QUEUE_NO_DETAIL - 1);
+   TEST_ASSERT_EQUAL_INT(MQTT_DEGRADE_NONE, level);
+   level = mqtt_degrade_next(level, MQTT_QUEUE_NO_DETAIL);
+   TEST_ASSERT_EQUAL_INT(MQTT_DEGRADE_NO_DETAIL, level);
+   level = mqtt_degrade_next(level, MQTT_QUEUE_ESSENTIAL);
+   TEST_ASSERT_EQUAL_INT(MQTT_DEGRADE_ESSENTIAL, level);
+
+   /* Each level holds until the depth falls below half of where it started */
+   level = mqtt_degrade_next(level, MQTT_QUEUE_ESSENTIAL / 2);
+   TEST_ASSERT_EQUAL_INT(MQTT_DEGRADE_ESSENTIAL, level);
+   level = mqtt_degrade_next(level, MQTT_QUEUE_THROTTLED / 2);
+   TEST_ASSERT_EQUAL_INT(MQTT_DEGRADE_THROTTLED, level);
+   level = mqtt_degrade_next(level, MQTT_QUEUE_NO_DETAIL / 2 - 1);
+   TEST_ASSERT_EQUAL_INT(MQTT_DEGRADE_NONE, level);
+}
+
+void test_degrade_keeps_alarms_and_drops_detail(void) {
+   unsigned long dropped = 0;
+   struct json_object *alarm = json_object_new_object();
+   struct json_object *routine = json_object_new_object();
+
+   json_object_object_add(alarm, "type", json_object_new_string("Battery"));
+   json_object_object_add(alarm, "battery_status", json_object_new_string("CRITICAL"));
+   json_object_object_add(routine, "type", json_object_new_string("BatteryHealth"));
+   json_object_object_add(routine, "critical_faults", json_object_new_int(0));
+   json_object_object_add(routine, "cells", json_object_new_array());
+   TEST_ASSERT_TRUE(mqtt_message_essential(alarm));
+   TEST_ASSERT_FALSE(mqtt_message_essential(routine));
+
+   g_root = mqtt_bundle_new();
+   mqtt_bundle_add(g_root, routine);
+   mqtt_bundle_add(g_root, alarm);
+   json_object_put(routine);
+   json_object_put(alarm);
+
+   /* Without detail the bundle keeps both sections, less their arrays */
+   struct json_object *sections;
+   TEST_ASSERT_TRUE(mqtt_degrade_message(g_root, MQTT_DEGRADE_NO_DETAIL, 1, &dropped));
+   TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "sections", &sections));
+   TEST_ASSERT_EQUAL_size_t(2, json_object_array_length(sections));
+   TEST_ASSERT_FALSE(json_object_object_get_ex(json_object_array_get_idx(sections, 0), "cells",
+                                               NULL));
+
+   /* Throttled, routine sections go out every MQTT_THROTTLE_UPDATES updates */
+   TEST_ASSERT_TRUE(
+       mqtt_degrade_message(g_root, MQTT_DEGRADE_THROTTLED, MQTT_THROTTLE_UPDATES, &dropped));
+   TEST_ASSERT_EQUAL_size_t(2, json_object_array_length(sections));
+   TEST_ASSERT_TRUE(mqtt_degrade_message(g_root, MQTT_DEGRADE_THROTTLED, 1, &dropped));
+   TEST_ASSERT_EQUAL_size_t(1, json_object_array_length(sections));
+   TEST_ASSERT_EQUAL_UINT32(1, (uint32_t)dropped);
+   TEST_ASSERT_EQUAL_STRING("CRITICAL", json_get_string(json_object_array_get_idx(sections, 0),
+                                                        "battery_status"));
+
+   /* A lone routine message is held back as a whole */
+   struct json_object *fan = json_object_new_object();
+   json_object_object_add(fan, "type", json_object_new_string("Fan"));
+   TEST_ASSERT_FALSE(mqtt_degrade_message(fan, MQTT_DEGRADE_ESSENTIAL, 0, &dropped));
+   TEST_ASSERT_EQUAL_UINT32(2, (uint32_t)dropped);
+   json_object_put(fan);
+}
+
+void test_queue_limit_keeps_headroom_for_essential(void) {
+   unsigned long dropped = 0;
+   struct json_object *status = json_object_new_object();
+   struct json_object *routine = json_object_new_object();
+
+   json_object_object_add(status, "type", json_object_new_string("BatteryStatus"));
+   json_object_object_add(status, "battery_status", json_object_new_string("NORMAL"));
+   json_object_object_add(routine, "type", json_object_new_string("SystemPower"));
+
+   /* Below the limit the current level applies */
+   TEST_ASSERT_TRUE(mqtt_queue_admit(routine, MQTT_DEGRADE_NONE, MQTT_QUEUE_LIMIT - 1, 1,
+                                     &dropped));
+
+   /* At the limit, even with the level not yet raised, only essential messages go out */
+   TEST_ASSERT_FALSE(mqtt_queue_admit(routine, MQTT_DEGRADE_NONE, MQTT_QUEUE_LIMIT, 0,
+                                      &dropped));
+   TEST_ASSERT_TRUE(mqtt_queue_admit(status, MQTT_DEGRADE_NONE, MQTT_QUEUE_LIMIT, 0,
+                                     &dropped));
+   TEST_ASSERT_TRUE(mqtt_queue_admit(status, MQTT_DEGRADE_ESSENTIAL,
+                                     MQTT_QUEUE_LIMIT + MQTT_QUEUE_RESERVE - 1, 0, &dropped));
+   TEST_ASSERT_EQUAL_UINT32(1, (uint32_t)dropped);
+
+   /* A bundle at the limit keeps its essential sections */
+   struct json_object *sections;
+   g_root = mqtt_bundle_new();
+   mqtt_bundle_add(g_root, routine);
+   mqtt_bundle_add(g_root, status);
+   TEST_ASSERT_TRUE(mqtt_queue_admit(g_root, MQTT_DEGRADE_NONE, MQTT_QUEUE_LIMIT, 1, &dropped));
+   TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "sections", &sections));
+   TEST_ASSERT_EQUAL_size_t(1, json_object_array_length(sections));
+   TEST_ASSERT_EQUAL_UINT32(2, (uint32_t)dropped);
+
+   /* Once the headroom is used up, nothing is queued */
+   TEST_ASSERT_FALSE(mqtt_queue_admit(status, MQTT_DEGRADE_ESSENTIAL,
+                                      MQTT_QUEUE_LIMIT + MQTT_QUEUE_RESERVE, 0, &dropped));
+   TEST_ASSERT_EQUAL_UINT32(3, (uint32_t)dropped);
+
+   json_object_put(routine);
+   json_object_put(status);
+}
+
+void test_alert_copy_keeps_alarm_without_detail(void) {
+   struct json_object *health = json_object_new_object();
+   struct json_object *type;
+
+   json_object_object_add(health, "type", json_object_new_string("BatteryHealth"));
+   json_object_object_add(health, "critical_faults", json_object_new_int(0));
+   json_object_object_add(health, "cells", json_object_new_array());
+   TEST_ASSERT_FALSE(mqtt_message_alarm(health));
+   json_object_object_add(health, "critical_faults", json_object_new_int(2));
+   TEST_ASSERT_TRUE(mqtt_message_alarm(health));
+
+   /* The unified status is essential under backpressure, but not an alarm by itself */
+   g_root = json_object_new_object();
+   json_object_object_add(g_root, "type", json_object_new_string("BatteryStatus"));
+   json_object_object_add(g_root, "battery_status", json_object_new_string("NORMAL"));
+   TEST_ASSERT_TRUE(mqtt_message_essential(g_root));
+   TEST_ASSERT_FALSE(mqtt_message_alarm(g_root));
+   json_object_put(g_root);
+
+   g_root = mqtt_alert_json(health);
+   TEST_ASSERT_NOT_NULL(g_root);
+   TEST_ASSERT_EQUAL_INT(2, json_get_int(g_root, "critical_faults"));
+   TEST_ASSERT_FALSE(json_object_object_get_ex(g_root, "cells", NULL));
+   TEST_ASSERT_TRUE(json_object_object_get_ex(health, "cells", NULL));
+   TEST_ASSERT_TRUE(json_object_object_get_ex(g_root, "type", &type));
+   TEST_ASSERT_EQUAL_STRING("BatteryHealth", json_object_get_string(type));
+   json_object_put(health);
+}
+
+void test_alert_once_per_alarm_change(void) {
+   g_root = json_object_new_object();
+   json_object_object_add(g_root, "battery_status", json_object_new_string("WARNING"));
+   TEST_ASSERT_EQUAL_INT(0, mqtt_message_alarm_level(g_root));
+   json_object_object_add(g_root, "battery_status", json_object_new_string("CRITICAL"));
+   TEST_ASSERT_EQUAL_INT(1, mqtt_message_alarm_level(g_root));
+   json_object_object_add(g_root, "critical_fault_count", json_object_new_int(3));
+   TEST_ASSERT_EQUAL_INT(3, mqtt_message_alarm_level(g_root));
+
+   /* One settle per update, whatever number of messages fed it */
+   mqtt_alert_source_t source = { .reported = 0, .seen = -1 };
+   static const struct {
+      int seen;
+      mqtt_alert_event_t event;
+   } steps[] = {
+      { -1, MQTT_ALERT_NONE },    /* no message from the source */
+      { 0, MQTT_ALERT_NONE },     /* all normal */
+      { 1, MQTT_ALERT_RAISE },    /* CRITICAL status */
+      { 1, MQTT_ALERT_NONE },     /* still the same */
+      { -1, MQTT_ALERT_NONE },    /* silence keeps the alarm */
+      { 3, MQTT_ALERT_ESCALATE }, /* three critical faults */
+      { 2, MQTT_ALERT_NONE },     /* one of them cleared */
+      { 3, MQTT_ALERT_ESCALATE }, /* and back */
+      { 0, MQTT_ALERT_CLEAR },
+      { 0, MQTT_ALERT_NONE },
+   };
+   for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+      source.seen = steps[i].seen;
+      TEST_ASSERT_EQUAL_INT_MESSAGE(steps[i].event, mqtt_alert_settle(&source), "step");
+      TEST_ASSERT_EQUAL_INT(-1, source.seen);
+   }
+}
+
 int main(void) {
    UNITY_BEGIN();
 
@@ -269,14 +697,34 @@ int main(void) {
    RUN_TEST(test_battery_json_measurement_fields_match);
    RUN_TEST(test_battery_json_null_battery_omits_detail_fields);
    RUN_TEST(test_battery_json_with_battery_adds_detail_fields);
+   RUN_TEST(test_battery_json_runtime_forecast_fields);
+   RUN_TEST(test_battery_json_soc_estimate_fields);
+   RUN_TEST(test_battery_json_window_statistics);
+   RUN_TEST(test_ina3221_json_window_per_channel);
 
    RUN_TEST(test_daly_json_invalid_device_returns_null);
    RUN_TEST(test_daly_json_ocp_envelope);
    RUN_TEST(test_daly_json_cells_array_size_matches_cell_count);
    RUN_TEST(test_daly_json_faults_array_matches_fault_count);
+   RUN_TEST(test_daly_json_lists_stale_fields);
+   RUN_TEST(test_daly_link_json_lists_measured_commands);
    RUN_TEST(test_daly_json_derived_state_discharging);
    RUN_TEST(test_daly_json_derived_state_charging);
    RUN_TEST(test_daly_json_pack_fields_match);
 
+   RUN_TEST(test_packs_json_empty_summary_returns_null);
+   RUN_TEST(test_packs_json_fields_match);
+
+   RUN_TEST(test_bundle_sections_share_one_envelope);
+
+   RUN_TEST(test_topic_alias_sends_topic_once_per_connection);
+   RUN_TEST(test_topic_alias_respects_broker_maximum);
+
+   RUN_TEST(test_degrade_level_hysteresis);
+   RUN_TEST(test_degrade_keeps_alarms_and_drops_detail);
+   RUN_TEST(test_queue_limit_keeps_headroom_for_essential);
+   RUN_TEST(test_alert_copy_keeps_alarm_without_detail);
+   RUN_TEST(test_alert_once_per_alarm_change);
+
    return UNITY_END();
 }
@@ -0,0 +1,120 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s).
+ *
+ * Unit tests for the adaptive sampling interval: speeding up on load steps
+ * and alarms, backing off when stable, and the idle and steady ceilings.
+ */
+
+#include "daly_bms.h"
+#include "sample_rate.h"
+#include "unity.h"
+
+#define FAST_MS 200
+#define STEADY_MS 1000
+#define IDLE_MS 5000
+
+static sample_rate_t sr;
+
+void setUp(void) {
+   sample_rate_init(&sr, FAST_MS, STEADY_MS, IDLE_MS);
+}
+
+void tearDown(void) {
+}
+
+/* Feed the same reading n times and return the last interval */
+static int feed(int n, float current_a, int state) {
+   int interval_ms = 0;
+   for (int i = 0; i < n; i++) {
+      interval_ms = sample_rate_update(&sr, current_a, state, false);
+   }
+   return interval_ms;
+}
+
+void test_starts_at_steady_interval(void) {
+   TEST_ASSERT_EQUAL_INT(STEADY_MS, sr.interval_ms);
+   TEST_ASSERT_EQUAL_INT(STEADY_MS, feed(1, -3.0f, DALY_STATE_DISCHARGE));
+}
+
+void test_idle_backs_off_by_doubling(void) {
+   TEST_ASSERT_EQUAL_INT(STEADY_MS, feed(SAMPLE_RATE_CALM_SAMPLES - 1, 0.0f, DALY_STATE_IDLE));
+   TEST_ASSERT_EQUAL_INT(2 * STEADY_MS, feed(1, 0.0f, DALY_STATE_IDLE));
+   TEST_ASSERT_EQUAL_INT(4 * STEADY_MS, feed(SAMPLE_RATE_CALM_SAMPLES, 0.0f, DALY_STATE_IDLE));
+   TEST_ASSERT_EQUAL_INT(IDLE_MS, feed(SAMPLE_RATE_CALM_SAMPLES, 0.0f, DALY_STATE_IDLE));
+   TEST_ASSERT_EQUAL_INT(IDLE_MS, feed(SAMPLE_RATE_CALM_SAMPLES, 0.0f, DALY_STATE_IDLE));
+
+   /* A steady load ends the idle back-off at once */
+   TEST_ASSERT_EQUAL_INT(STEADY_MS, feed(1, 0.1f, DALY_STATE_DISCHARGE));
+}
+
+void test_load_step_speeds_up_then_settles(void) {
+   feed(3 * SAMPLE_RATE_CALM_SAMPLES, -1.0f, DALY_STATE_DISCHARGE);
+
+   /* 4 A step: both the rate of change and the variance call for the fast rate */
+   TEST_ASSERT_EQUAL_INT(FAST_MS, feed(1, -5.0f, DALY_STATE_DISCHARGE));
+
+   /* Held while the variance decays, then doubled back up to the steady rate */
+   int interval_ms = FAST_MS;
+   int samples = 0;
+   while (interval_ms < STEADY_MS && samples < 100) {
+      interval_ms = feed(1, -5.0f, DALY_STATE_DISCHARGE);
+      samples++;
+   }
+   TEST_ASSERT_EQUAL_INT(STEADY_MS, interval_ms);
+   TEST_ASSERT_TRUE(samples > SAMPLE_RATE_CALM_SAMPLES);
+   TEST_ASSERT_EQUAL_INT(STEADY_MS, feed(3 * SAMPLE_RATE_CALM_SAMPLES, -5.0f,
+                                         DALY_STATE_DISCHARGE));
+}
+
+void test_noise_below_threshold_is_stable(void) {
+   for (int i = 0; i < 40; i++) {
+      float current_a = (i % 2) ? -2.1f : -1.9f;
+      sample_rate_update(&sr, current_a, DALY_STATE_DISCHARGE, false);
+   }
+   TEST_ASSERT_EQUAL_INT(STEADY_MS, sr.interval_ms);
+}
+
+void test_alarm_holds_fast_rate(void) {
+   feed(5 * SAMPLE_RATE_CALM_SAMPLES, 0.0f, DALY_STATE_IDLE);
+   TEST_ASSERT_EQUAL_INT(IDLE_MS, sr.interval_ms);
+
+   for (int i = 0; i < 3 * SAMPLE_RATE_CALM_SAMPLES; i++) {
+      TEST_ASSERT_EQUAL_INT(FAST_MS, sample_rate_update(&sr, 0.0f, DALY_STATE_IDLE, true));
+   }
+   TEST_ASSERT_EQUAL_INT(2 * FAST_MS, feed(SAMPLE_RATE_CALM_SAMPLES, 0.0f, DALY_STATE_IDLE));
+}
+
+void test_init_orders_intervals(void) {
+   sample_rate_init(&sr, 500, 300, 400);
+   TEST_ASSERT_EQUAL_INT(500, sr.steady_ms);
+   TEST_ASSERT_EQUAL_INT(500, sr.idle_ms);
+   TEST_ASSERT_EQUAL_INT(500, sr.interval_ms);
+}
+
+int main(void) {
+   UNITY_BEGIN();
+
+   RUN_TEST(test_starts_at_steady_interval);
+   RUN_TEST(test_idle_backs_off_by_doubling);
+   RUN_TEST(test_load_step_speeds_up_then_settles);
+   RUN_TEST(test_noise_below_threshold_is_stable);
+   RUN_TEST(test_alarm_holds_fast_rate);
+   RUN_TEST(test_init_orders_intervals);
+
+   return UNITY_END();
+}
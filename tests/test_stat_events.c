@@ -0,0 +1,235 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s).
+ *
+ * Unit tests for the Server-Sent Events stream: request handling, batch
+ * delivery, per-client rate caps and dropping a client that stops reading.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stat_events_internal.h"
+#include "unity.h"
+
+static char text[64 * 1024];
+static size_t text_len;
+
+static void sleep_ms(long ms) {
+   struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+   nanosleep(&ts, NULL);
+}
+
+/* Connect to the server and send a request; rcvbuf > 0 shrinks the receive buffer */
+static int open_client(const char *request, int rcvbuf) {
+   struct sockaddr_in sin = { .sin_family = AF_INET,
+                              .sin_port = htons((uint16_t)stat_events_bound_port()) };
+   struct timeval timeout = { .tv_usec = 300000 };
+
+   inet_pton(AF_INET, "127.0.0.1", &sin.sin_addr);
+   int fd = socket(AF_INET, SOCK_STREAM, 0);
+   TEST_ASSERT_TRUE(fd >= 0);
+   setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+   if (rcvbuf > 0) {
+      setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+   }
+   TEST_ASSERT_EQUAL_INT(0, connect(fd, (struct sockaddr *)&sin, sizeof(sin)));
+   TEST_ASSERT_EQUAL_INT((int)strlen(request), (int)send(fd, request, strlen(request), 0));
+   return fd;
+}
+
+/* Append whatever arrives until the receive timeout to text */
+static void drain(int fd) {
+   ssize_t n;
+   while (text_len < sizeof(text) - 1 &&
+          (n = recv(fd, text + text_len, sizeof(text) - 1 - text_len, 0)) > 0) {
+      text_len += (size_t)n;
+   }
+   text[text_len] = '\0';
+}
+
+/* Count non-overlapping occurrences of needle in text */
+static int count(const char *needle) {
+   int found = 0;
+   for (const char *p = text; (p = strstr(p, needle)) != NULL; p += strlen(needle)) {
+      found++;
+   }
+   return found;
+}
+
+/* Wait up to a second for the server to report this many streaming clients */
+static void wait_streaming(int expected) {
+   for (int i = 0; i < 100 && stat_events_streaming_clients() != expected; i++) {
+      sleep_ms(10);
+   }
+   TEST_ASSERT_EQUAL_INT(expected, stat_events_streaming_clients());
+}
+
+static void push(const char *json) {
+   stat_events_push(json, strlen(json));
+}
+
+void setUp(void) {
+   text_len = 0;
+   text[0] = '\0';
+   TEST_ASSERT_EQUAL_INT(0, stat_events_start("127.0.0.1", 0));
+   TEST_ASSERT_TRUE(stat_events_bound_port() > 0);
+}
+
+void tearDown(void) {
+   stat_events_stop();
+}
+
+void test_inactive_stream_ignores_messages(void) {
+   stat_events_stop();
+   TEST_ASSERT_FALSE(stat_events_active());
+   push("{\"device\":\"Fan\"}");
+   stat_events_commit();
+   TEST_ASSERT_EQUAL_INT(0, stat_events_start("127.0.0.1", 0));
+   TEST_ASSERT_TRUE(stat_events_active());
+}
+
+void test_stream_delivers_committed_batch(void) {
+   int fd = open_client("GET /events HTTP/1.1\r\nHost: localhost\r\n\r\n", 0);
+   wait_streaming(1);
+
+   push("{\"device\":\"Battery\",\"voltage\":14.5}");
+   push("{\"device\":\"Fan\",\"rpm\":2400}");
+   stat_events_commit();
+   drain(fd);
+   close(fd);
+
+   TEST_ASSERT_EQUAL_INT(0, strncmp(text, "HTTP/1.1 200 OK\r\n", 17));
+   TEST_ASSERT_NOT_NULL(strstr(text, "Content-Type: text/event-stream\r\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "Access-Control-Allow-Origin: *\r\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "\r\n\r\nretry: 2000\n\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text,
+                               "data: {\"device\":\"Battery\",\"voltage\":14.5}\n\n"
+                               "data: {\"device\":\"Fan\",\"rpm\":2400}\n\n"));
+}
+
+void test_rejects_other_requests(void) {
+   int fd = open_client("GET /metrics HTTP/1.1\r\n\r\n", 0);
+   drain(fd);
+   close(fd);
+   TEST_ASSERT_EQUAL_INT(0, strncmp(text, "HTTP/1.1 404 ", 13));
+
+   text_len = 0;
+   fd = open_client("POST /events HTTP/1.1\r\n\r\n", 0);
+   drain(fd);
+   close(fd);
+   TEST_ASSERT_EQUAL_INT(0, strncmp(text, "HTTP/1.1 405 ", 13));
+   TEST_ASSERT_EQUAL_INT(0, stat_events_streaming_clients());
+}
+
+void test_rate_cap_skips_batches(void) {
+   int slow = open_client("GET /events?hz=1 HTTP/1.1\r\n\r\n", 0);
+   int fast = open_client("GET /events HTTP/1.1\r\n\r\n", 0);
+   wait_streaming(2);
+
+   /* Five batches 60 ms apart: all reach the default client, one the 1 Hz client */
+   for (int i = 0; i < 5; i++) {
+      push("{\"tick\":1}");
+      stat_events_commit();
+      sleep_ms(60);
+   }
+
+   drain(fast);
+   TEST_ASSERT_EQUAL_INT(5, count("data: "));
+   text_len = 0;
+   drain(slow);
+   TEST_ASSERT_EQUAL_INT(1, count("data: "));
+   close(slow);
+   close(fast);
+}
+
+void test_rate_cap_merges_skipped_batches(void) {
+   int slow = open_client("GET /events?hz=2 HTTP/1.1\r\n\r\n", 0);
+   wait_streaming(1);
+
+   /* Due at once, then every 500 ms: the middle batches fold into the last */
+   push("{\"type\":\"a\",\"n\":0}");
+   push("{\"type\":\"b\",\"n\":0}");
+   stat_events_commit();
+   sleep_ms(100);
+   push("{\"type\":\"a\",\"n\":1}");
+   push("{\"type\":\"b\",\"n\":1}");
+   stat_events_commit();
+   sleep_ms(100);
+   push("{\"type\":\"a\",\"n\":2}");
+   push("{\"type\":\"c\",\"pack\":1,\"n\":2}");
+   push("{\"type\":\"c\",\"pack\":2,\"n\":2}");
+   stat_events_commit();
+   sleep_ms(400);
+   push("{\"type\":\"a\",\"n\":3}");
+   stat_events_commit();
+   sleep_ms(100);
+
+   text_len = 0;
+   drain(slow);
+   TEST_ASSERT_EQUAL_INT(2 + 4, count("data: "));
+   TEST_ASSERT_NOT_NULL(strstr(text, "{\"type\":\"b\",\"n\":1}"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "{\"type\":\"c\",\"pack\":1,\"n\":2}"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "{\"type\":\"c\",\"pack\":2,\"n\":2}"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "{\"type\":\"a\",\"n\":3}"));
+   TEST_ASSERT_NULL(strstr(text, "{\"type\":\"a\",\"n\":1}"));
+   TEST_ASSERT_NULL(strstr(text, "{\"type\":\"a\",\"n\":2}"));
+   close(slow);
+}
+
+void test_client_that_stops_reading_is_dropped(void) {
+   char json[STAT_EVENTS_BATCH_SIZE - 16];
+   char discard[4096];
+   unsigned long dropped = stat_events_dropped_clients();
+   int stalled = open_client("GET /events?hz=20 HTTP/1.1\r\n\r\n", 4096);
+   int reader = open_client("GET /events?hz=20 HTTP/1.1\r\n\r\n", 0);
+   wait_streaming(2);
+
+   memset(json, 'x', sizeof(json) - 1);
+   json[sizeof(json) - 1] = '\0';
+   for (int i = 0; i < 400 && stat_events_dropped_clients() == dropped; i++) {
+      push(json);
+      stat_events_commit();
+      sleep_ms(55);
+      while (recv(reader, discard, sizeof(discard), MSG_DONTWAIT) > 0) {
+      }
+   }
+
+   TEST_ASSERT_EQUAL_UINT32(1, (uint32_t)(stat_events_dropped_clients() - dropped));
+   wait_streaming(1);
+   close(stalled);
+   close(reader);
+}
+
+int main(void) {
+   UNITY_BEGIN();
+
+   RUN_TEST(test_inactive_stream_ignores_messages);
+   RUN_TEST(test_stream_delivers_committed_batch);
+   RUN_TEST(test_rejects_other_requests);
+   RUN_TEST(test_rate_cap_skips_batches);
+   RUN_TEST(test_rate_cap_merges_skipped_batches);
+   RUN_TEST(test_client_that_stops_reading_is_dropped);
+
+   return UNITY_END();
+}
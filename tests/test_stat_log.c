@@ -0,0 +1,160 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s).
+ *
+ * Unit tests for the asynchronous STAT logging front end. Logs go to a
+ * temporary file which is read back after the writer thread has been stopped.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stat_log.h"
+#include "unity.h"
+
+static char log_path[64];
+
+/* Count lines in the log file containing needle */
+static int count_lines(const char *needle) {
+   char line[MAX_LOG_LENGTH + 128];
+   int count = 0;
+   FILE *fp = fopen(log_path, "r");
+   TEST_ASSERT_NOT_NULL(fp);
+   while (fgets(line, sizeof(line), fp)) {
+      if (strstr(line, needle)) {
+         count++;
+      }
+   }
+   fclose(fp);
+   return count;
+}
+
+/* The same message from one call site, as in an error storm */
+static void log_storm(int n, const char *tag) {
+   for (int i = 0; i < n; i++) {
+      OLOG_ERROR("%s read failed", tag);
+   }
+}
+
+static void *storm_thread(void *arg) {
+   log_storm(50, (const char *)arg);
+   return NULL;
+}
+
+void setUp(void) {
+   snprintf(log_path, sizeof(log_path), "/tmp/test_stat_log_%d.log", (int)getpid());
+   TEST_ASSERT_EQUAL_INT(0, init_logging(log_path, LOG_TO_FILE));
+}
+
+void tearDown(void) {
+   stat_log_stop_async();
+   close_logging();
+   unlink(log_path);
+}
+
+void test_sync_logging_writes_every_line(void) {
+   log_storm(20, "sync");
+   close_logging();
+   TEST_ASSERT_EQUAL_INT(20, count_lines("sync read failed"));
+   TEST_ASSERT_EQUAL_INT(0, count_lines("Suppressed"));
+}
+
+void test_async_preserves_distinct_messages(void) {
+   TEST_ASSERT_EQUAL_INT(0, stat_log_start_async());
+   OLOG_INFO("first line");
+   OLOG_WARNING("second line");
+   OLOG_ERROR("third line");
+   stat_log_stop_async();
+   close_logging();
+
+   TEST_ASSERT_EQUAL_INT(1, count_lines("[INFO]"));
+   TEST_ASSERT_EQUAL_INT(1, count_lines("[WARN]"));
+   TEST_ASSERT_EQUAL_INT(1, count_lines("third line"));
+}
+
+void test_async_rate_limits_repeated_message(void) {
+   TEST_ASSERT_EQUAL_INT(0, stat_log_start_async());
+   log_storm(40, "storm");
+   stat_log_stop_async();
+   close_logging();
+
+   /* A burst of 5, then one summary for the other 35 */
+   TEST_ASSERT_EQUAL_INT(5, count_lines("storm read failed") - count_lines("Suppressed"));
+   TEST_ASSERT_EQUAL_INT(1, count_lines("Suppressed 35 times"));
+}
+
+void test_async_keys_on_arguments_not_call_site(void) {
+   TEST_ASSERT_EQUAL_INT(0, stat_log_start_async());
+   for (int i = 0; i < 20; i++) {
+      OLOG_WARNING("cell %d out of range", i);
+   }
+   stat_log_stop_async();
+   close_logging();
+
+   /* One call site, but every message is different */
+   TEST_ASSERT_EQUAL_INT(20, count_lines("out of range"));
+   TEST_ASSERT_EQUAL_INT(0, count_lines("Suppressed"));
+}
+
+void test_async_events_are_never_limited(void) {
+   TEST_ASSERT_EQUAL_INT(0, stat_log_start_async());
+   for (int i = 0; i < 20; i++) {
+      SLOG_EVENT_WARNING("BMS fault raised: %s", "cell overvoltage");
+      SLOG_EVENT_INFO("BMS fault cleared: %s", "cell overvoltage");
+   }
+   stat_log_stop_async();
+   close_logging();
+
+   TEST_ASSERT_EQUAL_INT(20, count_lines("fault raised"));
+   TEST_ASSERT_EQUAL_INT(20, count_lines("fault cleared"));
+   TEST_ASSERT_EQUAL_INT(0, count_lines("Suppressed"));
+}
+
+void test_async_accepts_concurrent_producers(void) {
+   pthread_t threads[4];
+   const char *tags[4] = { "t0", "t1", "t2", "t3" };
+
+   TEST_ASSERT_EQUAL_INT(0, stat_log_start_async());
+   for (int i = 0; i < 4; i++) {
+      TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, storm_thread, (void *)tags[i]));
+   }
+   for (int i = 0; i < 4; i++) {
+      pthread_join(threads[i], NULL);
+   }
+   stat_log_stop_async();
+   close_logging();
+
+   /* Each tag is its own message: at most a burst of 5 each, and everything
+    * else was either summarized or reported as dropped */
+   TEST_ASSERT_TRUE(count_lines("read failed") - count_lines("Suppressed") <= 20);
+   TEST_ASSERT_TRUE(count_lines("Suppressed") + count_lines("dropped") >= 1);
+}
+
+int main(void) {
+   UNITY_BEGIN();
+
+   RUN_TEST(test_sync_logging_writes_every_line);
+   RUN_TEST(test_async_preserves_distinct_messages);
+   RUN_TEST(test_async_rate_limits_repeated_message);
+   RUN_TEST(test_async_keys_on_arguments_not_call_site);
+   RUN_TEST(test_async_events_are_never_limited);
+   RUN_TEST(test_async_accepts_concurrent_producers);
+
+   return UNITY_END();
+}
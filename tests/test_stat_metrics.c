@@ -0,0 +1,210 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s).
+ *
+ * Unit tests for the OpenMetrics exporter: listen address parsing, rendering
+ * and a scrape over loopback.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "stat_metrics_internal.h"
+#include "unity.h"
+
+static char text[STAT_METRICS_BUFFER_SIZE];
+
+static void make_snapshot(stat_shm_snapshot_t *snap) {
+   memset(snap, 0, sizeof(*snap));
+   snap->timestamp_ms = 1700000000500ull;
+   snap->valid = STAT_SHM_BATTERY | STAT_SHM_CELLS | STAT_SHM_RAILS | STAT_SHM_FAN;
+   snap->battery_voltage_v = 14.5f;
+   snap->battery_current_a = 2.25f;
+   snap->battery_level_pct = 80.0f;
+   snap->time_remaining_min = 90.0f;
+   snap->charging_state = STAT_SHM_DISCHARGING;
+   snap->cell_count = 2;
+   snap->cell_mv[0] = 3625;
+   snap->cell_mv[1] = 3630;
+   snap->balancing = 0x2;
+   snap->rail_count = 1;
+   snprintf(snap->rails[0].label, sizeof(snap->rails[0].label), "CPU \"big\"");
+   snap->rails[0].power_w = 4.5f;
+   snap->fan_rpm = 2400;
+}
+
+/* Render and check the exposition ends with the OpenMetrics terminator */
+static void render(void) {
+   size_t len = stat_metrics_render(text, sizeof(text));
+   TEST_ASSERT_TRUE(len > 0);
+   TEST_ASSERT_EQUAL_size_t(strlen(text), len);
+   TEST_ASSERT_EQUAL_STRING("# EOF\n", text + len - 6);
+}
+
+void setUp(void) {
+   stat_metrics_reset();
+}
+
+void tearDown(void) {
+   stat_metrics_stop();
+}
+
+void test_parse_listen(void) {
+   char addr[INET_ADDRSTRLEN];
+   int port;
+
+   const int dflt = STAT_METRICS_DEFAULT_PORT;
+
+   TEST_ASSERT_EQUAL_INT(0, stat_metrics_parse_listen(NULL, dflt, addr, sizeof(addr), &port));
+   TEST_ASSERT_EQUAL_STRING("0.0.0.0", addr);
+   TEST_ASSERT_EQUAL_INT(STAT_METRICS_DEFAULT_PORT, port);
+
+   TEST_ASSERT_EQUAL_INT(0, stat_metrics_parse_listen("9100", dflt, addr, sizeof(addr), &port));
+   TEST_ASSERT_EQUAL_STRING("0.0.0.0", addr);
+   TEST_ASSERT_EQUAL_INT(9100, port);
+
+   TEST_ASSERT_EQUAL_INT(0, stat_metrics_parse_listen("127.0.0.1:9200", dflt, addr, sizeof(addr),
+                                                      &port));
+   TEST_ASSERT_EQUAL_STRING("127.0.0.1", addr);
+   TEST_ASSERT_EQUAL_INT(9200, port);
+
+   TEST_ASSERT_EQUAL_INT(-1, stat_metrics_parse_listen("localhost:9200", dflt, addr, sizeof(addr),
+                                                       &port));
+   TEST_ASSERT_EQUAL_INT(-1,
+                         stat_metrics_parse_listen("127.0.0.1:", dflt, addr, sizeof(addr), &port));
+   TEST_ASSERT_EQUAL_INT(-1, stat_metrics_parse_listen("70000", dflt, addr, sizeof(addr), &port));
+}
+
+void test_render_without_snapshot_has_only_own_metrics(void) {
+   render();
+   TEST_ASSERT_NULL(strstr(text, "oasis_stat_battery"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "# TYPE oasis_stat_stage_duration_seconds histogram\n"));
+   TEST_ASSERT_NOT_NULL(
+       strstr(text, "oasis_stat_stage_duration_seconds_count{stage=\"tick\"} 0\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_scrapes_total "));
+}
+
+void test_render_reports_present_sections(void) {
+   stat_shm_snapshot_t snap;
+   make_snapshot(&snap);
+   stat_metrics_publish(&snap);
+   render();
+
+   TEST_ASSERT_NOT_NULL(strstr(text, "# UNIT oasis_stat_battery_voltage_volts volts\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_battery_voltage_volts 14.5\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_battery_current_amperes 2.25\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_battery_time_remaining_seconds 5400\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_snapshot_timestamp_seconds 1700000000.500\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_cell_voltage_volts{cell=\"2\"} 3.630\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_cell_balancing{cell=\"1\"} 0\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_cell_balancing{cell=\"2\"} 1\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_rail_power_watts{rail=\"CPU \\\"big\\\"\"} 4.5\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_fan_speed_rpm 2400\n"));
+   TEST_ASSERT_NULL(strstr(text, "oasis_stat_cpu_usage_percent"));
+}
+
+void test_stage_histogram_is_cumulative(void) {
+   stat_metrics_observe(STAT_STAGE_BMS, 80);      /* <= 100 us */
+   stat_metrics_observe(STAT_STAGE_BMS, 40000);   /* <= 50 ms */
+   stat_metrics_observe(STAT_STAGE_BMS, 3000000); /* +Inf */
+   render();
+
+   TEST_ASSERT_NOT_NULL(
+       strstr(text, "oasis_stat_stage_duration_seconds_bucket{stage=\"bms\",le=\"0.0001\"} 1\n"));
+   TEST_ASSERT_NOT_NULL(
+       strstr(text, "oasis_stat_stage_duration_seconds_bucket{stage=\"bms\",le=\"0.025\"} 1\n"));
+   TEST_ASSERT_NOT_NULL(
+       strstr(text, "oasis_stat_stage_duration_seconds_bucket{stage=\"bms\",le=\"0.05\"} 2\n"));
+   TEST_ASSERT_NOT_NULL(
+       strstr(text, "oasis_stat_stage_duration_seconds_bucket{stage=\"bms\",le=\"1\"} 2\n"));
+   TEST_ASSERT_NOT_NULL(
+       strstr(text, "oasis_stat_stage_duration_seconds_bucket{stage=\"bms\",le=\"+Inf\"} 3\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_stage_duration_seconds_count{stage=\"bms\"} 3\n"));
+   TEST_ASSERT_NOT_NULL(
+       strstr(text, "oasis_stat_stage_duration_seconds_sum{stage=\"bms\"} 3.040080\n"));
+   TEST_ASSERT_NOT_NULL(
+       strstr(text, "oasis_stat_stage_duration_seconds_count{stage=\"host\"} 0\n"));
+}
+
+void test_mqtt_queue_reported_once_known(void) {
+   render();
+   TEST_ASSERT_NULL(strstr(text, "oasis_stat_mqtt_"));
+
+   stat_metrics_publish_mqtt(57, 2, 12);
+   render();
+   TEST_ASSERT_NOT_NULL(strstr(text, "# TYPE oasis_stat_mqtt_queue_depth gauge\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_mqtt_queue_depth 57\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_mqtt_degrade_level 2\n"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_mqtt_dropped_messages_total 12\n"));
+}
+
+/* Send a request over loopback and return the whole response in text */
+static void scrape(const char *request) {
+   struct sockaddr_in sin = { .sin_family = AF_INET,
+                              .sin_port = htons((uint16_t)stat_metrics_bound_port()) };
+   struct timeval timeout = { .tv_sec = 2 };
+   size_t len = 0;
+   ssize_t n;
+
+   inet_pton(AF_INET, "127.0.0.1", &sin.sin_addr);
+   int fd = socket(AF_INET, SOCK_STREAM, 0);
+   setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+   TEST_ASSERT_EQUAL_INT(0, connect(fd, (struct sockaddr *)&sin, sizeof(sin)));
+   TEST_ASSERT_EQUAL_INT((int)strlen(request), (int)send(fd, request, strlen(request), 0));
+   while ((n = recv(fd, text + len, sizeof(text) - 1 - len, 0)) > 0) {
+      len += (size_t)n;
+   }
+   text[len] = '\0';
+   close(fd);
+}
+
+void test_scrape_over_http(void) {
+   stat_shm_snapshot_t snap;
+   make_snapshot(&snap);
+   stat_metrics_publish(&snap);
+   TEST_ASSERT_EQUAL_INT(0, stat_metrics_start("127.0.0.1", 0));
+   TEST_ASSERT_TRUE(stat_metrics_bound_port() > 0);
+
+   scrape("GET /metrics HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n");
+   TEST_ASSERT_EQUAL_INT(0, strncmp(text, "HTTP/1.0 200 OK\r\n", 17));
+   TEST_ASSERT_NOT_NULL(strstr(text, "Content-Type: application/openmetrics-text; version=1.0.0"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "\r\n\r\n# TYPE oasis_stat_snapshot_timestamp_seconds"));
+   TEST_ASSERT_NOT_NULL(strstr(text, "oasis_stat_scrapes_total 1\n# EOF\n"));
+
+   scrape("GET /other HTTP/1.1\r\n\r\n");
+   TEST_ASSERT_EQUAL_INT(0, strncmp(text, "HTTP/1.0 404 ", 13));
+   scrape("POST /metrics HTTP/1.1\r\n\r\n");
+   TEST_ASSERT_EQUAL_INT(0, strncmp(text, "HTTP/1.0 405 ", 13));
+}
+
+int main(void) {
+   UNITY_BEGIN();
+
+   RUN_TEST(test_parse_listen);
+   RUN_TEST(test_render_without_snapshot_has_only_own_metrics);
+   RUN_TEST(test_render_reports_present_sections);
+   RUN_TEST(test_stage_histogram_is_cumulative);
+   RUN_TEST(test_mqtt_queue_reported_once_known);
+   RUN_TEST(test_scrape_over_http);
+
+   return UNITY_END();
+}
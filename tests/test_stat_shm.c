@@ -0,0 +1,192 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s).
+ *
+ * Unit tests for the shared-memory telemetry snapshot. Each test uses its
+ * own object name so runs do not collide with a live oasis-stat.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "stat_shm.h"
+#include "unity.h"
+
+#define WRITER_ROUNDS 200000
+
+static char shm_name[64];
+static stat_shm_reader_t reader;
+static atomic_bool writer_done;
+
+/* Snapshot whose fields all derive from n, so a torn copy is detectable */
+static void make_snapshot(stat_shm_snapshot_t *snap, uint32_t n) {
+   memset(snap, 0, sizeof(*snap));
+   snap->timestamp_ms = n;
+   snap->valid = STAT_SHM_BATTERY | STAT_SHM_CELLS;
+   snap->battery_voltage_v = (float)n;
+   snap->cell_count = STAT_SHM_MAX_CELLS;
+   for (int i = 0; i < STAT_SHM_MAX_CELLS; i++) {
+      snap->cell_mv[i] = (uint16_t)n;
+   }
+   snap->fan_rpm = (int32_t)n;
+}
+
+static void *writer_thread(void *arg) {
+   (void)arg;
+   stat_shm_snapshot_t snap;
+   for (uint32_t n = 1; n <= WRITER_ROUNDS; n++) {
+      make_snapshot(&snap, n);
+      stat_shm_writer_publish(&snap);
+   }
+   atomic_store(&writer_done, true);
+   return NULL;
+}
+
+void setUp(void) {
+   snprintf(shm_name, sizeof(shm_name), "/oasis-stat-test-%d", (int)getpid());
+   memset(&reader, 0, sizeof(reader));
+}
+
+void tearDown(void) {
+   stat_shm_reader_close(&reader);
+   stat_shm_writer_close();
+}
+
+void test_reader_needs_a_writer(void) {
+   TEST_ASSERT_EQUAL_INT(-1, stat_shm_reader_open(&reader, shm_name));
+   TEST_ASSERT_EQUAL_INT(ENOENT, errno);
+}
+
+void test_fresh_segment_has_no_sections(void) {
+   stat_shm_snapshot_t snap;
+   uint32_t generation = 99;
+
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_writer_open(shm_name));
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_reader_open(&reader, shm_name));
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_read(&reader, &snap, &generation));
+   TEST_ASSERT_EQUAL_UINT32(0, snap.valid);
+   TEST_ASSERT_EQUAL_UINT32(0, generation);
+}
+
+void test_read_returns_published_snapshot(void) {
+   stat_shm_snapshot_t in, out;
+   uint32_t generation;
+
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_writer_open(shm_name));
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_reader_open(&reader, shm_name));
+
+   make_snapshot(&in, 7);
+   stat_shm_writer_publish(&in);
+   make_snapshot(&in, 8);
+   stat_shm_writer_publish(&in);
+
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_read(&reader, &out, &generation));
+   TEST_ASSERT_EQUAL_MEMORY(&in, &out, sizeof(in));
+   TEST_ASSERT_EQUAL_UINT32(2, generation);
+}
+
+void test_read_gives_up_while_writer_is_busy(void) {
+   stat_shm_snapshot_t snap;
+
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_writer_open(shm_name));
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_reader_open(&reader, shm_name));
+
+   /* A writer stopped halfway through a copy leaves the sequence odd */
+   int fd = shm_open(shm_name, O_RDWR, 0);
+   TEST_ASSERT_TRUE(fd >= 0);
+   stat_shm_segment_t *seg = mmap(NULL, sizeof(*seg), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   TEST_ASSERT_TRUE(seg != MAP_FAILED);
+   seg->seq++;
+
+   TEST_ASSERT_EQUAL_INT(-1, stat_shm_read(&reader, &snap, NULL));
+   TEST_ASSERT_EQUAL_INT(EAGAIN, errno);
+
+   seg->seq++;
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_read(&reader, &snap, NULL));
+   munmap(seg, sizeof(*seg));
+}
+
+void test_reader_notices_writer_exit(void) {
+   stat_shm_snapshot_t snap;
+
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_writer_open(shm_name));
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_reader_open(&reader, shm_name));
+   stat_shm_writer_close();
+
+   TEST_ASSERT_EQUAL_INT(-1, stat_shm_read(&reader, &snap, NULL));
+   TEST_ASSERT_EQUAL_INT(ENOENT, errno);
+}
+
+void test_concurrent_reads_are_never_torn(void) {
+   pthread_t thread;
+   stat_shm_snapshot_t snap;
+   uint32_t last_generation = 0;
+   int reads = 0;
+
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_writer_open(shm_name));
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_reader_open(&reader, shm_name));
+   atomic_store(&writer_done, false);
+   TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL, writer_thread, NULL));
+
+   while (!atomic_load(&writer_done)) {
+      uint32_t generation;
+      if (stat_shm_read(&reader, &snap, &generation) != 0) {
+         continue;
+      }
+      reads++;
+      TEST_ASSERT_TRUE(generation >= last_generation);
+      last_generation = generation;
+      if (generation == 0) {
+         continue;
+      }
+
+      /* Every field must come from the same publish */
+      uint32_t n = (uint32_t)snap.timestamp_ms;
+      TEST_ASSERT_EQUAL_UINT32(generation, n);
+      TEST_ASSERT_EQUAL_FLOAT((float)n, snap.battery_voltage_v);
+      TEST_ASSERT_EQUAL_INT32((int32_t)n, snap.fan_rpm);
+      for (int i = 0; i < STAT_SHM_MAX_CELLS; i++) {
+         TEST_ASSERT_EQUAL_UINT16((uint16_t)n, snap.cell_mv[i]);
+      }
+   }
+   pthread_join(thread, NULL);
+
+   TEST_ASSERT_TRUE(reads > 0);
+   TEST_ASSERT_EQUAL_INT(0, stat_shm_read(&reader, &snap, &last_generation));
+   TEST_ASSERT_EQUAL_UINT32(WRITER_ROUNDS, last_generation);
+}
+
+int main(void) {
+   UNITY_BEGIN();
+
+   RUN_TEST(test_reader_needs_a_writer);
+   RUN_TEST(test_fresh_segment_has_no_sections);
+   RUN_TEST(test_read_returns_published_snapshot);
+   RUN_TEST(test_read_gives_up_while_writer_is_busy);
+   RUN_TEST(test_reader_notices_writer_exit);
+   RUN_TEST(test_concurrent_reads_are_never_torn);
+
+   return UNITY_END();
+}
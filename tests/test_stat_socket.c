@@ -0,0 +1,284 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s).
+ *
+ * Unit tests for the local query and streaming socket. Each test starts the
+ * server on its own path under /tmp and talks to it as a client would.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "stat_socket.h"
+#include "unity.h"
+
+static char sock_path[64];
+static int client_fd = -1;
+
+/* Snapshot with every section present, its fields derived from n */
+static void make_snapshot(stat_shm_snapshot_t *snap, uint32_t n) {
+   memset(snap, 0, sizeof(*snap));
+   snap->timestamp_ms = 1000u * n;
+   snap->valid = STAT_SHM_BATTERY | STAT_SHM_CELLS | STAT_SHM_RAILS | STAT_SHM_CPU |
+                 STAT_SHM_MEMORY | STAT_SHM_THERMAL | STAT_SHM_FAN;
+   snap->battery_voltage_v = 12.0f + (float)n;
+   snap->charging_state = STAT_SHM_CHARGING;
+   snap->cell_count = 4;
+   snap->cell_mv[3] = (uint16_t)(3300 + n);
+   snap->rail_count = 1;
+   snprintf(snap->rails[0].label, sizeof(snap->rails[0].label), "VDD_IN");
+   snap->rails[0].power_w = (float)n;
+   snap->cpu_usage_pct = 10.0f;
+   snap->memory_usage_pct = 20.0f;
+   snap->system_temp_c = 45.0f;
+   snap->fan_rpm = (int32_t)n;
+}
+
+static void publish(uint32_t n) {
+   stat_shm_snapshot_t snap;
+   make_snapshot(&snap, n);
+   stat_socket_publish(&snap);
+}
+
+static int connect_client(void) {
+   struct sockaddr_un addr = { .sun_family = AF_UNIX };
+   struct timeval timeout = { .tv_sec = 2 };
+   int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+   snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sock_path);
+   TEST_ASSERT_EQUAL_INT(0, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+   setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+   return fd;
+}
+
+static void send_request(int fd, uint8_t type, uint32_t a, uint32_t b, int nargs) {
+   uint8_t frame[STAT_SOCK_HEADER_LEN + 8];
+   uint32_t length = 1 + 4u * (uint32_t)nargs;
+
+   memcpy(frame, &length, 4);
+   frame[4] = type;
+   memcpy(frame + 5, &a, 4);
+   memcpy(frame + 9, &b, 4);
+   TEST_ASSERT_EQUAL_INT(4 + (int)length, (int)send(fd, frame, 4 + length, 0));
+}
+
+static void read_exact(int fd, void *buf, size_t len) {
+   size_t got = 0;
+   while (got < len) {
+      ssize_t n = recv(fd, (uint8_t *)buf + got, len - got, 0);
+      TEST_ASSERT_TRUE_MESSAGE(n > 0, "reply missing");
+      got += (size_t)n;
+   }
+}
+
+/* Read one frame; returns its type and leaves the payload in buf */
+static uint8_t read_frame(int fd, uint8_t *buf, size_t *len) {
+   uint32_t length;
+   uint8_t type;
+
+   read_exact(fd, &length, 4);
+   TEST_ASSERT_TRUE(length >= 1 && length - 1 <= sizeof(stat_shm_snapshot_t) + 16);
+   read_exact(fd, &type, 1);
+   read_exact(fd, buf, length - 1);
+   *len = length - 1;
+   return type;
+}
+
+static void read_snapshot(int fd, stat_shm_snapshot_t *snap, uint32_t *generation) {
+   uint8_t buf[STAT_SOCK_SNAPSHOT_MAX];
+   size_t len;
+
+   TEST_ASSERT_EQUAL_HEX8(STAT_SOCK_SNAPSHOT, read_frame(fd, buf, &len));
+   TEST_ASSERT_EQUAL_INT(0, stat_socket_decode_snapshot(buf, len, snap, generation));
+}
+
+static uint32_t read_u32_frame(int fd, uint8_t expected_type) {
+   uint8_t buf[STAT_SOCK_SNAPSHOT_MAX];
+   size_t len;
+   uint32_t value;
+
+   TEST_ASSERT_EQUAL_HEX8(expected_type, read_frame(fd, buf, &len));
+   TEST_ASSERT_EQUAL_size_t(4, len);
+   memcpy(&value, buf, 4);
+   return value;
+}
+
+void setUp(void) {
+   snprintf(sock_path, sizeof(sock_path), "/tmp/oasis-stat-test-%d.sock", (int)getpid());
+   TEST_ASSERT_EQUAL_INT(0, stat_socket_start(sock_path));
+   client_fd = connect_client();
+}
+
+void tearDown(void) {
+   if (client_fd >= 0) {
+      close(client_fd);
+      client_fd = -1;
+   }
+   stat_socket_stop();
+}
+
+void test_encode_keeps_only_selected_sections(void) {
+   stat_shm_snapshot_t in, out;
+   uint8_t frame[STAT_SOCK_SNAPSHOT_MAX];
+   uint32_t generation;
+
+   make_snapshot(&in, 3);
+   size_t all = stat_socket_encode_snapshot(&in, 7, 0, frame);
+   TEST_ASSERT_TRUE(all <= STAT_SOCK_SNAPSHOT_MAX);
+
+   size_t len = stat_socket_encode_snapshot(&in, 7, STAT_SHM_BATTERY | STAT_SHM_FAN, frame);
+   TEST_ASSERT_TRUE(len < all);
+   TEST_ASSERT_EQUAL_HEX8(STAT_SOCK_SNAPSHOT, frame[4]);
+   TEST_ASSERT_EQUAL_INT(0, stat_socket_decode_snapshot(frame + STAT_SOCK_HEADER_LEN,
+                                                        len - STAT_SOCK_HEADER_LEN, &out,
+                                                        &generation));
+   TEST_ASSERT_EQUAL_UINT32(7, generation);
+   TEST_ASSERT_EQUAL_UINT32(STAT_SHM_BATTERY | STAT_SHM_FAN, out.valid);
+   TEST_ASSERT_EQUAL_UINT64(3000, out.timestamp_ms);
+   TEST_ASSERT_EQUAL_FLOAT(15.0f, out.battery_voltage_v);
+   TEST_ASSERT_EQUAL_UINT32(STAT_SHM_CHARGING, out.charging_state);
+   TEST_ASSERT_EQUAL_INT32(3, out.fan_rpm);
+   TEST_ASSERT_EQUAL_UINT32(0, out.cell_count);
+   TEST_ASSERT_EQUAL_FLOAT(0.0f, out.cpu_usage_pct);
+
+   /* A truncated section is rejected */
+   TEST_ASSERT_EQUAL_INT(-1, stat_socket_decode_snapshot(frame + STAT_SOCK_HEADER_LEN,
+                                                         len - STAT_SOCK_HEADER_LEN - 1, &out,
+                                                         NULL));
+}
+
+void test_snapshot_before_first_publish_is_an_error(void) {
+   send_request(client_fd, STAT_SOCK_GET_SNAPSHOT, 0, 0, 1);
+   TEST_ASSERT_EQUAL_UINT32(ENODATA, read_u32_frame(client_fd, STAT_SOCK_ERROR));
+}
+
+void test_snapshot_returns_latest(void) {
+   stat_shm_snapshot_t snap;
+   uint32_t generation;
+
+   publish(1);
+   publish(2);
+   send_request(client_fd, STAT_SOCK_GET_SNAPSHOT, STAT_SHM_CELLS | STAT_SHM_RAILS, 0, 1);
+   read_snapshot(client_fd, &snap, &generation);
+
+   TEST_ASSERT_EQUAL_UINT32(2, generation);
+   TEST_ASSERT_EQUAL_UINT32(STAT_SHM_CELLS | STAT_SHM_RAILS, snap.valid);
+   TEST_ASSERT_EQUAL_UINT32(4, snap.cell_count);
+   TEST_ASSERT_EQUAL_UINT16(3302, snap.cell_mv[3]);
+   TEST_ASSERT_EQUAL_STRING("VDD_IN", snap.rails[0].label);
+   TEST_ASSERT_EQUAL_FLOAT(2.0f, snap.rails[0].power_w);
+}
+
+void test_history_is_oldest_first_and_bounded(void) {
+   stat_shm_snapshot_t snap;
+   uint32_t generation;
+
+   for (uint32_t n = 1; n <= 3; n++) {
+      publish(n);
+   }
+   send_request(client_fd, STAT_SOCK_GET_HISTORY, STAT_SHM_FAN, 10, 2);
+   for (uint32_t n = 1; n <= 3; n++) {
+      read_snapshot(client_fd, &snap, &generation);
+      TEST_ASSERT_EQUAL_UINT32(n, generation);
+      TEST_ASSERT_EQUAL_INT32((int32_t)n, snap.fan_rpm);
+   }
+   TEST_ASSERT_EQUAL_UINT32(3, read_u32_frame(client_fd, STAT_SOCK_HISTORY_END));
+
+   send_request(client_fd, STAT_SOCK_GET_HISTORY, 0, 1, 2);
+   read_snapshot(client_fd, &snap, &generation);
+   TEST_ASSERT_EQUAL_UINT32(3, generation);
+   TEST_ASSERT_EQUAL_UINT32(1, read_u32_frame(client_fd, STAT_SOCK_HISTORY_END));
+}
+
+void test_subscription_streams_each_publish(void) {
+   stat_shm_snapshot_t snap;
+   uint32_t generation;
+
+   publish(1);
+   send_request(client_fd, STAT_SOCK_SUBSCRIBE, STAT_SHM_BATTERY, 0, 2);
+   read_snapshot(client_fd, &snap, &generation);
+   TEST_ASSERT_EQUAL_UINT32(1, generation);
+
+   for (uint32_t n = 2; n <= 4; n++) {
+      publish(n);
+      read_snapshot(client_fd, &snap, &generation);
+      TEST_ASSERT_EQUAL_UINT32(n, generation);
+      TEST_ASSERT_EQUAL_UINT32(STAT_SHM_BATTERY, snap.valid);
+      TEST_ASSERT_EQUAL_FLOAT(12.0f + (float)n, snap.battery_voltage_v);
+   }
+}
+
+void test_subscription_interval_limits_the_stream(void) {
+   stat_shm_snapshot_t snap;
+   uint32_t generation;
+
+   publish(1);
+   send_request(client_fd, STAT_SOCK_SUBSCRIBE, 0, 60000, 2);
+   read_snapshot(client_fd, &snap, &generation);
+   TEST_ASSERT_EQUAL_UINT32(1, generation);
+
+   /* Nothing is streamed inside the interval, so the next frame is the query's */
+   publish(2);
+   publish(3);
+   send_request(client_fd, STAT_SOCK_GET_SNAPSHOT, 0, 0, 1);
+   read_snapshot(client_fd, &snap, &generation);
+   TEST_ASSERT_EQUAL_UINT32(3, generation);
+}
+
+void test_bad_requests(void) {
+   uint8_t buf[16];
+
+   send_request(client_fd, 0x7f, 0, 0, 0);
+   TEST_ASSERT_EQUAL_UINT32(EINVAL, read_u32_frame(client_fd, STAT_SOCK_ERROR));
+   send_request(client_fd, STAT_SOCK_GET_HISTORY, 0, 0, 1);
+   TEST_ASSERT_EQUAL_UINT32(EINVAL, read_u32_frame(client_fd, STAT_SOCK_ERROR));
+
+   /* An oversized length is not this protocol: the server hangs up */
+   uint32_t length = 1u << 20;
+   TEST_ASSERT_EQUAL_INT(4, (int)send(client_fd, &length, 4, 0));
+   TEST_ASSERT_EQUAL_INT(0, (int)recv(client_fd, buf, sizeof(buf), 0));
+}
+
+void test_stop_removes_the_socket(void) {
+   struct stat st;
+
+   TEST_ASSERT_EQUAL_INT(0, lstat(sock_path, &st));
+   TEST_ASSERT_TRUE(S_ISSOCK(st.st_mode));
+   stat_socket_stop();
+   TEST_ASSERT_EQUAL_INT(-1, lstat(sock_path, &st));
+}
+
+int main(void) {
+   UNITY_BEGIN();
+
+   RUN_TEST(test_encode_keeps_only_selected_sections);
+   RUN_TEST(test_snapshot_before_first_publish_is_an_error);
+   RUN_TEST(test_snapshot_returns_latest);
+   RUN_TEST(test_history_is_oldest_first_and_bounded);
+   RUN_TEST(test_subscription_streams_each_publish);
+   RUN_TEST(test_subscription_interval_limits_the_stream);
+   RUN_TEST(test_bad_requests);
+   RUN_TEST(test_stop_removes_the_socket);
+
+   return UNITY_END();
+}
@@ -0,0 +1,98 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s).
+ *
+ * Unit tests for the publish window statistics: Welford mean and variance,
+ * extremes, the time integral and reset.
+ */
+
+#include "stat_window.h"
+#include "unity.h"
+
+static stat_window_t w;
+
+void setUp(void) {
+   stat_window_reset(&w);
+}
+
+void tearDown(void) {
+}
+
+void test_empty_window(void) {
+   TEST_ASSERT_EQUAL_UINT32(0, w.count);
+   TEST_ASSERT_EQUAL_FLOAT(0.0f, stat_window_stddev(&w));
+}
+
+void test_single_sample(void) {
+   stat_window_add(&w, -2.5f, 1.0f);
+   TEST_ASSERT_EQUAL_UINT32(1, w.count);
+   TEST_ASSERT_EQUAL_FLOAT(-2.5f, w.min);
+   TEST_ASSERT_EQUAL_FLOAT(-2.5f, w.max);
+   TEST_ASSERT_DOUBLE_WITHIN(1e-9, -2.5, w.mean);
+   TEST_ASSERT_EQUAL_FLOAT(0.0f, stat_window_stddev(&w));
+}
+
+void test_mean_stddev_and_extremes(void) {
+   static const float samples[] = { 2.0f, 4.0f, 4.0f, 4.0f, 5.0f, 5.0f, 7.0f, 9.0f };
+
+   for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+      stat_window_add(&w, samples[i], 0.25f);
+   }
+   TEST_ASSERT_EQUAL_UINT32(8, w.count);
+   TEST_ASSERT_DOUBLE_WITHIN(1e-9, 5.0, w.mean);
+   TEST_ASSERT_FLOAT_WITHIN(1e-6f, 2.0f, stat_window_stddev(&w));
+   TEST_ASSERT_EQUAL_FLOAT(2.0f, w.min);
+   TEST_ASSERT_EQUAL_FLOAT(9.0f, w.max);
+   TEST_ASSERT_DOUBLE_WITHIN(1e-9, 10.0, w.integral);
+   TEST_ASSERT_DOUBLE_WITHIN(1e-9, 2.0, w.duration_s);
+}
+
+void test_large_offset_keeps_precision(void) {
+   /* A naive sum of squares loses the spread of samples around a large mean */
+   for (int i = 0; i < 1000; i++) {
+      stat_window_add(&w, (i % 2) ? 100000.1f : 99999.9f, 0.0f);
+   }
+   TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.1f, stat_window_stddev(&w));
+   TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, w.duration_s);
+}
+
+void test_reset_starts_new_window(void) {
+   stat_battery_window_t battery;
+
+   stat_battery_window_reset(&battery);
+   stat_battery_window_add(&battery, 16.0f, 3.0f, 48.0f, 2.0f);
+   TEST_ASSERT_DOUBLE_WITHIN(1e-9, 6.0, battery.current.integral);
+   TEST_ASSERT_DOUBLE_WITHIN(1e-9, 96.0, battery.power.integral);
+
+   stat_battery_window_reset(&battery);
+   stat_battery_window_add(&battery, 15.0f, -1.0f, -15.0f, 1.0f);
+   TEST_ASSERT_EQUAL_UINT32(1, battery.voltage.count);
+   TEST_ASSERT_EQUAL_FLOAT(-1.0f, battery.current.max);
+   TEST_ASSERT_DOUBLE_WITHIN(1e-9, -1.0, battery.current.integral);
+}
+
+int main(void) {
+   UNITY_BEGIN();
+
+   RUN_TEST(test_empty_window);
+   RUN_TEST(test_single_sample);
+   RUN_TEST(test_mean_stddev_and_extremes);
+   RUN_TEST(test_large_offset_keeps_precision);
+   RUN_TEST(test_reset_starts_new_window);
+
+   return UNITY_END();
+}
@@ -0,0 +1,141 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s).
+ *
+ * Unit tests for the sysfs discovery cache and uevent classification. The
+ * cache is written to a temporary file; uevents are built in memory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sysfs_discovery.h"
+#include "unity.h"
+
+static char cache_file[64];
+
+/* Build a kernel-style uevent: "action@devpath" then NUL-separated fields */
+static size_t make_uevent(char *buf, const char *action, const char *subsystem) {
+   return (size_t)snprintf(buf, 256, "%s@/devices/x%cACTION=%s%cDEVPATH=/devices/x%cSUBSYSTEM=%s%c",
+                           action, '\0', action, '\0', '\0', subsystem, '\0');
+}
+
+void setUp(void) {
+   snprintf(cache_file, sizeof(cache_file), "/tmp/test_sysfs_discovery_%d", (int)getpid());
+   unlink(cache_file);
+}
+
+void tearDown(void) {
+   sysfs_discovery_cleanup();
+   unlink(cache_file);
+}
+
+void test_missing_file_loads_empty(void) {
+   char value[64];
+   TEST_ASSERT_EQUAL_INT(0, sysfs_discovery_load(cache_file));
+   TEST_ASSERT_EQUAL_INT(-1, sysfs_discovery_get(SYSFS_KEY_FAN_RPM, value, sizeof(value)));
+}
+
+void test_save_and_reload_round_trip(void) {
+   char value[128];
+   sysfs_discovery_load(cache_file);
+   sysfs_discovery_set(SYSFS_KEY_FAN_RPM, "/sys/class/hwmon/hwmon3/fan1_input");
+   sysfs_discovery_set(SYSFS_KEY_FAN_NAME, "pwmfan");
+   sysfs_discovery_set(SYSFS_KEY_THERMAL, "/sys/devices/virtual/thermal/thermal_zone8/temp");
+   TEST_ASSERT_EQUAL_INT(0, sysfs_discovery_save());
+
+   sysfs_discovery_cleanup();
+   TEST_ASSERT_EQUAL_INT(3, sysfs_discovery_load(cache_file));
+   TEST_ASSERT_EQUAL_INT(0, sysfs_discovery_get(SYSFS_KEY_FAN_RPM, value, sizeof(value)));
+   TEST_ASSERT_EQUAL_STRING("/sys/class/hwmon/hwmon3/fan1_input", value);
+   TEST_ASSERT_EQUAL_INT(0, sysfs_discovery_get(SYSFS_KEY_FAN_NAME, value, sizeof(value)));
+   TEST_ASSERT_EQUAL_STRING("pwmfan", value);
+   TEST_ASSERT_EQUAL_INT(0, sysfs_discovery_get(SYSFS_KEY_THERMAL, value, sizeof(value)));
+   TEST_ASSERT_EQUAL_STRING("/sys/devices/virtual/thermal/thermal_zone8/temp", value);
+}
+
+void test_set_empty_drops_entry(void) {
+   char value[128];
+   sysfs_discovery_load(cache_file);
+   sysfs_discovery_set(SYSFS_KEY_FAN_RPM, "/sys/class/hwmon/hwmon3/rpm");
+   sysfs_discovery_set(SYSFS_KEY_FAN_PWM, "/sys/class/hwmon/hwmon3/pwm1");
+   sysfs_discovery_set(SYSFS_KEY_FAN_RPM, "");
+   TEST_ASSERT_EQUAL_INT(-1, sysfs_discovery_get(SYSFS_KEY_FAN_RPM, value, sizeof(value)));
+   TEST_ASSERT_EQUAL_INT(0, sysfs_discovery_get(SYSFS_KEY_FAN_PWM, value, sizeof(value)));
+   TEST_ASSERT_EQUAL_STRING("/sys/class/hwmon/hwmon3/pwm1", value);
+}
+
+void test_get_rejects_small_buffer(void) {
+   char value[8];
+   sysfs_discovery_load(cache_file);
+   sysfs_discovery_set(SYSFS_KEY_INA3221, "/sys/bus/i2c/drivers/ina3221/1-0040/hwmon/hwmon2");
+   TEST_ASSERT_EQUAL_INT(-1, sysfs_discovery_get(SYSFS_KEY_INA3221, value, sizeof(value)));
+}
+
+void test_malformed_lines_are_skipped(void) {
+   char value[128];
+   FILE *fp = fopen(cache_file, "w");
+   TEST_ASSERT_NOT_NULL(fp);
+   fputs("# comment\n\nfan_rpm\nthermal_temp relative/path\nfan_hwmon_name \n"
+         "ina3221_hwmon /sys/x/hwmon1\n",
+         fp);
+   fclose(fp);
+
+   TEST_ASSERT_EQUAL_INT(1, sysfs_discovery_load(cache_file));
+   TEST_ASSERT_EQUAL_INT(0, sysfs_discovery_get(SYSFS_KEY_INA3221, value, sizeof(value)));
+   TEST_ASSERT_EQUAL_STRING("/sys/x/hwmon1", value);
+}
+
+void test_disabled_cache_is_not_written(void) {
+   TEST_ASSERT_EQUAL_INT(-1, sysfs_discovery_load(""));
+   sysfs_discovery_set(SYSFS_KEY_FAN_RPM, "/sys/class/hwmon/hwmon0/rpm");
+   TEST_ASSERT_EQUAL_INT(0, sysfs_discovery_save());
+   TEST_ASSERT_NOT_EQUAL(0, access(cache_file, F_OK));
+}
+
+void test_uevent_classification(void) {
+   char buf[256];
+   size_t len;
+
+   len = make_uevent(buf, "add", "hwmon");
+   TEST_ASSERT_EQUAL_UINT(SYSFS_CHANGE_HWMON, sysfs_discovery_parse_uevent(buf, len));
+   len = make_uevent(buf, "remove", "thermal");
+   TEST_ASSERT_EQUAL_UINT(SYSFS_CHANGE_THERMAL, sysfs_discovery_parse_uevent(buf, len));
+   len = make_uevent(buf, "move", "hwmon");
+   TEST_ASSERT_EQUAL_UINT(SYSFS_CHANGE_HWMON, sysfs_discovery_parse_uevent(buf, len));
+
+   /* Trip-point "change" events and other subsystems are ignored */
+   len = make_uevent(buf, "change", "thermal");
+   TEST_ASSERT_EQUAL_UINT(0, sysfs_discovery_parse_uevent(buf, len));
+   len = make_uevent(buf, "add", "usb");
+   TEST_ASSERT_EQUAL_UINT(0, sysfs_discovery_parse_uevent(buf, len));
+}
+
+int main(void) {
+   UNITY_BEGIN();
+
+   RUN_TEST(test_missing_file_loads_empty);
+   RUN_TEST(test_save_and_reload_round_trip);
+   RUN_TEST(test_set_empty_drops_entry);
+   RUN_TEST(test_get_rejects_small_buffer);
+   RUN_TEST(test_malformed_lines_are_skipped);
+   RUN_TEST(test_disabled_cache_is_not_written);
+   RUN_TEST(test_uevent_classification);
+
+   return UNITY_END();
+}
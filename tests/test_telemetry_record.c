@@ -0,0 +1,240 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s).
+ *
+ * Unit tests for telemetry record/replay. Writes a recording to a temporary
+ * file, replays it, and feeds recorded Daly frames back through the driver's
+ * fetch hook — no hardware required.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "daly_bms.h"
+#include "daly_bms_internal.h"
+#include "telemetry_record.h"
+#include "unity.h"
+
+static char rec_path[64];
+
+/* Build a valid BMS->host response frame for cmd with the given data */
+static void make_frame(uint8_t cmd, const uint8_t data[8], uint8_t frame[DALY_FRAME_LEN]) {
+   frame[0] = 0xA5;
+   frame[1] = 0x01;
+   frame[2] = cmd;
+   frame[3] = 0x08;
+   memcpy(frame + 4, data, 8);
+   frame[DALY_FRAME_LEN - 1] = daly_checksum(frame, DALY_FRAME_LEN - 1);
+}
+
+static const telemetry_record_header_t test_header = { .r_shunt = 0.001f,
+                                                       .max_current = 10.0f,
+                                                       .i2c_addr = 0x45,
+                                                       .power_monitor = 3,
+                                                       .bms_enable = true,
+                                                       .interval_ms = 250,
+                                                       .bms_interval_ms = 1000 };
+
+/* Write a two-tick recording: tick 1 has everything, tick 2 only proc */
+static void write_sample_recording(void) {
+   uint8_t data[8] = { 0x00, 0x00, 0x27, 0x10, 0x00, 0x00, 0x0E, 0x74 };
+   uint8_t frame[DALY_FRAME_LEN];
+   make_frame(DALY_CMD_READ_CAPACITY, data, frame);
+
+   TEST_ASSERT_EQUAL_INT(0, telemetry_record_open(rec_path, &test_header));
+   TEST_ASSERT_TRUE(telemetry_record_active());
+
+   telemetry_record_tick();
+   ina238_raw_t raw = { .vbus = 0x1234, .current = 0xFFF0, .power = 0x00ABCD, .dietemp = 0x0C80 };
+   telemetry_record_ina238(&raw);
+
+   ina3221_measurements_t m = { 0 };
+   m.num_channels = 2;
+   m.channels[0] = (ina3221_channel_t){ .channel = 1, .valid = true };
+   snprintf(m.channels[0].label, sizeof(m.channels[0].label), "VDD IN");
+   ina3221_apply_raw(&m.channels[0], 5012, 1234);
+   m.channels[1] = (ina3221_channel_t){ .channel = 3, .valid = true };
+   snprintf(m.channels[1].label, sizeof(m.channels[1].label), "VDD_CPU_GPU_CV");
+   ina3221_apply_raw(&m.channels[1], 4990, -5);
+   telemetry_record_ina3221(&m);
+
+   telemetry_record_daly_frame(NULL, NULL, DALY_CMD_READ_CAPACITY, frame);
+   telemetry_record_daly_frame(NULL, NULL, DALY_CMD_READ_CAPACITY, NULL);
+
+   telemetry_proc_sample_t p = { 12.5f, 40.25f, 51.0f, true, 3200, 53, 136 };
+   telemetry_record_proc(&p);
+
+   telemetry_record_tick();
+   telemetry_proc_sample_t p2 = { 1.0f, 2.0f, -1.0f, false, 0, 0, 0 };
+   telemetry_record_proc(&p2);
+
+   telemetry_record_close();
+   TEST_ASSERT_FALSE(telemetry_record_active());
+}
+
+void setUp(void) {
+   snprintf(rec_path, sizeof(rec_path), "/tmp/test_telemetry_record_%d.rec", (int)getpid());
+}
+
+void tearDown(void) {
+   telemetry_replay_close();
+   daly_bms_set_frame_hooks(NULL);
+   unlink(rec_path);
+}
+
+void test_header_round_trip(void) {
+   write_sample_recording();
+
+   telemetry_record_header_t hdr;
+   TEST_ASSERT_EQUAL_INT(0, telemetry_replay_open(rec_path, &hdr));
+   TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.001f, hdr.r_shunt);
+   TEST_ASSERT_FLOAT_WITHIN(1e-3f, 10.0f, hdr.max_current);
+   TEST_ASSERT_EQUAL_HEX8(0x45, hdr.i2c_addr);
+   TEST_ASSERT_EQUAL_INT(3, hdr.power_monitor);
+   TEST_ASSERT_TRUE(hdr.bms_enable);
+   TEST_ASSERT_EQUAL_INT(250, hdr.interval_ms);
+   TEST_ASSERT_EQUAL_INT(1000, hdr.bms_interval_ms);
+}
+
+void test_ticks_round_trip(void) {
+   write_sample_recording();
+
+   telemetry_record_header_t hdr;
+   static telemetry_tick_t tick;
+   TEST_ASSERT_EQUAL_INT(0, telemetry_replay_open(rec_path, &hdr));
+
+   TEST_ASSERT_EQUAL_INT(1, telemetry_replay_next(&tick));
+   TEST_ASSERT_TRUE(tick.wall_ms > 0);
+   uint64_t first_us = tick.t_us;
+
+   TEST_ASSERT_TRUE(tick.has_ina238);
+   TEST_ASSERT_EQUAL_HEX16(0x1234, tick.ina238.vbus);
+   TEST_ASSERT_EQUAL_HEX16(0xFFF0, tick.ina238.current);
+   TEST_ASSERT_EQUAL_HEX32(0x00ABCD, tick.ina238.power);
+   TEST_ASSERT_EQUAL_HEX16(0x0C80, tick.ina238.dietemp);
+
+   TEST_ASSERT_EQUAL_INT(2, tick.ina3221_count);
+   TEST_ASSERT_EQUAL_INT(1, tick.ina3221[0].channel);
+   TEST_ASSERT_EQUAL_INT(5012, tick.ina3221[0].voltage_mv);
+   TEST_ASSERT_EQUAL_INT(1234, tick.ina3221[0].current_ma);
+   TEST_ASSERT_EQUAL_STRING("VDD IN", tick.ina3221[0].label);
+   TEST_ASSERT_EQUAL_INT(3, tick.ina3221[1].channel);
+   TEST_ASSERT_EQUAL_INT(-5, tick.ina3221[1].current_ma);
+
+   TEST_ASSERT_EQUAL_INT(2, tick.daly_count);
+   TEST_ASSERT_TRUE(tick.daly[0].ok);
+   TEST_ASSERT_FALSE(tick.daly[1].ok);
+
+   TEST_ASSERT_TRUE(tick.has_proc);
+   TEST_ASSERT_FLOAT_WITHIN(1e-4f, 12.5f, tick.proc.cpu_usage);
+   TEST_ASSERT_FLOAT_WITHIN(1e-4f, 40.25f, tick.proc.memory_usage);
+   TEST_ASSERT_TRUE(tick.proc.fan_available);
+   TEST_ASSERT_EQUAL_INT(3200, tick.proc.fan_rpm);
+   TEST_ASSERT_EQUAL_INT(136, tick.proc.fan_pwm);
+
+   TEST_ASSERT_EQUAL_INT(1, telemetry_replay_next(&tick));
+   TEST_ASSERT_TRUE(tick.t_us >= first_us);
+   TEST_ASSERT_FALSE(tick.has_ina238);
+   TEST_ASSERT_EQUAL_INT(0, tick.ina3221_count);
+   TEST_ASSERT_EQUAL_INT(0, tick.daly_count);
+   TEST_ASSERT_TRUE(tick.has_proc);
+   TEST_ASSERT_FALSE(tick.proc.fan_available);
+   TEST_ASSERT_FLOAT_WITHIN(1e-4f, -1.0f, tick.proc.system_temperature);
+
+   TEST_ASSERT_EQUAL_INT(0, telemetry_replay_next(&tick));
+}
+
+void test_replayed_frames_drive_the_driver(void) {
+   write_sample_recording();
+
+   telemetry_record_header_t hdr;
+   static telemetry_tick_t tick;
+   TEST_ASSERT_EQUAL_INT(0, telemetry_replay_open(rec_path, &hdr));
+   TEST_ASSERT_EQUAL_INT(1, telemetry_replay_next(&tick));
+
+   daly_device_t dev;
+   TEST_ASSERT_EQUAL_INT(0, daly_bms_init_offline(&dev, "replay", 500));
+   daly_frame_hooks_t hooks = { .fetch_frame = telemetry_replay_fetch_daly_frame, .ctx = &tick };
+   daly_bms_set_frame_hooks(&hooks);
+
+   /* First recorded exchange succeeded: 10000 mAh, 3700 mV nominal */
+   daly_capacity_t cap = { 0 };
+   TEST_ASSERT_EQUAL_INT(0, daly_bms_read_capacity(&dev, &cap));
+   TEST_ASSERT_EQUAL_INT(10000, cap.rated_capacity_mah);
+   TEST_ASSERT_EQUAL_INT(3700, cap.nominal_cell_mv);
+
+   /* Second recorded exchange failed, and then the tick is exhausted */
+   TEST_ASSERT_EQUAL_INT(-1, daly_bms_read_capacity(&dev, &cap));
+   TEST_ASSERT_EQUAL_INT(-1, daly_bms_read_capacity(&dev, &cap));
+}
+
+void test_fetch_rejects_command_mismatch(void) {
+   static telemetry_tick_t tick;
+   memset(&tick, 0, sizeof(tick));
+   uint8_t data[8] = { 0 };
+   make_frame(DALY_CMD_PACK_INFO, data, tick.daly[0].frame);
+   tick.daly[0].cmd = DALY_CMD_PACK_INFO;
+   tick.daly[0].ok = true;
+   tick.daly_count = 1;
+
+   uint8_t frame[DALY_FRAME_LEN];
+   TEST_ASSERT_EQUAL_INT(-1,
+                         telemetry_replay_fetch_daly_frame(&tick, NULL, DALY_CMD_STATUS, frame));
+   TEST_ASSERT_EQUAL_INT(0, tick.daly_next);
+   TEST_ASSERT_EQUAL_INT(0,
+                         telemetry_replay_fetch_daly_frame(&tick, NULL, DALY_CMD_PACK_INFO, frame));
+   TEST_ASSERT_EQUAL_MEMORY(tick.daly[0].frame, frame, DALY_FRAME_LEN);
+}
+
+void test_replay_rejects_non_recording(void) {
+   FILE *fp = fopen(rec_path, "w");
+   TEST_ASSERT_NOT_NULL(fp);
+   fputs("hello world\n", fp);
+   fclose(fp);
+
+   telemetry_record_header_t hdr;
+   TEST_ASSERT_EQUAL_INT(-1, telemetry_replay_open(rec_path, &hdr));
+}
+
+void test_replay_reports_malformed_record(void) {
+   FILE *fp = fopen(rec_path, "w");
+   TEST_ASSERT_NOT_NULL(fp);
+   fputs("V 1\nT 0 0\nR 12 zz\n", fp);
+   fclose(fp);
+
+   telemetry_record_header_t hdr;
+   static telemetry_tick_t tick;
+   TEST_ASSERT_EQUAL_INT(0, telemetry_replay_open(rec_path, &hdr));
+   TEST_ASSERT_EQUAL_INT(-1, telemetry_replay_next(&tick));
+}
+
+int main(void) {
+   UNITY_BEGIN();
+
+   RUN_TEST(test_header_round_trip);
+   RUN_TEST(test_ticks_round_trip);
+   RUN_TEST(test_replayed_frames_drive_the_driver);
+   RUN_TEST(test_fetch_rejects_command_mismatch);
+   RUN_TEST(test_replay_rejects_non_recording);
+   RUN_TEST(test_replay_reports_malformed_record);
+
+   return UNITY_END();
+}
@@ -12,11 +12,13 @@ import threading
 import time
 from datetime import datetime
 import argparse
+import urllib.request
 
 
 class StatMonitor:
    def __init__(self, mqtt_host="localhost", mqtt_port=1883, mqtt_topic="stat/telemetry",
-                mqtt_username=None, mqtt_password=None, mqtt_tls=False, mqtt_ca_cert=None):
+                mqtt_username=None, mqtt_password=None, mqtt_tls=False, mqtt_ca_cert=None,
+                events_url=None):
       self.mqtt_host = mqtt_host
       self.mqtt_port = mqtt_port
       self.mqtt_topic = mqtt_topic
@@ -24,6 +26,7 @@ class StatMonitor:
       self.mqtt_password = mqtt_password
       self.mqtt_tls = mqtt_tls
       self.mqtt_ca_cert = mqtt_ca_cert
+      self.events_url = events_url
       self.debug_mode = False  # Can be enabled externally
       
       # Data storage - separate different battery sources
@@ -39,7 +42,7 @@ class StatMonitor:
       
       # Create main window
       self.root = tk.Tk()
-      self.root.title(f"OASIS STAT Monitor - {mqtt_host}:{mqtt_port}")
+      self.root.title(f"OASIS STAT Monitor - {events_url or f'{mqtt_host}:{mqtt_port}'}")
       self.root.geometry("1300x1400")  # Larger window to fit all data
       self.root.configure(bg='#2b2b2b')
       
@@ -49,12 +52,17 @@ class StatMonitor:
       # Create UI
       self.create_widgets()
       
-      # MQTT client
-      self.mqtt_client = None
-      self.setup_mqtt()
-      
       # Start update thread
       self.running = True
+
+      # MQTT client, or the event stream when given one
+      self.mqtt_client = None
+      if self.events_url:
+         self.events_thread = threading.Thread(target=self.events_loop, daemon=True)
+         self.events_thread.start()
+      else:
+         self.setup_mqtt()
+      
       self.update_thread = threading.Thread(target=self.update_loop, daemon=True)
       self.update_thread.start()
       
@@ -494,16 +502,54 @@ class StatMonitor:
       print("Disconnected from MQTT broker")
       self.data['connection']['status'] = 'Disconnected'
    
+   def events_loop(self):
+      """Read the Server-Sent Events stream, reconnecting when it drops"""
+      retry_s = 2.0
+      while self.running:
+         try:
+            with urllib.request.urlopen(self.events_url, timeout=60) as stream:
+               print(f"Connected to event stream {self.events_url}")
+               self.data['connection']['status'] = 'Connected'
+               for line in stream:
+                  if not self.running:
+                     return
+                  if line.startswith(b'data: '):
+                     self.handle_payload(line[6:].rstrip(b'\r\n'))
+                  elif line.startswith(b'retry: '):
+                     retry_s = int(line[7:]) / 1000.0
+            self.data['connection']['status'] = 'Disconnected'
+         except Exception as e:
+            print(f"Event stream error: {e}")
+            self.data['connection']['status'] = f'Error: {e}'
+         time.sleep(retry_s)
+
    def on_mqtt_message(self, client, userdata, msg):
       """Handle incoming MQTT messages"""
+      self.handle_payload(msg.payload)
+
+   def handle_payload(self, raw):
+      """Handle one telemetry message, from MQTT or the event stream"""
+      try:
+         payload = json.loads(raw.decode())
+         if payload.get('type') == 'Bundle':
+            # One update's messages under a single envelope (--mqtt-bundle)
+            for section in payload.get('sections', []):
+               section.setdefault('timestamp', payload.get('timestamp'))
+               self.handle_section(section, len(raw))
+         else:
+            self.handle_section(payload, len(raw))
+      except json.JSONDecodeError as e:
+         print(f"JSON decode error: {e}")
+
+   def handle_section(self, payload, size):
+      """Route one telemetry message to the data store"""
       try:
-         payload = json.loads(msg.payload.decode())
          # OCP v1.4: route on 'type' field (fallback to 'device' for legacy)
          msg_type = payload.get('type', '') or payload.get('device', '')
          sensor = payload.get('sensor', '')
 
          if self.debug_mode:
-            print(f"[DEBUG] Received: type='{msg_type}', sensor='{sensor}', size={len(msg.payload)} bytes")
+            print(f"[DEBUG] Received: type='{msg_type}', sensor='{sensor}', size={size} bytes")
 
          self.data['connection']['last_update'] = datetime.now()
 
@@ -547,8 +593,6 @@ class StatMonitor:
             if self.debug_mode:
                print(f"[DEBUG] Updated {source_name} data")
             
-      except json.JSONDecodeError as e:
-         print(f"JSON decode error: {e}")
       except Exception as e:
          print(f"Message processing error: {e}")
    
@@ -855,6 +899,8 @@ def main():
    parser.add_argument('--password', default=None, help='MQTT password')
    parser.add_argument('--tls', action='store_true', help='Enable MQTT TLS encryption')
    parser.add_argument('--ca-cert', default=None, help='Path to CA certificate (implies --tls)')
+   parser.add_argument('--events', default=None, metavar='URL',
+                       help='Read the event stream (http://HOST:9465/events) instead of MQTT')
    parser.add_argument('--debug', action='store_true', help='Enable debug output for MQTT messages')
 
    args = parser.parse_args()
@@ -864,15 +910,19 @@ def main():
       args.tls = True
 
    print(f"Starting OASIS STAT Monitor...")
-   print(f"Connecting to MQTT broker: {args.host}:{args.port}")
-   print(f"Subscribing to topic: {args.topic}")
+   if args.events:
+      print(f"Reading event stream: {args.events}")
+   else:
+      print(f"Connecting to MQTT broker: {args.host}:{args.port}")
+      print(f"Subscribing to topic: {args.topic}")
    if args.debug:
       print("Debug mode enabled - MQTT messages will be logged")
 
    try:
       monitor = StatMonitor(args.host, args.port, args.topic,
                             mqtt_username=args.username, mqtt_password=args.password,
-                            mqtt_tls=args.tls, mqtt_ca_cert=args.ca_cert)
+                            mqtt_tls=args.tls, mqtt_ca_cert=args.ca_cert,
+                            events_url=args.events)
       # Enable debug mode if requested
       if args.debug:
          monitor.debug_mode = True